@@ -25,6 +25,8 @@ from tqdm import tqdm
 
 from dragons.meraxes import io as samio
 
+from read_galaxies import read_gals
+
 __author__ = "Simon Mutch"
 __date__   = "2013/08/14"
 
@@ -145,8 +147,8 @@ if __name__ == '__main__':
             np_ind.append([])
 
     # Find the index of our requested galaxy
-    gal = samio.read_gals(fname_gals, snapshot=last_snapnum, quiet=True, h=0.7,
-                          props=gal_props)
+    gal = read_gals(fname_gals, snapshot=last_snapnum, quiet=True, h=0.7,
+                    props=gal_props)
     ind = np.argwhere(gal["ID"]==galaxy_ID)[0][0]
 
     # Walk the fp and np indices and construct the graph
@@ -156,8 +158,8 @@ if __name__ == '__main__':
     # Attach the galaxies to the graph
     for snap in tqdm(snaplist, desc="Generating graph"):
         try:
-            gal = samio.read_gals(fname_gals, snapshot=snap, quiet=True, h=0.7,
-                                  props=gal_props)
+            gal = read_gals(fname_gals, snapshot=snap, quiet=True, h=0.7,
+                            props=gal_props)
         except IndexError:
             continue
         for node in G.iter_nodes():
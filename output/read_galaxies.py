@@ -0,0 +1,119 @@
+#!/usr/bin/env python
+
+"""Read the galaxies of a single snapshot from a Meraxes master file.
+
+Handles both galaxy output layouts (see `GalaxyOutputLayout`):
+
+    0 -> each core file holds one H5TB compound table per snapshot
+    1 -> each core file holds one dataset per galaxy property
+
+Usage: read_galaxies.py <master_file> <snapshot> [<prop>...]
+
+"""
+
+import h5py as h5
+import numpy as np
+from numpy.lib import recfunctions as rfn
+
+
+def _read_core_table(ds, props):
+    gals = ds[()]
+    if props is not None:
+        gals = rfn.repack_fields(gals[list(props)])
+    return gals
+
+
+def _read_core_columns(group, props):
+    names = list(props) if props is not None else list(group.keys())
+    missing = [name for name in names if name not in group]
+    if missing:
+        raise KeyError("Properties not written to the output file: {}".format(", ".join(missing)))
+
+    n_gals = group.attrs["NGalaxies"][0] if "NGalaxies" in group.attrs else group[names[0]].shape[0]
+    dtype = [(name, group[name].dtype, group[name].shape[1:]) for name in names]
+    gals = np.empty(n_gals, dtype=dtype)
+    for name in names:
+        if n_gals > 0:
+            gals[name] = group[name][()]
+    return gals
+
+
+def read_gals(fname, snapshot, props=None, h=None, quiet=True, sim_props=False, h_scaling=None):
+    """Read the galaxies at `snapshot` from master file `fname`.
+
+    Parameters
+    ----------
+    fname : str
+        Path to the master file (`<FileNameGalaxies>.hdf5`).
+    snapshot : int
+        Snapshot number.
+    props : sequence of str, optional
+        Properties to read.  All available properties are read if `None`.
+    h : float, optional
+        If given, convert properties to this value of the Hubble constant using
+        the stored `HubbleConversions`.
+    quiet : bool
+        Suppress progress messages.
+    sim_props : bool
+        Also return the run parameters (as read by `dragons.meraxes.io.read_input_params`).
+    h_scaling : dict, optional
+        Functions `f(value, h)` overriding the stored `HubbleConversions` of the named properties.
+
+    Returns
+    -------
+    gals : numpy structured array
+    simprops : dict
+        Only if `sim_props` is True.
+
+    This takes the same arguments as `dragons.meraxes.io.read_gals`, which only reads the table layout.
+    """
+
+    with h5.File(fname, "r") as fd:
+        snap_group = fd["Snap{:03d}".format(snapshot)]
+        core_names = sorted((k for k in snap_group.keys() if k.startswith("Core")), key=lambda k: int(k[4:]))
+
+        gals = []
+        for core in core_names:
+            obj = snap_group[core].get("Galaxies")
+            if obj is None:
+                continue
+            if isinstance(obj, h5.Group):
+                gals.append(_read_core_columns(obj, props))
+            else:
+                gals.append(_read_core_table(obj, props))
+            if not quiet:
+                print("Read {:d} galaxies from {:s}".format(gals[-1].size, core))
+
+        if len(gals) == 0:
+            raise IndexError("No galaxies present at snapshot {:d}".format(snapshot))
+        gals = np.concatenate(gals)
+
+        if h is not None:
+            conversions = fd["HubbleConversions"].attrs
+            for name in gals.dtype.names:
+                if h_scaling is not None and name in h_scaling:
+                    gals[name] = h_scaling[name](gals[name], h)
+                    continue
+                conv = conversions.get(name)
+                if conv is None:
+                    continue
+                conv = conv.decode() if isinstance(conv, bytes) else str(conv)
+                if conv != "None":
+                    gals[name] = eval(conv, {"v": gals[name], "h": h})
+
+    if sim_props:
+        from dragons.meraxes.io import read_input_params
+
+        return gals, read_input_params(fname, h)
+
+    return gals
+
+
+if __name__ == "__main__":
+    from docopt import docopt
+
+    args = docopt(__doc__)
+    props = args["<prop>"] if args["<prop>"] else None
+    gals = read_gals(args["<master_file>"], int(args["<snapshot>"]), props=props, quiet=False)
+    print(gals.dtype)
+    print("{:d} galaxies".format(gals.size))
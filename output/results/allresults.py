@@ -28,6 +28,10 @@ import sfrf_z5, smf_z5, shmr_z5
 import sfrf_z6, smf_z6
 import sfrf_z7, smf_z7
 import sfh
+import sys
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+from read_galaxies import read_gals
 
 __author__ = "Simon Mutch"
 __date__   = "2014-07-08"
@@ -80,7 +84,7 @@ if __name__ == '__main__':
     if not redshift or (redshift == 5):
         snap, _ = meraxes.io.check_for_redshift(fname, 5.0, tol=0.1)
 
-        gals, simprops = meraxes.io.read_gals(fname, snapshot=snap, props=props,
+        gals, simprops = read_gals(fname, snapshot=snap, props=props,
                 sim_props=True)
         gals = gals.view(np.recarray)
         simprops["h"] = h
@@ -116,7 +120,7 @@ if __name__ == '__main__':
     if not redshift or (redshift == 6):
         snap, _ = meraxes.io.check_for_redshift(fname, 6.0, tol=0.1)
 
-        gals, simprops = meraxes.io.read_gals(fname, snapshot=snap, props=props,
+        gals, simprops = read_gals(fname, snapshot=snap, props=props,
                 sim_props=True, h=h)
         gals = gals.view(np.recarray)
         simprops["h"] = h
@@ -140,7 +144,7 @@ if __name__ == '__main__':
     if not redshift or (redshift == 7):
         snap, _ = meraxes.io.check_for_redshift(fname, 7.0, tol=0.1)
 
-        gals, simprops = meraxes.io.read_gals(fname, snapshot=snap, props=props,
+        gals, simprops = read_gals(fname, snapshot=snap, props=props,
                 sim_props=True, h=h)
         gals = gals.view(np.recarray)
         simprops["h"] = h
@@ -16,6 +16,10 @@ import matplotlib.pyplot as plt
 from docopt import docopt
 from dragons import meraxes, munge
 import os
+import sys
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", ".."))
+from read_galaxies import read_gals
 
 __author__ = "Simon Mutch"
 __date__ = "2014-10-07"
@@ -67,10 +71,10 @@ if __name__ == '__main__':
 
     props = ("StellarMass", "ColdGas", "DiskScaleLength", "Type",
              "MaxReheatFrac", "MaxEjectedFrac")
-    gals, simprops = meraxes.io.read_gals(fname, snapshot=snap, props=props,
-                                          sim_props=True, h=h,
-                                          h_scaling={'MaxReheatFrac' : lambda
-                                                     x, h: x})
+    gals, simprops = read_gals(fname, snapshot=snap, props=props,
+                               sim_props=True, h=h,
+                               h_scaling={'MaxReheatFrac' : lambda
+                                          x, h: x})
     gals = gals.view(np.recarray)
 
     fig, ax = plt.subplots(1,1)
@@ -14,6 +14,10 @@ from docopt import docopt
 from dragons import meraxes
 from astropy.utils.console import ProgressBar
 import os
+import sys
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+from read_galaxies import read_gals
 
 __author__ = "Simon Mutch"
 __date__ = "2014-08-13"
@@ -35,8 +39,8 @@ def plot(fname, ax, h):
     with ProgressBar(snaps.shape[0]) as bar:
         for snap in snaps:
             try:
-                gals = meraxes.io.read_gals(fname, snapshot=snap, props=props,
-                                            h=h, quiet=True)
+                gals = read_gals(fname, snapshot=snap, props=props,
+                                 h=h, quiet=True)
             except IndexError:
                 continue
             gals = gals.view(np.recarray)
@@ -15,6 +15,10 @@ from dragons import plotutils, meraxes, munge
 import pandas as pd
 from astropy import log
 import os
+import sys
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+from read_galaxies import read_gals
 
 __author__ = "Simon Mutch"
 __date__   = "2014-07-08"
@@ -117,7 +121,7 @@ if __name__ == '__main__':
     snap, redshift = meraxes.io.check_for_redshift(fname, 5.0, tol=0.1)
 
     props = ("StellarMass", "FOFMvir", "Type", "CentralGal")
-    gals, simprops = meraxes.io.read_gals(fname, snapshot=snap, props=props,
+    gals, simprops = read_gals(fname, snapshot=snap, props=props,
             sim_props=True, h=h)
     gals = gals.view(np.recarray)
 
@@ -4,6 +4,11 @@ import numpy as np
 from dragons import meraxes, munge
 from tqdm import tqdm
 import emcee
+import os
+import sys
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+from read_galaxies import read_gals
 
 __author__ = "Simon Mutch"
 __date__ = "2015-04-14"
@@ -113,9 +118,9 @@ class Smf(object):
         self.masses = np.log10(masses*1e10)
 
     def read_masses(self):
-        sm = meraxes.io.read_gals(self.fname, snapshot=self.snapshot,
-                                  props=["StellarMass",],
-                                  quiet=True)["StellarMass"]
+        sm = read_gals(self.fname, snapshot=self.snapshot,
+                       props=["StellarMass",],
+                       quiet=True)["StellarMass"]
         # drop zeros
         sel = sm > 0
         self.masses = np.log10(sm[sel]*1e10)
@@ -26,6 +26,8 @@ import seaborn as sns
 
 from dragons import meraxes, nbody, plotutils
 
+from read_galaxies import read_gals
+
 sns.set("talk", "white")
 
 def setup_fig(redshift, neutral_fraction, slice_str, slice_axis):
@@ -149,7 +151,7 @@ if __name__ == '__main__':
 
     # if requested read in the galaxies and select those within our slice
     if(args['--galaxies']):
-        gals = meraxes.io.read_gals(input_file, snapshot)
+        gals = read_gals(input_file, snapshot)
         edges = np.linspace(0, box_len, slice_dim+1)
         sel = np.prod([((gals["Pos"][:,i] <= edges[slice_sel[i].stop]) &
                      (gals["Pos"][:,i] > edges[slice_sel[i].start]))
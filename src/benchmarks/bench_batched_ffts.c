@@ -0,0 +1,206 @@
+#define _MAIN
+#include <complex.h>
+#include <fftw3-mpi.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/reionization.h"
+#include "core/utils.h"
+#include "meraxes.h"
+
+/*
+ * Compare the per-field and batched (ReionBatchedFFTs) inverse transforms used
+ * in the reionization radius loops.  Intended to be run at a range of rank
+ * counts, e.g.
+ *
+ *   for n in 64 128 256 512 1024; do mpirun -n $n bench_batched_ffts 512 5 20; done
+ *
+ * usage: bench_batched_ffts [<grid_dim> <n_fields> <n_repeats>]
+ *
+ * Two things are timed (maximum over ranks, per R step):
+ *  - the full copy + filter + c2r sequence for `n_fields` fields, one plan per
+ *    field vs. a single interleaved plan (`execute_filter_batch`);
+ *  - the MPI transpose alone, as `n_fields` separate transposes vs. a single
+ *    transpose of the interleaved data.  This is the all-to-all that the
+ *    batching saves, i.e. the communication time.
+ */
+
+static double max_over_ranks(double val)
+{
+  MPI_Allreduce(MPI_IN_PLACE, &val, 1, MPI_DOUBLE, MPI_MAX, run_globals.mpi_comm);
+  return val;
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc, &argv);
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  MPI_Comm_rank(MPI_COMM_WORLD, &run_globals.mpi_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &run_globals.mpi_size);
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  int grid_dim = 256;
+  int n_fields = 5;
+  int n_repeats = 10;
+
+  if (argc == 4) {
+    grid_dim = atoi(argv[1]);
+    n_fields = atoi(argv[2]);
+    n_repeats = atoi(argv[3]);
+  } else if (argc != 1) {
+    if (run_globals.mpi_rank == 0)
+      fprintf(stderr, "usage: %s [<grid_dim> <n_fields> <n_repeats>]\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  if ((grid_dim < 2) || (n_fields < 1) || (n_fields > FILTER_BATCH_MAX_FIELDS) || (n_repeats < 1)) {
+    if (run_globals.mpi_rank == 0)
+      fprintf(stderr, "Invalid arguments.\n");
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  fftwf_mpi_init();
+
+  run_globals.params.ReionGridDim = grid_dim;
+  run_globals.params.BoxSize = 100.0;
+  assign_slabs();
+
+  const int rank = run_globals.mpi_rank;
+  const ptrdiff_t slab_n_complex = run_globals.reion_grids.slab_n_complex[rank];
+  const int local_nix = (int)run_globals.reion_grids.slab_nix[rank];
+  const int local_ix_start = (int)run_globals.reion_grids.slab_ix_start[rank];
+  const float R = 5.0f;
+
+  // per-field grids and plans, as set up in malloc_reionization_grids
+  fftwf_complex* unfiltered[FILTER_BATCH_MAX_FIELDS];
+  fftwf_complex* filtered[FILTER_BATCH_MAX_FIELDS];
+  fftwf_plan reverse_plans[FILTER_BATCH_MAX_FIELDS];
+
+  srand(42 + rank);
+  for (int jj = 0; jj < n_fields; jj++) {
+    unfiltered[jj] = fftwf_alloc_complex((size_t)slab_n_complex);
+    filtered[jj] = fftwf_alloc_complex((size_t)slab_n_complex);
+    for (ptrdiff_t ii = 0; ii < slab_n_complex; ii++)
+      unfiltered[jj][ii] = (float)rand() / (float)RAND_MAX + I * (float)rand() / (float)RAND_MAX;
+    reverse_plans[jj] = fftwf_mpi_plan_dft_c2r_3d(
+      grid_dim, grid_dim, grid_dim, filtered[jj], (float*)filtered[jj], run_globals.mpi_comm, FFTW_ESTIMATE);
+  }
+
+  filter_batch_t* batch = create_filter_batch(n_fields, unfiltered, filtered, FFTW_ESTIMATE);
+
+  // the transposes of the slab decomposition on their own: n0 x n1 elements of a padded z-row each
+  const ptrdiff_t row_len = 2 * (grid_dim / 2 + 1);
+  ptrdiff_t local_n0, local_0_start, local_n1, local_1_start;
+  const ptrdiff_t n_transpose[2] = { grid_dim, grid_dim };
+  ptrdiff_t n_alloc = fftwf_mpi_local_size_many_transposed(2,
+                                                           n_transpose,
+                                                           row_len * n_fields,
+                                                           FFTW_MPI_DEFAULT_BLOCK,
+                                                           FFTW_MPI_DEFAULT_BLOCK,
+                                                           run_globals.mpi_comm,
+                                                           &local_n0,
+                                                           &local_0_start,
+                                                           &local_n1,
+                                                           &local_1_start);
+  float* transpose_buffer = fftwf_alloc_real((size_t)n_alloc);
+  memset(transpose_buffer, 0, sizeof(float) * (size_t)n_alloc);
+  fftwf_plan transpose_single = fftwf_mpi_plan_many_transpose(grid_dim,
+                                                              grid_dim,
+                                                              row_len,
+                                                              FFTW_MPI_DEFAULT_BLOCK,
+                                                              FFTW_MPI_DEFAULT_BLOCK,
+                                                              transpose_buffer,
+                                                              transpose_buffer,
+                                                              run_globals.mpi_comm,
+                                                              FFTW_ESTIMATE);
+  fftwf_plan transpose_batched = fftwf_mpi_plan_many_transpose(grid_dim,
+                                                               grid_dim,
+                                                               row_len * n_fields,
+                                                               FFTW_MPI_DEFAULT_BLOCK,
+                                                               FFTW_MPI_DEFAULT_BLOCK,
+                                                               transpose_buffer,
+                                                               transpose_buffer,
+                                                               run_globals.mpi_comm,
+                                                               FFTW_ESTIMATE);
+
+  timer_info timer;
+  double t_single = 0.0;
+  double t_batched = 0.0;
+  double t_transpose_single = 0.0;
+  double t_transpose_batched = 0.0;
+
+  for (int rep = 0; rep < n_repeats; rep++) {
+    MPI_Barrier(run_globals.mpi_comm);
+    timer_start(&timer);
+    for (int jj = 0; jj < n_fields; jj++) {
+      memcpy(filtered[jj], unfiltered[jj], sizeof(fftwf_complex) * slab_n_complex);
+      filter(filtered[jj], local_ix_start, local_nix, grid_dim, R, 0);
+      fftwf_execute(reverse_plans[jj]);
+    }
+    timer_stop(&timer);
+    t_single += max_over_ranks(timer_delta(timer));
+
+    MPI_Barrier(run_globals.mpi_comm);
+    timer_start(&timer);
+    execute_filter_batch(batch, R, 0, true);
+    timer_stop(&timer);
+    t_batched += max_over_ranks(timer_delta(timer));
+
+    MPI_Barrier(run_globals.mpi_comm);
+    timer_start(&timer);
+    for (int jj = 0; jj < n_fields; jj++)
+      fftwf_execute(transpose_single);
+    timer_stop(&timer);
+    t_transpose_single += max_over_ranks(timer_delta(timer));
+
+    MPI_Barrier(run_globals.mpi_comm);
+    timer_start(&timer);
+    fftwf_execute(transpose_batched);
+    timer_stop(&timer);
+    t_transpose_batched += max_over_ranks(timer_delta(timer));
+  }
+
+  if (rank == 0) {
+    printf("# %6s %6s %6s %12s %12s %8s %14s %14s %8s\n",
+           "ranks",
+           "grid",
+           "fields",
+           "c2r [s]",
+           "batched [s]",
+           "speedup",
+           "transpose [s]",
+           "batched [s]",
+           "speedup");
+    printf("  %6d %6d %6d %12.4e %12.4e %8.2f %14.4e %14.4e %8.2f\n",
+           run_globals.mpi_size,
+           grid_dim,
+           n_fields,
+           t_single / n_repeats,
+           t_batched / n_repeats,
+           t_batched > 0 ? t_single / t_batched : 0.0,
+           t_transpose_single / n_repeats,
+           t_transpose_batched / n_repeats,
+           t_transpose_batched > 0 ? t_transpose_single / t_transpose_batched : 0.0);
+  }
+
+  fftwf_destroy_plan(transpose_batched);
+  fftwf_destroy_plan(transpose_single);
+  fftwf_free(transpose_buffer);
+  destroy_filter_batch(batch);
+  for (int jj = 0; jj < n_fields; jj++) {
+    fftwf_destroy_plan(reverse_plans[jj]);
+    fftwf_free(filtered[jj]);
+    fftwf_free(unfiltered[jj]);
+  }
+  free(run_globals.reion_grids.slab_n_complex);
+  free(run_globals.reion_grids.slab_ix_start);
+  free(run_globals.reion_grids.slab_nix);
+  fftwf_mpi_cleanup();
+  MPI_Finalize();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,188 @@
+#define _MAIN
+#include <math.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/find_HII_bubbles.h"
+#include "core/misc_tools.h"
+#include "core/reionization.h"
+#include "core/utils.h"
+#include "meraxes.h"
+
+/*
+ * Compare _find_HII_bubbles with and without ReionActiveCellLists over a
+ * range of global neutral fractions.
+ *
+ * usage: bench_find_HII_bubbles [<box_size [Mpc/h]> <grid_dim>]
+ *
+ * The density field is a synthetic log-normal field (defaults: 100 Mpc/h box,
+ * 128^3 grid) and the stellar mass grid is proportional to (1+delta)^2, with
+ * the normalisation stepped to move the box from mostly neutral to mostly
+ * ionised.  For each step the time taken with the dense cell loop and with
+ * the active cell lists is reported (this includes the FFTs, which are not
+ * affected), along with the number of cells whose r_bubble differs between
+ * the two (which should always be zero).
+ */
+
+static const double stars_norm[] = { 0.2, 0.35, 0.5, 0.7, 1.0, 1.5, 2.5, 5.0 };
+
+static void set_params(double box_size, int grid_dim)
+{
+  run_params_t* params = &(run_globals.params);
+  params->Flag_PatchyReion = 1;
+  params->ReionGridDim = grid_dim;
+  params->BoxSize = box_size;
+  params->Hubble_h = 0.678;
+  params->OmegaM = 0.308;
+  params->OmegaLambda = 0.692;
+  params->ReionDeltaRFactor = 1.1;
+  params->ReionFilterType = 0;
+  params->ReionRtoMFilterType = 0;
+  params->physics.ReionRBubbleMax = 50.0;
+  params->physics.ReionRBubbleMin = 0.0;
+  params->physics.ReionEfficiency = 1.0;
+  params->physics.ReionNionPhotPerBary = 4000.0;
+  params->physics.ReionGammaHaloBias = 2.0;
+  params->physics.ReionAlphaUV = 5.0;
+
+  run_globals.RhoCrit = 27.755;
+  run_globals.units.UnitLength_in_cm = 3.08568e24;
+  run_globals.units.UnitMass_in_g = 1.989e43;
+  run_globals.units.UnitTime_in_s = 3.08568e19;
+
+  run_globals.ZZ = malloc(sizeof(double) * 2);
+  run_globals.ZZ[0] = 8.5;
+  run_globals.ZZ[1] = 8.0;
+  run_globals.NStoreSnapshots = 1;
+}
+
+static float* make_density_field(int dim)
+{
+  float* density = malloc(sizeof(float) * (size_t)dim * dim * dim);
+
+  // A handful of random long-wavelength modes, exponentiated to give a density-like field with a long tail
+  const int n_modes = 16;
+  double k[16][3];
+  double phase[16];
+  srand(42);
+  for (int ii = 0; ii < n_modes; ii++) {
+    for (int jj = 0; jj < 3; jj++)
+      k[ii][jj] = 2.0 * M_PI * (double)(rand() % 8) / (double)dim;
+    phase[ii] = 2.0 * M_PI * (double)rand() / (double)RAND_MAX;
+  }
+
+  for (int ii = 0; ii < dim; ii++)
+    for (int jj = 0; jj < dim; jj++)
+      for (int kk = 0; kk < dim; kk++) {
+        double val = 0.0;
+        for (int mm = 0; mm < n_modes; mm++)
+          val += cos(k[mm][0] * ii + k[mm][1] * jj + k[mm][2] * kk + phase[mm]);
+        density[grid_index(ii, jj, kk, dim, INDEX_REAL)] = (float)exp(0.15 * val);
+      }
+
+  return density;
+}
+
+static float run(const float* density, double norm, bool active_cells)
+{
+  reion_grids_t* grids = &(run_globals.reion_grids);
+  const int dim = run_globals.params.ReionGridDim;
+  const double cell_mass =
+    run_globals.params.OmegaM * run_globals.RhoCrit * pow(run_globals.params.BoxSize / (double)dim, 3);
+
+  init_reion_grids();
+
+  // the input grids are overwritten by the forward FFTs
+  for (int ii = 0; ii < dim; ii++)
+    for (int jj = 0; jj < dim; jj++)
+      for (int kk = 0; kk < dim; kk++) {
+        int i_padded = grid_index(ii, jj, kk, dim, INDEX_PADDED);
+        double rho = (double)density[grid_index(ii, jj, kk, dim, INDEX_REAL)];
+        grids->deltax[i_padded] = (float)(rho - 1.0);
+        grids->stars[i_padded] = (float)(norm * cell_mass * rho * rho);
+        grids->weighted_sfr[i_padded] = (float)(1e-3 * norm * cell_mass * rho * rho);
+#if USE_MINI_HALOS
+        grids->starsIII[i_padded] = 0.0f;
+        grids->weighted_sfrIII[i_padded] = 0.0f;
+#endif
+      }
+
+  run_globals.params.ReionActiveCellLists = active_cells;
+
+  timer_info timer;
+  timer_start(&timer);
+  _find_HII_bubbles(1);
+  timer_stop(&timer);
+
+  return timer_delta(timer);
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc, &argv);
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  run_globals.mpi_rank = 0;
+  run_globals.mpi_size = 1;
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  double box_size = 100.0;
+  int grid_dim = 128;
+
+  if (argc == 3) {
+    box_size = atof(argv[1]);
+    grid_dim = atoi(argv[2]);
+  } else if (argc != 1) {
+    fprintf(stderr, "usage: %s [<box_size [Mpc/h]> <grid_dim>]\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  if ((box_size <= 0) || (grid_dim < 2)) {
+    fprintf(stderr, "Invalid arguments.\n");
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  set_params(box_size, grid_dim);
+  malloc_reionization_grids();
+
+  const int n_real = grid_dim * grid_dim * grid_dim;
+  float* density = make_density_field(grid_dim);
+  float* r_bubble_dense = malloc(sizeof(float) * (size_t)n_real);
+
+  printf("# box: %.1f Mpc/h, grid: %d^3\n", box_size, grid_dim);
+  printf("# %6s %10s %10s %10s %8s %10s\n", "norm", "xH", "dense [s]", "active [s]", "speedup", "n differ");
+
+  int n_norm = (int)(sizeof(stars_norm) / sizeof(stars_norm[0]));
+  for (int ii = 0; ii < n_norm; ii++) {
+    float t_dense = run(density, stars_norm[ii], false);
+    memcpy(r_bubble_dense, run_globals.reion_grids.r_bubble, sizeof(float) * (size_t)n_real);
+
+    float t_active = run(density, stars_norm[ii], true);
+
+    int n_differ = 0;
+    for (int jj = 0; jj < n_real; jj++)
+      if (run_globals.reion_grids.r_bubble[jj] != r_bubble_dense[jj])
+        n_differ++;
+
+    printf("  %6.2f %10.4f %10.4f %10.4f %8.2f %10d\n",
+           stars_norm[ii],
+           run_globals.reion_grids.volume_weighted_global_xH,
+           t_dense,
+           t_active,
+           t_active > 0 ? t_dense / t_active : 0.0,
+           n_differ);
+  }
+
+  free(r_bubble_dense);
+  free(density);
+  free_reionization_grids();
+  free(run_globals.SnapshotVel);
+  free(run_globals.SnapshotDeltax);
+  free(run_globals.ZZ);
+  MPI_Finalize();
+
+  return EXIT_SUCCESS;
+}
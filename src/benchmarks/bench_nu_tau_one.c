@@ -0,0 +1,179 @@
+#define _MAIN
+#include <math.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core/ComputeTs.h"
+#include "core/XRayHeatingFunctions.h"
+#include "core/reionization.h"
+#include "core/utils.h"
+#include "meraxes.h"
+
+/*
+ * Compare the memoised, warm-started nu_tau_one_cached against the direct
+ * nu_tau_one solve over the zpp shells used by _ComputeTs.
+ *
+ * usage: bench_nu_tau_one [<box_size [Mpc]> <grid_dim> <n_filter_steps> <n_snaps>]
+ *
+ * The collapsed fraction history and mean electron fraction are synthetic
+ * (defaults: 100 Mpc box, 128^3 grid, 40 filter steps, 30 snapshots between
+ * z = 35 and z = 6).  For each snapshot the time taken by each solver, the
+ * number of Brent solves and full-bracket fallbacks of the cached solver and
+ * the maximum relative difference between the two roots are reported.
+ */
+
+static void set_cosmology()
+{
+  run_globals.params.Hubble_h = 0.678;
+  run_globals.params.OmegaM = 0.308;
+  run_globals.params.OmegaLambda = 0.692;
+  run_globals.params.BaryonFrac = 0.157;
+  run_globals.params.physics.Y_He = 0.24;
+  run_globals.params.physics.ReionEfficiency = 1.0;
+}
+
+static void set_history(int n_snaps)
+{
+  const double z_max = 35.0;
+  const double z_min = 6.0;
+
+  run_globals.ZZ = malloc(sizeof(double) * n_snaps);
+  for (int ii = 0; ii < n_snaps; ii++) {
+    run_globals.ZZ[ii] = z_max - (z_max - z_min) * (double)ii / (double)(n_snaps - 1);
+    stored_fcoll[ii] = 0.05 * exp(-0.35 * (run_globals.ZZ[ii] - z_min));
+  }
+}
+
+static void make_zpp(double zp, double box_size, int grid_dim, int n_filter_steps, double* zpp)
+{
+  // mirror the shell redshifts of _ComputeTs
+  double R = L_FACTOR * box_size / (double)grid_dim;
+  double R_factor = pow(R_XLy_MAX / R, 1 / (float)n_filter_steps);
+  double prev_zpp = zp;
+  double prev_R = 0;
+
+  for (int R_ct = 0; R_ct < n_filter_steps; R_ct++) {
+    double zpp_edge = prev_zpp - (R - prev_R) * MPC / (drdz((float)prev_zpp));
+    zpp[R_ct] = (zpp_edge + prev_zpp) * 0.5;
+    prev_zpp = zpp_edge;
+    prev_R = R;
+    R *= R_factor;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc, &argv);
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  run_globals.mpi_rank = 0;
+  run_globals.mpi_size = 1;
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  double box_size = 100.0;
+  int grid_dim = 128;
+  int n_filter_steps = 40;
+  int n_snaps = 30;
+
+  if (argc == 5) {
+    box_size = atof(argv[1]);
+    grid_dim = atoi(argv[2]);
+    n_filter_steps = atoi(argv[3]);
+    n_snaps = atoi(argv[4]);
+  } else if (argc != 1) {
+    fprintf(stderr, "usage: %s [<box_size [Mpc]> <grid_dim> <n_filter_steps> <n_snaps>]\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  if ((box_size <= 0) || (grid_dim < 1) || (n_filter_steps < 1) || (n_snaps < 2) || (n_snaps > 1000)) {
+    fprintf(stderr, "Invalid arguments.\n");
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  set_cosmology();
+  set_history(n_snaps);
+
+  double* zpp = malloc(sizeof(double) * n_filter_steps);
+  double* nu_direct = malloc(sizeof(double) * n_filter_steps);
+  double* nu_cached = malloc(sizeof(double) * n_filter_steps);
+  nu_tau_one_memo_t memo;
+  init_nu_tau_one_memo(&memo);
+
+  double total_direct = 0.0;
+  double total_cached = 0.0;
+  double total_max_rel_err = 0.0;
+
+  printf("# box: %.1f Mpc, grid: %d^3, %d filter steps\n", box_size, grid_dim, n_filter_steps);
+  printf("# %6s %10s %12s %12s %8s %7s %9s %12s\n",
+         "zp",
+         "x_e",
+         "direct [s]",
+         "cached [s]",
+         "speedup",
+         "solves",
+         "fallbacks",
+         "max rel err");
+
+  for (int snap = 1; snap < n_snaps; snap++) {
+    double zp = run_globals.ZZ[snap];
+    x_e_ave = 2e-4 + 0.5 * stored_fcoll[snap];
+    double filling_factor_of_HI_zp =
+      1. - run_globals.params.physics.ReionEfficiency * stored_fcoll[snap] / (1.0 - x_e_ave);
+
+    make_zpp(zp, box_size, grid_dim, n_filter_steps, zpp);
+
+    timer_info timer;
+    timer_start(&timer);
+    for (int R_ct = 0; R_ct < n_filter_steps; R_ct++)
+      nu_direct[R_ct] = nu_tau_one(zp, zpp[R_ct], x_e_ave, filling_factor_of_HI_zp, snap);
+    timer_stop(&timer);
+    float t_direct = timer_delta(timer);
+
+    int n_solves = memo.n_solves;
+    int n_direct = memo.n_direct;
+    timer_start(&timer);
+    for (int R_ct = 0; R_ct < n_filter_steps; R_ct++)
+      nu_cached[R_ct] = nu_tau_one_cached(&memo, zp, zpp[R_ct], x_e_ave, filling_factor_of_HI_zp, snap);
+    timer_stop(&timer);
+    float t_cached = timer_delta(timer);
+
+    double max_rel_err = 0.0;
+    for (int R_ct = 0; R_ct < n_filter_steps; R_ct++) {
+      double err = fabs(nu_cached[R_ct] / nu_direct[R_ct] - 1.0);
+      if (err > max_rel_err)
+        max_rel_err = err;
+    }
+
+    printf("  %6.2f %10.3e %12.4e %12.4e %8.2f %7d %9d %12.3e\n",
+           zp,
+           x_e_ave,
+           t_direct,
+           t_cached,
+           t_cached > 0 ? t_direct / t_cached : 0.0,
+           memo.n_solves - n_solves,
+           memo.n_direct - n_direct,
+           max_rel_err);
+
+    total_direct += t_direct;
+    total_cached += t_cached;
+    if (max_rel_err > total_max_rel_err)
+      total_max_rel_err = max_rel_err;
+  }
+
+  printf("# total: direct %.4e s, cached %.4e s, speedup %.2f, max rel err %.3e\n",
+         total_direct,
+         total_cached,
+         total_cached > 0 ? total_direct / total_cached : 0.0,
+         total_max_rel_err);
+
+  free_nu_tau_one_memo(&memo);
+  free(nu_cached);
+  free(nu_direct);
+  free(zpp);
+  free(run_globals.ZZ);
+  MPI_Finalize();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,224 @@
+#define _MAIN
+#include <hdf5_hl.h>
+#include <math.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "core/output_filters.h"
+#include "core/utils.h"
+#include "meraxes.h"
+
+/*
+ * Report the compression ratio, write time and maximum error of each output
+ * filter setting when writing a single float grid.
+ *
+ * usage: bench_output_filters <output_file> [<grid_dim> | <grids_file> <dataset>] [<filter> <chunks>]...
+ *
+ * The grid is either a synthetic log-normal field of side <grid_dim> (default
+ * 128) or a dataset read from an existing Meraxes grids file (e.g. `xH` or
+ * `deltax`).  If no <filter> <chunks> pairs are given, a default set of
+ * settings is benchmarked.
+ */
+
+static const char* default_settings[][2] = {
+  { "none", "1, 0, 0" },
+  { "deflate:1", "1, 0, 0" },
+  { "deflate:6", "1, 0, 0" },
+  { "shuffle, deflate:1", "1, 0, 0" },
+  { "shuffle, deflate:6", "1, 0, 0" },
+  { "shuffle, deflate:1", "16, 0, 0" },
+  { "shuffle, deflate:1", "32, 32, 32" },
+  { "scaleoffset:3", "1, 0, 0" },
+  { "scaleoffset:3, deflate:1", "1, 0, 0" },
+  { "bitround:10, shuffle, deflate:1", "1, 0, 0" },
+  { "bitround:7, shuffle, deflate:1", "1, 0, 0" },
+};
+
+static float* make_synthetic_grid(int dim)
+{
+  size_t n_cell = (size_t)dim * dim * dim;
+  float* grid = malloc(sizeof(float) * n_cell);
+
+  // A handful of random long-wavelength modes plus white noise, exponentiated
+  // to give a density-like field with a long tail.
+  const int n_modes = 16;
+  double k[16][3];
+  double phase[16];
+  srand(42);
+  for (int ii = 0; ii < n_modes; ii++) {
+    for (int jj = 0; jj < 3; jj++)
+      k[ii][jj] = 2.0 * M_PI * (double)(rand() % 8) / (double)dim;
+    phase[ii] = 2.0 * M_PI * (double)rand() / (double)RAND_MAX;
+  }
+
+  for (int ii = 0; ii < dim; ii++)
+    for (int jj = 0; jj < dim; jj++)
+      for (int kk = 0; kk < dim; kk++) {
+        double val = 0.0;
+        for (int mm = 0; mm < n_modes; mm++)
+          val += cos(k[mm][0] * ii + k[mm][1] * jj + k[mm][2] * kk + phase[mm]);
+        val = 0.3 * val + 0.2 * ((double)rand() / (double)RAND_MAX - 0.5);
+        grid[((size_t)ii * dim + jj) * dim + kk] = (float)(exp(val) - 1.0);
+      }
+
+  return grid;
+}
+
+static float* read_grid_from_file(const char* fname, const char* dataset, hsize_t dims[3])
+{
+  hid_t file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+  if (file_id < 0) {
+    fprintf(stderr, "Failed to open %s\n", fname);
+    return NULL;
+  }
+
+  int rank = 0;
+  H5LTget_dataset_ndims(file_id, dataset, &rank);
+  if (rank != 3) {
+    fprintf(stderr, "Expected %s/%s to be a 3D grid\n", fname, dataset);
+    H5Fclose(file_id);
+    return NULL;
+  }
+  H5LTget_dataset_info(file_id, dataset, dims, NULL, NULL);
+
+  float* grid = malloc(sizeof(float) * dims[0] * dims[1] * dims[2]);
+  H5LTread_dataset_float(file_id, dataset, grid);
+  H5Fclose(file_id);
+
+  return grid;
+}
+
+static void bench_setting(const char* fname,
+                          const char* filter_str,
+                          const char* chunks_str,
+                          const float* grid,
+                          const hsize_t dims[3])
+{
+  output_filter_t filter;
+  if (parse_output_filter(filter_str, chunks_str, &filter) != 0)
+    return;
+
+  size_t n_cell = dims[0] * dims[1] * dims[2];
+  float* buffer = malloc(sizeof(float) * n_cell);
+  memcpy(buffer, grid, sizeof(float) * n_cell);
+
+  timer_info timer;
+  timer_start(&timer);
+
+  // mirror write_grid_float (bit rounding is included in the write time)
+  apply_output_bitround(&filter, buffer, n_cell);
+
+  hid_t file_id = H5Fcreate(fname, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  hid_t fspace_id = H5Screate_simple(3, dims, NULL);
+  hid_t dcpl_id = create_output_dcpl(&filter, 3, dims, H5T_NATIVE_FLOAT);
+  hid_t dset_id = H5Dcreate(file_id, "grid", H5T_NATIVE_FLOAT, fspace_id, H5P_DEFAULT, dcpl_id, H5P_DEFAULT);
+  H5Dwrite(dset_id, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer);
+  hsize_t stored_bytes = H5Dget_storage_size(dset_id);
+  H5Dclose(dset_id);
+  H5Pclose(dcpl_id);
+  H5Sclose(fspace_id);
+  H5Fclose(file_id);
+
+  timer_stop(&timer);
+  float write_time = timer_delta(timer);
+
+  // read back to measure the error introduced by lossy filters
+  file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+  timer_start(&timer);
+  H5LTread_dataset_float(file_id, "grid", buffer);
+  timer_stop(&timer);
+  H5Fclose(file_id);
+  float read_time = timer_delta(timer);
+
+  double max_abs_err = 0.0;
+  double max_rel_err = 0.0;
+  for (size_t ii = 0; ii < n_cell; ii++) {
+    double err = fabs((double)buffer[ii] - (double)grid[ii]);
+    if (err > max_abs_err)
+      max_abs_err = err;
+    if ((grid[ii] != 0.0f) && (err / fabs(grid[ii]) > max_rel_err))
+      max_rel_err = err / fabs(grid[ii]);
+  }
+
+  double raw_bytes = (double)n_cell * sizeof(float);
+  printf("%-34s %-12s %8.3f %10.3f %10.3f %12.3e %12.3e\n",
+         filter_str,
+         chunks_str,
+         stored_bytes > 0 ? raw_bytes / (double)stored_bytes : 0.0,
+         write_time,
+         read_time,
+         max_abs_err,
+         max_rel_err);
+
+  free(buffer);
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc, &argv);
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  run_globals.mpi_rank = 0;
+  run_globals.mpi_size = 1;
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  if (argc < 2) {
+    fprintf(stderr,
+            "usage: %s <output_file> [<grid_dim> | <grids_file> <dataset>] [<filter> <chunks>]...\n",
+            argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  const char* out_fname = argv[1];
+  hsize_t dims[3] = { 128, 128, 128 };
+  float* grid = NULL;
+  int i_arg = 2;
+
+  if ((argc > 3) && (access(argv[2], F_OK) != -1) && (H5Fis_hdf5(argv[2]) > 0)) {
+    grid = read_grid_from_file(argv[2], argv[3], dims);
+    i_arg = 4;
+  } else {
+    if ((argc > 2) && (atoi(argv[2]) > 0)) {
+      dims[0] = dims[1] = dims[2] = (hsize_t)atoi(argv[2]);
+      i_arg = 3;
+    }
+    grid = make_synthetic_grid((int)dims[0]);
+  }
+
+  if (grid == NULL) {
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  printf("# grid: %llu x %llu x %llu floats (%.1f MB)\n",
+         (unsigned long long)dims[0],
+         (unsigned long long)dims[1],
+         (unsigned long long)dims[2],
+         (double)(dims[0] * dims[1] * dims[2] * sizeof(float)) / (1024. * 1024.));
+  printf("# %-32s %-12s %8s %10s %10s %12s %12s\n",
+         "filter",
+         "chunks",
+         "ratio",
+         "write [s]",
+         "read [s]",
+         "max abs err",
+         "max rel err");
+
+  if (i_arg + 1 < argc) {
+    for (; i_arg + 1 < argc; i_arg += 2)
+      bench_setting(out_fname, argv[i_arg], argv[i_arg + 1], grid, dims);
+  } else {
+    int n_settings = (int)(sizeof(default_settings) / sizeof(default_settings[0]));
+    for (int ii = 0; ii < n_settings; ii++)
+      bench_setting(out_fname, default_settings[ii][0], default_settings[ii][1], grid, dims);
+  }
+
+  remove(out_fname);
+  free(grid);
+  MPI_Finalize();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,213 @@
+#define _MAIN
+#include <math.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core/magnitudes.h"
+#include "core/misc_tools.h"
+#include "core/save.h"
+#include "core/utils.h"
+#include "meraxes.h"
+
+/*
+ * Compare the time taken to convert the fluxes of an output buffer of
+ * galaxies to (dusty) magnitudes by the batched kernel, the per-galaxy
+ * get_output_magnitudes and the original per-galaxy conversion (which calls
+ * sector's dust_absorption_approx).
+ *
+ * usage: bench_output_magnitudes [<n_gals> <n_repeats>]
+ *
+ * Requires CALC_MAGS.  The number of bands is MAGS_N_BANDS, so configure with
+ * e.g. -DMAGS_N_BANDS=40 to benchmark many bands.  The galaxies and band
+ * wavelengths are synthetic (defaults: 20000 galaxies, 10 repeats).  The
+ * maximum difference from the original conversion is also reported.
+ */
+
+static void get_output_magnitudes_orig(float* mags, float* dusty_mags, galaxy_t* gal, int snapshot)
+{
+  // The conversion as it was before the per-band dust optical depths were tabulated
+  int iS;
+  int* targetSnap = run_globals.mag_params.targetSnap;
+  flux_t* pInBCFlux = gal->inBCFlux;
+  flux_t* pOutBCFlux = gal->outBCFlux;
+
+  for (iS = 0; iS < MAGS_N_SNAPS; ++iS) {
+    if (snapshot == targetSnap[iS])
+      break;
+    else {
+      pInBCFlux += MAGS_N_BANDS;
+      pOutBCFlux += MAGS_N_BANDS;
+    }
+  }
+
+  double redshift = run_globals.ZZ[snapshot];
+  double sfr_unit =
+    -2.5 * log10(run_globals.units.UnitMass_in_g / run_globals.units.UnitTime_in_s * SEC_PER_YEAR / SOLAR_MASS);
+  for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band)
+    mags[i_band] = (float)(-2.5 * log10((double)pInBCFlux[i_band] + pOutBCFlux[i_band]) + 8.9 + sfr_unit);
+
+  double factor = pow(calc_metallicity(gal->ColdGas, gal->MetalsColdGas) / 0.02, 1.2) * gal->ColdGas *
+                  pow(gal->DiskScaleLength * 1e3, -2.0) * exp(-0.35 * redshift);
+  dust_params_t dust_params = { .tauUV_ISM = 13.5 * factor,
+                                .nISM = -1.6,
+                                .tauUV_BC = 381.3 * factor,
+                                .nBC = -1.6,
+                                .tBC = run_globals.mag_params.tBC };
+
+  double local_InBCFlux[MAGS_N_BANDS], local_OutBCFlux[MAGS_N_BANDS];
+  for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band) {
+    local_InBCFlux[i_band] = pInBCFlux[i_band];
+    local_OutBCFlux[i_band] = pOutBCFlux[i_band];
+  }
+
+  dust_absorption_approx(
+    local_InBCFlux, local_OutBCFlux, run_globals.mag_params.centreWaves, MAGS_N_BANDS, &dust_params);
+
+  for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band)
+    dusty_mags[i_band] = (float)(-2.5 * log10(local_InBCFlux[i_band] + local_OutBCFlux[i_band]) + 8.9 + sfr_unit);
+}
+
+static void set_mag_params(double* centre_waves)
+{
+  mag_params_t* mag_params = &run_globals.mag_params;
+
+  for (int iS = 0; iS < MAGS_N_SNAPS; ++iS)
+    mag_params->targetSnap[iS] = 10 * (iS + 1);
+  mag_params->tBC = 1e7;
+
+  // Rest-frame bands spread logarithmically from the far-UV to the near-IR
+  double step = (MAGS_N_BANDS > 1) ? log(20000. / 1300.) / (MAGS_N_BANDS - 1) : 0.;
+  for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band)
+    centre_waves[i_band] = 1300. * exp(step * i_band);
+  mag_params->centreWaves = centre_waves;
+
+  init_dust_attenuation(mag_params);
+}
+
+static void make_galaxies(galaxy_t* gals, int n_gals)
+{
+  srand(42);
+  for (int i_gal = 0; i_gal < n_gals; ++i_gal) {
+    galaxy_t* gal = &gals[i_gal];
+    double mass = pow(10., -4. + 3. * (double)rand() / RAND_MAX);
+
+    gal->ColdGas = mass;
+    gal->MetalsColdGas = mass * 0.02 * (double)rand() / RAND_MAX;
+    gal->DiskScaleLength = 1e-3 * (0.2 + (double)rand() / RAND_MAX);
+    for (int ii = 0; ii < MAGS_N; ++ii) {
+      gal->inBCFlux[ii] = mass * pow(10., 2. * (double)rand() / RAND_MAX) + TOL;
+      gal->outBCFlux[ii] = mass * pow(10., 3. * (double)rand() / RAND_MAX) + TOL;
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc, &argv);
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  run_globals.mpi_rank = 0;
+  run_globals.mpi_size = 1;
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  int n_gals = 20000;
+  int n_repeats = 10;
+
+  if (argc == 3) {
+    n_gals = atoi(argv[1]);
+    n_repeats = atoi(argv[2]);
+  } else if (argc != 1) {
+    fprintf(stderr, "usage: %s [<n_gals> <n_repeats>]\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  if ((n_gals < 1) || (n_repeats < 1)) {
+    fprintf(stderr, "Invalid arguments.\n");
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  const int n_snaps = 10 * MAGS_N_SNAPS + 1;
+  run_globals.ZZ = malloc(sizeof(double) * n_snaps);
+  for (int ii = 0; ii < n_snaps; ii++)
+    run_globals.ZZ[ii] = 20.0 - 14.0 * (double)ii / (double)(n_snaps - 1);
+  run_globals.units.UnitMass_in_g = 1.989e43;
+  run_globals.units.UnitTime_in_s = 3.08568e19;
+
+  double centre_waves[MAGS_N_BANDS];
+  set_mag_params(centre_waves);
+
+  galaxy_t* gals = calloc((size_t)n_gals, sizeof(galaxy_t));
+  galaxy_t** gal_ptrs = malloc(sizeof(galaxy_t*) * (size_t)n_gals);
+  galaxy_output_t* galout_orig = calloc((size_t)n_gals, sizeof(galaxy_output_t));
+  galaxy_output_t* galout = calloc((size_t)n_gals, sizeof(galaxy_output_t));
+  make_galaxies(gals, n_gals);
+  for (int i_gal = 0; i_gal < n_gals; ++i_gal)
+    gal_ptrs[i_gal] = &gals[i_gal];
+
+  printf("# %d galaxies, %d bands, %d repeats\n", n_gals, MAGS_N_BANDS, n_repeats);
+  printf("# %s precision fluxes, sizeof(galaxy_t) = %zu bytes\n",
+         sizeof(flux_t) == sizeof(float) ? "single" : "double",
+         sizeof(galaxy_t));
+  printf("# %8s %12s %12s %12s %8s %12s\n", "snapshot", "orig [s]", "single [s]", "batch [s]", "speedup", "max |dmag|");
+
+  double total_orig = 0.0;
+  double total_batch = 0.0;
+
+  for (int iS = 0; iS < MAGS_N_SNAPS; ++iS) {
+    int snapshot = run_globals.mag_params.targetSnap[iS];
+    timer_info timer;
+
+    timer_start(&timer);
+    for (int ii = 0; ii < n_repeats; ++ii)
+      for (int i_gal = 0; i_gal < n_gals; ++i_gal)
+        get_output_magnitudes_orig(galout_orig[i_gal].Mags, galout_orig[i_gal].DustyMags, &gals[i_gal], snapshot);
+    timer_stop(&timer);
+    float t_orig = timer_delta(timer);
+
+    timer_start(&timer);
+    for (int ii = 0; ii < n_repeats; ++ii)
+      for (int i_gal = 0; i_gal < n_gals; ++i_gal)
+        get_output_magnitudes(galout[i_gal].Mags, galout[i_gal].DustyMags, &gals[i_gal], snapshot);
+    timer_stop(&timer);
+    float t_single = timer_delta(timer);
+
+    timer_start(&timer);
+    for (int ii = 0; ii < n_repeats; ++ii)
+      get_output_magnitudes_batch(galout, gal_ptrs, n_gals, snapshot);
+    timer_stop(&timer);
+    float t_batch = timer_delta(timer);
+
+    double max_diff = 0.0;
+    for (int i_gal = 0; i_gal < n_gals; ++i_gal)
+      for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band) {
+        double diff = fmax(fabs(galout[i_gal].Mags[i_band] - galout_orig[i_gal].Mags[i_band]),
+                           fabs(galout[i_gal].DustyMags[i_band] - galout_orig[i_gal].DustyMags[i_band]));
+        if (diff > max_diff)
+          max_diff = diff;
+      }
+
+    printf("  %8d %12.4e %12.4e %12.4e %8.2f %12.3e\n",
+           snapshot,
+           t_orig,
+           t_single,
+           t_batch,
+           t_orig / t_batch,
+           max_diff);
+
+    total_orig += t_orig;
+    total_batch += t_batch;
+  }
+
+  printf("# total: orig %.4e s, batch %.4e s, speedup %.2f\n", total_orig, total_batch, total_orig / total_batch);
+
+  free(galout);
+  free(galout_orig);
+  free(gal_ptrs);
+  free(gals);
+  free(run_globals.ZZ);
+
+  MPI_Finalize();
+  return EXIT_SUCCESS;
+}
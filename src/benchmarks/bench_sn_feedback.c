@@ -0,0 +1,181 @@
+#define _MAIN
+#include <math.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/misc_tools.h"
+#include "core/stellar_feedback.h"
+#include "core/utils.h"
+#include "meraxes.h"
+
+/*
+ * Compare the time taken by the Pop. II lookups of the delayed supernova
+ * feedback step when the recycling fraction, metal yield and SNII energy of
+ * each burst are looked up separately (as delayed_supernova_feedback used to)
+ * and when a galaxy's burst history is looked up in one pass by
+ * get_burst_history_feedback.
+ *
+ * usage: bench_sn_feedback <StellarFeedbackDir> [<n_gals> <n_repeats>]
+ *
+ * StellarFeedbackDir must contain stellar_feedback_tables.hdf5.  The
+ * snapshots (evenly spaced by 15 Myr) and star formation histories are
+ * synthetic (defaults: 100000 galaxies, 10 repeats).  Both versions should
+ * give identical results, which is also checked.
+ */
+
+#define N_SNAPS 100
+#define SNAP_SPACING 15.0 // Myr
+
+static void delayed_feedback_orig(const double* new_stars, const double* new_metals, int n_bursts, double* result)
+{
+  double m_recycled = 0.0;
+  double new_metal_mass = 0.0;
+  double sn_energy = 0.0;
+
+  for (int i_burst = 1; i_burst < n_bursts; i_burst++) {
+    double m_stars = new_stars[i_burst];
+    if (m_stars > 1e-10) {
+      double metallicity = calc_metallicity(m_stars, new_metals[i_burst]);
+      m_recycled += m_stars * get_recycling_fraction(i_burst, metallicity);
+      new_metal_mass += m_stars * get_metal_yield(i_burst, metallicity);
+      sn_energy += get_SN_energy(i_burst, metallicity) * m_stars;
+    }
+  }
+
+  result[0] = m_recycled;
+  result[1] = new_metal_mass;
+  result[2] = sn_energy;
+}
+
+static void delayed_feedback(const double* new_stars, const double* new_metals, int n_bursts, double* result)
+{
+  double m_stars_hist[N_HISTORY_SNAPS] = { 0.0 };
+  double metallicity_hist[N_HISTORY_SNAPS] = { 0.0 };
+
+  for (int i_burst = 1; i_burst < n_bursts; i_burst++) {
+    double m_stars = new_stars[i_burst];
+    if (m_stars > 1e-10) {
+      m_stars_hist[i_burst] = m_stars;
+      metallicity_hist[i_burst] = calc_metallicity(m_stars, new_metals[i_burst]);
+    }
+  }
+
+  result[0] = result[1] = result[2] = 0.0;
+  get_burst_history_feedback(m_stars_hist, metallicity_hist, 1, n_bursts, &result[0], &result[1], &result[2]);
+}
+
+static void make_histories(double* new_stars, double* new_metals, int n_gals)
+{
+  // Star formation histories spanning several decades, with roughly a third of the bursts empty
+  srand(42);
+  for (int ii = 0; ii < n_gals * N_HISTORY_SNAPS; ++ii) {
+    if (rand() % 3 == 0) {
+      new_stars[ii] = 0.0;
+      new_metals[ii] = 0.0;
+    } else {
+      new_stars[ii] = pow(10., -8. + 6. * (double)rand() / RAND_MAX);
+      new_metals[ii] = new_stars[ii] * 0.04 * (double)rand() / RAND_MAX;
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc, &argv);
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  run_globals.mpi_rank = 0;
+  run_globals.mpi_size = 1;
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  int n_gals = 100000;
+  int n_repeats = 10;
+
+  if (argc == 4) {
+    n_gals = atoi(argv[2]);
+    n_repeats = atoi(argv[3]);
+  } else if (argc != 2) {
+    fprintf(stderr, "usage: %s <StellarFeedbackDir> [<n_gals> <n_repeats>]\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  if ((n_gals < 1) || (n_repeats < 1)) {
+    fprintf(stderr, "Invalid arguments.\n");
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  strncpy(run_globals.params.StellarFeedbackDir, argv[1], STRLEN - 1);
+  run_globals.params.SnaplistLength = N_SNAPS;
+  run_globals.params.Hubble_h = 1.0;
+  run_globals.units.UnitTime_in_Megayears = 1.0;
+  run_globals.units.UnitEnergy_in_cgs = 1.989e53;
+  run_globals.LTTime = malloc(sizeof(double) * N_SNAPS);
+  for (int ii = 0; ii < N_SNAPS; ii++)
+    run_globals.LTTime[ii] = SNAP_SPACING * (N_SNAPS - 1 - ii);
+  int last_snap = N_SNAPS - 1;
+  run_globals.ListOutputSnaps = &last_snap;
+  run_globals.NOutputSnaps = 1;
+
+  read_stellar_feedback_tables();
+
+  double* new_stars = malloc(sizeof(double) * (size_t)n_gals * N_HISTORY_SNAPS);
+  double* new_metals = malloc(sizeof(double) * (size_t)n_gals * N_HISTORY_SNAPS);
+  double* result_orig = malloc(sizeof(double) * (size_t)n_gals * 3);
+  double* result = malloc(sizeof(double) * (size_t)n_gals * 3);
+  make_histories(new_stars, new_metals, n_gals);
+
+  printf("# %d galaxies, %d history snapshots, %d repeats\n", n_gals, N_HISTORY_SNAPS, n_repeats);
+  printf("# %8s %12s %12s %8s %10s\n", "snapshot", "orig [s]", "history [s]", "speedup", "identical");
+
+  double total_orig = 0.0;
+  double total = 0.0;
+  int all_identical = 1;
+
+  for (int snapshot = N_HISTORY_SNAPS; snapshot < N_SNAPS; snapshot += 10) {
+    timer_info timer;
+    compute_stellar_feedback_tables(snapshot);
+
+    timer_start(&timer);
+    for (int ii = 0; ii < n_repeats; ++ii)
+      for (int i_gal = 0; i_gal < n_gals; ++i_gal)
+        delayed_feedback_orig(new_stars + i_gal * N_HISTORY_SNAPS,
+                              new_metals + i_gal * N_HISTORY_SNAPS,
+                              N_HISTORY_SNAPS,
+                              result_orig + i_gal * 3);
+    timer_stop(&timer);
+    float t_orig = timer_delta(timer);
+
+    timer_start(&timer);
+    for (int ii = 0; ii < n_repeats; ++ii)
+      for (int i_gal = 0; i_gal < n_gals; ++i_gal)
+        delayed_feedback(new_stars + i_gal * N_HISTORY_SNAPS,
+                         new_metals + i_gal * N_HISTORY_SNAPS,
+                         N_HISTORY_SNAPS,
+                         result + i_gal * 3);
+    timer_stop(&timer);
+    float t_history = timer_delta(timer);
+
+    int identical = memcmp(result, result_orig, sizeof(double) * (size_t)n_gals * 3) == 0;
+    all_identical &= identical;
+
+    printf("  %8d %12.4e %12.4e %8.2f %10s\n", snapshot, t_orig, t_history, t_orig / t_history, identical ? "yes" : "no");
+
+    total_orig += t_orig;
+    total += t_history;
+  }
+
+  printf("# total: orig %.4e s, history %.4e s, speedup %.2f\n", total_orig, total, total_orig / total);
+
+  free(result);
+  free(result_orig);
+  free(new_metals);
+  free(new_stars);
+  free_stellar_feedback_tables();
+  free(run_globals.LTTime);
+
+  MPI_Finalize();
+  return all_identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
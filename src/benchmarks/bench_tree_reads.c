@@ -0,0 +1,285 @@
+#define _MAIN
+#include <hdf5_hl.h>
+#include <math.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core/read_halos.h"
+#include "core/tree_file_cache.h"
+#include "core/utils.h"
+#include "meraxes.h"
+
+/*
+ * Count the HDF5 file and dataset opens and closes made by the VELOCIraptor
+ * tree readers, and time them, with and without the tree file cache
+ * (TreesMaxOpenFiles = 0 and > 0).
+ *
+ * usage: bench_tree_reads <work_dir> [<n_halos> <n_snaps> [<max_open_files>]]
+ *
+ * A synthetic set of trees (defaults: 100000 halos in each of 20 snapshots)
+ * is written to <work_dir>/trees and removed afterwards.  Both runs should
+ * read identical halos, which is also checked.
+ */
+
+#define TREE_PROPS_FILE "bench_tree_reads.h5"
+
+static const char* long_props[] = { "ForestID", "Head", "Tail", "hostHaloID" };
+static const char* double_props[] = { "Mass_200crit", "Mass_FOF", "Mass_tot", "R_200crit", "Vmax", "Xc", "Yc",
+                                      "Zc",           "VXc",      "VYc",      "VZc",       "Lx",   "Ly", "Lz" };
+static const char* ulong_props[] = { "ID", "npart" };
+
+static void write_prop(hid_t group_id, const char* name, hid_t type_id, int n_halos, const void* data)
+{
+  hsize_t dims = (hsize_t)n_halos;
+  hsize_t chunks = dims < 10000 ? dims : 10000;
+  hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+  H5Pset_chunk(dcpl_id, 1, &chunks);
+  hid_t fspace_id = H5Screate_simple(1, &dims, NULL);
+  hid_t dset_id = H5Dcreate(group_id, name, type_id, fspace_id, H5P_DEFAULT, dcpl_id, H5P_DEFAULT);
+  H5Dwrite(dset_id, type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+  H5Dclose(dset_id);
+  H5Sclose(fspace_id);
+  H5Pclose(dcpl_id);
+}
+
+static void write_synthetic_trees(const char* work_dir, int n_halos, int n_snaps)
+{
+  char fname[STRLEN * 2 + 8];
+
+  // One FOF group for every 4 halos, with the subhalos following their host
+  sprintf(fname, "%s/trees/meraxes_augmented_stats.h5", work_dir);
+  hid_t fd = H5Fcreate(fname, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  int n_fof_groups = (n_halos + 3) / 4;
+  int* counts = malloc(sizeof(int) * n_snaps);
+  hsize_t dims = (hsize_t)n_snaps;
+  for (int ii = 0; ii < n_snaps; ii++)
+    counts[ii] = n_halos;
+  H5LTmake_dataset_int(fd, "n_halos", 1, &dims, counts);
+  for (int ii = 0; ii < n_snaps; ii++)
+    counts[ii] = n_fof_groups;
+  H5LTmake_dataset_int(fd, "n_fof_groups", 1, &dims, counts);
+  H5LTset_attribute_int(fd, "/", "n_snaps", &n_snaps, 1);
+  H5LTset_attribute_int(fd, "/", "n_halos_max", &n_halos, 1);
+  H5LTset_attribute_int(fd, "/", "n_fof_groups_max", &n_fof_groups, 1);
+  H5Fclose(fd);
+  free(counts);
+
+  sprintf(fname, "%s/trees/%s", work_dir, TREE_PROPS_FILE);
+  fd = H5Fcreate(fname, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  hid_t group_id = H5Gcreate(fd, "Header", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Gclose(group_id);
+  group_id = H5Gcreate(fd, "Header/Units", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  H5Gclose(group_id);
+  double mass_unit = 1e10;
+  H5LTset_attribute_double(fd, "Header/Units", "Mass_unit_to_solarmass", &mass_unit, 1);
+
+  long* long_buffer = malloc(sizeof(long) * (size_t)n_halos);
+  double* double_buffer = malloc(sizeof(double) * (size_t)n_halos);
+  unsigned long* ulong_buffer = malloc(sizeof(unsigned long) * (size_t)n_halos);
+
+  srand(1012);
+  for (int snapshot = 0; snapshot < n_snaps; snapshot++) {
+    char group_name[9];
+    sprintf(group_name, "Snap_%03d", snapshot);
+    group_id = H5Gcreate(fd, group_name, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    H5LTset_attribute_int(fd, group_name, "NHalos", &n_halos, 1);
+    double scale_factor = 1.0 / (11.0 - 0.25 * snapshot);
+    H5LTset_attribute_double(fd, group_name, "scalefactor", &scale_factor, 1);
+
+    long id_offset = (long)snapshot * 1000000000000L + 1;
+    for (int i_prop = 0; i_prop < 4; i_prop++) {
+      for (int ii = 0; ii < n_halos; ii++)
+        switch (i_prop) {
+          case 0:
+            long_buffer[ii] = ii / 4;
+            break;
+          case 3:
+            long_buffer[ii] = (ii % 4 == 0) ? -1 : id_offset + ii - ii % 4;
+            break;
+          default:
+            // Head and Tail are the halo itself, i.e. no descendants or progenitors
+            long_buffer[ii] = id_offset + ii;
+            break;
+        }
+      write_prop(group_id, long_props[i_prop], H5T_NATIVE_LONG, n_halos, long_buffer);
+    }
+
+    for (int i_prop = 0; i_prop < 14; i_prop++) {
+      for (int ii = 0; ii < n_halos; ii++) {
+        double mass = pow(10., -2. + 3. * (double)(ii / 4) / n_fof_groups);
+        switch (i_prop) {
+          case 0: // Mass_200crit
+            double_buffer[ii] = mass;
+            break;
+          case 1: // Mass_FOF
+            double_buffer[ii] = 1.2 * mass;
+            break;
+          case 2: // Mass_tot
+            double_buffer[ii] = (ii % 4 == 0) ? 0.9 * mass : 0.05 * mass;
+            break;
+          case 3: // R_200crit
+            double_buffer[ii] = 0.1 * cbrt(mass);
+            break;
+          default:
+            double_buffer[ii] = 10.0 * (double)rand() / RAND_MAX;
+            break;
+        }
+      }
+      write_prop(group_id, double_props[i_prop], H5T_NATIVE_DOUBLE, n_halos, double_buffer);
+    }
+
+    for (int ii = 0; ii < n_halos; ii++)
+      ulong_buffer[ii] = (unsigned long)(id_offset + ii);
+    write_prop(group_id, ulong_props[0], H5T_NATIVE_ULONG, n_halos, ulong_buffer);
+    for (int ii = 0; ii < n_halos; ii++)
+      ulong_buffer[ii] = 100 + (unsigned long)(rand() % 10000);
+    write_prop(group_id, ulong_props[1], H5T_NATIVE_ULONG, n_halos, ulong_buffer);
+
+    H5Gclose(group_id);
+  }
+
+  free(ulong_buffer);
+  free(double_buffer);
+  free(long_buffer);
+  H5Fclose(fd);
+}
+
+static unsigned long hash_bytes(const void* data, size_t n, unsigned long hash)
+{
+  // FNV-1a
+  for (size_t ii = 0; ii < n; ii++)
+    hash = (hash ^ ((const unsigned char*)data)[ii]) * 1099511628211UL;
+  return hash;
+}
+
+static unsigned long read_all_snapshots(int n_snaps, halo_t* halos, fof_group_t* fof_groups, float* t_read)
+{
+  unsigned long hash = 14695981039346656037UL;
+  timer_info timer;
+
+  timer_start(&timer);
+  for (int snapshot = 0; snapshot < n_snaps; snapshot++) {
+    int n_halos = 0;
+    int n_fof_groups = 0;
+    trees_info_t trees_info = read_trees_info__velociraptor(snapshot);
+    read_trees__velociraptor(snapshot, halos, &n_halos, fof_groups, &n_fof_groups, NULL);
+    if (n_halos != trees_info.n_halos)
+      mlog_error("Read %d halos at snapshot %d (expected %d)", n_halos, snapshot, trees_info.n_halos);
+    hash = hash_bytes(halos, sizeof(halo_t) * (size_t)n_halos, hash);
+    hash = hash_bytes(fof_groups, sizeof(fof_group_t) * (size_t)n_fof_groups, hash);
+  }
+  close_tree_file_cache();
+  timer_stop(&timer);
+
+  *t_read = timer_delta(timer);
+  return hash;
+}
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc, &argv);
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  run_globals.mpi_rank = 0;
+  run_globals.mpi_size = 1;
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  int n_halos = 100000;
+  int n_snaps = 20;
+  int max_open_files = 4;
+
+  if (argc >= 4) {
+    n_halos = atoi(argv[2]);
+    n_snaps = atoi(argv[3]);
+    if (argc == 5)
+      max_open_files = atoi(argv[4]);
+  }
+  if (((argc != 2) && (argc != 4) && (argc != 5)) || (n_halos < 1) || (n_snaps < 1) || (n_snaps > 999) ||
+      (max_open_files < 1)) {
+    fprintf(stderr, "usage: %s <work_dir> [<n_halos> <n_snaps> [<max_open_files>]]\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+
+  run_params_t* params = &(run_globals.params);
+  strncpy(params->SimulationDir, argv[1], STRLEN - 1);
+  sprintf(params->CatalogFilePrefix, TREE_PROPS_FILE);
+  params->Hubble_h = 0.7;
+  params->BoxSize = 10.0;
+  params->OmegaM = 0.3;
+  params->OmegaLambda = 0.7;
+  params->OmegaK = 0.0;
+  params->TreesChunkCacheMB = 16;
+  params->TreesMetadataCacheMB = 8;
+  run_globals.RequestedMassRatioModifier = -1;
+  run_globals.G = 43.0;
+  run_globals.Hubble = 100.0;
+  run_globals.ZZ = malloc(sizeof(double) * n_snaps);
+  run_globals.rhocrit = malloc(sizeof(double) * n_snaps);
+  for (int ii = 0; ii < n_snaps; ii++) {
+    run_globals.ZZ[ii] = 10.0 - 0.25 * ii;
+    double zplus1 = run_globals.ZZ[ii] + 1.0;
+    double hubble = run_globals.Hubble * sqrt(params->OmegaM * zplus1 * zplus1 * zplus1 + params->OmegaLambda);
+    run_globals.rhocrit[ii] = 3 * hubble * hubble / (8 * M_PI * run_globals.G);
+  }
+
+  char trees_dir[STRLEN + 8];
+  sprintf(trees_dir, "%s/trees", argv[1]);
+  mkdir(trees_dir, 0755);
+  write_synthetic_trees(argv[1], n_halos, n_snaps);
+
+  halo_t* halos = malloc(sizeof(halo_t) * (size_t)n_halos);
+  fof_group_t* fof_groups = malloc(sizeof(fof_group_t) * (size_t)n_halos);
+
+  printf("# %d halos (%d chunks) in each of %d snapshots\n", n_halos, (n_halos + 9999) / 10000, n_snaps);
+  printf("# %14s %10s %10s %10s %10s %10s %10s\n",
+         "max open files",
+         "file open",
+         "file close",
+         "dset open",
+         "dset close",
+         "read [s]",
+         "identical");
+
+  unsigned long hash_ref = 0;
+  int all_identical = 1;
+  int settings[2] = { 0, max_open_files };
+  for (int ii = 0; ii < 2; ii++) {
+    float t_read;
+    params->TreesMaxOpenFiles = settings[ii];
+    tree_file_cache_stats_t before = get_tree_file_cache_stats();
+    unsigned long hash = read_all_snapshots(n_snaps, halos, fof_groups, &t_read);
+    tree_file_cache_stats_t after = get_tree_file_cache_stats();
+
+    if (ii == 0)
+      hash_ref = hash;
+    all_identical &= (hash == hash_ref);
+
+    printf("  %14d %10ld %10ld %10ld %10ld %10.4f %10s\n",
+           settings[ii],
+           after.n_file_opens - before.n_file_opens,
+           after.n_file_closes - before.n_file_closes,
+           after.n_dataset_opens - before.n_dataset_opens,
+           after.n_dataset_closes - before.n_dataset_closes,
+           t_read,
+           hash == hash_ref ? "yes" : "no");
+  }
+
+  char fname[STRLEN * 2 + 8];
+  sprintf(fname, "%s/meraxes_augmented_stats.h5", trees_dir);
+  remove(fname);
+  sprintf(fname, "%s/%s", trees_dir, TREE_PROPS_FILE);
+  remove(fname);
+  rmdir(trees_dir);
+
+  free(fof_groups);
+  free(halos);
+  free(run_globals.rhocrit);
+  free(run_globals.ZZ);
+
+  MPI_Finalize();
+  return all_identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -2,6 +2,9 @@
 #include <fftw3-mpi.h>
 #include <math.h>
 #include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "ComputeTs.h"
 #include "XRayHeatingFunctions.h"
@@ -11,6 +14,463 @@
 #include "reionization.h"
 #include "utils.h"
 
+static inline double interp_freq_int(const double* tbl, int n_filter_steps, int R_ct, int m_xHII_low, double xHII_call)
+{
+  // linear interpolation of a [x_int_NXHII][n_filter_steps] frequency integral table in the ionized fraction
+  const double lo = tbl[m_xHII_low * n_filter_steps + R_ct];
+  const double hi = tbl[(m_xHII_low + 1) * n_filter_steps + R_ct];
+
+  return (hi - lo) / (x_int_XHII[m_xHII_low + 1] - x_int_XHII[m_xHII_low]) * (xHII_call - x_int_XHII[m_xHII_low]) +
+         lo;
+}
+
+static inline void store_smoothed_sfr(double* sfr,
+                                      float* sfr_blocked,
+                                      int R_ct,
+                                      int ix,
+                                      int iy,
+                                      int iz,
+                                      int n_filter_steps,
+                                      int dim,
+                                      double sfr_internal,
+                                      const run_units_t* units)
+{
+  // The blocked float history is kept in internal units (the cgs values underflow a float) and converted on reading
+  if (sfr_blocked != NULL)
+    sfr_blocked[grid_index_smoothedSFR_blocked(R_ct, ix, iy, iz, n_filter_steps, dim)] = (float)sfr_internal;
+  else
+    sfr[grid_index_smoothedSFR(R_ct, ix, iy, iz, n_filter_steps, dim)] =
+      sfr_internal * (units->UnitMass_in_g / units->UnitTime_in_s) * pow(units->UnitLength_in_cm, -3.) / SOLAR_MASS;
+}
+
+void evolve_Ts_cells(const Ts_cell_inputs_t* in, int n_threads, Ts_cell_sums_t* sums)
+{
+  /*
+   * Evolve the electron fraction and kinetic temperature of every cell in the local slab over the redshift step
+   * in->dzp, and compute the resulting spin temperatures.  Cells are independent, so rows of cells are shared
+   * between n_threads OpenMP threads (<= 0 uses the OpenMP default).  Box sums are accumulated per row and then added
+   * up in row order, so the results don't depend on the number of threads.
+   */
+
+  const int ReionGridDim = in->grid_dim;
+  const int TsNumFilterSteps = in->n_filter_steps;
+  const int n_rows = in->local_nix * ReionGridDim;
+  const double zp = in->zp;
+  const double dzp = in->dzp;
+
+  float* x_e_box_prev = run_globals.reion_grids.x_e_box_prev;
+  float* Tk_box = run_globals.reion_grids.Tk_box;
+  float* TS_box = run_globals.reion_grids.TS_box;
+  float* deltax = run_globals.reion_grids.deltax;
+#if USE_MINI_HALOS
+  float* Tk_boxII = run_globals.reion_grids.Tk_boxII;
+  float* TS_boxII = run_globals.reion_grids.TS_boxII;
+  float* JLW_box = run_globals.reion_grids.JLW_box;
+  float* JLW_boxII = run_globals.reion_grids.JLW_boxII;
+#endif
+
+  Ts_cell_sums_t* row_sums = calloc((size_t)n_rows, sizeof(Ts_cell_sums_t));
+
+#ifdef _OPENMP
+  if (n_threads <= 0)
+    n_threads = omp_get_max_threads();
+#else
+  (void)n_threads;
+#endif
+
+#pragma omp parallel num_threads(n_threads)
+  {
+    double freq_int_heat_GAL[TsNumFilterSteps], freq_int_ion_GAL[TsNumFilterSteps], freq_int_lya_GAL[TsNumFilterSteps];
+    double SFR_GAL[TsNumFilterSteps];
+#if USE_MINI_HALOS
+    double freq_int_heat_III[TsNumFilterSteps], freq_int_ion_III[TsNumFilterSteps], freq_int_lya_III[TsNumFilterSteps];
+    double SFR_III[TsNumFilterSteps];
+#endif
+    double ans[3], dansdz[20];
+    float curr_xalpha;
+
+    kappa_accel_t acc;
+    init_kappa_accel(&acc);
+
+#pragma omp for schedule(dynamic)
+    for (int i_row = 0; i_row < n_rows; i_row++) {
+      const int ix = i_row / ReionGridDim;
+      const int iy = i_row % ReionGridDim;
+      Ts_cell_sums_t* row = &(row_sums[i_row]);
+
+      for (int iz = 0; iz < ReionGridDim; iz++) {
+        int i_real = grid_index(ix, iy, iz, ReionGridDim, INDEX_REAL);
+        int i_padded = grid_index(ix, iy, iz, ReionGridDim, INDEX_PADDED);
+
+        ans[0] = x_e_box_prev[i_padded];
+        ans[1] = Tk_box[i_real];
+#if USE_MINI_HALOS
+        ans[2] = Tk_boxII[i_real];
+#endif
+
+        // Check if ionized fraction is within boundaries; if not, adjust to be within
+        double xHII_call = x_e_box_prev[i_padded];
+        if (xHII_call > x_int_XHII[x_int_NXHII - 1] * 0.999) {
+          xHII_call = x_int_XHII[x_int_NXHII - 1] * 0.999;
+        } else if (xHII_call < x_int_XHII[0]) {
+          xHII_call = 1.001 * x_int_XHII[0];
+        }
+        int m_xHII_low = locate_xHII_index((float)xHII_call);
+
+        // interpolate to correct nu integral value based on the cell's ionization state
+        if (in->SMOOTHED_SFR_GAL_blocked != NULL) {
+          int i_block = grid_index_smoothedSFR_blocked(0, ix, iy, iz, TsNumFilterSteps, ReionGridDim);
+          for (int R_ct = 0; R_ct < TsNumFilterSteps; R_ct++) {
+            SFR_GAL[R_ct] = in->SMOOTHED_SFR_GAL_blocked[i_block + R_ct * SMOOTHED_SFR_BLOCK_CELLS] *
+                            in->SMOOTHED_SFR_blocked_units;
+#if USE_MINI_HALOS
+            SFR_III[R_ct] = in->SMOOTHED_SFR_III_blocked[i_block + R_ct * SMOOTHED_SFR_BLOCK_CELLS] *
+                            in->SMOOTHED_SFR_blocked_units;
+#endif
+          }
+        } else {
+          for (int R_ct = 0; R_ct < TsNumFilterSteps; R_ct++) {
+            int i_smoothedSFR = grid_index_smoothedSFR(R_ct, ix, iy, iz, TsNumFilterSteps, ReionGridDim);
+            SFR_GAL[R_ct] = in->SMOOTHED_SFR_GAL[i_smoothedSFR];
+#if USE_MINI_HALOS
+            SFR_III[R_ct] = in->SMOOTHED_SFR_III[i_smoothedSFR];
+#endif
+          }
+        }
+
+        for (int R_ct = 0; R_ct < TsNumFilterSteps; R_ct++) {
+          freq_int_heat_GAL[R_ct] =
+            interp_freq_int(in->freq_int_heat_tbl_GAL, TsNumFilterSteps, R_ct, m_xHII_low, xHII_call);
+          freq_int_ion_GAL[R_ct] =
+            interp_freq_int(in->freq_int_ion_tbl_GAL, TsNumFilterSteps, R_ct, m_xHII_low, xHII_call);
+          freq_int_lya_GAL[R_ct] =
+            interp_freq_int(in->freq_int_lya_tbl_GAL, TsNumFilterSteps, R_ct, m_xHII_low, xHII_call);
+#if USE_MINI_HALOS
+          freq_int_heat_III[R_ct] =
+            interp_freq_int(in->freq_int_heat_tbl_III, TsNumFilterSteps, R_ct, m_xHII_low, xHII_call);
+          freq_int_ion_III[R_ct] =
+            interp_freq_int(in->freq_int_ion_tbl_III, TsNumFilterSteps, R_ct, m_xHII_low, xHII_call);
+          freq_int_lya_III[R_ct] =
+            interp_freq_int(in->freq_int_lya_tbl_III, TsNumFilterSteps, R_ct, m_xHII_low, xHII_call);
+#endif
+        }
+
+        // Perform the calculation of the heating/ionisation integrals, updating relevant quantities etc.
+#if USE_MINI_HALOS
+        evolveInt((float)zp,
+                  deltax[i_padded],
+                  SFR_GAL,
+                  SFR_III,
+                  freq_int_heat_GAL,
+                  freq_int_ion_GAL,
+                  freq_int_lya_GAL,
+                  freq_int_heat_III,
+                  freq_int_ion_III,
+                  freq_int_lya_III,
+                  in->no_light,
+                  ans,
+                  dansdz);
+#else
+        evolveInt((float)zp,
+                  deltax[i_padded],
+                  SFR_GAL,
+                  0,
+                  freq_int_heat_GAL,
+                  freq_int_ion_GAL,
+                  freq_int_lya_GAL,
+                  0,
+                  0,
+                  0,
+                  in->no_light,
+                  ans,
+                  dansdz);
+#endif
+
+        x_e_box_prev[i_padded] += dansdz[0] * dzp; // remember dzp is negative
+        if (x_e_box_prev[i_padded] > 1)            // can do this late in evolution if dzp is too large
+          x_e_box_prev[i_padded] = (float)(1 - FRACT_FLOAT_ERR);
+        else if (x_e_box_prev[i_padded] < 0)
+          x_e_box_prev[i_padded] = 0;
+        if (Tk_box[i_real] < MAX_TK)
+          Tk_box[i_real] += dansdz[1] * dzp;
+
+#if USE_MINI_HALOS
+        if (Tk_boxII[i_real] < MAX_TK)
+          Tk_boxII[i_real] += dansdz[6] * dzp;
+        if (run_globals.params.Flag_IncludeLymanWerner) {
+          JLW_box[i_real] = dansdz[5];
+          JLW_boxII[i_real] = dansdz[10];
+        }
+#endif
+        // spurious bahaviour of the trapazoidalintegrator. generally overcooling in underdensities
+        if (Tk_box[i_real] < 0) {
+          Tk_box[i_real] = (float)(TCMB * (1 + zp));
+        }
+
+#if USE_MINI_HALOS
+        if (Tk_boxII[i_real] < 0) {
+          Tk_boxII[i_real] = (float)(TCMB * (1 + zp));
+        }
+#endif
+
+        TS_box[i_real] = get_Ts(
+          (float)zp, deltax[i_padded], Tk_box[i_real], x_e_box_prev[i_padded], (float)dansdz[2], &curr_xalpha, &acc);
+#if USE_MINI_HALOS
+        // It should be correct, probably I don't need a new curr_xalphaII
+        TS_boxII[i_real] = get_Ts(
+          (float)zp, deltax[i_padded], Tk_boxII[i_real], x_e_box_prev[i_padded], (float)dansdz[7], &curr_xalpha, &acc);
+#endif
+        row->J_alpha += dansdz[2];
+        row->xalpha += curr_xalpha; // Double check this! It might be saving the one from PopIII!
+        row->Xheat += dansdz[3];
+        row->Xion += dansdz[4];
+#if USE_MINI_HALOS
+        row->J_alphaII += dansdz[7];
+        row->XheatII += dansdz[8];
+        if (run_globals.params.Flag_IncludeLymanWerner) {
+          row->J_LW += dansdz[5];
+          row->J_LWII += dansdz[10];
+        }
+#endif
+      }
+    }
+
+    free_kappa_accel(&acc);
+  }
+
+  memset(sums, 0, sizeof(Ts_cell_sums_t));
+  for (int i_row = 0; i_row < n_rows; i_row++) {
+    sums->J_alpha += row_sums[i_row].J_alpha;
+    sums->xalpha += row_sums[i_row].xalpha;
+    sums->Xheat += row_sums[i_row].Xheat;
+    sums->Xion += row_sums[i_row].Xion;
+#if USE_MINI_HALOS
+    sums->J_alphaII += row_sums[i_row].J_alphaII;
+    sums->XheatII += row_sums[i_row].XheatII;
+    sums->J_LW += row_sums[i_row].J_LW;
+    sums->J_LWII += row_sums[i_row].J_LWII;
+#endif
+  }
+
+  free(row_sums);
+}
+
+static Ts_tables_t Ts_tables;
+
+static double luminosity_conversion_factor(double spec_index)
+{
+  // Below is the converstion of the soft-band X_ray luminosity into number of X-ray photons produced. This is the
+  // code taken from 21CMMC, which somewhat uses the 21cmFAST nomenclature (to ease flipping between old/new
+  // parameterisation), so isn't necessarily the most intuitive way to express this.
+
+  // Conversion of the input bolometric luminosity (new) to a ZETA_X (old) to be consistent with Ts.c from 21cmFAST
+  // Conversion here means the code otherwise remains the same as the original Ts.c
+  physics_params_t* physics = &(run_globals.params.physics);
+  double factor;
+
+  if (fabs(spec_index - 1.0) < 0.000001) {
+    factor = (physics->NuXrayGalThreshold * NU_over_EV) * log(physics->NuXraySoftCut / physics->NuXrayGalThreshold);
+    factor = 1. / factor;
+  } else {
+    factor = pow(physics->NuXraySoftCut * NU_over_EV, 1. - spec_index) -
+             pow(physics->NuXrayGalThreshold * NU_over_EV, 1. - spec_index);
+    factor = 1. / factor;
+    factor *= pow(physics->NuXrayGalThreshold * NU_over_EV, -spec_index) * (1 - spec_index);
+  }
+
+  // Finally, convert to the correct units. NU_over_EV*hplank as only want to divide by eV -> erg (owing to the
+  // definition of Luminosity)
+  return factor * (SEC_PER_YEAR) / (PLANCK);
+}
+
+double xray_emissivity_prefactor(double zp, double lum_xray, double spec_index)
+{
+  // Leave the original 21cmFAST code for reference. Refer to Greig & Mesinger (2017) for the new parameterisation.
+  //        const_zp_prefactor_GAL = (1.0/0.59)*( run_globals.params.physics.LXrayGal *
+  //        Luminosity_converstion_factor_GAL ) / (run_globals.params.physics.NuXrayGalThreshold*NU_over_EV) *
+  //        SPEED_OF_LIGHT * pow(1+zp, run_globals.params.physics.SpecIndexXrayGal+3);
+  const double NuXrayGalThreshold = run_globals.params.physics.NuXrayGalThreshold;
+
+  return (lum_xray * luminosity_conversion_factor(spec_index)) / (NuXrayGalThreshold * NU_over_EV) * SPEED_OF_LIGHT *
+         pow(1 + zp, spec_index + 3);
+}
+
+static void tabulate_lyn_sums(int snapshot, const double* R_values)
+{
+  const int TsNumFilterSteps = Ts_tables.n_filter_steps;
+  const int i_table = snapshot * TsNumFilterSteps;
+  const int n_pts_radii = 1000;
+  const double zp = run_globals.ZZ[snapshot];
+
+  double* zpp_edge = &(Ts_tables.zpp_edge[i_table]);
+  double* sum_lyn = &(Ts_tables.sum_lyn[i_table]);
+#if USE_MINI_HALOS
+  double* sum_lyn_III = &(Ts_tables.sum_lyn_III[i_table]);
+  double* sum_lyn_LW = NULL;
+  double* sum_lyn_LW_III = NULL;
+  if (run_globals.params.Flag_IncludeLymanWerner) {
+    sum_lyn_LW = &(Ts_tables.sum_lyn_LW[i_table]);
+    sum_lyn_LW_III = &(Ts_tables.sum_lyn_LW_III[i_table]);
+  }
+#endif
+
+  double prev_zpp, prev_R, zpp, nuprime;
+  double weight = 0;
+  bool first_radii = true;
+  bool first_zero = true;
+
+  for (int R_ct = 0; R_ct < TsNumFilterSteps; R_ct++) {
+
+    if (R_ct == 0) {
+      prev_zpp = zp;
+      prev_R = 0;
+    } else {
+      prev_zpp = zpp_edge[R_ct - 1];
+      prev_R = R_values[R_ct - 1];
+    }
+
+    zpp_edge[R_ct] = prev_zpp - (R_values[R_ct] - prev_R) * MPC / (drdz((float)prev_zpp)); // cell size
+    zpp = (zpp_edge[R_ct] + prev_zpp) * 0.5; // average redshift value of shell: z'' + 0.5 * dz''
+
+    Ts_tables.zpp[i_table + R_ct] = zpp;
+    Ts_tables.dt_dzpp[i_table + R_ct] = dtdz((float)zpp);
+
+    // and create the sum over Lya transitions from direct Lyn flux
+    for (int n_ct = NSPEC_MAX; n_ct >= 2; n_ct--) {
+      if (zpp > zmax((float)zp, n_ct))
+        continue;
+
+      nuprime = nu_n(n_ct) * (1 + zpp) / (1.0 + zp);
+      sum_lyn[R_ct] += frecycle(n_ct) * spectral_emissivity(nuprime, 0, 2);
+#if USE_MINI_HALOS
+      sum_lyn_III[R_ct] += frecycle(n_ct) * spectral_emissivity(nuprime, 0, 3);
+      if (run_globals.params.Flag_IncludeLymanWerner) {
+        if (nuprime < NU_LW / NU_LL)
+          nuprime = NU_LW / NU_LL;
+        if (nuprime > nu_n(n_ct + 1))
+          continue;
+        sum_lyn_LW[R_ct] += spectral_emissivity(nuprime, 2, 2);
+        sum_lyn_LW_III[R_ct] += spectral_emissivity(nuprime, 2, 3);
+      }
+
+#endif
+    }
+
+    // Find if we need to add a partial contribution to a radii to avoid kinks in the Lyman-alpha flux
+    // As we look at discrete radii (light-cone redshift, zpp) we can have two radii where one has a
+    // contribution and the next (larger) radii has no contribution. However, if the number of filtering
+    // steps were infinitely large, we would have contributions between these two discrete radii
+    // Thus, this aims to add a weighted contribution to the first radii where this occurs to smooth out
+    // kinks in the average Lyman-alpha flux.
+
+    // Note: We do not apply this correction to the LW background as it is unaffected by this. It is only
+    // the Lyn contribution that experiences the kink. Applying this correction to LW introduces kinks
+    // into the otherwise smooth quantity
+    if (R_ct > 2 && sum_lyn[R_ct] == 0.0 && sum_lyn[R_ct - 1] > 0. && first_radii) {
+
+      // The current zpp for which we are getting zero contribution
+      double trial_zpp_max = (prev_zpp - (R_values[R_ct] - prev_R) * MPC / drdz((float)prev_zpp) + prev_zpp) * 0.5;
+      // The zpp for the previous radius for which we had a non-zero contribution
+      double trial_zpp_min =
+        (zpp_edge[R_ct - 2] - (R_values[R_ct - 1] - R_values[R_ct - 2]) * MPC / drdz((float)zpp_edge[R_ct - 2]) +
+         zpp_edge[R_ct - 2]) *
+        0.5;
+
+      // Split the previous radii and current radii into n_pts_radii smaller radii (redshift) to have fine control of
+      // where it transitions from zero to non-zero This is a coarse approximation as it assumes that the linear
+      // sampling is a good representation of the different volumes of the shells (from different radii).
+      for (int ii = 0; ii < n_pts_radii; ii++) {
+        double trial_zpp = trial_zpp_min + (trial_zpp_max - trial_zpp_min) * (float)ii / ((float)n_pts_radii - 1.);
+
+        int counter = 0;
+        for (int n_ct = NSPEC_MAX; n_ct >= 2; n_ct--) {
+          if (trial_zpp > zmax(zp, n_ct))
+            continue;
+
+          counter += 1;
+        }
+        if (counter == 0 && first_zero) {
+          first_zero = false;
+          weight = (float)ii / (float)n_pts_radii;
+        }
+      }
+
+      // Now add a non-zero contribution to the previously zero contribution
+      // The amount is the weight, multplied by the contribution from the previous radii
+      sum_lyn[R_ct] = weight * sum_lyn[R_ct - 1];
+#if USE_MINI_HALOS
+      sum_lyn_III[R_ct] = weight * sum_lyn_III[R_ct - 1]; // I am not really sure about this line!
+      if (run_globals.params.Flag_IncludeLymanWerner)
+        sum_lyn_LW[R_ct] = weight * sum_lyn_LW[R_ct - 1];
+#endif
+      first_radii = false;
+    }
+  }
+}
+
+void init_Ts_tables()
+{
+  /*
+   * Tabulate the parts of the _ComputeTs preamble which depend only on the snapshot redshift and filter radius (and
+   * not on the grids) for every snapshot: the shell redshifts and the sums over the Lyman series.  The spectral
+   * emissivity tables must be initialised (init_heat) before calling this.  The X-ray emissivity prefactors depend on
+   * the (possibly MCMC sampled) X-ray parameters, so are instead computed by _ComputeTs on every call.
+   */
+
+  const int n_snaps = run_globals.params.SnaplistLength;
+  const int TsNumFilterSteps = run_globals.params.TsNumFilterSteps;
+  const int ReionGridDim = run_globals.params.ReionGridDim;
+  const double box_size = run_globals.params.BoxSize / run_globals.params.Hubble_h; // Mpc
+  const size_t n_entries = (size_t)n_snaps * TsNumFilterSteps;
+  double R_values[TsNumFilterSteps];
+
+  free_Ts_tables();
+
+  Ts_tables.n_snaps = n_snaps;
+  Ts_tables.n_filter_steps = TsNumFilterSteps;
+  Ts_tables.zpp_edge = calloc(n_entries, sizeof(double));
+  Ts_tables.zpp = calloc(n_entries, sizeof(double));
+  Ts_tables.dt_dzpp = calloc(n_entries, sizeof(double));
+  Ts_tables.sum_lyn = calloc(n_entries, sizeof(double));
+#if USE_MINI_HALOS
+  Ts_tables.sum_lyn_III = calloc(n_entries, sizeof(double));
+  if (run_globals.params.Flag_IncludeLymanWerner) {
+    Ts_tables.sum_lyn_LW = calloc(n_entries, sizeof(double));
+    Ts_tables.sum_lyn_LW_III = calloc(n_entries, sizeof(double));
+  }
+#endif
+
+  // The filter radii used by _ComputeTs
+  double R = L_FACTOR * box_size / (float)ReionGridDim;
+  double R_factor = pow(R_XLy_MAX / R, 1 / (float)TsNumFilterSteps);
+  for (int R_ct = 0; R_ct < TsNumFilterSteps; R_ct++) {
+    R_values[R_ct] = R;
+    R *= R_factor;
+  }
+
+  for (int snapshot = 0; snapshot < n_snaps; snapshot++)
+    tabulate_lyn_sums(snapshot, R_values);
+}
+
+void free_Ts_tables()
+{
+  free(Ts_tables.zpp_edge);
+  free(Ts_tables.zpp);
+  free(Ts_tables.dt_dzpp);
+  free(Ts_tables.sum_lyn);
+#if USE_MINI_HALOS
+  free(Ts_tables.sum_lyn_III);
+  free(Ts_tables.sum_lyn_LW);
+  free(Ts_tables.sum_lyn_LW_III);
+#endif
+  memset(&Ts_tables, 0, sizeof(Ts_tables_t));
+}
+
+const Ts_tables_t* get_Ts_tables()
+{
+  return &Ts_tables;
+}
+
 /*
  * This code is a re-write of the spin temperature calculation (Ts.c) within 21cmFAST.
  * Modified for usage within Meraxes by Bradley Greig.
@@ -50,31 +510,18 @@ void _ComputeTs(int snapshot)
     prev_redshift = run_globals.ZZ[snapshot - 1];
   }
 
-  int i_real, i_padded, i_smoothedSFR, R_ct, x_e_ct, n_ct, m_xHII_low, m_xHII_high, NO_LIGHT;
+  int i_real, i_padded, R_ct, x_e_ct, NO_LIGHT;
 
-  double prev_zpp, prev_R, zpp, zp, lower_int_limit_GAL, filling_factor_of_HI_zp, R_factor, R, nuprime, dzp,
-    Luminosity_converstion_factor_GAL;
+  double zpp, zp, lower_int_limit_GAL, filling_factor_of_HI_zp, R_factor, R, dzp;
   double collapse_fraction, density_over_mean, collapse_fraction_in_cell;
 
 #if USE_MINI_HALOS
-  double Luminosity_converstion_factor_III, collapse_fractionIII, collapse_fractionIII_in_cell;
+  double collapse_fractionIII, collapse_fractionIII_in_cell;
 #endif
 
-  // TODO: Can we reduce the scope of these variables and, if not, improve the names?
-  double weight = 0;
-  bool first_radii = true;
-  bool first_zero = true;
-  int n_pts_radii = 1000;
-
   float curr_xalpha;
   int TsNumFilterSteps = run_globals.params.TsNumFilterSteps;
 
-  double freq_int_heat_GAL[TsNumFilterSteps], freq_int_ion_GAL[TsNumFilterSteps], freq_int_lya_GAL[TsNumFilterSteps];
-
-#if USE_MINI_HALOS
-  double freq_int_heat_III[TsNumFilterSteps], freq_int_ion_III[TsNumFilterSteps], freq_int_lya_III[TsNumFilterSteps];
-#endif
-
   double freq_int_heat_tbl_GAL[x_int_NXHII][TsNumFilterSteps], freq_int_ion_tbl_GAL[x_int_NXHII][TsNumFilterSteps],
     freq_int_lya_tbl_GAL[x_int_NXHII][TsNumFilterSteps];
 
@@ -83,17 +530,8 @@ void _ComputeTs(int snapshot)
     freq_int_lya_tbl_III[x_int_NXHII][TsNumFilterSteps];
 #endif
 
-  double R_values[TsNumFilterSteps];
-
   double dt_dzpp_list[TsNumFilterSteps];
 
-  double ans[3], dansdz[20], xHII_call;
-  double SFR_GAL[TsNumFilterSteps];
-
-#if USE_MINI_HALOS
-  double SFR_III[TsNumFilterSteps];
-#endif
-
   float* x_e_box = run_globals.reion_grids.x_e_box;
   float* x_e_box_prev = run_globals.reion_grids.x_e_box_prev;
   float* Tk_box = run_globals.reion_grids.Tk_box;
@@ -102,8 +540,6 @@ void _ComputeTs(int snapshot)
 #if USE_MINI_HALOS
   float* Tk_boxII = run_globals.reion_grids.Tk_boxII;
   float* TS_boxII = run_globals.reion_grids.TS_boxII;
-  float* JLW_box = run_globals.reion_grids.JLW_box;
-  float* JLW_boxII = run_globals.reion_grids.JLW_boxII;
 #endif
 
   fftwf_complex* sfr_unfiltered = run_globals.reion_grids.sfr_unfiltered;
@@ -127,12 +563,17 @@ void _ComputeTs(int snapshot)
   }
 
   double* SMOOTHED_SFR_GAL = run_globals.reion_grids.SMOOTHED_SFR_GAL;
+  float* SMOOTHED_SFR_GAL_blocked = run_globals.reion_grids.SMOOTHED_SFR_GAL_blocked;
 #if USE_MINI_HALOS
   double* SMOOTHED_SFR_III = run_globals.reion_grids.SMOOTHED_SFR_III;
+  float* SMOOTHED_SFR_III_blocked = run_globals.reion_grids.SMOOTHED_SFR_III_blocked;
 #endif
 
   // Initialise the RECFAST, electron rate tables
   init_heat();
+  if (Ts_tables.n_snaps == 0)
+    init_Ts_tables();
+  const int i_table = snapshot * TsNumFilterSteps;
 
   x_e_ave = 0.0;
 
@@ -166,7 +607,8 @@ void _ComputeTs(int snapshot)
                                   Tk_box[i_real],
                                   x_e_box_prev[i_padded],
                                   0,
-                                  &curr_xalpha);
+                                  &curr_xalpha,
+                                  NULL);
 #if USE_MINI_HALOS
           Tk_boxII[i_real] = Tk_box[i_real];
           TS_boxII[i_real] = TS_box[i_real]; // This is true because Jalpha = 0 so curr_xalpha is the same.
@@ -240,28 +682,33 @@ void _ComputeTs(int snapshot)
     // heating/ionisation integrals)
     for (R_ct = 0; R_ct < TsNumFilterSteps; R_ct++) {
 
-      R_values[R_ct] = R;
-
-      memcpy(sfr_filtered, sfr_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
+      if (run_globals.reion_grids.Ts_filter_batch != NULL) {
+        // copy, filter (for R_ct > 0) and inverse transform the Pop II and Pop III SFR fields together
+        execute_filter_batch(
+          run_globals.reion_grids.Ts_filter_batch, (float)R, run_globals.params.TsHeatingFilterType, R_ct > 0);
+      } else {
+        memcpy(sfr_filtered, sfr_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
 #if USE_MINI_HALOS
-      memcpy(sfrIII_filtered, sfrIII_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
+        memcpy(sfrIII_filtered, sfrIII_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
 #endif
 
-      if (R_ct > 0) {
-        int local_ix_start = (int)(run_globals.reion_grids.slab_ix_start[run_globals.mpi_rank]);
+        if (R_ct > 0) {
+          int local_ix_start = (int)(run_globals.reion_grids.slab_ix_start[run_globals.mpi_rank]);
 
-        filter(sfr_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.TsHeatingFilterType);
+          filter(
+            sfr_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.TsHeatingFilterType);
 #if USE_MINI_HALOS
-        filter(
-          sfrIII_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.TsHeatingFilterType);
+          filter(
+            sfrIII_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.TsHeatingFilterType);
 #endif
-      }
+        }
 
-      // inverse fourier transform back to real space
-      fftwf_execute(run_globals.reion_grids.sfr_filtered_reverse_plan);
+        // inverse fourier transform back to real space
+        fftwf_execute(run_globals.reion_grids.sfr_filtered_reverse_plan);
 #if USE_MINI_HALOS
-      fftwf_execute(run_globals.reion_grids.sfrIII_filtered_reverse_plan);
+        fftwf_execute(run_globals.reion_grids.sfrIII_filtered_reverse_plan);
 #endif
+      }
 
       // Compute and store the collapse fraction and average electron fraction. Necessary for evaluating the integrals
       // back along the light-cone. Need the non-smoothed version, hence this is only done for R_ct == 0.
@@ -272,19 +719,32 @@ void _ComputeTs(int snapshot)
             for (int iz = 0; iz < ReionGridDim; iz++) {
               i_padded = grid_index(ix, iy, iz, ReionGridDim, INDEX_PADDED);
               i_real = grid_index(ix, iy, iz, ReionGridDim, INDEX_REAL);
-              i_smoothedSFR = grid_index_smoothedSFR(R_ct, ix, iy, iz, TsNumFilterSteps, ReionGridDim);
 
               ((float*)sfr_filtered)[i_padded] = fmaxf(((float*)sfr_filtered)[i_padded], 0.0);
 
-              SMOOTHED_SFR_GAL[i_smoothedSFR] = (((float*)sfr_filtered)[i_padded] / pixel_volume) *
-                                                (units->UnitMass_in_g / units->UnitTime_in_s) *
-                                                pow(units->UnitLength_in_cm, -3.) / SOLAR_MASS;
+              store_smoothed_sfr(SMOOTHED_SFR_GAL,
+                                 SMOOTHED_SFR_GAL_blocked,
+                                 R_ct,
+                                 ix,
+                                 iy,
+                                 iz,
+                                 TsNumFilterSteps,
+                                 ReionGridDim,
+                                 ((float*)sfr_filtered)[i_padded] / pixel_volume,
+                                 units);
 #if USE_MINI_HALOS
               ((float*)sfrIII_filtered)[i_padded] = fmaxf(((float*)sfrIII_filtered)[i_padded], 0.0);
 
-              SMOOTHED_SFR_III[i_smoothedSFR] = (((float*)sfrIII_filtered)[i_padded] / pixel_volume) *
-                                                (units->UnitMass_in_g / units->UnitTime_in_s) *
-                                                pow(units->UnitLength_in_cm, -3.) / SOLAR_MASS;
+              store_smoothed_sfr(SMOOTHED_SFR_III,
+                                 SMOOTHED_SFR_III_blocked,
+                                 R_ct,
+                                 ix,
+                                 iy,
+                                 iz,
+                                 TsNumFilterSteps,
+                                 ReionGridDim,
+                                 ((float*)sfrIII_filtered)[i_padded] / pixel_volume,
+                                 units);
 #endif
 
               density_over_mean = 1.0 + run_globals.reion_grids.deltax[i_padded];
@@ -336,20 +796,33 @@ void _ComputeTs(int snapshot)
             for (int iz = 0; iz < ReionGridDim; iz++) {
               i_real = grid_index(ix, iy, iz, ReionGridDim, INDEX_REAL);
               i_padded = grid_index(ix, iy, iz, ReionGridDim, INDEX_PADDED);
-              i_smoothedSFR = grid_index_smoothedSFR(R_ct, ix, iy, iz, TsNumFilterSteps, ReionGridDim);
 
               ((float*)sfr_filtered)[i_padded] = fmaxf(((float*)sfr_filtered)[i_padded], 0.0);
 #if USE_MINI_HALOS
               ((float*)sfrIII_filtered)[i_padded] = fmaxf(((float*)sfrIII_filtered)[i_padded], 0.0);
 #endif
 
-              SMOOTHED_SFR_GAL[i_smoothedSFR] = (((float*)sfr_filtered)[i_padded] / pixel_volume) *
-                                                (units->UnitMass_in_g / units->UnitTime_in_s) *
-                                                pow(units->UnitLength_in_cm, -3.) / SOLAR_MASS;
+              store_smoothed_sfr(SMOOTHED_SFR_GAL,
+                                 SMOOTHED_SFR_GAL_blocked,
+                                 R_ct,
+                                 ix,
+                                 iy,
+                                 iz,
+                                 TsNumFilterSteps,
+                                 ReionGridDim,
+                                 ((float*)sfr_filtered)[i_padded] / pixel_volume,
+                                 units);
 #if USE_MINI_HALOS
-              SMOOTHED_SFR_III[i_smoothedSFR] = (((float*)sfrIII_filtered)[i_padded] / pixel_volume) *
-                                                (units->UnitMass_in_g / units->UnitTime_in_s) *
-                                                pow(units->UnitLength_in_cm, -3.) / SOLAR_MASS;
+              store_smoothed_sfr(SMOOTHED_SFR_III,
+                                 SMOOTHED_SFR_III_blocked,
+                                 R_ct,
+                                 ix,
+                                 iy,
+                                 iz,
+                                 TsNumFilterSteps,
+                                 ReionGridDim,
+                                 ((float*)sfrIII_filtered)[i_padded] / pixel_volume,
+                                 units);
 #endif
             }
       }
@@ -369,21 +842,15 @@ void _ComputeTs(int snapshot)
       NO_LIGHT = 1;
     }
 
-    // Populate the initial ionisation/heating tables
+    // Populate the initial ionisation/heating tables.  zpp increases with R_ct, so each nu_tau_one root brackets the
+    // next one from below.
+    nu_tau_one_memo_t nu_tau_one_memo;
+    init_nu_tau_one_memo(&nu_tau_one_memo);
     for (R_ct = 0; R_ct < TsNumFilterSteps; R_ct++) {
 
-      if (R_ct == 0) {
-        prev_zpp = zp;
-        prev_R = 0;
-      } else {
-        prev_zpp = zpp_edge[R_ct - 1];
-        prev_R = R_values[R_ct - 1];
-      }
-
-      zpp_edge[R_ct] = prev_zpp - (R_values[R_ct] - prev_R) * MPC / (drdz((float)prev_zpp)); // cell size
-      zpp = (zpp_edge[R_ct] + prev_zpp) * 0.5; // average redshift value of shell: z'' + 0.5 * dz''
-
-      dt_dzpp_list[R_ct] = dtdz((float)zpp);
+      zpp_edge[R_ct] = Ts_tables.zpp_edge[i_table + R_ct];
+      zpp = Ts_tables.zpp[i_table + R_ct];
+      dt_dzpp_list[R_ct] = Ts_tables.dt_dzpp[i_table + R_ct];
 
 #if USE_MINI_HALOS
       filling_factor_of_HI_zp =
@@ -392,8 +859,9 @@ void _ComputeTs(int snapshot)
       filling_factor_of_HI_zp = 1. - ReionEfficiency * collapse_fraction / (1.0 - x_e_ave);
 #endif
 
-      lower_int_limit_GAL = fmax(nu_tau_one(zp, zpp, x_e_ave, filling_factor_of_HI_zp, snapshot),
-                                 run_globals.params.physics.NuXrayGalThreshold * NU_over_EV);
+      lower_int_limit_GAL =
+        fmax(nu_tau_one_cached(&nu_tau_one_memo, zp, zpp, x_e_ave, filling_factor_of_HI_zp, snapshot),
+             run_globals.params.physics.NuXrayGalThreshold * NU_over_EV);
 
       if (filling_factor_of_HI_zp < 0)
         filling_factor_of_HI_zp =
@@ -440,151 +908,29 @@ void _ComputeTs(int snapshot)
                                                                2);
 #endif
       }
+    }
+    free_nu_tau_one_memo(&nu_tau_one_memo);
 
-      // and create the sum over Lya transitions from direct Lyn flux
-      sum_lyn[R_ct] = 0;
-#if USE_MINI_HALOS
-      sum_lyn_III[R_ct] = 0;
-      if (run_globals.params.Flag_IncludeLymanWerner) {
-        sum_lyn_LW[R_ct] = 0;
-        sum_lyn_LW_III[R_ct] = 0;
-      }
-#endif
-
-      for (n_ct = NSPEC_MAX; n_ct >= 2; n_ct--) {
-        if (zpp > zmax((float)zp, n_ct))
-          continue;
-
-        nuprime = nu_n(n_ct) * (1 + zpp) / (1.0 + zp);
-        sum_lyn[R_ct] += frecycle(n_ct) * spectral_emissivity(nuprime, 0, 2);
-#if USE_MINI_HALOS
-        sum_lyn_III[R_ct] += frecycle(n_ct) * spectral_emissivity(nuprime, 0, 3);
-        if (run_globals.params.Flag_IncludeLymanWerner) {
-          if (nuprime < NU_LW / NU_LL)
-            nuprime = NU_LW / NU_LL;
-          if (nuprime > nu_n(n_ct + 1))
-            continue;
-          sum_lyn_LW[R_ct] += spectral_emissivity(nuprime, 2, 2);
-          sum_lyn_LW_III[R_ct] += spectral_emissivity(nuprime, 2, 3);
-        }
-
-#endif
-      }
-
-      // Find if we need to add a partial contribution to a radii to avoid kinks in the Lyman-alpha flux
-      // As we look at discrete radii (light-cone redshift, zpp) we can have two radii where one has a
-      // contribution and the next (larger) radii has no contribution. However, if the number of filtering
-      // steps were infinitely large, we would have contributions between these two discrete radii
-      // Thus, this aims to add a weighted contribution to the first radii where this occurs to smooth out
-      // kinks in the average Lyman-alpha flux.
-
-      // Note: We do not apply this correction to the LW background as it is unaffected by this. It is only
-      // the Lyn contribution that experiences the kink. Applying this correction to LW introduces kinks
-      // into the otherwise smooth quantity
-      if (R_ct > 2 && sum_lyn[R_ct] == 0.0 && sum_lyn[R_ct - 1] > 0. && first_radii) {
-
-        // The current zpp for which we are getting zero contribution
-        double trial_zpp_max = (prev_zpp - (R_values[R_ct] - prev_R) * MPC / drdz((float)prev_zpp) + prev_zpp) * 0.5;
-        // The zpp for the previous radius for which we had a non-zero contribution
-        double trial_zpp_min =
-          (zpp_edge[R_ct - 2] - (R_values[R_ct - 1] - R_values[R_ct - 2]) * MPC / drdz((float)zpp_edge[R_ct - 2]) +
-           zpp_edge[R_ct - 2]) *
-          0.5;
-
-        // Split the previous radii and current radii into n_pts_radii smaller radii (redshift) to have fine control of
-        // where it transitions from zero to non-zero This is a coarse approximation as it assumes that the linear
-        // sampling is a good representation of the different volumes of the shells (from different radii).
-        for (int ii = 0; ii < n_pts_radii; ii++) {
-          double trial_zpp = trial_zpp_min + (trial_zpp_max - trial_zpp_min) * (float)ii / ((float)n_pts_radii - 1.);
-
-          int counter = 0;
-          for (n_ct = NSPEC_MAX; n_ct >= 2; n_ct--) {
-            if (trial_zpp > zmax(zp, n_ct))
-              continue;
-
-            counter += 1;
-          }
-          if (counter == 0 && first_zero) {
-            first_zero = false;
-            weight = (float)ii / (float)n_pts_radii;
-          }
-        }
-
-        // Now add a non-zero contribution to the previously zero contribution
-        // The amount is the weight, multplied by the contribution from the previous radii
-        sum_lyn[R_ct] = weight * sum_lyn[R_ct - 1];
+    // the sums over Lya transitions from direct Lyn flux
+    memcpy(sum_lyn, &(Ts_tables.sum_lyn[i_table]), sizeof(double) * TsNumFilterSteps);
 #if USE_MINI_HALOS
-        sum_lyn_III[R_ct] = weight * sum_lyn_III[R_ct - 1]; // I am not really sure about this line!
-        if (run_globals.params.Flag_IncludeLymanWerner)
-          sum_lyn_LW[R_ct] = weight * sum_lyn_LW[R_ct - 1];
-#endif
-        first_radii = false;
-      }
+    memcpy(sum_lyn_III, &(Ts_tables.sum_lyn_III[i_table]), sizeof(double) * TsNumFilterSteps);
+    if (run_globals.params.Flag_IncludeLymanWerner) {
+      memcpy(sum_lyn_LW, &(Ts_tables.sum_lyn_LW[i_table]), sizeof(double) * TsNumFilterSteps);
+      memcpy(sum_lyn_LW_III, &(Ts_tables.sum_lyn_LW_III[i_table]), sizeof(double) * TsNumFilterSteps);
     }
+#endif
 
     growth_factor_zp = dicke(zp);
     dgrowth_factor_dzp = ddicke_dz(zp);
     dt_dzp = dtdz((float)zp);
 
-    // Below is the converstion of the soft-band X_ray luminosity into number of X-ray photons produced. This is the
-    // code taken from 21CMMC, which somewhat uses the 21cmFAST nomenclature (to ease flipping between old/new
-    // parameterisation), so isn't necessarily the most intuitive way to express this.
-
-    // Conversion of the input bolometric luminosity (new) to a ZETA_X (old) to be consistent with Ts.c from 21cmFAST
-    // Conversion here means the code otherwise remains the same as the original Ts.c
-    if (fabs(run_globals.params.physics.SpecIndexXrayGal - 1.0) < 0.000001) {
-      Luminosity_converstion_factor_GAL =
-        (run_globals.params.physics.NuXrayGalThreshold * NU_over_EV) *
-        log(run_globals.params.physics.NuXraySoftCut / run_globals.params.physics.NuXrayGalThreshold);
-      Luminosity_converstion_factor_GAL = 1. / Luminosity_converstion_factor_GAL;
-    } else {
-      Luminosity_converstion_factor_GAL =
-        pow(run_globals.params.physics.NuXraySoftCut * NU_over_EV, 1. - run_globals.params.physics.SpecIndexXrayGal) -
-        pow(run_globals.params.physics.NuXrayGalThreshold * NU_over_EV,
-            1. - run_globals.params.physics.SpecIndexXrayGal);
-      Luminosity_converstion_factor_GAL = 1. / Luminosity_converstion_factor_GAL;
-      Luminosity_converstion_factor_GAL *=
-        pow(run_globals.params.physics.NuXrayGalThreshold * NU_over_EV, -run_globals.params.physics.SpecIndexXrayGal) *
-        (1 - run_globals.params.physics.SpecIndexXrayGal);
-    }
-    // Finally, convert to the correct units. NU_over_EV*hplank as only want to divide by eV -> erg (owing to the
-    // definition of Luminosity)
-
-    Luminosity_converstion_factor_GAL *= (SEC_PER_YEAR) / (PLANCK);
-
-    // Do the same for Pop III.
-
-#if USE_MINI_HALOS
-    if (fabs(run_globals.params.physics.SpecIndexXrayIII - 1.0) < 0.000001) {
-      Luminosity_converstion_factor_III =
-        (run_globals.params.physics.NuXrayGalThreshold * NU_over_EV) *
-        log(run_globals.params.physics.NuXraySoftCut / run_globals.params.physics.NuXrayGalThreshold);
-      Luminosity_converstion_factor_III = 1. / Luminosity_converstion_factor_III;
-    } else {
-      Luminosity_converstion_factor_III =
-        pow(run_globals.params.physics.NuXraySoftCut * NU_over_EV, 1. - run_globals.params.physics.SpecIndexXrayIII) -
-        pow(run_globals.params.physics.NuXrayGalThreshold * NU_over_EV,
-            1. - run_globals.params.physics.SpecIndexXrayIII);
-      Luminosity_converstion_factor_III = 1. / Luminosity_converstion_factor_III;
-      Luminosity_converstion_factor_III *=
-        pow(run_globals.params.physics.NuXrayGalThreshold * NU_over_EV, -run_globals.params.physics.SpecIndexXrayIII) *
-        (1 - run_globals.params.physics.SpecIndexXrayIII);
-    }
-
-    Luminosity_converstion_factor_III *= (SEC_PER_YEAR) / (PLANCK);
-#endif
-
-    // Leave the original 21cmFAST code for reference. Refer to Greig & Mesinger (2017) for the new parameterisation.
-    //        const_zp_prefactor_GAL = (1.0/0.59)*( run_globals.params.physics.LXrayGal *
-    //        Luminosity_converstion_factor_GAL ) / (run_globals.params.physics.NuXrayGalThreshold*NU_over_EV) *
-    //        SPEED_OF_LIGHT * pow(1+zp, run_globals.params.physics.SpecIndexXrayGal+3);
-    const_zp_prefactor_GAL = (run_globals.params.physics.LXrayGal * Luminosity_converstion_factor_GAL) /
-                             (run_globals.params.physics.NuXrayGalThreshold * NU_over_EV) * SPEED_OF_LIGHT *
-                             pow(1 + zp, run_globals.params.physics.SpecIndexXrayGal + 3);
+    // The soft-band X-ray emissivity prefactors (not tabulated, see init_Ts_tables)
+    const_zp_prefactor_GAL = xray_emissivity_prefactor(
+      zp, run_globals.params.physics.LXrayGal, run_globals.params.physics.SpecIndexXrayGal);
 #if USE_MINI_HALOS
-    const_zp_prefactor_III = (run_globals.params.physics.LXrayGalIII * Luminosity_converstion_factor_III) /
-                             (run_globals.params.physics.NuXrayGalThreshold * NU_over_EV) * SPEED_OF_LIGHT *
-                             pow(1 + zp, run_globals.params.physics.SpecIndexXrayIII + 3);
+    const_zp_prefactor_III = xray_emissivity_prefactor(
+      zp, run_globals.params.physics.LXrayGalIII, run_globals.params.physics.SpecIndexXrayIII);
 #endif
     // Note the factor of 0.59 appears to be required to match 21cmFAST
 
@@ -598,171 +944,45 @@ void _ComputeTs(int snapshot)
     // 21cmFAST, which can be trivially compensated for by reducing L_X. Ultimately the backgrounds in Meraxes will be
     // this same factor higher than 21cmFAST, but at least it is understood why and trivially accounted for.
 
-    // interpolate to correct nu integral value based on the cell's ionization state
-    for (int ix = 0; ix < local_nix; ix++)
-      for (int iy = 0; iy < ReionGridDim; iy++)
-        for (int iz = 0; iz < ReionGridDim; iz++) {
-          i_real = grid_index(ix, iy, iz, ReionGridDim, INDEX_REAL);
-          i_padded = grid_index(ix, iy, iz, ReionGridDim, INDEX_PADDED);
-
-          ans[0] = x_e_box_prev[i_padded];
-          ans[1] = Tk_box[i_real];
+    // evolveInt() uses the global dt_dzpp for every filter step. This was previously (re)set for each cell to the
+    // value of the last filter step; set it once here so that the cells can be evolved concurrently.
+    dt_dzpp = dt_dzpp_list[TsNumFilterSteps - 1];
+
+    Ts_cell_inputs_t cell_inputs = { .zp = zp,
+                                     .dzp = dzp,
+                                     .local_nix = local_nix,
+                                     .grid_dim = ReionGridDim,
+                                     .n_filter_steps = TsNumFilterSteps,
+                                     .no_light = NO_LIGHT,
+                                     .SMOOTHED_SFR_GAL = SMOOTHED_SFR_GAL,
+                                     .SMOOTHED_SFR_GAL_blocked = SMOOTHED_SFR_GAL_blocked,
+                                     .SMOOTHED_SFR_blocked_units = (units->UnitMass_in_g / units->UnitTime_in_s) *
+                                                                   pow(units->UnitLength_in_cm, -3.) / SOLAR_MASS,
+                                     .freq_int_heat_tbl_GAL = &(freq_int_heat_tbl_GAL[0][0]),
+                                     .freq_int_ion_tbl_GAL = &(freq_int_ion_tbl_GAL[0][0]),
+                                     .freq_int_lya_tbl_GAL = &(freq_int_lya_tbl_GAL[0][0]),
 #if USE_MINI_HALOS
-          ans[2] = Tk_boxII[i_real];
+                                     .SMOOTHED_SFR_III = SMOOTHED_SFR_III,
+                                     .SMOOTHED_SFR_III_blocked = SMOOTHED_SFR_III_blocked,
+                                     .freq_int_heat_tbl_III = &(freq_int_heat_tbl_III[0][0]),
+                                     .freq_int_ion_tbl_III = &(freq_int_ion_tbl_III[0][0]),
+                                     .freq_int_lya_tbl_III = &(freq_int_lya_tbl_III[0][0]),
 #endif
+    };
+    Ts_cell_sums_t cell_sums;
 
-          for (R_ct = 0; R_ct < TsNumFilterSteps; R_ct++) {
-            i_smoothedSFR = grid_index_smoothedSFR(R_ct, ix, iy, iz, TsNumFilterSteps, ReionGridDim);
+    evolve_Ts_cells(&cell_inputs, run_globals.params.TsNumThreads, &cell_sums);
 
-            SFR_GAL[R_ct] = SMOOTHED_SFR_GAL[i_smoothedSFR];
+    J_alpha_ave = cell_sums.J_alpha;
+    xalpha_ave = cell_sums.xalpha;
+    Xheat_ave = cell_sums.Xheat;
+    Xion_ave = cell_sums.Xion;
 #if USE_MINI_HALOS
-            SFR_III[R_ct] = SMOOTHED_SFR_III[i_smoothedSFR];
+    J_alpha_aveII = cell_sums.J_alphaII;
+    Xheat_aveII = cell_sums.XheatII;
+    J_LW_ave = cell_sums.J_LW;
+    J_LW_aveII = cell_sums.J_LWII;
 #endif
-            xHII_call = x_e_box_prev[i_padded];
-
-            dt_dzpp = dt_dzpp_list[R_ct];
-
-            // Check if ionized fraction is within boundaries; if not, adjust to be within
-            if (xHII_call > x_int_XHII[x_int_NXHII - 1] * 0.999) {
-              xHII_call = x_int_XHII[x_int_NXHII - 1] * 0.999;
-            } else if (xHII_call < x_int_XHII[0]) {
-              xHII_call = 1.001 * x_int_XHII[0];
-            }
-
-            m_xHII_low = locate_xHII_index((float)xHII_call);
-            m_xHII_high = m_xHII_low + 1;
-
-            // heat
-            freq_int_heat_GAL[R_ct] =
-              (freq_int_heat_tbl_GAL[m_xHII_high][R_ct] - freq_int_heat_tbl_GAL[m_xHII_low][R_ct]) /
-              (x_int_XHII[m_xHII_high] - x_int_XHII[m_xHII_low]);
-            freq_int_heat_GAL[R_ct] *= (xHII_call - x_int_XHII[m_xHII_low]);
-            freq_int_heat_GAL[R_ct] += freq_int_heat_tbl_GAL[m_xHII_low][R_ct];
-
-            // ionization
-            freq_int_ion_GAL[R_ct] =
-              (freq_int_ion_tbl_GAL[m_xHII_high][R_ct] - freq_int_ion_tbl_GAL[m_xHII_low][R_ct]) /
-              (x_int_XHII[m_xHII_high] - x_int_XHII[m_xHII_low]);
-            freq_int_ion_GAL[R_ct] *= (xHII_call - x_int_XHII[m_xHII_low]);
-            freq_int_ion_GAL[R_ct] += freq_int_ion_tbl_GAL[m_xHII_low][R_ct];
-
-            // lya
-            freq_int_lya_GAL[R_ct] =
-              (freq_int_lya_tbl_GAL[m_xHII_high][R_ct] - freq_int_lya_tbl_GAL[m_xHII_low][R_ct]) /
-              (x_int_XHII[m_xHII_high] - x_int_XHII[m_xHII_low]);
-            freq_int_lya_GAL[R_ct] *= (xHII_call - x_int_XHII[m_xHII_low]);
-            freq_int_lya_GAL[R_ct] += freq_int_lya_tbl_GAL[m_xHII_low][R_ct];
-
-#if USE_MINI_HALOS
-            freq_int_heat_III[R_ct] =
-              (freq_int_heat_tbl_III[m_xHII_high][R_ct] - freq_int_heat_tbl_III[m_xHII_low][R_ct]) /
-              (x_int_XHII[m_xHII_high] - x_int_XHII[m_xHII_low]);
-            freq_int_heat_III[R_ct] *= (xHII_call - x_int_XHII[m_xHII_low]);
-            freq_int_heat_III[R_ct] += freq_int_heat_tbl_III[m_xHII_low][R_ct];
-
-            // ionization
-            freq_int_ion_III[R_ct] =
-              (freq_int_ion_tbl_III[m_xHII_high][R_ct] - freq_int_ion_tbl_III[m_xHII_low][R_ct]) /
-              (x_int_XHII[m_xHII_high] - x_int_XHII[m_xHII_low]);
-            freq_int_ion_III[R_ct] *= (xHII_call - x_int_XHII[m_xHII_low]);
-            freq_int_ion_III[R_ct] += freq_int_ion_tbl_III[m_xHII_low][R_ct];
-
-            // lya
-            freq_int_lya_III[R_ct] =
-              (freq_int_lya_tbl_III[m_xHII_high][R_ct] - freq_int_lya_tbl_III[m_xHII_low][R_ct]) /
-              (x_int_XHII[m_xHII_high] - x_int_XHII[m_xHII_low]);
-            freq_int_lya_III[R_ct] *= (xHII_call - x_int_XHII[m_xHII_low]);
-            freq_int_lya_III[R_ct] += freq_int_lya_tbl_III[m_xHII_low][R_ct];
-#endif
-          }
-
-          // Perform the calculation of the heating/ionisation integrals, updating relevant quantities etc. GET BACK AT
-          // THIS FOR USE_MINI_HALOS!!
-#if USE_MINI_HALOS
-          evolveInt((float)zp,
-                    run_globals.reion_grids.deltax[i_padded],
-                    SFR_GAL,
-                    SFR_III,
-                    freq_int_heat_GAL,
-                    freq_int_ion_GAL,
-                    freq_int_lya_GAL,
-                    freq_int_heat_III,
-                    freq_int_ion_III,
-                    freq_int_lya_III,
-                    NO_LIGHT,
-                    ans,
-                    dansdz);
-#else
-          evolveInt((float)zp,
-                    run_globals.reion_grids.deltax[i_padded],
-                    SFR_GAL,
-                    0,
-                    freq_int_heat_GAL,
-                    freq_int_ion_GAL,
-                    freq_int_lya_GAL,
-                    0,
-                    0,
-                    0,
-                    NO_LIGHT,
-                    ans,
-                    dansdz);
-#endif
-
-          x_e_box_prev[i_padded] += dansdz[0] * dzp; // remember dzp is negative
-          if (x_e_box_prev[i_padded] > 1)            // can do this late in evolution if dzp is too large
-            x_e_box_prev[i_padded] = (float)(1 - FRACT_FLOAT_ERR);
-          else if (x_e_box_prev[i_padded] < 0)
-            x_e_box_prev[i_padded] = 0;
-          if (Tk_box[i_real] < MAX_TK)
-            Tk_box[i_real] += dansdz[1] * dzp;
-
-#if USE_MINI_HALOS
-          if (Tk_boxII[i_real] < MAX_TK)
-            Tk_boxII[i_real] += dansdz[6] * dzp;
-          if (run_globals.params.Flag_IncludeLymanWerner) {
-            JLW_box[i_real] = dansdz[5];
-            JLW_boxII[i_real] = dansdz[10];
-          }
-#endif
-          if (Tk_box[i_real] <
-              0) { // spurious bahaviour of the trapazoidalintegrator. generally overcooling in underdensities
-            Tk_box[i_real] = (float)(TCMB * (1 + zp));
-          }
-
-#if USE_MINI_HALOS
-          if (Tk_boxII[i_real] <
-              0) { // spurious bahaviour of the trapazoidalintegrator. generally overcooling in underdensities
-            Tk_boxII[i_real] = (float)(TCMB * (1 + zp));
-          }
-#endif
-
-          TS_box[i_real] = get_Ts((float)zp,
-                                  run_globals.reion_grids.deltax[i_padded],
-                                  Tk_box[i_real],
-                                  x_e_box_prev[i_padded],
-                                  (float)dansdz[2],
-                                  &curr_xalpha);
-#if USE_MINI_HALOS
-          TS_boxII[i_real] = get_Ts((float)zp,
-                                    run_globals.reion_grids.deltax[i_padded],
-                                    Tk_boxII[i_real],
-                                    x_e_box_prev[i_padded],
-                                    (float)dansdz[7],
-                                    &curr_xalpha); // It should be correct, probably I don't need a new curr_xalphaII
-#endif
-          J_alpha_ave += dansdz[2];
-          xalpha_ave += curr_xalpha; // Double check this! It might be saving the one from PopIII!
-          Xheat_ave += dansdz[3];
-          Xion_ave += dansdz[4];
-#if USE_MINI_HALOS
-          J_alpha_aveII += dansdz[7];
-          Xheat_aveII += dansdz[8];
-          if (run_globals.params.Flag_IncludeLymanWerner) {
-            J_LW_ave += dansdz[5];
-            J_LW_aveII += dansdz[10];
-          }
-#endif
-        }
 
     MPI_Allreduce(MPI_IN_PLACE, &J_alpha_ave, 1, MPI_DOUBLE, MPI_SUM, run_globals.mpi_comm);
     MPI_Allreduce(MPI_IN_PLACE, &xalpha_ave, 1, MPI_DOUBLE, MPI_SUM, run_globals.mpi_comm);
@@ -5,12 +5,72 @@
 
 #define R_XLy_MAX (float)(500)
 
+//! Per-snapshot inputs to the spin temperature update of each cell (see evolve_Ts_cells)
+typedef struct Ts_cell_inputs_t
+{
+  double zp;
+  double dzp;
+  int local_nix;
+  int grid_dim;
+  int n_filter_steps;
+  int no_light;
+  const double* SMOOTHED_SFR_GAL;        //!< indexed with grid_index_smoothedSFR (NULL if blocked)
+  const float* SMOOTHED_SFR_GAL_blocked; //!< indexed with grid_index_smoothedSFR_blocked (NULL if not)
+  double SMOOTHED_SFR_blocked_units;     //!< converts the blocked (internal unit) values to those of SMOOTHED_SFR_GAL
+  const double* freq_int_heat_tbl_GAL; //!< [x_int_NXHII][n_filter_steps]
+  const double* freq_int_ion_tbl_GAL;  //!< [x_int_NXHII][n_filter_steps]
+  const double* freq_int_lya_tbl_GAL;  //!< [x_int_NXHII][n_filter_steps]
+#if USE_MINI_HALOS
+  const double* SMOOTHED_SFR_III;
+  const float* SMOOTHED_SFR_III_blocked;
+  const double* freq_int_heat_tbl_III;
+  const double* freq_int_ion_tbl_III;
+  const double* freq_int_lya_tbl_III;
+#endif
+} Ts_cell_inputs_t;
+
+//! Sums over the local slab accumulated by evolve_Ts_cells
+typedef struct Ts_cell_sums_t
+{
+  double J_alpha;
+  double xalpha;
+  double Xheat;
+  double Xion;
+#if USE_MINI_HALOS
+  double J_alphaII;
+  double XheatII;
+  double J_LW;
+  double J_LWII;
+#endif
+} Ts_cell_sums_t;
+
+//! Per-run tables of the grid-independent inputs to _ComputeTs, indexed [snapshot] or [snapshot][R_ct]
+typedef struct Ts_tables_t
+{
+  int n_snaps;
+  int n_filter_steps;
+  double* zpp_edge;
+  double* zpp;
+  double* dt_dzpp;
+  double* sum_lyn;
+#if USE_MINI_HALOS
+  double* sum_lyn_III;
+  double* sum_lyn_LW; //!< NULL unless Flag_IncludeLymanWerner
+  double* sum_lyn_LW_III;
+#endif
+} Ts_tables_t;
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
   void ComputeTs(int snapshot, timer_info* timer_total);
+  void evolve_Ts_cells(const Ts_cell_inputs_t* in, int n_threads, Ts_cell_sums_t* sums);
+  void init_Ts_tables(void);
+  void free_Ts_tables(void);
+  const Ts_tables_t* get_Ts_tables(void);
+  double xray_emissivity_prefactor(double zp, double lum_xray, double spec_index);
 
 #ifdef __cplusplus
 }
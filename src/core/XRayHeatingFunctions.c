@@ -10,6 +10,7 @@
 #include <limits.h>
 #include <math.h>
 #include <signal.h>
+#include <string.h>
 
 // DEBUG
 #include <hdf5.h>
@@ -57,11 +58,8 @@ int init_heat()
   }
 #endif
 
-  kappa_10(1.0, 1); // 1 is the flag, allocates memory.
-  if (kappa_10_elec(1.0, 1) < 0)
-    return -2;
-  if (kappa_10_pH(1.0, 1) < 0)
-    return -3;
+  if (init_kappa_10_tables() < 0)
+    return -1;
   if (T_RECFAST(100, 1) < 0)
     return -4;
   if (xion_RECFAST(100, 1) < 0)
@@ -79,9 +77,7 @@ void destruct_heat()
   spectral_emissivity(0.0, 2, 2); // 2 is the flag, frees memory. Flag_Population shouldn't matter
   xion_RECFAST(100.0, 2);
   T_RECFAST(100.0, 2);
-  kappa_10_pH(1.0, 2);
-  kappa_10_elec(1.0, 2);
-  kappa_10(1.0, 2);
+  free_kappa_10_tables();
 
   free(sum_lyn);
   free(ST_over_PS);
@@ -226,25 +222,82 @@ double xion_RECFAST(float z, int flag)
 //  Returns the frequency threshold where \tau_X = 1, given parameter values of
 //  electron fraction in the IGM outside of HII regions, x_e,
 //  recieved redshift, zp, and emitted redshift, zpp.
+#define NU_TAU_ONE_REL_ERROR 0.02
+#define NU_TAU_ONE_MAX_ITER 100
+#define NU_TAU_ONE_N_CACHED 4
+#define NU_TAU_ONE_BRACKET_GROWTH 1.25
 typedef struct
 {
   double x_e, zp, zpp, HI_filling_factor_zp;
   int snap_i;
+  gsl_integration_workspace* w; // NULL => tauX allocates its own
+
+  // the last few evaluations, so that re-evaluating a bracket end in the solver is free
+  int n_cached;
+  double cached_nu[NU_TAU_ONE_N_CACHED];
+  double cached_f[NU_TAU_ONE_N_CACHED];
 } nu_tau_one_params;
+static double tauX_ws(double nu,
+                      double x_e,
+                      double zp,
+                      double zpp,
+                      double HI_filling_factor_zp,
+                      int snap_i,
+                      gsl_integration_workspace* w);
 double nu_tau_one_helper(double nu, void* params)
 {
   nu_tau_one_params* p = (nu_tau_one_params*)params;
-  return tauX(nu, p->x_e, p->zp, p->zpp, p->HI_filling_factor_zp, p->snap_i) - 1;
+  int n_cached = p->n_cached < NU_TAU_ONE_N_CACHED ? p->n_cached : NU_TAU_ONE_N_CACHED;
+
+  for (int ii = 0; ii < n_cached; ii++)
+    if (p->cached_nu[ii] == nu)
+      return p->cached_f[ii];
+
+  double f = tauX_ws(nu, p->x_e, p->zp, p->zpp, p->HI_filling_factor_zp, p->snap_i, p->w) - 1;
+
+  int i_cache = p->n_cached++ % NU_TAU_ONE_N_CACHED;
+  p->cached_nu[i_cache] = nu;
+  p->cached_f[i_cache] = f;
+
+  return f;
+}
+static double solve_nu_tau_one(gsl_root_fsolver* s, nu_tau_one_params* p, double x_lo, double x_hi)
+{
+  // Brent iterations on [x_lo, x_hi], which must bracket the root
+  int status, iter;
+  gsl_function F;
+  double r = 0;
+
+  F.function = &nu_tau_one_helper;
+  F.params = p;
+  gsl_root_fsolver_set(s, &F, x_lo, x_hi);
+
+  // iterate until we guess close enough
+  iter = 0;
+  do {
+    iter++;
+    status = gsl_root_fsolver_iterate(s);
+    r = gsl_root_fsolver_root(s);
+    x_lo = gsl_root_fsolver_x_lower(s);
+    x_hi = gsl_root_fsolver_x_upper(s);
+    status = gsl_root_test_interval(x_lo, x_hi, 0, NU_TAU_ONE_REL_ERROR);
+  }
+
+  while (status == GSL_CONTINUE && iter < NU_TAU_ONE_MAX_ITER);
+
+  return r;
 }
 double nu_tau_one(double zp, double zpp, double x_e, double HI_filling_factor_zp, int snap_i)
 {
-  int status, iter, max_iter;
-  const gsl_root_fsolver_type* T;
   gsl_root_fsolver* s;
-  gsl_function F;
-  double x_lo, x_hi, r = 0;
-  double relative_error = 0.02;
-  nu_tau_one_params p;
+  double r;
+  nu_tau_one_params p = { .x_e = x_e,
+                          .zp = zp,
+                          .zpp = zpp,
+                          .HI_filling_factor_zp = HI_filling_factor_zp,
+                          .snap_i = snap_i,
+                          .w = NULL,
+                          .n_cached = 0 };
 
   // check if too ionized
   if (x_e > 0.9999) {
@@ -252,48 +305,147 @@ double nu_tau_one(double zp, double zpp, double x_e, double HI_filling_factor_zp
     return -1;
   }
 
+  // check if lower bound has null
+  if (nu_tau_one_helper(HeI_NUIONIZATION, &p) < 0)
+    return HeI_NUIONIZATION;
+
   // select solver and allocate memory
-  T = gsl_root_fsolver_brent;
-  s = gsl_root_fsolver_alloc(T); // non-derivative based Brent method
+  s = gsl_root_fsolver_alloc(gsl_root_fsolver_brent); // non-derivative based Brent method
   if (!s) {
     mlog("Unable to allocate memory in function nu_tau_one\n", MLOG_MESG);
     return -1;
   }
 
-  // check if lower bound has null
-  if (tauX(HeI_NUIONIZATION, x_e, zp, zpp, HI_filling_factor_zp, snap_i) < 1)
-    return HeI_NUIONIZATION;
+  r = solve_nu_tau_one(s, &p, HeI_NUIONIZATION, 1e6 * NU_over_EV);
 
-  // set frequency boundary values
-  x_lo = HeI_NUIONIZATION;
-  x_hi = 1e6 * NU_over_EV;
+  // deallocate and return
+  gsl_root_fsolver_free(s);
 
-  // select function we wish to solve
-  p.x_e = x_e;
-  p.zp = zp;
-  p.zpp = zpp;
-  p.HI_filling_factor_zp = HI_filling_factor_zp;
-  p.snap_i = snap_i;
-  F.function = &nu_tau_one_helper;
-  F.params = &p;
-  gsl_root_fsolver_set(s, &F, x_lo, x_hi);
+  return r;
+}
 
-  // iterate until we guess close enough
-  iter = 0;
-  max_iter = 100;
-  do {
-    iter++;
-    status = gsl_root_fsolver_iterate(s);
-    r = gsl_root_fsolver_root(s);
-    x_lo = gsl_root_fsolver_x_lower(s);
-    x_hi = gsl_root_fsolver_x_upper(s);
-    status = gsl_root_test_interval(x_lo, x_hi, 0, relative_error);
+void init_nu_tau_one_memo(nu_tau_one_memo_t* memo)
+{
+  memset(memo, 0, sizeof(nu_tau_one_memo_t));
+  memo->snap_i = -1;
+}
+
+void free_nu_tau_one_memo(nu_tau_one_memo_t* memo)
+{
+  if (memo->solver != NULL)
+    gsl_root_fsolver_free(memo->solver);
+  if (memo->workspace != NULL)
+    gsl_integration_workspace_free(memo->workspace);
+  free(memo->nu);
+  free(memo->zpp);
+  init_nu_tau_one_memo(memo);
+}
+
+double nu_tau_one_cached(nu_tau_one_memo_t* memo,
+                         double zp,
+                         double zpp,
+                         double x_e,
+                         double HI_filling_factor_zp,
+                         int snap_i)
+{
+  /*
+   * For fixed (zp, x_e, snapshot) tauX increases with the path length (i.e. with zpp) and decreases with nu, so the
+   * root is a monotonically increasing function of zpp.  The roots stored for the neighbouring zpp values therefore
+   * bracket the root we are after.  If there is no stored root above zpp we step the bracket up geometrically from
+   * the one below, falling back to the full nu_tau_one bracket if that fails.  The solver, integration workspace and
+   * the tauX values at the bracket ends are reused between solves.
+   */
+
+  nu_tau_one_params p = { .x_e = x_e,
+                          .zp = zp,
+                          .zpp = zpp,
+                          .HI_filling_factor_zp = HI_filling_factor_zp,
+                          .snap_i = snap_i,
+                          .n_cached = 0 };
+  const double nu_max = 1e6 * NU_over_EV;
+  double x_lo, x_hi, r;
+  int i_ins;
+
+  if (x_e > 0.9999)
+    return nu_tau_one(zp, zpp, x_e, HI_filling_factor_zp, snap_i);
+
+  memo->n_calls++;
+
+  // any change in the key invalidates the stored roots
+  if ((zp != memo->zp) || (x_e != memo->x_e) || (HI_filling_factor_zp != memo->HI_filling_factor_zp) ||
+      (snap_i != memo->snap_i)) {
+    memo->zp = zp;
+    memo->x_e = x_e;
+    memo->HI_filling_factor_zp = HI_filling_factor_zp;
+    memo->snap_i = snap_i;
+    memo->n_entries = 0;
   }
 
-  while (status == GSL_CONTINUE && iter < max_iter);
+  i_ins = 0;
+  while ((i_ins < memo->n_entries) && (memo->zpp[i_ins] < zpp))
+    i_ins++;
+  if ((i_ins < memo->n_entries) && (memo->zpp[i_ins] == zpp))
+    return memo->nu[i_ins];
+
+  if (memo->solver == NULL) {
+    memo->solver = gsl_root_fsolver_alloc(gsl_root_fsolver_brent);
+    memo->workspace = gsl_integration_workspace_alloc(1000);
+    if ((memo->solver == NULL) || (memo->workspace == NULL)) {
+      mlog_error("Unable to allocate memory in function nu_tau_one_cached");
+      ABORT(EXIT_FAILURE);
+    }
+  }
+  p.w = memo->workspace;
 
-  // deallocate and return
-  gsl_root_fsolver_free(s);
+  x_lo = (i_ins > 0) ? memo->nu[i_ins - 1] : HeI_NUIONIZATION;
+  if (i_ins < memo->n_entries)
+    x_hi = memo->nu[i_ins];
+  else if (i_ins > 0)
+    x_hi = fmin(x_lo * NU_TAU_ONE_BRACKET_GROWTH, nu_max);
+  else
+    x_hi = nu_max;
+
+  if ((nu_tau_one_helper(x_lo, &p) < 0) && (x_lo == HeI_NUIONIZATION)) {
+    // as nu_tau_one: no root above the HeI threshold
+    r = HeI_NUIONIZATION;
+  } else if ((x_hi / x_lo - 1.0) < NU_TAU_ONE_REL_ERROR) {
+    // the neighbours already pin the root down to the solver tolerance
+    r = sqrt(x_lo * x_hi);
+  } else {
+    if (nu_tau_one_helper(x_lo, &p) < 0) {
+      // the neighbour below was only solved to within NU_TAU_ONE_REL_ERROR and doesn't bracket the root
+      x_lo = HeI_NUIONIZATION;
+      x_hi = nu_max;
+      memo->n_direct++;
+    } else {
+      while ((nu_tau_one_helper(x_hi, &p) > 0) && (x_hi < nu_max)) {
+        x_lo = x_hi;
+        x_hi = fmin(x_hi * NU_TAU_ONE_BRACKET_GROWTH * NU_TAU_ONE_BRACKET_GROWTH, nu_max);
+      }
+      if (nu_tau_one_helper(x_hi, &p) > 0) {
+        x_lo = HeI_NUIONIZATION;
+        x_hi = nu_max;
+        memo->n_direct++;
+      }
+    }
+
+    memo->n_solves++;
+    if (nu_tau_one_helper(x_hi, &p) > 0)
+      r = nu_tau_one(zp, zpp, x_e, HI_filling_factor_zp, snap_i);
+    else
+      r = solve_nu_tau_one(memo->solver, &p, x_lo, x_hi);
+  }
+
+  if (memo->n_entries == memo->max_entries) {
+    memo->max_entries = memo->max_entries > 0 ? memo->max_entries * 2 : 64;
+    memo->zpp = realloc(memo->zpp, sizeof(double) * memo->max_entries);
+    memo->nu = realloc(memo->nu, sizeof(double) * memo->max_entries);
+  }
+  memmove(&(memo->zpp[i_ins + 1]), &(memo->zpp[i_ins]), sizeof(double) * (memo->n_entries - i_ins));
+  memmove(&(memo->nu[i_ins + 1]), &(memo->nu[i_ins]), sizeof(double) * (memo->n_entries - i_ins));
+  memo->zpp[i_ins] = zpp;
+  memo->nu[i_ins] = r;
+  memo->n_entries++;
 
   return r;
 }
@@ -342,12 +494,17 @@ double tauX_integrand(double zhat, void* params)
   sigma_tilde = species_weighted_x_ray_cross_section(nuhat, p->x_e);
   return drpropdz * n * HI_filling_factor_zhat * sigma_tilde;
 }
-double tauX(double nu, double x_e, double zp, double zpp, double HI_filling_factor_zp, int snap_i)
+static double tauX_ws(double nu,
+                      double x_e,
+                      double zp,
+                      double zpp,
+                      double HI_filling_factor_zp,
+                      int snap_i,
+                      gsl_integration_workspace* w)
 {
   double result, error;
   gsl_function F;
   double rel_tol = 0.005; //<- relative tolerance
-  gsl_integration_workspace* w = gsl_integration_workspace_alloc(1000);
   tauX_params p;
 
   F.function = &tauX_integrand;
@@ -369,11 +526,19 @@ double tauX(double nu, double x_e, double zp, double zpp, double HI_filling_fact
   p.snap_i = snap_i;
 
   F.params = &p;
-  gsl_integration_qag(&F, zpp, zp, 0, rel_tol, 1000, GSL_INTEG_GAUSS61, w, &result, &error);
-  gsl_integration_workspace_free(w);
+  if (w == NULL) {
+    gsl_integration_workspace* w_local = gsl_integration_workspace_alloc(1000);
+    gsl_integration_qag(&F, zpp, zp, 0, rel_tol, 1000, GSL_INTEG_GAUSS61, w_local, &result, &error);
+    gsl_integration_workspace_free(w_local);
+  } else
+    gsl_integration_qag(&F, zpp, zp, 0, rel_tol, 1000, GSL_INTEG_GAUSS61, w, &result, &error);
 
   return result;
 }
+double tauX(double nu, double x_e, double zp, double zpp, double HI_filling_factor_zp, int snap_i)
+{
+  return tauX_ws(nu, x_e, zp, zpp, HI_filling_factor_zp, snap_i, NULL);
+}
 
 double dtdz(float z)
 {
@@ -1498,14 +1663,14 @@ double ddicke_dz(double z)
   return (dicke(z + dz) - dicke(z)) / dz;
 }
 
-float get_Ts(float z, float delta, float TK, float xe, float Jalpha, float* curr_xalpha)
+float get_Ts(float z, float delta, float TK, float xe, float Jalpha, float* curr_xalpha, kappa_accel_t* acc)
 {
   double Trad, xc, xa_tilde;
   double TS, TSold, TSinv;
   double Tceff;
 
   Trad = TCMB * (1.0 + z);
-  xc = xcoll(z, TK, delta, xe);
+  xc = xcoll(z, TK, delta, xe, acc);
 
   if (Jalpha > 1.0e-20) { // * Must use WF effect * //
     TS = Trad;
@@ -1545,286 +1710,193 @@ float get_Ts(float z, float delta, float TK, float xe, float Jalpha, float* curr
   return (float)TS;
 }
 
-double xcoll(double z, double TK, double delta, double xe)
+double xcoll(double z, double TK, double delta, double xe, kappa_accel_t* acc)
 {
-  return xcoll_HI(z, TK, delta, xe) + xcoll_elec(z, TK, delta, xe) + xcoll_prot(z, TK, delta, xe);
+  if (acc == NULL)
+    return xcoll_HI(z, TK, delta, xe, NULL) + xcoll_elec(z, TK, delta, xe, NULL) + xcoll_prot(z, TK, delta, xe, NULL);
+
+  return xcoll_HI(z, TK, delta, xe, acc->HI) + xcoll_elec(z, TK, delta, xe, acc->elec) +
+         xcoll_prot(z, TK, delta, xe, acc->pH);
 }
 
-double xcoll_HI(double z, double TK, double delta, double xe)
+double xcoll_HI(double z, double TK, double delta, double xe, gsl_interp_accel* acc)
 {
   double krate, nH, Trad;
   double xcoll;
 
   Trad = TCMB * (1.0 + z);
   nH = (1.0 - xe) * No * pow(1.0 + z, 3.0) * (1.0 + delta);
-  krate = kappa_10(TK, 0);
+  krate = kappa_10(TK, acc);
   xcoll = T21 / Trad * nH * krate / A10_HYPERFINE;
   return xcoll;
 }
 
 // * Note that this assumes Helium ionized same as Hydrogen * //
-double xcoll_elec(double z, double TK, double delta, double xe)
+double xcoll_elec(double z, double TK, double delta, double xe, gsl_interp_accel* acc)
 {
   double krate, ne, Trad;
   double xcoll;
 
   Trad = TCMB * (1.0 + z);
   ne = xe * N_b0 * pow(1.0 + z, 3.0) * (1.0 + delta);
-  krate = kappa_10_elec(TK, 0);
+  krate = kappa_10_elec(TK, acc);
   xcoll = T21 / Trad * ne * krate / A10_HYPERFINE;
   return xcoll;
 }
 
-double xcoll_prot(double z, double TK, double delta, double xe)
+double xcoll_prot(double z, double TK, double delta, double xe, gsl_interp_accel* acc)
 {
   double krate, np, Trad;
   double xcoll;
 
   Trad = TCMB * (1.0 + z);
   np = xe * No * pow(1.0 + z, 3.0) * (1.0 + delta);
-  krate = kappa_10_pH(TK, 0);
+  krate = kappa_10_pH(TK, acc);
   xcoll = T21 / Trad * np * krate / A10_HYPERFINE;
   return xcoll;
 }
 
-double kappa_10(double TK, int flag)
+// kappa_10 spline tables in (ln T, ln kappa).  These are only written by init_kappa_10_tables() and are read-only
+// afterwards, so the kappa_10 functions can be called concurrently as long as each thread has its own accelerators
+// (or passes NULL).
+static double kappa_HI_lnT[KAPPA_10_NPTS], kappa_HI_lnkap[KAPPA_10_NPTS];
+static double kappa_elec_lnT[KAPPA_10_elec_NPTS], kappa_elec_lnkap[KAPPA_10_elec_NPTS];
+static double kappa_pH_lnT[KAPPA_10_pH_NPTS], kappa_pH_lnkap[KAPPA_10_pH_NPTS];
+static gsl_spline* kappa_HI_spline = NULL;
+static gsl_spline* kappa_elec_spline = NULL;
+static gsl_spline* kappa_pH_spline = NULL;
+
+static void read_kappa_10_table(const char* fname, double* lnT, double* lnkap, int n_pts)
 {
-  int i;
-  static double tkin[KAPPA_10_NPTS], kap[KAPPA_10_NPTS];
-  static gsl_interp_accel* acc;
-  static gsl_spline* spline;
-  double ans;
+  if (run_globals.mpi_rank == 0) {
+    FILE* fin;
+    float curr_TK, curr_kappa;
 
-  if (flag == 1) { // * Set up spline table * //
-    // * Initialize kappa from Zygelman (2005), Table 2, column 4 * //
-    tkin[0] = 1.0;
-    kap[0] = 1.38e-13;
-    tkin[1] = 2.0;
-    kap[1] = 1.43e-13;
-    tkin[2] = 4.0;
-    kap[2] = 2.71e-13;
-    tkin[3] = 6.0;
-    kap[3] = 6.60e-13;
-    tkin[4] = 8.0;
-    kap[4] = 1.47e-12;
-    tkin[5] = 10.0;
-    kap[5] = 2.88e-12;
-    tkin[6] = 15.0;
-    kap[6] = 9.10e-12;
-    tkin[7] = 20.0;
-    kap[7] = 1.78e-11;
-    tkin[8] = 25.0;
-    kap[8] = 2.73e-11;
-    tkin[9] = 30.0;
-    kap[9] = 3.67e-11;
-    tkin[10] = 40.0;
-    kap[10] = 5.38e-11;
-    tkin[11] = 50.0;
-    kap[11] = 6.86e-11;
-    tkin[12] = 60.0;
-    kap[12] = 8.14e-11;
-    tkin[13] = 70.0;
-    kap[13] = 9.25e-11;
-    tkin[14] = 80.0;
-    kap[14] = 1.02e-10;
-    tkin[15] = 90.0;
-    kap[15] = 1.11e-10;
-    tkin[16] = 100.0;
-    kap[16] = 1.19e-10;
-    tkin[17] = 200.0;
-    kap[17] = 1.75e-10;
-    tkin[18] = 300.0;
-    kap[18] = 2.09e-10;
-    tkin[19] = 501.0;
-    kap[19] = 2.565e-10;
-    tkin[20] = 701.0;
-    kap[20] = 2.91e-10;
-    tkin[21] = 1000.0;
-    kap[21] = 3.31e-10;
-    tkin[22] = 2000.0;
-    kap[22] = 4.27e-10;
-    tkin[23] = 3000.0;
-    kap[23] = 4.97e-10;
-    tkin[24] = 5000.0;
-    kap[24] = 6.03e-10;
-    tkin[25] = 7000.0;
-    kap[25] = 6.87e-10;
-    tkin[26] = 10000.0;
-    kap[26] = 7.87e-10;
-
-    // * Convert to logs for interpolation * //
-    for (i = 0; i < KAPPA_10_NPTS; i++) {
-      tkin[i] = log(tkin[i]);
-      kap[i] = log(kap[i]);
+    if (!(fin = fopen(fname, "r"))) {
+      mlog_error("Unable to open the kappa_10 table at %s", fname);
+      ABORT(EXIT_FAILURE);
     }
 
-    // * Set up spline table * //
-    acc = gsl_interp_accel_alloc();
-    spline = gsl_spline_alloc(gsl_interp_cspline, KAPPA_10_NPTS);
-    gsl_spline_init(spline, tkin, kap, KAPPA_10_NPTS);
-    return 0;
-  }
-
-  if (flag == 2) { // * Clear memory * //
-    gsl_spline_free(spline);
-    gsl_interp_accel_free(acc);
-    return 0;
+    for (int ii = 0; ii < n_pts; ii++) {
+      if (fscanf(fin, "%f %e", &curr_TK, &curr_kappa) != 2) {
+        mlog_error("Failed to read entry %d of the kappa_10 table at %s", ii, fname);
+        ABORT(EXIT_FAILURE);
+      }
+      lnT[ii] = log(curr_TK);
+      lnkap[ii] = log(curr_kappa);
+    }
+    fclose(fin);
   }
 
-  if (log(TK) < tkin[0]) { // * Below 1 K, just use that value * //
-    ans = kap[0];
-  } else if (log(TK) > tkin[KAPPA_10_NPTS - 1]) {
-    // * Power law extrapolation * //
-    ans = log(exp(kap[KAPPA_10_NPTS - 1]) * pow(TK / exp(tkin[KAPPA_10_NPTS - 1]), 0.381));
-  } else { // * Do spline * //
-    TK = log(TK);
-    ans = gsl_spline_eval(spline, TK, acc);
-  }
-  return exp(ans);
+  // broadcast the values to all cores
+  MPI_Bcast(lnT, (int)(sizeof(double) * n_pts), MPI_BYTE, 0, run_globals.mpi_comm);
+  MPI_Bcast(lnkap, (int)(sizeof(double) * n_pts), MPI_BYTE, 0, run_globals.mpi_comm);
 }
 
-// * Interpolate exact results for kappa_10^eH.  The table goes up to
-// * 10^5 K, but values are only accurate for T<2x10^4 K.  From
-// * Furlanetto & Furlanetto 2006 * //
-double kappa_10_elec(double T, int flag)
+int init_kappa_10_tables()
 {
-  static double TK[KAPPA_10_elec_NPTS], kappa[KAPPA_10_elec_NPTS];
-  static gsl_interp_accel* acc;
-  static gsl_spline* spline;
-  double ans;
-  int i;
-  float curr_TK, curr_kappa;
-  FILE* F;
-
+  // * Initialize kappa from Zygelman (2005), Table 2, column 4 * //
+  const double tkin[KAPPA_10_NPTS] = { 1.0,   2.0,   4.0,   6.0,    8.0,    10.0,   15.0,   20.0,   25.0,
+                                       30.0,  40.0,  50.0,  60.0,   70.0,   80.0,   90.0,   100.0,  200.0,
+                                       300.0, 501.0, 701.0, 1000.0, 2000.0, 3000.0, 5000.0, 7000.0, 10000.0 };
+  const double kap[KAPPA_10_NPTS] = { 1.38e-13, 1.43e-13, 2.71e-13, 6.60e-13,  1.47e-12, 2.88e-12, 9.10e-12,
+                                      1.78e-11, 2.73e-11, 3.67e-11, 5.38e-11,  6.86e-11, 8.14e-11, 9.25e-11,
+                                      1.02e-10, 1.11e-10, 1.19e-10, 1.75e-10,  2.09e-10, 2.565e-10, 2.91e-10,
+                                      3.31e-10, 4.27e-10, 4.97e-10, 6.03e-10,  6.87e-10, 7.87e-10 };
   char fname[STRLEN];
 
-  if (flag == 1) {
-
-    if (run_globals.mpi_rank == 0) {
-
-      sprintf(fname, "%s/kappa_eH_table.dat", run_globals.params.TablesForXHeatingDir);
+  // * Convert to logs for interpolation * //
+  for (int ii = 0; ii < KAPPA_10_NPTS; ii++) {
+    kappa_HI_lnT[ii] = log(tkin[ii]);
+    kappa_HI_lnkap[ii] = log(kap[ii]);
+  }
 
-      // Read in the data
-      if (!(F = fopen(fname, "r"))) {
-        mlog("Unable to open the kappa_10^eH file at %s\nAborting\n", MLOG_MESG, fname);
-        return 0;
-      }
+  // * Interpolate exact results for kappa_10^eH and kappa_10^pH.  The tables go up to 10^5 K, but values are only
+  // * accurate for T<2x10^4 K.  From Furlanetto & Furlanetto 2006 * //
+  sprintf(fname, "%s/kappa_eH_table.dat", run_globals.params.TablesForXHeatingDir);
+  read_kappa_10_table(fname, kappa_elec_lnT, kappa_elec_lnkap, KAPPA_10_elec_NPTS);
+  sprintf(fname, "%s/kappa_pH_table.dat", run_globals.params.TablesForXHeatingDir);
+  read_kappa_10_table(fname, kappa_pH_lnT, kappa_pH_lnkap, KAPPA_10_pH_NPTS);
+
+  // * Set up spline tables * //
+  kappa_HI_spline = gsl_spline_alloc(gsl_interp_cspline, KAPPA_10_NPTS);
+  gsl_spline_init(kappa_HI_spline, kappa_HI_lnT, kappa_HI_lnkap, KAPPA_10_NPTS);
+  kappa_elec_spline = gsl_spline_alloc(gsl_interp_cspline, KAPPA_10_elec_NPTS);
+  gsl_spline_init(kappa_elec_spline, kappa_elec_lnT, kappa_elec_lnkap, KAPPA_10_elec_NPTS);
+  kappa_pH_spline = gsl_spline_alloc(gsl_interp_cspline, KAPPA_10_pH_NPTS);
+  gsl_spline_init(kappa_pH_spline, kappa_pH_lnT, kappa_pH_lnkap, KAPPA_10_pH_NPTS);
 
-      for (i = 0; i < KAPPA_10_elec_NPTS; i++) {
-        fscanf(F, "%f %e", &curr_TK, &curr_kappa);
-        TK[i] = curr_TK;
-        kappa[i] = curr_kappa;
-      }
+  return 0;
+}
 
-      for (i = 0; i < KAPPA_10_elec_NPTS; i++) {
-        TK[i] = log(TK[i]);
-        kappa[i] = log(kappa[i]);
-      }
-    }
+void free_kappa_10_tables()
+{
+  gsl_spline_free(kappa_pH_spline);
+  gsl_spline_free(kappa_elec_spline);
+  gsl_spline_free(kappa_HI_spline);
+  kappa_pH_spline = kappa_elec_spline = kappa_HI_spline = NULL;
+}
 
-    // broadcast the values to all cores
-    MPI_Bcast(TK, sizeof(TK), MPI_BYTE, 0, run_globals.mpi_comm);
-    MPI_Bcast(kappa, sizeof(kappa), MPI_BYTE, 0, run_globals.mpi_comm);
+void init_kappa_accel(kappa_accel_t* acc)
+{
+  acc->HI = gsl_interp_accel_alloc();
+  acc->elec = gsl_interp_accel_alloc();
+  acc->pH = gsl_interp_accel_alloc();
+}
 
-    // * Set up spline table * //
-    acc = gsl_interp_accel_alloc();
-    spline = gsl_spline_alloc(gsl_interp_cspline, KAPPA_10_elec_NPTS);
-    gsl_spline_init(spline, TK, kappa, KAPPA_10_elec_NPTS);
-    return 0;
-  }
+void free_kappa_accel(kappa_accel_t* acc)
+{
+  gsl_interp_accel_free(acc->pH);
+  gsl_interp_accel_free(acc->elec);
+  gsl_interp_accel_free(acc->HI);
+  acc->HI = acc->elec = acc->pH = NULL;
+}
 
-  if (flag == 2) {
-    // * Free memory * //
-    gsl_spline_free(spline);
-    gsl_interp_accel_free(acc);
-    return 0;
-  }
+double kappa_10(double TK, gsl_interp_accel* acc)
+{
+  double ans;
 
-  T = log(T);
-  if (T < TK[0]) { // * Use TK=1 K value if called at lower temperature * //
-    ans = kappa[0];
-  } else if (T > TK[KAPPA_10_elec_NPTS - 1]) {
+  if (log(TK) < kappa_HI_lnT[0]) { // * Below 1 K, just use that value * //
+    ans = kappa_HI_lnkap[0];
+  } else if (log(TK) > kappa_HI_lnT[KAPPA_10_NPTS - 1]) {
     // * Power law extrapolation * //
-    ans = kappa[KAPPA_10_elec_NPTS - 1] +
-          ((kappa[KAPPA_10_elec_NPTS - 1] - kappa[KAPPA_10_elec_NPTS - 2]) /
-           (TK[KAPPA_10_elec_NPTS - 1] - TK[KAPPA_10_elec_NPTS - 2]) * (T - TK[KAPPA_10_elec_NPTS - 1]));
+    ans = log(exp(kappa_HI_lnkap[KAPPA_10_NPTS - 1]) * pow(TK / exp(kappa_HI_lnT[KAPPA_10_NPTS - 1]), 0.381));
   } else { // * Do spline * //
-    ans = gsl_spline_eval(spline, T, acc);
+    ans = gsl_spline_eval(kappa_HI_spline, log(TK), acc);
   }
   return exp(ans);
 }
 
-// * Interpolate exact results for kappa_10^pH.  The table goes up to
-// * 10^5 K, but values are only accurate for T<2x10^4 K.  From
-// * Furlanetto & Furlanetto 2006 * //
-double kappa_10_pH(double T, int flag)
+static double kappa_10_from_table(double T,
+                                  const gsl_spline* spline,
+                                  const double* lnT,
+                                  const double* lnkap,
+                                  int n_pts,
+                                  gsl_interp_accel* acc)
 {
-  static double TK[KAPPA_10_pH_NPTS], kappa[KAPPA_10_pH_NPTS];
-  static gsl_interp_accel* acc;
-  static gsl_spline* spline;
   double ans;
-  int i;
-  float curr_TK, curr_kappa;
-
-  FILE* F;
-
-  char fname[STRLEN];
-
-  if (flag == 1) {
-
-    if (run_globals.mpi_rank == 0) {
-
-      sprintf(fname, "%s/kappa_pH_table.dat", run_globals.params.TablesForXHeatingDir);
-
-      if (!(F = fopen(fname, "r"))) {
-        mlog("Unable to open the kappa_10^pH file at %s\nAborting\n", MLOG_MESG, fname);
-        return 0;
-      }
-
-      for (i = 0; i < KAPPA_10_pH_NPTS; i++) {
-        fscanf(F, "%f %e", &curr_TK, &curr_kappa);
-        TK[i] = curr_TK;
-        kappa[i] = curr_kappa;
-      }
-      fclose(F);
-
-      for (i = 0; i < KAPPA_10_pH_NPTS; i++) {
-        TK[i] = log(TK[i]);
-        kappa[i] = log(kappa[i]);
-      }
-    }
-
-    // broadcast the values to all cores
-    MPI_Bcast(TK, sizeof(TK), MPI_BYTE, 0, run_globals.mpi_comm);
-    MPI_Bcast(kappa, sizeof(kappa), MPI_BYTE, 0, run_globals.mpi_comm);
-
-    // * Set up spline table * //
-    acc = gsl_interp_accel_alloc();
-    spline = gsl_spline_alloc(gsl_interp_cspline, KAPPA_10_pH_NPTS);
-    gsl_spline_init(spline, TK, kappa, KAPPA_10_pH_NPTS);
-    return 0;
-  }
-
-  if (flag == 2) {
-    // * Free memory * //
-    gsl_spline_free(spline);
-    gsl_interp_accel_free(acc);
-    return 0;
-  }
 
   T = log(T);
-  if (T < TK[0]) { // * Use TK=1 K value if called at lower temperature * //
-    ans = kappa[0];
-  } else if (T > TK[KAPPA_10_pH_NPTS - 1]) {
+  if (T < lnT[0]) { // * Use TK=1 K value if called at lower temperature * //
+    ans = lnkap[0];
+  } else if (T > lnT[n_pts - 1]) {
     // * Power law extrapolation * //
-    ans = kappa[KAPPA_10_pH_NPTS - 1] +
-          ((kappa[KAPPA_10_pH_NPTS - 1] - kappa[KAPPA_10_pH_NPTS - 2]) /
-           (TK[KAPPA_10_pH_NPTS - 1] - TK[KAPPA_10_pH_NPTS - 2]) * (T - TK[KAPPA_10_pH_NPTS - 1]));
+    ans = lnkap[n_pts - 1] + ((lnkap[n_pts - 1] - lnkap[n_pts - 2]) / (lnT[n_pts - 1] - lnT[n_pts - 2]) *
+                              (T - lnT[n_pts - 1]));
   } else { // * Do spline * //
     ans = gsl_spline_eval(spline, T, acc);
   }
-  ans = exp(ans);
-  return ans;
+  return exp(ans);
+}
+
+double kappa_10_elec(double T, gsl_interp_accel* acc)
+{
+  return kappa_10_from_table(T, kappa_elec_spline, kappa_elec_lnT, kappa_elec_lnkap, KAPPA_10_elec_NPTS, acc);
+}
+
+double kappa_10_pH(double T, gsl_interp_accel* acc)
+{
+  return kappa_10_from_table(T, kappa_pH_spline, kappa_pH_lnT, kappa_pH_lnkap, KAPPA_10_pH_NPTS, acc);
 }
 
 // ********************************************************************
@@ -8,6 +8,10 @@
 #ifndef XRAY_HEATING_FUNCTIONS_H
 #define XRAY_HEATING_FUNCTIONS_H
 
+#include <gsl/gsl_integration.h>
+#include <gsl/gsl_interp.h>
+#include <gsl/gsl_roots.h>
+
 #include "meraxes.h"
 
 // Below gives grid sizes for the interpolation arrays
@@ -76,6 +80,30 @@ extern double const_zp_prefactor_III;
 extern float x_int_XHII[x_int_NXHII];
 #endif
 
+//! Per-thread accelerators for the (read-only) kappa_10 spline tables
+typedef struct kappa_accel_t
+{
+  gsl_interp_accel* HI;
+  gsl_interp_accel* elec;
+  gsl_interp_accel* pH;
+} kappa_accel_t;
+
+//! Memoised nu_tau_one roots for a single (zp, x_e, HI filling factor, snapshot) and any number of zpp values
+typedef struct nu_tau_one_memo_t
+{
+  double zp, x_e, HI_filling_factor_zp;
+  int snap_i;
+  int n_entries;
+  int max_entries;
+  double* zpp; //!< emission redshifts of the stored roots (ascending)
+  double* nu;  //!< stored roots
+  gsl_root_fsolver* solver;
+  gsl_integration_workspace* workspace;
+  int n_calls;  //!< number of calls to nu_tau_one_cached
+  int n_solves; //!< number of calls which ran the root finder
+  int n_direct; //!< number of solves which fell back to the full nu_tau_one bracket
+} nu_tau_one_memo_t;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -132,6 +160,16 @@ extern "C"
      in the IGM with mean electron fraction x_e */
   double nu_tau_one(double zp, double zpp, double x_e, double HI_filling_factor_zp, int snap_i);
 
+  /* As nu_tau_one, but memoised in `memo` and with the bracket warm-started from the roots at neighbouring zpp */
+  void init_nu_tau_one_memo(nu_tau_one_memo_t* memo);
+  void free_nu_tau_one_memo(nu_tau_one_memo_t* memo);
+  double nu_tau_one_cached(nu_tau_one_memo_t* memo,
+                           double zp,
+                           double zpp,
+                           double x_e,
+                           double HI_filling_factor_zp,
+                           int snap_i);
+
   /* Main integral driver for the frequency integral in the evolution equations */
   double integrate_over_nu(double zp,
                            double local_x_e,
@@ -151,17 +189,21 @@ extern "C"
   double frecycle(int n);
 
   /* returns the spin temperature */
-  float get_Ts(float z, float delta, float TK, float xe, float Jalpha, float* curr_xalpha);
-
-  /* Spin Temperature helper functions */
-  double xcoll(double z, double TK, double delta, double xe);
-  double xcoll_HI(double z, double TK, double delta, double xe);
-  double xcoll_elec(double z, double TK, double delta, double xe);
-  double xcoll_prot(double z, double TK, double delta, double xe);
-  double kappa_10_pH(double T, int flag);
-  double kappa_10_elec(double T, int flag);
-
-  double kappa_10(double TK, int flag);
+  float get_Ts(float z, float delta, float TK, float xe, float Jalpha, float* curr_xalpha, kappa_accel_t* acc);
+
+  /* Spin Temperature helper functions.  The kappa_10 tables must be initialised (init_heat) before use, after which
+     these are re-entrant: accelerators may be NULL, or must not be shared between threads. */
+  double xcoll(double z, double TK, double delta, double xe, kappa_accel_t* acc);
+  double xcoll_HI(double z, double TK, double delta, double xe, gsl_interp_accel* acc);
+  double xcoll_elec(double z, double TK, double delta, double xe, gsl_interp_accel* acc);
+  double xcoll_prot(double z, double TK, double delta, double xe, gsl_interp_accel* acc);
+  int init_kappa_10_tables(void);
+  void free_kappa_10_tables(void);
+  void init_kappa_accel(kappa_accel_t* acc);
+  void free_kappa_accel(kappa_accel_t* acc);
+  double kappa_10_pH(double T, gsl_interp_accel* acc);
+  double kappa_10_elec(double T, gsl_interp_accel* acc);
+  double kappa_10(double TK, gsl_interp_accel* acc);
   double xalpha_tilde(double z, double Jalpha, double TK, double TS, double delta, double xe);
   double taugp(double z, double delta, double xe);
   double Salpha_tilde(double TK, double TS, double tauGP);
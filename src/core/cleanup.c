@@ -7,6 +7,7 @@
 #include "read_halos.h"
 #include "recombinations.h"
 #include "reionization.h"
+#include "stellar_feedback.h"
 
 #if USE_MINI_HALOS
 #include "metal_evo.h"
@@ -24,6 +25,7 @@ void cleanup()
     free(run_globals.baryon_frac_modifier);
 
   free_halo_storage();
+  free_stellar_feedback_tables();
 
 #ifdef CALC_MAGS
   cleanup_mags();
@@ -55,6 +57,7 @@ void cleanup()
         free(run_globals.hdf5props.params_tag[ii]);
       free(run_globals.hdf5props.params_tag);
     }
+    free(run_globals.hdf5props.field_deflate);
     free(run_globals.hdf5props.field_h_conv);
     free(run_globals.hdf5props.field_units);
     free(run_globals.hdf5props.field_types);
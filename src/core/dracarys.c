@@ -324,9 +324,7 @@ void dracarys()
     if (run_globals.params.Flag_IncludeMetalEvo) { // Need this for metal grid, here you assign to galaxies their
                                                    // metallicity and probabilities from bubbles
       int ngals_in_metal_slabs = map_galaxies_to_slabs_metals(NGal);
-      for (int ii = 0; ii < 5; ii++) {
-        assign_probability_to_galaxies(ngals_in_metal_slabs, snapshot, ii);
-      }
+      assign_metal_properties_to_galaxies(ngals_in_metal_slabs);
     }
 #endif
 
@@ -393,6 +391,7 @@ void dracarys()
       // longer need them as they will need to be re-created for the new halo
       // positions in the next time step
       free(run_globals.reion_grids.galaxy_to_slab_map);
+      free(run_globals.reion_grids.slab_gal_offsets);
     }
 
 #if USE_MINI_HALOS
@@ -402,6 +401,7 @@ void dracarys()
       smooth_Densitygrid_real(snapshot);
       save_metal_input_grids(snapshot);
       free(run_globals.metal_grids.galaxy_to_slab_map_metals);
+      free(run_globals.metal_grids.slab_gal_offsets_metals);
     }
 #endif
 
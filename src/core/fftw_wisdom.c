@@ -0,0 +1,225 @@
+#include <fftw3-mpi.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "fftw_wisdom.h"
+#include "meraxes.h"
+#include "utils.h"
+
+/*
+ * FFTW3 wisdom for the reionization grids.
+ *
+ * Wisdom is stored in FFTW3WisdomDir as one file per grid size and rank
+ * count.  Alongside these, the registry (FFTW_WISDOM_REGISTRY) records the
+ * FFTW version and the set of plans each file was generated for, with one
+ * line per file:
+ *
+ *   <ReionGridDim> <n_ranks> <fftw_version> <plan_set> <wisdom_file>
+ *
+ * At startup the registry is used to spot wisdom generated by a different
+ * FFTW version (which is discarded) or for a different set of plans (which
+ * is used, with any missing plans planned from scratch and the wisdom
+ * updated).  The `make_fftw_wisdom` target generates wisdom offline.
+ */
+
+static struct
+{
+  bool save;
+  bool loaded;
+  char fname[STRLEN + 64];
+  char plan_set[128];
+  timer_info timer;
+} wisdom;
+
+static void get_plan_set(char* plan_set, size_t len)
+{
+  // The groups of plans created by malloc_reionization_grids for these parameters
+  run_params_t* params = &(run_globals.params);
+
+  snprintf(plan_set, len, "base");
+#if USE_MINI_HALOS
+  strncat(plan_set, "+minihalos", len - strlen(plan_set) - 1);
+#endif
+  if (params->Flag_IncludeSpinTemp)
+    strncat(plan_set, "+spin_temp", len - strlen(plan_set) - 1);
+  if (params->Flag_IncludeRecombinations)
+    strncat(plan_set, "+recombinations", len - strlen(plan_set) - 1);
+  if (params->Flag_Compute21cmBrightTemp && (params->Flag_IncludePecVelsFor21cm > 0))
+    strncat(plan_set, "+pec_vels", len - strlen(plan_set) - 1);
+  if (params->ReionBatchedFFTs)
+    strncat(plan_set, "+batched", len - strlen(plan_set) - 1);
+  if (params->ReionPencilDecomposition)
+    strncat(plan_set, "+pencil", len - strlen(plan_set) - 1);
+}
+
+static bool read_registry_entry(char* fftw_version, char* plan_set)
+{
+  // Find the registry entry for this grid size and rank count (returns false if there isn't one)
+  char fname[STRLEN + 64];
+  char line[STRLEN * 2];
+  bool found = false;
+
+  snprintf(fname, sizeof(fname), "%s/%s", run_globals.params.FFTW3WisdomDir, FFTW_WISDOM_REGISTRY);
+  FILE* fd = fopen(fname, "r");
+  if (fd == NULL)
+    return false;
+
+  while (fgets(line, sizeof(line), fd) != NULL) {
+    int grid_dim, n_ranks;
+    if (line[0] == '#')
+      continue;
+    if ((sscanf(line, "%d %d %127s %127s", &grid_dim, &n_ranks, fftw_version, plan_set) == 4) &&
+        (grid_dim == run_globals.params.ReionGridDim) && (n_ranks == run_globals.mpi_size))
+      found = true;
+  }
+
+  fclose(fd);
+  return found;
+}
+
+static void write_registry_entry(void)
+{
+  // Add (or replace) the entry for this grid size and rank count
+  char fname[STRLEN + 64];
+  char tmp_fname[STRLEN + 68];
+  char line[STRLEN * 2];
+
+  snprintf(fname, sizeof(fname), "%s/%s", run_globals.params.FFTW3WisdomDir, FFTW_WISDOM_REGISTRY);
+  snprintf(tmp_fname, sizeof(tmp_fname), "%s.tmp", fname);
+
+  FILE* fout = fopen(tmp_fname, "w");
+  if (fout == NULL) {
+    mlog_error("Failed to write FFTW3 wisdom registry %s", tmp_fname);
+    return;
+  }
+  fprintf(fout, "# ReionGridDim n_ranks fftw_version plan_set wisdom_file\n");
+
+  FILE* fin = fopen(fname, "r");
+  if (fin != NULL) {
+    while (fgets(line, sizeof(line), fin) != NULL) {
+      int grid_dim, n_ranks;
+      if (line[0] == '#')
+        continue;
+      if ((sscanf(line, "%d %d", &grid_dim, &n_ranks) == 2) && (grid_dim == run_globals.params.ReionGridDim) &&
+          (n_ranks == run_globals.mpi_size))
+        continue;
+      fputs(line, fout);
+    }
+    fclose(fin);
+  }
+
+  // fftwf_version is of the form "fftw-3.3.10-sse2-avx", i.e. has no white space
+  const char* wisdom_basename = strrchr(wisdom.fname, '/') + 1;
+  fprintf(fout,
+          "%d %d %s %s %s\n",
+          run_globals.params.ReionGridDim,
+          run_globals.mpi_size,
+          fftwf_version,
+          wisdom.plan_set,
+          wisdom_basename);
+  fclose(fout);
+
+  if (rename(tmp_fname, fname) != 0)
+    mlog_error("Failed to update FFTW3 wisdom registry %s", fname);
+}
+
+unsigned init_fftw_wisdom()
+{
+  /*
+   * Load any wisdom for the reionization grids.  Returns the planner flags to
+   * use (FFTW_PATIENT if FFTW3WisdomDir is set, FFTW_ESTIMATE otherwise).
+   * Must be called on all ranks, before any plans are created.
+   */
+
+  run_globals.reion_grids.flag_wisdom = strlen(run_globals.params.FFTW3WisdomDir) > 0;
+  if (!run_globals.reion_grids.flag_wisdom)
+    return FFTW_ESTIMATE;
+
+  wisdom.save = false;
+  wisdom.loaded = false;
+  get_plan_set(wisdom.plan_set, sizeof(wisdom.plan_set));
+  snprintf(wisdom.fname,
+           sizeof(wisdom.fname),
+           "%s/fftw3f-meraxes-N_%d-ranks_%d.wisdom",
+           run_globals.params.FFTW3WisdomDir,
+           run_globals.params.ReionGridDim,
+           run_globals.mpi_size);
+
+  if (run_globals.mpi_rank == 0) {
+    char registered_version[128] = "";
+    char registered_plan_set[128] = "";
+    bool registered = read_registry_entry(registered_version, registered_plan_set);
+
+    if (registered && (strcmp(registered_version, fftwf_version) != 0)) {
+      mlog("FFTW3 wisdom in %s was generated by %s, but this is %s. Ignoring it and replanning (this may take a "
+           "while).",
+           MLOG_MESG | MLOG_FLUSH,
+           wisdom.fname,
+           registered_version,
+           fftwf_version);
+    } else if (fftwf_import_wisdom_from_filename(wisdom.fname)) {
+      wisdom.loaded = true;
+      mlog("Successfully loaded FFTW3 wisdom from %s", MLOG_MESG, wisdom.fname);
+      if (!registered) {
+        mlog("...but it is not in the wisdom registry. It will be re-saved and registered.", MLOG_MESG);
+      } else if (strcmp(registered_plan_set, wisdom.plan_set) != 0) {
+        mlog("...but it was generated for plans `%s` and this run needs `%s`. Missing plans will be planned from "
+             "scratch and the wisdom updated.",
+             MLOG_MESG | MLOG_FLUSH,
+             registered_plan_set,
+             wisdom.plan_set);
+      }
+    } else {
+      mlog("FFTW3 wisdom directory provided, but no suitable wisdom exists. New wisdom will be created (this make "
+           "take a while).",
+           MLOG_MESG | MLOG_FLUSH);
+      // Check to see if the wisdom directory exists and if not, create it
+      struct stat filestatus;
+      if (stat(run_globals.params.FFTW3WisdomDir, &filestatus) != 0)
+        mkdir(run_globals.params.FFTW3WisdomDir, 02755);
+    }
+
+    wisdom.save = !(wisdom.loaded && registered && (strcmp(registered_plan_set, wisdom.plan_set) == 0));
+  }
+
+  MPI_Bcast(&wisdom.loaded, 1, MPI_C_BOOL, 0, run_globals.mpi_comm);
+  MPI_Bcast(&wisdom.save, 1, MPI_C_BOOL, 0, run_globals.mpi_comm);
+  if (wisdom.loaded)
+    fftwf_mpi_broadcast_wisdom(run_globals.mpi_comm);
+
+  timer_start(&wisdom.timer);
+
+  return FFTW_PATIENT;
+}
+
+void finalize_fftw_wisdom()
+{
+  // Report how the plans were made and save (and register) any new wisdom.  Must be called on all ranks, after
+  // all of the plans have been created.
+  if (!run_globals.reion_grids.flag_wisdom)
+    return;
+
+  timer_stop(&wisdom.timer);
+  mlog("FFTW3 plans (%s) for N=%d on %d ranks %s in %.1f s",
+       MLOG_MESG,
+       wisdom.plan_set,
+       run_globals.params.ReionGridDim,
+       run_globals.mpi_size,
+       wisdom.save ? (wisdom.loaded ? "loaded from wisdom where available, otherwise planned" : "freshly planned")
+                   : "loaded from wisdom",
+       timer_delta(wisdom.timer));
+
+  if (!wisdom.save)
+    return;
+
+  fftwf_mpi_gather_wisdom(run_globals.mpi_comm);
+  if (run_globals.mpi_rank == 0) {
+    if (fftwf_export_wisdom_to_filename(wisdom.fname)) {
+      mlog("Successfully saved FFTW3 wisdom to %s", MLOG_MESG, wisdom.fname);
+      write_registry_entry();
+    } else {
+      mlog_error("Failed to save FFTW3 wisdom to %s", wisdom.fname);
+    }
+  }
+}
@@ -0,0 +1,21 @@
+#ifndef FFTW_WISDOM_H
+#define FFTW_WISDOM_H
+
+#include <stdbool.h>
+
+// Registry of the wisdom files in FFTW3WisdomDir (one line per grid size and rank count)
+#define FFTW_WISDOM_REGISTRY "wisdom_registry.txt"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  unsigned init_fftw_wisdom(void);
+  void finalize_fftw_wisdom(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -7,6 +7,7 @@
 #include "meraxes.h"
 #include "meraxes_gpu.h"
 #include "misc_tools.h"
+#include "pencil_decomp.h"
 #include "recombinations.h"
 #include "reionization.h"
 #include "utils.h"
@@ -23,6 +24,47 @@
  * Inclusion od Pop. III galaxies when accounting for MINIHALOS by Manu Ventura.
  */
 
+// Maximum number of ReionDeltaRFactor steps taken at once by the adaptive radius schedule (ReionAdaptiveRTol)
+#define REION_ADAPTIVE_R_MAX_SKIP 8
+
+static inline int padded_index(int i_real, int dim)
+{
+  return i_real + (i_real / dim) * (2 * (dim / 2 + 1) - dim);
+}
+
+static float* scatter_to_pencil(pencil_decomp_t* pencil, const float* slab)
+{
+  float* field = fftwf_alloc_real((size_t)pencil->n_real);
+  if (slab != NULL)
+    pencil_scatter_real(pencil, slab, field);
+  return field;
+}
+
+static void gather_from_pencil(pencil_decomp_t* pencil, float** field, float* slab)
+{
+  // Copy a pencil grid back into its slab counterpart, then point `field` at the slab
+  pencil_gather_real(pencil, *field, slab);
+  fftwf_free(*field);
+  *field = slab;
+}
+
+// Sanity checks to account for aliasing effects in the filtered grids
+static inline float clamp_filtered(float val)
+{
+  val = fmaxf(val, 0.0);
+  return (val < ABS_TOL) ? 0 : val;
+}
+
+static inline float clamp_filtered_deltax(float val)
+{
+  return fmaxf(val, -1 + REL_TOL);
+}
+
+static inline float clamp_filtered_x_e(float val)
+{
+  return fminf(clamp_filtered(val), 0.999);
+}
+
 double RtoM(double R)
 {
   // All in internal units
@@ -77,8 +119,7 @@ void _find_HII_bubbles(const int snapshot)
   double Gamma_R_prefactorIII;
 #endif
 
-  double dNrec, rec;
-  float z_eff;
+  double rec;
 
   const double redshift = run_globals.ZZ[snapshot];
   double prev_redshift;
@@ -183,6 +224,67 @@ void _find_HII_bubbles(const int snapshot)
     }
   }
 
+  // With ReionPencilDecomposition the radius loop runs on the 2D process grid: the k-space fields are redistributed
+  // into pencils once here, and the per-cell grids are gathered back into the slabs after the loop.
+  pencil_decomp_t* pencil = run_globals.reion_grids.pencil;
+  fftwf_complex* pencil_unfiltered[FILTER_BATCH_MAX_FIELDS];
+  fftwf_complex* pencil_filtered[FILTER_BATCH_MAX_FIELDS];
+  int n_pencil_fields = 0;
+  float* z_in = run_globals.reion_grids.z_at_ionization;
+  float* J_21_at_ionization = run_globals.reion_grids.J_21_at_ionization;
+  int n_cells = slab_n_real;
+
+  if (pencil != NULL) {
+    fftwf_complex* slab_unfiltered[FILTER_BATCH_MAX_FIELDS];
+    fftwf_complex** filtered[FILTER_BATCH_MAX_FIELDS];
+
+    slab_unfiltered[n_pencil_fields] = deltax_unfiltered;
+    filtered[n_pencil_fields++] = &deltax_filtered;
+    slab_unfiltered[n_pencil_fields] = stars_unfiltered;
+    filtered[n_pencil_fields++] = &stars_filtered;
+    slab_unfiltered[n_pencil_fields] = weighted_sfr_unfiltered;
+    filtered[n_pencil_fields++] = &weighted_sfr_filtered;
+#if USE_MINI_HALOS
+    slab_unfiltered[n_pencil_fields] = starsIII_unfiltered;
+    filtered[n_pencil_fields++] = &starsIII_filtered;
+    slab_unfiltered[n_pencil_fields] = weighted_sfrIII_unfiltered;
+    filtered[n_pencil_fields++] = &weighted_sfrIII_filtered;
+#endif
+    if (run_globals.params.Flag_IncludeRecombinations) {
+      slab_unfiltered[n_pencil_fields] = N_rec_unfiltered;
+      filtered[n_pencil_fields++] = &N_rec_filtered;
+    }
+    if (run_globals.params.Flag_IncludeSpinTemp) {
+      slab_unfiltered[n_pencil_fields] = x_e_unfiltered;
+      filtered[n_pencil_fields++] = &x_e_filtered;
+    }
+
+    // The cell loop below reads the filtered pencils through the usual pointers
+    for (int ii = 0; ii < n_pencil_fields; ii++) {
+      pencil_unfiltered[ii] = fftwf_alloc_complex((size_t)pencil->n_complex);
+      pencil_filtered[ii] = fftwf_alloc_complex((size_t)pencil->n_alloc);
+      pencil_scatter_complex(pencil, slab_unfiltered[ii], pencil_unfiltered[ii]);
+      *filtered[ii] = pencil_filtered[ii];
+    }
+
+    n_cells = (int)pencil->n_real;
+    xH = scatter_to_pencil(pencil, NULL);
+    r_bubble = scatter_to_pencil(pencil, NULL);
+    for (int ii = 0; ii < n_cells; ii++) {
+      xH[ii] = 1.0;
+      r_bubble[ii] = 0.0;
+    }
+    z_in = scatter_to_pencil(pencil, z_in);
+    if (flag_ReionUVBFlag) {
+      J_21 = scatter_to_pencil(pencil, NULL);
+      for (int ii = 0; ii < n_cells; ii++)
+        J_21[ii] = 0.0;
+      J_21_at_ionization = scatter_to_pencil(pencil, J_21_at_ionization);
+    }
+    if (run_globals.params.Flag_IncludeRecombinations)
+      Gamma12 = scatter_to_pencil(pencil, Gamma12);
+  }
+
   // Loop through filter radii
   double ReionRBubbleMax;
   if (run_globals.params.Flag_IncludeRecombinations) {
@@ -194,9 +296,27 @@ void _find_HII_bubbles(const int snapshot)
   double R = fmin(ReionRBubbleMax, L_FACTOR * box_size);               // Mpc/h
   double ReionDeltaRFactor = run_globals.params.ReionDeltaRFactor;
   double ReionGammaHaloBias = run_globals.params.physics.ReionGammaHaloBias;
+  const double ReionAdaptiveRTol = run_globals.params.ReionAdaptiveRTol;
 
   bool flag_last_filter_step = false;
 
+  // With ReionAdaptiveRTol > 0 we take n_R_skip ReionDeltaRFactor steps at once, doubling n_R_skip while fewer than
+  // ReionAdaptiveRTol/2 of the cells are newly ionised at each radius and dropping back to single steps as soon as
+  // more than ReionAdaptiveRTol are.
+  int n_R_skip = 1;
+  int n_filter_steps = 0;
+
+  // Cells which are still neutral get the full treatment at every R.  With ReionActiveCellLists, cells are moved to
+  // `ionised_cells` once they first cross the ionisation barrier.  Their xH, J_21, Gamma12 and z_at_ionization are
+  // then final and all that is left to do is record the smallest R at which they are still ionised (r_bubble).
+  const bool flag_active_cells = run_globals.params.ReionActiveCellLists;
+  int* neutral_cells = malloc(sizeof(int) * (size_t)n_cells);
+  int* ionised_cells = flag_active_cells ? malloc(sizeof(int) * (size_t)n_cells) : NULL;
+  int n_neutral = n_cells;
+  int n_ionised = 0;
+  for (int ii = 0; ii < n_cells; ii++)
+    neutral_cells[ii] = ii;
+
   // set recombinations to zero (for case when recombinations are not used)
   rec = 0.0;
 
@@ -212,105 +332,80 @@ void _find_HII_bubbles(const int snapshot)
     // mlog("R = %.2e (h=0.678 -> %.2e)", MLOG_MESG, R, R/0.678);
     mlog(".", MLOG_CONT);
 
-    // copy the k-space grids
-    memcpy(deltax_filtered, deltax_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
-    memcpy(stars_filtered, stars_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
-    memcpy(weighted_sfr_filtered, weighted_sfr_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
+    if (pencil != NULL) {
+      for (int ii = 0; ii < n_pencil_fields; ii++)
+        pencil_filter_c2r(pencil,
+                          pencil_unfiltered[ii],
+                          pencil_filtered[ii],
+                          (float)R,
+                          run_globals.params.ReionFilterType,
+                          !flag_last_filter_step);
+    } else if (run_globals.reion_grids.HII_filter_batch != NULL) {
+      // copy, filter (unless this is the last filter step) and inverse transform all of the fields together
+      execute_filter_batch(run_globals.reion_grids.HII_filter_batch,
+                           (float)R,
+                           run_globals.params.ReionFilterType,
+                           !flag_last_filter_step);
+    } else {
+      // copy the k-space grids
+      memcpy(deltax_filtered, deltax_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
+      memcpy(stars_filtered, stars_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
+      memcpy(weighted_sfr_filtered, weighted_sfr_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
 #if USE_MINI_HALOS
-    memcpy(starsIII_filtered, starsIII_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
-    memcpy(weighted_sfrIII_filtered, weighted_sfrIII_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
-#endif
-
-    if (run_globals.params.Flag_IncludeRecombinations) {
-      memcpy(N_rec_filtered, N_rec_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
-    }
-    if (run_globals.params.Flag_IncludeSpinTemp) {
-      memcpy(x_e_filtered, x_e_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
-    }
-
-    // do the filtering unless this is the last filter step
-    int local_ix_start = (int)(run_globals.reion_grids.slab_ix_start[run_globals.mpi_rank]);
-    if (!flag_last_filter_step) {
-      filter(deltax_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.ReionFilterType);
-      filter(stars_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.ReionFilterType);
-      filter(
-        weighted_sfr_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.ReionFilterType);
-#if USE_MINI_HALOS
-      filter(starsIII_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.ReionFilterType);
-      filter(weighted_sfrIII_filtered,
-             local_ix_start,
-             local_nix,
-             ReionGridDim,
-             (float)R,
-             run_globals.params.ReionFilterType);
+      memcpy(starsIII_filtered, starsIII_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
+      memcpy(weighted_sfrIII_filtered, weighted_sfrIII_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
 #endif
 
       if (run_globals.params.Flag_IncludeRecombinations) {
-        filter(N_rec_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.ReionFilterType);
+        memcpy(N_rec_filtered, N_rec_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
       }
       if (run_globals.params.Flag_IncludeSpinTemp) {
-        filter(x_e_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.ReionFilterType);
+        memcpy(x_e_filtered, x_e_unfiltered, sizeof(fftwf_complex) * slab_n_complex);
       }
-    }
 
-    // inverse fourier transform back to real space
-    fftwf_execute(run_globals.reion_grids.deltax_filtered_reverse_plan);
-    fftwf_execute(run_globals.reion_grids.stars_filtered_reverse_plan);
-    fftwf_execute(run_globals.reion_grids.weighted_sfr_filtered_reverse_plan);
+      // do the filtering unless this is the last filter step
+      int local_ix_start = (int)(run_globals.reion_grids.slab_ix_start[run_globals.mpi_rank]);
+      if (!flag_last_filter_step) {
+        filter(deltax_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.ReionFilterType);
+        filter(stars_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.ReionFilterType);
+        filter(
+          weighted_sfr_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.ReionFilterType);
 #if USE_MINI_HALOS
-    fftwf_execute(run_globals.reion_grids.starsIII_filtered_reverse_plan);
-    fftwf_execute(run_globals.reion_grids.weighted_sfrIII_filtered_reverse_plan);
+        filter(
+          starsIII_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.ReionFilterType);
+        filter(weighted_sfrIII_filtered,
+               local_ix_start,
+               local_nix,
+               ReionGridDim,
+               (float)R,
+               run_globals.params.ReionFilterType);
 #endif
 
-    if (run_globals.params.Flag_IncludeRecombinations) {
-      fftwf_execute(run_globals.reion_grids.N_rec_filtered_reverse_plan);
-    }
-
-    if (run_globals.params.Flag_IncludeSpinTemp) {
-      fftwf_execute(run_globals.reion_grids.x_e_filtered_reverse_plan);
-    }
-
-    // Perform sanity checks to account for aliasing effects
-    for (int ix = 0; ix < local_nix; ix++)
-      for (int iy = 0; iy < ReionGridDim; iy++)
-        for (int iz = 0; iz < ReionGridDim; iz++) {
-          i_padded = grid_index(ix, iy, iz, ReionGridDim, INDEX_PADDED);
-          ((float*)deltax_filtered)[i_padded] = fmaxf(((float*)deltax_filtered)[i_padded], -1 + REL_TOL);
-          ((float*)stars_filtered)[i_padded] = fmaxf(((float*)stars_filtered)[i_padded], 0.0);
-          if (((float*)stars_filtered)[i_padded] < ABS_TOL) {
-            ((float*)stars_filtered)[i_padded] = 0;
-          }
-          ((float*)weighted_sfr_filtered)[i_padded] = fmaxf(((float*)weighted_sfr_filtered)[i_padded], 0.0);
-          if (((float*)weighted_sfr_filtered)[i_padded] < ABS_TOL) {
-            ((float*)weighted_sfr_filtered)[i_padded] = 0;
-          }
+        if (run_globals.params.Flag_IncludeRecombinations) {
+          filter(N_rec_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.ReionFilterType);
+        }
+        if (run_globals.params.Flag_IncludeSpinTemp) {
+          filter(x_e_filtered, local_ix_start, local_nix, ReionGridDim, (float)R, run_globals.params.ReionFilterType);
+        }
+      }
 
+      // inverse fourier transform back to real space
+      fftwf_execute(run_globals.reion_grids.deltax_filtered_reverse_plan);
+      fftwf_execute(run_globals.reion_grids.stars_filtered_reverse_plan);
+      fftwf_execute(run_globals.reion_grids.weighted_sfr_filtered_reverse_plan);
 #if USE_MINI_HALOS
-          ((float*)starsIII_filtered)[i_padded] = fmaxf(((float*)starsIII_filtered)[i_padded], 0.0);
-          if (((float*)starsIII_filtered)[i_padded] < ABS_TOL) {
-            ((float*)starsIII_filtered)[i_padded] = 0;
-          }
-
-          ((float*)weighted_sfrIII_filtered)[i_padded] = fmaxf(((float*)weighted_sfrIII_filtered)[i_padded], 0.0);
-          if (((float*)weighted_sfrIII_filtered)[i_padded] < ABS_TOL) {
-            ((float*)weighted_sfrIII_filtered)[i_padded] = 0;
-          }
+      fftwf_execute(run_globals.reion_grids.starsIII_filtered_reverse_plan);
+      fftwf_execute(run_globals.reion_grids.weighted_sfrIII_filtered_reverse_plan);
 #endif
 
-          if (run_globals.params.Flag_IncludeRecombinations) {
-            ((float*)N_rec_filtered)[i_padded] = fmaxf(((float*)N_rec_filtered)[i_padded], 0.0);
-            if (((float*)N_rec_filtered)[i_padded] < ABS_TOL) {
-              ((float*)N_rec_filtered)[i_padded] = 0;
-            }
-          }
-          if (run_globals.params.Flag_IncludeSpinTemp) {
-            ((float*)x_e_filtered)[i_padded] = fmaxf(((float*)x_e_filtered)[i_padded], 0.0);
-            if (((float*)x_e_filtered)[i_padded] < ABS_TOL) {
-              ((float*)x_e_filtered)[i_padded] = 0;
-            }
-            ((float*)x_e_filtered)[i_padded] = fminf(((float*)x_e_filtered)[i_padded], 0.999);
-          }
-        }
+      if (run_globals.params.Flag_IncludeRecombinations) {
+        fftwf_execute(run_globals.reion_grids.N_rec_filtered_reverse_plan);
+      }
+
+      if (run_globals.params.Flag_IncludeSpinTemp) {
+        fftwf_execute(run_globals.reion_grids.x_e_filtered_reverse_plan);
+      }
+    }
 
     /*
      * Main loop through the box...
@@ -340,111 +435,186 @@ void _find_HII_bubbles(const int snapshot)
 
     double M_mean = RtoM(R);
     double R_cubed = R * R * R;
+    long long n_new_ionised = 0;
+    const int n_ionised_prev = n_ionised;
+    int n_still_neutral = 0;
 
-    for (int ix = 0; ix < local_nix; ix++)
-      for (int iy = 0; iy < ReionGridDim; iy++)
-        for (int iz = 0; iz < ReionGridDim; iz++) {
-          i_real = grid_index(ix, iy, iz, ReionGridDim, INDEX_REAL);
-          i_padded = grid_index(ix, iy, iz, ReionGridDim, INDEX_PADDED);
+    for (int i_cell = 0; i_cell < n_neutral; i_cell++) {
+      i_real = neutral_cells[i_cell];
+      i_padded = padded_index(i_real, ReionGridDim);
 
-          density_over_mean = 1.0 + (double)((float*)deltax_filtered)[i_padded];
+      density_over_mean = 1.0 + (double)clamp_filtered_deltax(((float*)deltax_filtered)[i_padded]);
 
-          f_coll_stars = (double)((float*)stars_filtered)[i_padded] / (M_mean * density_over_mean) * (4.0 / 3.0) *
-                         M_PI * R_cubed / pixel_volume;
-          weighted_sfr_density = (double)((float*)weighted_sfr_filtered)[i_padded] / pixel_volume; // In internal units
+      f_coll_stars = (double)clamp_filtered(((float*)stars_filtered)[i_padded]) / (M_mean * density_over_mean) *
+                     (4.0 / 3.0) * M_PI * R_cubed / pixel_volume;
+      weighted_sfr_density =
+        (double)clamp_filtered(((float*)weighted_sfr_filtered)[i_padded]) / pixel_volume; // In internal units
 #if USE_MINI_HALOS
-          f_coll_starsIII = (double)((float*)starsIII_filtered)[i_padded] / (M_mean * density_over_mean) * (4.0 / 3.0) *
-                            M_PI * R_cubed / pixel_volume;
-          weighted_sfr_densityIII =
-            (double)((float*)weighted_sfrIII_filtered)[i_padded] / pixel_volume; // In internal units
+      f_coll_starsIII = (double)clamp_filtered(((float*)starsIII_filtered)[i_padded]) / (M_mean * density_over_mean) *
+                        (4.0 / 3.0) * M_PI * R_cubed / pixel_volume;
+      weighted_sfr_densityIII =
+        (double)clamp_filtered(((float*)weighted_sfrIII_filtered)[i_padded]) / pixel_volume; // In internal units
 #endif
 
-          // Calculate the recombinations within the cell
-          if (run_globals.params.Flag_IncludeRecombinations) {
-            rec = (double)((float*)N_rec_filtered)[i_padded] / density_over_mean;
-          }
+      // Calculate the recombinations within the cell
+      if (run_globals.params.Flag_IncludeRecombinations) {
+        rec = (double)clamp_filtered(((float*)N_rec_filtered)[i_padded]) / density_over_mean;
+      }
 
-          // Account for the partial ionisation of the cell from X-rays
-          if (run_globals.params.Flag_IncludeSpinTemp) {
-            neutral_fraction = 1.0 - ((float*)x_e_filtered)[i_padded];
-          } else {
-            neutral_fraction = 1.0;
-          }
+      // Account for the partial ionisation of the cell from X-rays
+      if (run_globals.params.Flag_IncludeSpinTemp) {
+        neutral_fraction = 1.0 - clamp_filtered_x_e(((float*)x_e_filtered)[i_padded]);
+      } else {
+        neutral_fraction = 1.0;
+      }
 
-          if (flag_ReionUVBFlag) {
-            J_21_aux = (float)(weighted_sfr_density * J_21_aux_constant);
+      if (flag_ReionUVBFlag) {
+        J_21_aux = (float)(weighted_sfr_density * J_21_aux_constant);
 #if USE_MINI_HALOS
-            J_21_auxIII = (float)(weighted_sfr_densityIII * J_21_auxIII_constant);
+        J_21_auxIII = (float)(weighted_sfr_densityIII * J_21_auxIII_constant);
 #endif
-          }
+      }
 
-          // Modified reionisation condition, including recombinations and partial ionisations from X-rays
-          // Check if ionised!
+      // Modified reionisation condition, including recombinations and partial ionisations from X-rays
+      // Check if ionised!
 
 #if USE_MINI_HALOS
-          if ((f_coll_stars * ReionEfficiency + f_coll_starsIII * ReionEfficiencyIII) >
-              neutral_fraction * (1. + rec)) // IONISED!!!!
+      if ((f_coll_stars * ReionEfficiency + f_coll_starsIII * ReionEfficiencyIII) >
+          neutral_fraction * (1. + rec)) // IONISED!!!!
 #else
-          if (f_coll_stars * ReionEfficiency > neutral_fraction * (1. + rec))
+      if (f_coll_stars * ReionEfficiency > neutral_fraction * (1. + rec))
 #endif
-          {
-            // If it is the first crossing of the ionisation barrier for this cell (largest R), let's record J_21
-            if (xH[i_real] > REL_TOL) {
-              if (flag_ReionUVBFlag)
+      {
+        // If it is the first crossing of the ionisation barrier for this cell (largest R), let's record J_21
+        if (xH[i_real] > REL_TOL) {
+          n_new_ionised++;
+          if (flag_ReionUVBFlag)
 #if USE_MINI_HALOS
-                J_21[i_real] = J_21_aux + J_21_auxIII;
+            J_21[i_real] = J_21_aux + J_21_auxIII;
 #else
-                J_21[i_real] = J_21_aux;
+            J_21[i_real] = J_21_aux;
 #endif
-              // Store the ionisation background and the reionisation redshift for each cell
-              if (run_globals.params.Flag_IncludeRecombinations) {
+          // Store the ionisation background and the reionisation redshift for each cell
+          if (run_globals.params.Flag_IncludeRecombinations) {
 #if USE_MINI_HALOS
-                Gamma12[i_real] =
-                  (float)(Gamma_R_prefactor * weighted_sfr_density + Gamma_R_prefactorIII * weighted_sfr_densityIII);
+            Gamma12[i_real] =
+              (float)(Gamma_R_prefactor * weighted_sfr_density + Gamma_R_prefactorIII * weighted_sfr_densityIII);
 #else
-                Gamma12[i_real] = (float)(Gamma_R_prefactor * weighted_sfr_density);
+            Gamma12[i_real] = (float)(Gamma_R_prefactor * weighted_sfr_density);
 #endif
-              }
-            }
+          }
+        }
 
-            // Mark as ionised
-            xH[i_real] = 0;
+        // Mark as ionised
+        xH[i_real] = 0;
 
-            // Record radius
-            r_bubble[i_real] = (float)R;
-          }
-          // Check if this is the last filtering step.
-          // If so, assign partial ionisations to those cells which aren't fully ionised
-          else if (flag_last_filter_step && (xH[i_real] > REL_TOL)) {
+        // Record radius
+        r_bubble[i_real] = (float)R;
+      }
+      // Check if this is the last filtering step.
+      // If so, assign partial ionisations to those cells which aren't fully ionised
+      else if (flag_last_filter_step && (xH[i_real] > REL_TOL)) {
 #if USE_MINI_HALOS
-            xH[i_real] =
-              (float)(neutral_fraction - (f_coll_stars * ReionEfficiency + f_coll_starsIII * ReionEfficiencyIII));
+        xH[i_real] =
+          (float)(neutral_fraction - (f_coll_stars * ReionEfficiency + f_coll_starsIII * ReionEfficiencyIII));
 #else
-            xH[i_real] = (float)(neutral_fraction - f_coll_stars * ReionEfficiency);
+        xH[i_real] = (float)(neutral_fraction - f_coll_stars * ReionEfficiency);
 #endif
-            if (xH[i_real] < 0.) {
-              xH[i_real] = (float)0.;
-            } else if (xH[i_real] > 1.0) {
-              xH[i_real] = (float)1.;
-            }
-          }
+        if (xH[i_real] < 0.) {
+          xH[i_real] = (float)0.;
+        } else if (xH[i_real] > 1.0) {
+          xH[i_real] = (float)1.;
+        }
+      }
 
-          // Check if new ionisation
-          float* z_in = run_globals.reion_grids.z_at_ionization;
-          if ((xH[i_real] < REL_TOL) && (z_in[i_real] < 0)) // New ionisation!
-          {
-            z_in[i_real] = (float)redshift;
-            if (flag_ReionUVBFlag)
+      // Check if new ionisation
+      if ((xH[i_real] < REL_TOL) && (z_in[i_real] < 0)) // New ionisation!
+      {
+        z_in[i_real] = (float)redshift;
+        if (flag_ReionUVBFlag)
 #if USE_MINI_HALOS
-              run_globals.reion_grids.J_21_at_ionization[i_real] =
-                (J_21_aux + J_21_auxIII) * (float)ReionGammaHaloBias; // Is HaloBias the same for PopIII / Pop II?
+          J_21_at_ionization[i_real] =
+            (J_21_aux + J_21_auxIII) * (float)ReionGammaHaloBias; // Is HaloBias the same for PopIII / Pop II?
 #else
-              run_globals.reion_grids.J_21_at_ionization[i_real] = J_21_aux * (float)ReionGammaHaloBias;
+          J_21_at_ionization[i_real] = J_21_aux * (float)ReionGammaHaloBias;
 #endif
-          }
-        }
-    // iz
-    R /= ReionDeltaRFactor;
+      }
+
+      if (!flag_active_cells)
+        continue;
+      if (xH[i_real] < REL_TOL)
+        ionised_cells[n_ionised++] = i_real;
+      else
+        neutral_cells[n_still_neutral++] = i_real;
+    }
+
+    // Cells ionised at a larger R only need their bubble radius updating
+    for (int i_cell = 0; i_cell < n_ionised_prev; i_cell++) {
+      i_real = ionised_cells[i_cell];
+      i_padded = padded_index(i_real, ReionGridDim);
+
+      density_over_mean = 1.0 + (double)clamp_filtered_deltax(((float*)deltax_filtered)[i_padded]);
+      f_coll_stars = (double)clamp_filtered(((float*)stars_filtered)[i_padded]) / (M_mean * density_over_mean) *
+                     (4.0 / 3.0) * M_PI * R_cubed / pixel_volume;
+#if USE_MINI_HALOS
+      f_coll_starsIII = (double)clamp_filtered(((float*)starsIII_filtered)[i_padded]) / (M_mean * density_over_mean) *
+                        (4.0 / 3.0) * M_PI * R_cubed / pixel_volume;
+#endif
+      if (run_globals.params.Flag_IncludeRecombinations)
+        rec = (double)clamp_filtered(((float*)N_rec_filtered)[i_padded]) / density_over_mean;
+      if (run_globals.params.Flag_IncludeSpinTemp)
+        neutral_fraction = 1.0 - clamp_filtered_x_e(((float*)x_e_filtered)[i_padded]);
+      else
+        neutral_fraction = 1.0;
+
+#if USE_MINI_HALOS
+      if ((f_coll_stars * ReionEfficiency + f_coll_starsIII * ReionEfficiencyIII) > neutral_fraction * (1. + rec))
+#else
+      if (f_coll_stars * ReionEfficiency > neutral_fraction * (1. + rec))
+#endif
+        r_bubble[i_real] = (float)R;
+    }
+
+    if (flag_active_cells)
+      n_neutral = n_still_neutral;
+
+    n_filter_steps++;
+
+    if (ReionAdaptiveRTol > 0) {
+      MPI_Allreduce(MPI_IN_PLACE, &n_new_ionised, 1, MPI_LONG_LONG, MPI_SUM, run_globals.mpi_comm);
+      double frac_new_ionised = (double)n_new_ionised / total_n_cells;
+
+      if (frac_new_ionised > ReionAdaptiveRTol)
+        n_R_skip = 1;
+      else if ((frac_new_ionised < 0.5 * ReionAdaptiveRTol) && (n_R_skip < REION_ADAPTIVE_R_MAX_SKIP))
+        n_R_skip *= 2;
+    }
+
+    R /= pow(ReionDeltaRFactor, n_R_skip);
+  }
+
+  if (ReionAdaptiveRTol > 0)
+    mlog("%d filter steps", MLOG_MESG, n_filter_steps);
+  run_globals.reion_grids.n_filter_steps = n_filter_steps;
+
+  free(ionised_cells);
+  free(neutral_cells);
+
+  if (pencil != NULL) {
+    for (int ii = 0; ii < n_pencil_fields; ii++) {
+      fftwf_free(pencil_filtered[ii]);
+      fftwf_free(pencil_unfiltered[ii]);
+    }
+
+    gather_from_pencil(pencil, &xH, run_globals.reion_grids.xH);
+    gather_from_pencil(pencil, &r_bubble, run_globals.reion_grids.r_bubble);
+    gather_from_pencil(pencil, &z_in, run_globals.reion_grids.z_at_ionization);
+    if (flag_ReionUVBFlag) {
+      gather_from_pencil(pencil, &J_21, run_globals.reion_grids.J_21);
+      gather_from_pencil(pencil, &J_21_at_ionization, run_globals.reion_grids.J_21_at_ionization);
+    }
+    if (run_globals.params.Flag_IncludeRecombinations)
+      gather_from_pencil(pencil, &Gamma12, run_globals.reion_grids.Gamma12);
   }
 
   // Find the volume and mass weighted neutral fractions
@@ -456,7 +626,7 @@ void _find_HII_bubbles(const int snapshot)
   double volume_weighted_global_J_21 = 0.0;
 
   for (int ix = 0; ix < local_nix; ix++)
-    for (int iy = 0; iy < ReionGridDim; iy++)
+    for (int iy = 0; iy < ReionGridDim; iy++) {
       for (int iz = 0; iz < ReionGridDim; iz++) {
         i_real = grid_index(ix, iy, iz, ReionGridDim, INDEX_REAL);
         i_padded = grid_index(ix, iy, iz, ReionGridDim, INDEX_PADDED);
@@ -470,14 +640,24 @@ void _find_HII_bubbles(const int snapshot)
         density_over_mean = 1.0 + (double)((float*)deltax)[i_padded];
         mass_weighted_global_xH += cell_xH * density_over_mean;
         mass_weight += density_over_mean;
+      }
 
-        if (run_globals.params.Flag_IncludeRecombinations) {
-          // Store the resultant recombination cell
-          z_eff = (float)((1. + redshift) * pow(density_over_mean, 1.0 / 3.0) - 1);
-          dNrec = splined_recombination_rate(z_eff, Gamma12[i_real]) * fabs_dtdz * zstep * (1. - cell_xH);
-          N_rec[i_padded] += dNrec;
+      if (run_globals.params.Flag_IncludeRecombinations) {
+        // Store the resultant recombination cells.  This is kept as a separate loop over contiguous cells, with
+        // the rate coming from the (inlined) bilinear table, so that the compiler can vectorise it.
+        const float* deltax_row = (float*)deltax + grid_index(ix, iy, 0, ReionGridDim, INDEX_PADDED);
+        const float* Gamma12_row = Gamma12 + grid_index(ix, iy, 0, ReionGridDim, INDEX_REAL);
+        const float* xH_row = xH + grid_index(ix, iy, 0, ReionGridDim, INDEX_REAL);
+        float* N_rec_row = N_rec + grid_index(ix, iy, 0, ReionGridDim, INDEX_PADDED);
+
+        for (int iz = 0; iz < ReionGridDim; iz++) {
+          const float z_eff = (float)((1. + redshift) * cbrt(1.0 + (double)deltax_row[iz]) - 1);
+          const double dNrec =
+            tabulated_recombination_rate(z_eff, Gamma12_row[iz]) * fabs_dtdz * zstep * (1. - xH_row[iz]);
+          N_rec_row[iz] += dNrec;
         }
       }
+    }
 
   MPI_Allreduce(MPI_IN_PLACE, &volume_weighted_global_xH, 1, MPI_DOUBLE, MPI_SUM, run_globals.mpi_comm);
   if (flag_ReionUVBFlag) {
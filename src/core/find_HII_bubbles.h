@@ -9,6 +9,7 @@ extern "C"
 #endif
 
   double RtoM(double R);
+  void _find_HII_bubbles(const int snapshot);
   void find_HII_bubbles(int snapshot, timer_info* timer_total);
 
 #ifdef __cplusplus
@@ -630,7 +630,8 @@ void _find_HII_bubbles_gpu(const int snapshot, const bool flag_write_validation_
 
         if (Flag_IncludeRecombinations) {
           const float z_eff = (float)((1. + redshift) * pow(density_over_mean, 1.0 / 3.0) - 1);
-          const float dNrec = splined_recombination_rate(z_eff, Gamma12[i_real]) * fabs_dtdz * zstep * (1. - cell_xH);
+          const float dNrec =
+            tabulated_recombination_rate(z_eff, Gamma12[i_real]) * fabs_dtdz * zstep * (1. - cell_xH);
           N_rec[i_padded] += dNrec;
         }
       }
@@ -82,6 +82,7 @@ galaxy_t* new_galaxy(int snapshot, unsigned long halo_ID)
   gal->RmetalBubble = 0.0;
   gal->PrefactorBubble = 0.0;
   gal->TimeBubble = 0.0;
+  gal->BubbleHead = 0;
   gal->AveBubble = 0.;
   gal->MaxBubble = 0.;
   gal->Flag_ExtMetEnr = 0;
@@ -9,6 +9,7 @@
 #include "magnitudes.h"
 #include "meraxes.h"
 #include "misc_tools.h"
+#include "output_filters.h"
 #include "parse_paramfile.h"
 #include "read_halos.h"
 #include "recombinations.h"
@@ -244,6 +245,9 @@ void init_meraxes()
   // parse the requested output snaps
   parse_output_snaps(run_globals.params.OutputSnapsString);
 
+  // parse the output dataset filters and chunk shapes
+  init_output_filters();
+
   snaplist_len = run_globals.params.SnaplistLength;
   for (i = 0; i < snaplist_len; i++) {
     run_globals.ZZ[i] = 1 / run_globals.AA[i] - 1;
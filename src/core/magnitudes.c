@@ -6,16 +6,17 @@
 #include "meraxes.h"
 #include "misc_tools.h"
 #include "parse_paramfile.h"
+#include "save.h"
 #include <assert.h>
 
 void init_luminosities(galaxy_t* gal)
 {
   // Initialise all elements of flux arrays to TOL.
-  double* inBCFlux = gal->inBCFlux;
-  double* outBCFlux = gal->outBCFlux;
+  flux_t* inBCFlux = gal->inBCFlux;
+  flux_t* outBCFlux = gal->outBCFlux;
 #if USE_MINI_HALOS
-  double* inBCFluxIII = gal->inBCFluxIII;
-  double* outBCFluxIII = gal->outBCFluxIII;
+  flux_t* inBCFluxIII = gal->inBCFluxIII;
+  flux_t* outBCFluxIII = gal->outBCFluxIII;
 #endif
 
   for (int iSF = 0; iSF < MAGS_N; ++iSF) {
@@ -54,15 +55,15 @@ void add_luminosities(mag_params_t* miniSpectra,
   double* pWorking = miniSpectra->working;
   double* pInBC = miniSpectra->inBC;
   double* pOutBC = miniSpectra->outBC;
-  double* pInBCFlux = gal->inBCFlux;
-  double* pOutBCFlux = gal->outBCFlux;
+  flux_t* pInBCFlux = gal->inBCFlux;
+  flux_t* pOutBCFlux = gal->outBCFlux;
 
 #if USE_MINI_HALOS
   double time_unit = run_globals.units.UnitTime_in_Megayears / run_globals.params.Hubble_h * 1e6;
   int nZFIII = MAGS_N_BANDS;
   double* pWorkingIII = miniSpectra->workingIII;
-  double* pInBCFluxIII = gal->inBCFluxIII;
-  double* pOutBCFluxIII = gal->outBCFluxIII;
+  flux_t* pInBCFluxIII = gal->inBCFluxIII;
+  flux_t* pOutBCFluxIII = gal->outBCFluxIII;
   if ((gal->Galaxy_Population == 3) && (bool)run_globals.params.physics.InstantSfIII)
     sfr = new_stars * time_unit; // a bit hacky... (we want new_stars / sfr is in units of year)
 #endif
@@ -117,16 +118,16 @@ void merge_luminosities(galaxy_t* target, galaxy_t* gal)
 {
   // Sum fluexs together when a merge happens.
 
-  double* inBCFluxTgt = target->inBCFlux;
-  double* outBCFluxTgt = target->outBCFlux;
-  double* inBCFlux = gal->inBCFlux;
-  double* outBCFlux = gal->outBCFlux;
+  flux_t* inBCFluxTgt = target->inBCFlux;
+  flux_t* outBCFluxTgt = target->outBCFlux;
+  flux_t* inBCFlux = gal->inBCFlux;
+  flux_t* outBCFlux = gal->outBCFlux;
 
 #if USE_MINI_HALOS
-  double* inBCFluxTgtIII = target->inBCFluxIII;
-  double* outBCFluxTgtIII = target->outBCFluxIII;
-  double* inBCFluxIII = gal->inBCFluxIII;
-  double* outBCFluxIII = gal->outBCFluxIII;
+  flux_t* inBCFluxTgtIII = target->inBCFluxIII;
+  flux_t* outBCFluxTgtIII = target->outBCFluxIII;
+  flux_t* inBCFluxIII = gal->inBCFluxIII;
+  flux_t* outBCFluxIII = gal->outBCFluxIII;
 #endif
 
   for (int iSF = 0; iSF < MAGS_N; ++iSF) {
@@ -545,6 +546,19 @@ void init_magnitudes(void)
   MPI_Bcast(workingIII, mag_params->totalSizeIII, MPI_BYTE, MASTER, mpi_comm);
   mag_params->workingIII = workingIII;
 #endif
+
+  init_dust_attenuation(mag_params);
+}
+
+void init_dust_attenuation(mag_params_t* mag_params)
+{
+  // The wavelength dependence of the dust optical depths is the same for all
+  // galaxies, so tabulate it per band rather than per galaxy.
+  for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band) {
+    double wave = mag_params->centreWaves[i_band] / DUST_WAVE_UV;
+    mag_params->dustTauISM[i_band] = DUST_TAUUV_ISM * pow(wave, DUST_N_ISM);
+    mag_params->dustTauBC[i_band] = DUST_TAUUV_BC * pow(wave, DUST_N_BC);
+  }
 }
 
 void cleanup_mags(void)
@@ -557,34 +571,68 @@ void cleanup_mags(void)
 #endif
 }
 
-#if USE_MINI_HALOS
-void get_output_magnitudesIII(float* mags, galaxy_t* gal, int snapshot)
+static int find_target_snap(int snapshot)
 {
-  // Convert fluxes to AB magnitudes at all target snapshots.
-
-  // Check if ``snapshot`` is a target snapshot
+  // Return the index of ``snapshot`` in the target snapshots (or MAGS_N_SNAPS if it is not a target snapshot)
   int iS;
   int* targetSnap = run_globals.mag_params.targetSnap;
-  double* pInBCFlux = gal->inBCFluxIII;
-  double* pOutBCFlux = gal->outBCFluxIII;
 
-  for (iS = 0; iS < MAGS_N_SNAPS; ++iS) {
+  for (iS = 0; iS < MAGS_N_SNAPS; ++iS)
     if (snapshot == targetSnap[iS])
       break;
-    else {
-      pInBCFlux += MAGS_N_BANDS;
-      pOutBCFlux += MAGS_N_BANDS;
-    }
+
+  return iS;
+}
+
+static double get_mag_offset(void)
+{
+  // AB zero point plus the correction for the unit of SFRs
+  return -2.5 * log10(run_globals.units.UnitMass_in_g / run_globals.units.UnitTime_in_s * SEC_PER_YEAR / SOLAR_MASS) +
+         8.9;
+}
+
+static inline double calc_dust_factor(galaxy_t* gal, double redshift)
+{
+  // Best fit dust--gas model from Qiu, Mutch, da Cunha et al. 2019, MNRAS, 489, 1357
+  return pow(calc_metallicity(gal->ColdGas, gal->MetalsColdGas) / 0.02, 1.2) * gal->ColdGas *
+         pow(gal->DiskScaleLength * 1e3, -2.0) * exp(-0.35 * redshift);
+}
+
+static inline void calc_magnitudes(float* mags,
+                                   float* dusty_mags,
+                                   const flux_t* inBCFlux,
+                                   const flux_t* outBCFlux,
+                                   double dust_factor,
+                                   double mag_offset)
+{
+  const double* tauISM = run_globals.mag_params.dustTauISM;
+  const double* tauBC = run_globals.mag_params.dustTauBC;
+
+  for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band) {
+    mags[i_band] = (float)(-2.5 * log10((double)inBCFlux[i_band] + outBCFlux[i_band]) + mag_offset);
+
+    // Light from young stars is attenuated by both the birth clouds and the ISM, and the rest by the ISM alone, so
+    // the ISM term can be taken outside of the log
+    double flux = inBCFlux[i_band] * exp(-dust_factor * tauBC[i_band]) + outBCFlux[i_band];
+    dusty_mags[i_band] = (float)(-2.5 * log10(flux) + 2.5 * M_LOG10E * dust_factor * tauISM[i_band] + mag_offset);
   }
-  // Correct the unit of SFRs and convert fluxes to magnitudes
-  if (iS != MAGS_N_SNAPS) {
-    double redshift = run_globals.ZZ[snapshot];
-    double sfr_unit =
-      -2.5 * log10(run_globals.units.UnitMass_in_g / run_globals.units.UnitTime_in_s * SEC_PER_YEAR / SOLAR_MASS);
-    for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band) {
-      mags[i_band] = (float)(-2.5 * log10(pInBCFlux[i_band] + pOutBCFlux[i_band]) + 8.9 + sfr_unit);
-    }
+}
+
+#if USE_MINI_HALOS
+static inline void calc_magnitudesIII(float* mags, const flux_t* inBCFlux, const flux_t* outBCFlux, double mag_offset)
+{
+  for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band)
+    mags[i_band] = (float)(-2.5 * log10((double)inBCFlux[i_band] + outBCFlux[i_band]) + mag_offset);
+}
 
+void get_output_magnitudesIII(float* mags, galaxy_t* gal, int snapshot)
+{
+  // Convert fluxes to AB magnitudes at all target snapshots.
+  int iS = find_target_snap(snapshot);
+
+  if (iS != MAGS_N_SNAPS) {
+    int offset = iS * MAGS_N_BANDS;
+    calc_magnitudesIII(mags, gal->inBCFluxIII + offset, gal->outBCFluxIII + offset, get_mag_offset());
   } else {
     for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band) {
       mags[i_band] = 999.999f;
@@ -596,50 +644,16 @@ void get_output_magnitudesIII(float* mags, galaxy_t* gal, int snapshot)
 void get_output_magnitudes(float* mags, float* dusty_mags, galaxy_t* gal, int snapshot)
 {
   // Convert fluxes to AB magnitudes at all target snapshots.
+  int iS = find_target_snap(snapshot);
 
-  // Check if ``snapshot`` is a target snapshot
-  int iS;
-  int* targetSnap = run_globals.mag_params.targetSnap;
-  double* pInBCFlux = gal->inBCFlux;
-  double* pOutBCFlux = gal->outBCFlux;
-
-  for (iS = 0; iS < MAGS_N_SNAPS; ++iS) {
-    if (snapshot == targetSnap[iS])
-      break;
-    else {
-      pInBCFlux += MAGS_N_BANDS;
-      pOutBCFlux += MAGS_N_BANDS;
-    }
-  }
-  // Correct the unit of SFRs and convert fluxes to magnitudes
   if (iS != MAGS_N_SNAPS) {
-    double redshift = run_globals.ZZ[snapshot];
-    double sfr_unit =
-      -2.5 * log10(run_globals.units.UnitMass_in_g / run_globals.units.UnitTime_in_s * SEC_PER_YEAR / SOLAR_MASS);
-    for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band) {
-      mags[i_band] = (float)(-2.5 * log10(pInBCFlux[i_band] + pOutBCFlux[i_band]) + 8.9 + sfr_unit);
-    }
-
-    // Best fit dust--gas model from Qiu, Mutch, da Cunha et al. 2019, MNRAS, 489, 1357
-    double factor = pow(calc_metallicity(gal->ColdGas, gal->MetalsColdGas) / 0.02, 1.2) * gal->ColdGas *
-                    pow(gal->DiskScaleLength * 1e3, -2.0) * exp(-0.35 * redshift);
-    dust_params_t dust_params = { .tauUV_ISM = 13.5 * factor,
-                                  .nISM = -1.6,
-                                  .tauUV_BC = 381.3 * factor,
-                                  .nBC = -1.6,
-                                  .tBC = run_globals.mag_params.tBC };
-
-    double local_InBCFlux[MAGS_N_BANDS], local_OutBCFlux[MAGS_N_BANDS];
-    memcpy(local_InBCFlux, pInBCFlux, sizeof(local_InBCFlux));
-    memcpy(local_OutBCFlux, pOutBCFlux, sizeof(local_OutBCFlux));
-
-    dust_absorption_approx(
-      local_InBCFlux, local_OutBCFlux, run_globals.mag_params.centreWaves, MAGS_N_BANDS, &dust_params);
-
-    for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band) {
-      dusty_mags[i_band] = (float)(-2.5 * log10(local_InBCFlux[i_band] + local_OutBCFlux[i_band]) + 8.9 + sfr_unit);
-    }
-
+    int offset = iS * MAGS_N_BANDS;
+    calc_magnitudes(mags,
+                    dusty_mags,
+                    gal->inBCFlux + offset,
+                    gal->outBCFlux + offset,
+                    calc_dust_factor(gal, run_globals.ZZ[snapshot]),
+                    get_mag_offset());
   } else {
     for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band) {
       mags[i_band] = 999.999f;
@@ -647,4 +661,41 @@ void get_output_magnitudes(float* mags, float* dusty_mags, galaxy_t* gal, int sn
     }
   }
 }
+
+void get_output_magnitudes_batch(galaxy_output_t* galout, galaxy_t** gals, int n_gals, int snapshot)
+{
+  // Convert the fluxes of a buffer of output galaxies to AB magnitudes.  The
+  // target snapshot look up, unit conversion and per-band dust optical depths
+  // are shared by the whole buffer.
+  int iS = find_target_snap(snapshot);
+
+  if (iS == MAGS_N_SNAPS) {
+    for (int i_gal = 0; i_gal < n_gals; ++i_gal)
+      for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band) {
+        galout[i_gal].Mags[i_band] = 999.999f;
+        galout[i_gal].DustyMags[i_band] = 999.999f;
+#if USE_MINI_HALOS
+        galout[i_gal].MagsIII[i_band] = 999.999f;
+#endif
+      }
+    return;
+  }
+
+  int offset = iS * MAGS_N_BANDS;
+  double redshift = run_globals.ZZ[snapshot];
+  double mag_offset = get_mag_offset();
+
+  for (int i_gal = 0; i_gal < n_gals; ++i_gal) {
+    galaxy_t* gal = gals[i_gal];
+    calc_magnitudes(galout[i_gal].Mags,
+                    galout[i_gal].DustyMags,
+                    gal->inBCFlux + offset,
+                    gal->outBCFlux + offset,
+                    calc_dust_factor(gal, redshift),
+                    mag_offset);
+#if USE_MINI_HALOS
+    calc_magnitudesIII(galout[i_gal].MagsIII, gal->inBCFluxIII + offset, gal->outBCFluxIII + offset, mag_offset);
+#endif
+  }
+}
 #endif
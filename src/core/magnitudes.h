@@ -8,11 +8,20 @@
 
 #define TOL 1e-30 // Minimum Flux
 
+// Best fit dust--gas model from Qiu, Mutch, da Cunha et al. 2019, MNRAS, 489, 1357
+#define DUST_WAVE_UV 1600. // Reference wavelength [AA]
+#define DUST_TAUUV_ISM 13.5
+#define DUST_N_ISM -1.6
+#define DUST_TAUUV_BC 381.3
+#define DUST_N_BC -1.6
+
 enum core
 {
   MASTER
 };
 
+struct galaxy_output_t;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -38,6 +47,8 @@ extern "C"
                            int nRest,
                            double tBC);
   void init_magnitudes(void);
+  void init_dust_attenuation(mag_params_t* mag_params);
+  void get_output_magnitudes_batch(struct galaxy_output_t* galout, struct galaxy_t** gals, int n_gals, int snapshot);
   void cleanup_mags(void);
 
 #ifdef __cplusplus
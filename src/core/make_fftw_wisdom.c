@@ -0,0 +1,77 @@
+#define _MAIN
+#include <fftw3-mpi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "meraxes.h"
+#include "reionization.h"
+
+/*
+ * Generate FFTW3 wisdom for the reionization grids offline, rather than in
+ * the first production run.
+ *
+ *   mpirun -n <n_ranks> make_fftw_wisdom <parameterfile> [<ReionGridDim> ...]
+ *
+ * The set of plans (spin temperature, recombinations, batched and pencil
+ * transforms, ...) comes from the parameter file, as does FFTW3WisdomDir.
+ * Wisdom is made for the parameter file's ReionGridDim, or for each of the
+ * grid sizes given.  As the transforms are MPI parallel, the tool must be
+ * run on the same number of ranks as the production runs that will use the
+ * wisdom.  The wisdom files are registered in FFTW3WisdomDir (see
+ * fftw_wisdom.c).
+ */
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc, &argv);
+  MPI_Comm_dup(MPI_COMM_WORLD, &run_globals.mpi_comm);
+  MPI_Comm_rank(MPI_COMM_WORLD, &run_globals.mpi_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &run_globals.mpi_size);
+
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  if (argc < 2) {
+    mlog("\n  usage: %s <parameterfile> [<ReionGridDim> ...]\n\n", MLOG_MESG, argv[0]);
+    ABORT(EXIT_FAILURE);
+  }
+
+  read_parameter_file(argv[1], 0);
+
+  if (!run_globals.params.Flag_PatchyReion || (strlen(run_globals.params.FFTW3WisdomDir) == 0)) {
+    mlog_error("Flag_PatchyReion and FFTW3WisdomDir must be set to generate wisdom.");
+    ABORT(EXIT_FAILURE);
+  }
+
+  // These only allocate grids, not plans
+  run_globals.params.Flag_ConstructLightcone = 0;
+  run_globals.params.Flag_ComputePS = 0;
+  run_globals.NStoreSnapshots = 0;
+
+  int n_grid_dims = argc > 2 ? argc - 2 : 1;
+  for (int ii = 0; ii < n_grid_dims; ii++) {
+    if (argc > 2)
+      run_globals.params.ReionGridDim = atoi(argv[ii + 2]);
+
+    if (run_globals.params.ReionGridDim < 2) {
+      mlog_error("Invalid ReionGridDim (%d).", run_globals.params.ReionGridDim);
+      ABORT(EXIT_FAILURE);
+    }
+
+    mlog("Generating FFTW3 wisdom for N=%d on %d ranks...",
+         MLOG_OPEN | MLOG_TIMERSTART,
+         run_globals.params.ReionGridDim,
+         run_globals.mpi_size);
+    malloc_reionization_grids();
+    free_reionization_grids();
+    free(run_globals.SnapshotVel);
+    free(run_globals.SnapshotDeltax);
+    fftwf_forget_wisdom();
+    mlog("...done", MLOG_CLOSE | MLOG_TIMERSTOP);
+  }
+
+  fftwf_mpi_cleanup();
+  MPI_Comm_free(&run_globals.mpi_comm);
+  MPI_Finalize();
+
+  return EXIT_SUCCESS;
+}
@@ -13,6 +13,29 @@
 #include "reionization.c"
 #include "virial_properties.h"
 
+//! The properties deposited by construct_metal_grids, in the order they are stored for each cell (MetalFusedGrids)
+enum metal_record
+{
+  rec_prob,
+  rec_count,
+  rec_Rave,
+  rec_Rmax,
+  rec_mass_ej_metals,
+  rec_mass_ej_gas,
+  N_METAL_RECORD
+};
+
+//! The values of a cell given to the galaxies in it by assign_metal_properties_to_galaxies
+enum metal_gal_record
+{
+  gal_rec_prob,
+  gal_rec_metals,
+  gal_rec_gas,
+  gal_rec_Rave,
+  gal_rec_Rmax,
+  N_GAL_METAL_RECORD
+};
+
 void assign_slabs_metals()
 {
   mlog("Assigning slabs to MPI cores for Metals...", MLOG_OPEN);
@@ -50,6 +73,122 @@ void assign_slabs_metals()
   mlog("...done", MLOG_CLOSE);
 }
 
+static void reduce_metal_records(void* invec, void* inoutvec, int* len, MPI_Datatype* datatype)
+{
+  // Sum the records of each cell, except for Rmax which takes the maximum (as for the per-property reductions)
+  float* in = (float*)invec;
+  float* inout = (float*)inoutvec;
+
+  for (int ii = 0; ii < *len * N_METAL_RECORD; ii++) {
+    if (ii % N_METAL_RECORD == rec_Rmax)
+      inout[ii] = (in[ii] > inout[ii]) ? in[ii] : inout[ii];
+    else
+      inout[ii] += in[ii];
+  }
+}
+
+static void construct_metal_grids_fused(double redshift, double pixel_volume_metals)
+{
+  // Single pass version of the per-property loop in construct_metal_grids.  Each galaxy's cell is found once and
+  // all of the properties are deposited into that cell's record, so each slab needs only one reduction.  The
+  // deposits and final passes are those of the per-property loop, in the same order, so the grids are the same.
+  metal_grids_t* grids = &(run_globals.metal_grids);
+  double box_size = run_globals.params.BoxSize;
+  int MetalGridDim = run_globals.params.MetalGridDim;
+
+  gal_to_slab_t* galaxy_to_slab_map_metals = grids->galaxy_to_slab_map_metals;
+  int* slab_gal_offsets_metals = grids->slab_gal_offsets_metals;
+  ptrdiff_t* slab_ix_start_metals = grids->slab_ix_start_metals;
+  ptrdiff_t* slab_nix_metals = grids->slab_nix_metals;
+  float* records = grids->buffer_records_metals;
+
+  MPI_Datatype record_type;
+  MPI_Type_contiguous(N_METAL_RECORD, MPI_FLOAT, &record_type);
+  MPI_Type_commit(&record_type);
+
+  MPI_Op record_op;
+  MPI_Op_create(reduce_metal_records, 1, &record_op);
+
+  for (int i_r = 0; i_r < run_globals.mpi_size; i_r++) {
+    int n_cells = (int)(slab_nix_metals[i_r] * MetalGridDim * MetalGridDim);
+    memset(records, 0, sizeof(float) * N_METAL_RECORD * (size_t)n_cells);
+
+    for (int i_gal = slab_gal_offsets_metals[i_r]; i_gal < slab_gal_offsets_metals[i_r + 1]; i_gal++) {
+      galaxy_t* gal = galaxy_to_slab_map_metals[i_gal].galaxy;
+
+      if (gal->Type > 2)
+        continue;
+
+      int ix = (int)(pos_to_ngp(gal->Pos[0], box_size, MetalGridDim) - slab_ix_start_metals[i_r]);
+      int iy = pos_to_ngp(gal->Pos[1], box_size, MetalGridDim);
+      int iz = pos_to_ngp(gal->Pos[2], box_size, MetalGridDim);
+
+      assert((ix < slab_nix_metals[i_r]) && (ix >= 0));
+      assert((iy < MetalGridDim) && (iy >= 0));
+      assert((iz < MetalGridDim) && (iz >= 0));
+
+      float* rec = records + (size_t)N_METAL_RECORD * grid_index(ix, iy, iz, MetalGridDim, INDEX_REAL);
+
+      if (gal->RmetalBubble >= 3 * gal->Rvir) {
+        rec[rec_prob] += (4.0 / 3.0 * M_PI * pow((gal->RmetalBubble) * (1 + redshift), 3.0));
+        rec[rec_mass_ej_metals] += gal->MetalsEjectedGas;
+      }
+
+      if (gal->RmetalBubble > 0.) {
+        rec[rec_count] += 1;
+        rec[rec_Rave] += gal->RmetalBubble * (1 + redshift);
+      }
+
+      if (gal->RmetalBubble * (1 + redshift) >= rec[rec_Rmax])
+        rec[rec_Rmax] = gal->RmetalBubble * (1 + redshift);
+
+      rec[rec_mass_ej_gas] -= (gal->HotGas + gal->ColdGas);
+      if (gal->RmetalBubble >= 3 * gal->Rvir)
+        rec[rec_mass_ej_gas] += gal->EjectedGas;
+    }
+
+    // reduce on to the correct rank
+    if (run_globals.mpi_rank == i_r)
+      MPI_Reduce(MPI_IN_PLACE, records, n_cells, record_type, record_op, i_r, run_globals.mpi_comm);
+    else
+      MPI_Reduce(records, records, n_cells, record_type, record_op, i_r, run_globals.mpi_comm);
+
+    if (run_globals.mpi_rank == i_r)
+      for (int ii = 0; ii < n_cells; ii++) {
+        float* rec = records + (size_t)N_METAL_RECORD * ii;
+
+        float val = rec[rec_prob] / pixel_volume_metals;
+        if (val < 0)
+          val = 0;
+        if (val > 1)
+          val = 1;
+        grids->Probability_metals[ii] = val;
+
+        val = rec[rec_count];
+        if (val < 0)
+          val = 0;
+        grids->N_bubbles[ii] = val;
+
+        val = rec[rec_Rave];
+        if (val > 0)
+          grids->R_ave[ii] = val / grids->N_bubbles[ii];
+
+        val = rec[rec_Rmax];
+        if (val >= grids->R_max[ii])
+          grids->R_max[ii] = val;
+
+        val = rec[rec_mass_ej_metals];
+        grids->mass_metals[ii] = (val < 0) ? 0 : val;
+
+        val = rec[rec_mass_ej_gas];
+        grids->mass_gas[ii] = (val < 0) ? 0 : val;
+      }
+  }
+
+  MPI_Op_free(&record_op);
+  MPI_Type_free(&record_type);
+}
+
 void construct_metal_grids(int snapshot, int local_ngals)
 {
   double box_size = run_globals.params.BoxSize;
@@ -66,6 +205,7 @@ void construct_metal_grids(int snapshot, int local_ngals)
   double pixel_volume_metals = pow(box_size / (double)MetalGridDim, 3); // (Mpc/h)^3
 
   gal_to_slab_t* galaxy_to_slab_map_metals = run_globals.metal_grids.galaxy_to_slab_map_metals;
+  int* slab_gal_offsets_metals = run_globals.metal_grids.slab_gal_offsets_metals;
   ptrdiff_t* slab_ix_start_metals = run_globals.metal_grids.slab_ix_start_metals;
   ptrdiff_t* slab_nix_metals = run_globals.metal_grids.slab_nix_metals;
   ptrdiff_t slab_n_real_metals = slab_nix_metals[run_globals.mpi_rank] * MetalGridDim * MetalGridDim;
@@ -82,6 +222,12 @@ void construct_metal_grids(int snapshot, int local_ngals)
     Rmax_grid_metals[ii] = 0.0;
   }
 
+  if (run_globals.params.MetalFusedGrids) {
+    construct_metal_grids_fused(redshift, pixel_volume_metals);
+    mlog("done", MLOG_CLOSE | MLOG_TIMERSTOP);
+    return;
+  }
+
   // loop through each slab
   ptrdiff_t buffer_size_metals = run_globals.metal_grids.buffer_size_metals;
   float* buffer_metals = run_globals.metal_grids.buffer_metals;
@@ -98,101 +244,91 @@ void construct_metal_grids(int snapshot, int local_ngals)
 
   for (int prop = prop_prob; prop <= prop_mass_ej_gas; prop++) {
 
-    int i_gal = 0;
-    int skipped_gals = 0;
-
     for (int i_r = 0; i_r < run_globals.mpi_size; i_r++) {
       // init the buffer
       for (int ii = 0; ii < buffer_size_metals; ii++)
         buffer_metals[ii] = (float)0.;
 
-      // if this core holds no galaxies then we don't need to fill the buffer
-      if (local_ngals != 0)
-        // fill the local buffer for this slab
-        while (((i_gal - skipped_gals) < local_ngals) && (galaxy_to_slab_map_metals[i_gal].slab_ind == i_r)) {
-          galaxy_t* gal = galaxy_to_slab_map_metals[i_gal].galaxy;
-
-          // Dead galaxies should not be included here and are not in the
-          // local_ngals count.  They will, however, have been assigned to a
-          // slab so we will need to ignore them here...
-          if (gal->Type > 2) {
-            i_gal++;
-            skipped_gals++;
-            continue;
-          }
+      // fill the local buffer for this slab
+      for (int i_gal = slab_gal_offsets_metals[i_r]; i_gal < slab_gal_offsets_metals[i_r + 1]; i_gal++) {
+        galaxy_t* gal = galaxy_to_slab_map_metals[i_gal].galaxy;
 
-          assert(galaxy_to_slab_map_metals[i_gal].index >= 0);
-          assert((galaxy_to_slab_map_metals[i_gal].slab_ind >= 0) &&
-                 (galaxy_to_slab_map_metals[i_gal].slab_ind < run_globals.mpi_size));
+        // Dead galaxies should not be included here and are not in the
+        // local_ngals count.  They will, however, have been assigned to a
+        // slab so we will need to ignore them here...
+        if (gal->Type > 2)
+          continue;
 
-          int ix = (int)(pos_to_ngp(gal->Pos[0], box_size, MetalGridDim) - slab_ix_start_metals[i_r]);
-          int iy = pos_to_ngp(gal->Pos[1], box_size, MetalGridDim);
-          int iz = pos_to_ngp(gal->Pos[2], box_size, MetalGridDim);
+        assert(galaxy_to_slab_map_metals[i_gal].index >= 0);
+        assert((galaxy_to_slab_map_metals[i_gal].slab_ind >= 0) &&
+               (galaxy_to_slab_map_metals[i_gal].slab_ind < run_globals.mpi_size));
 
-          assert((ix < slab_nix_metals[i_r]) && (ix >= 0));
-          assert((iy < MetalGridDim) && (iy >= 0));
-          assert((iz < MetalGridDim) && (iz >= 0));
+        int ix = (int)(pos_to_ngp(gal->Pos[0], box_size, MetalGridDim) - slab_ix_start_metals[i_r]);
+        int iy = pos_to_ngp(gal->Pos[1], box_size, MetalGridDim);
+        int iz = pos_to_ngp(gal->Pos[2], box_size, MetalGridDim);
 
-          int ind = grid_index(ix, iy, iz, MetalGridDim, INDEX_REAL);
+        assert((ix < slab_nix_metals[i_r]) && (ix >= 0));
+        assert((iy < MetalGridDim) && (iy >= 0));
+        assert((iz < MetalGridDim) && (iz >= 0));
 
-          assert((ind >= 0) && (ind < slab_nix_metals[i_r] * MetalGridDim * MetalGridDim));
+        int ind = grid_index(ix, iy, iz, MetalGridDim, INDEX_REAL);
 
-          switch (prop) {
-            case prop_prob:
+        assert((ind >= 0) && (ind < slab_nix_metals[i_r] * MetalGridDim * MetalGridDim));
 
-              if (gal->RmetalBubble >= 3 * gal->Rvir) { // A bubble can actually pollute the IGM only if it's bigger
-                                                        // than its virial radius.
-                buffer_metals[ind] +=
-                  (4.0 / 3.0 * M_PI *
-                   pow((gal->RmetalBubble) * (1 + redshift), 3.0)); // cMpc/h (same units of cell volume)
-              }
+        switch (prop) {
+          case prop_prob:
 
-              break;
+            if (gal->RmetalBubble >= 3 * gal->Rvir) { // A bubble can actually pollute the IGM only if it's bigger
+                                                      // than its virial radius.
+              buffer_metals[ind] +=
+                (4.0 / 3.0 * M_PI *
+                 pow((gal->RmetalBubble) * (1 + redshift), 3.0)); // cMpc/h (same units of cell volume)
+            }
 
-            case prop_Rave:
+            break;
 
-              if (gal->RmetalBubble > 0.)
-                buffer_metals[ind] += gal->RmetalBubble * (1 + redshift); // cMpc/h
+          case prop_Rave:
 
-              break;
+            if (gal->RmetalBubble > 0.)
+              buffer_metals[ind] += gal->RmetalBubble * (1 + redshift); // cMpc/h
 
-            case prop_Rmax:
+            break;
 
-              if (gal->RmetalBubble * (1 + redshift) >= buffer_metals[ind])
-                buffer_metals[ind] = gal->RmetalBubble * (1 + redshift); // cMpc/h
+          case prop_Rmax:
 
-              break;
+            if (gal->RmetalBubble * (1 + redshift) >= buffer_metals[ind])
+              buffer_metals[ind] = gal->RmetalBubble * (1 + redshift); // cMpc/h
 
-            case prop_count:
+            break;
 
-              if (gal->RmetalBubble > 0.)
-                buffer_metals[ind] += 1;
+          case prop_count:
 
-              break;
+            if (gal->RmetalBubble > 0.)
+              buffer_metals[ind] += 1;
 
-            case prop_mass_ej_metals:
+            break;
 
-              if (gal->RmetalBubble >= 3 * gal->Rvir)        // Add this condition to be consistent with above
-                buffer_metals[ind] += gal->MetalsEjectedGas; // Internal units (same of gas_cell)
+          case prop_mass_ej_metals:
 
-              break;
+            if (gal->RmetalBubble >= 3 * gal->Rvir)        // Add this condition to be consistent with above
+              buffer_metals[ind] += gal->MetalsEjectedGas; // Internal units (same of gas_cell)
 
-            case prop_mass_ej_gas:
+            break;
 
-              buffer_metals[ind] -= (gal->HotGas + gal->ColdGas);
-              if (gal->RmetalBubble >= 3 * gal->Rvir)
-                buffer_metals[ind] += gal->EjectedGas; // Add this condition to be consistent with above
+          case prop_mass_ej_gas:
 
-              break;
+            buffer_metals[ind] -= (gal->HotGas + gal->ColdGas);
+            if (gal->RmetalBubble >= 3 * gal->Rvir)
+              buffer_metals[ind] += gal->EjectedGas; // Add this condition to be consistent with above
 
-            default:
-              mlog_error("Unrecognised property in slab creation.");
-              ABORT(EXIT_FAILURE);
-              break;
-          }
+            break;
 
-          i_gal++;
+          default:
+            mlog_error("Unrecognised property in slab creation.");
+            ABORT(EXIT_FAILURE);
+            break;
         }
+      }
 
       // reduce on to the correct rank
       if (prop == prop_Rmax) {
@@ -319,6 +455,9 @@ void save_metal_input_grids(int snapshot)
 
   mlog("Saving tocf input metal grids...", MLOG_OPEN);
 
+  timer_info timer;
+  timer_start(&timer);
+
   char name[STRLEN];
   gen_metal_grids_fname(snapshot, name, false);
 
@@ -341,9 +480,9 @@ void save_metal_input_grids(int snapshot)
   hsize_t count[3] = { (hsize_t)local_nix_metals, (hsize_t)MetalGridDim, (hsize_t)MetalGridDim };
   H5Sselect_hyperslab(fspace_id, H5S_SELECT_SET, start, NULL, count, NULL);
 
-  // set the dataset creation property list to use chunking along x-axis
-  hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
-  H5Pset_chunk(dcpl_id, 3, (hsize_t[3]){ 1, (hsize_t)MetalGridDim, (hsize_t)MetalGridDim });
+  // set the dataset creation property list (chunking along the x-axis by default)
+  const output_filter_t* filter = get_output_filter(OUTPUT_GRIDS_INPUT);
+  hid_t dcpl_id = create_output_dcpl(filter, 3, dims, H5T_NATIVE_FLOAT);
 
   // fftw padded grids
   float* grid = (float*)calloc((size_t)local_nix_metals * (size_t)MetalGridDim * (size_t)MetalGridDim, sizeof(float));
@@ -353,49 +492,49 @@ void save_metal_input_grids(int snapshot)
       for (int kk = 0; kk < MetalGridDim; kk++)
         grid[grid_index(ii, jj, kk, MetalGridDim, INDEX_REAL)] =
           (float)((grids->Probability_metals)[grid_index(ii, jj, kk, MetalGridDim, INDEX_REAL)]);
-  write_grid_float("Probability_metals", grid, file_id, fspace_id, memspace_id, dcpl_id);
+  write_grid_float("Probability_metals", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
 
   for (int ii = 0; ii < local_nix_metals; ii++)
     for (int jj = 0; jj < MetalGridDim; jj++)
       for (int kk = 0; kk < MetalGridDim; kk++)
         grid[grid_index(ii, jj, kk, MetalGridDim, INDEX_REAL)] =
           (float)((grids->R_ave)[grid_index(ii, jj, kk, MetalGridDim, INDEX_REAL)]);
-  write_grid_float("Average Radius", grid, file_id, fspace_id, memspace_id, dcpl_id);
+  write_grid_float("Average Radius", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
 
   for (int ii = 0; ii < local_nix_metals; ii++)
     for (int jj = 0; jj < MetalGridDim; jj++)
       for (int kk = 0; kk < MetalGridDim; kk++)
         grid[grid_index(ii, jj, kk, MetalGridDim, INDEX_REAL)] =
           (float)((grids->R_max)[grid_index(ii, jj, kk, MetalGridDim, INDEX_REAL)]);
-  write_grid_float("Max Radius", grid, file_id, fspace_id, memspace_id, dcpl_id);
+  write_grid_float("Max Radius", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
 
   for (int ii = 0; ii < local_nix_metals; ii++)
     for (int jj = 0; jj < MetalGridDim; jj++)
       for (int kk = 0; kk < MetalGridDim; kk++)
         grid[grid_index(ii, jj, kk, MetalGridDim, INDEX_REAL)] =
           (float)((grids->mass_IGM)[grid_index(ii, jj, kk, MetalGridDim, INDEX_REAL)] * UnitMass_in_g / SOLAR_MASS);
-  write_grid_float("mass_IGM", grid, file_id, fspace_id, memspace_id, dcpl_id);
+  write_grid_float("mass_IGM", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
 
   for (int ii = 0; ii < local_nix_metals; ii++)
     for (int jj = 0; jj < MetalGridDim; jj++)
       for (int kk = 0; kk < MetalGridDim; kk++)
         grid[grid_index(ii, jj, kk, MetalGridDim, INDEX_REAL)] =
           roundf((grids->N_bubbles)[grid_index(ii, jj, kk, MetalGridDim, INDEX_REAL)]);
-  write_grid_float("N_bubbles", grid, file_id, fspace_id, memspace_id, dcpl_id);
+  write_grid_float("N_bubbles", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
 
   for (int ii = 0; ii < local_nix_metals; ii++)
     for (int jj = 0; jj < MetalGridDim; jj++)
       for (int kk = 0; kk < MetalGridDim; kk++)
         grid[grid_index(ii, jj, kk, MetalGridDim, INDEX_REAL)] =
           (float)((grids->mass_metals)[grid_index(ii, jj, kk, MetalGridDim, INDEX_REAL)] * UnitMass_in_g / SOLAR_MASS);
-  write_grid_float("mass_metals", grid, file_id, fspace_id, memspace_id, dcpl_id);
+  write_grid_float("mass_metals", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
 
   for (int ii = 0; ii < local_nix_metals; ii++)
     for (int jj = 0; jj < MetalGridDim; jj++)
       for (int kk = 0; kk < MetalGridDim; kk++)
         grid[grid_index(ii, jj, kk, MetalGridDim, INDEX_REAL)] =
           (float)((grids->mass_gas)[grid_index(ii, jj, kk, MetalGridDim, INDEX_REAL)] * UnitMass_in_g / SOLAR_MASS);
-  write_grid_float("mass_gas", grid, file_id, fspace_id, memspace_id, dcpl_id);
+  write_grid_float("mass_gas", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
 
   // tidy up
   free(grid);
@@ -404,6 +543,9 @@ void save_metal_input_grids(int snapshot)
   H5Sclose(fspace_id);
   H5Fclose(file_id);
 
+  timer_stop(&timer);
+  log_grid_write_stats(filter, timer);
+
   mlog("...done", MLOG_CLOSE);
 }
 
@@ -438,6 +580,7 @@ void malloc_metal_grids()
   metal_grids_t* grids = &(run_globals.metal_grids);
 
   grids->galaxy_to_slab_map_metals = NULL;
+  grids->buffer_records_metals = NULL;
 
   grids->mass_metals = NULL;
   grids->mass_gas = NULL;
@@ -464,6 +607,8 @@ void malloc_metal_grids()
   grids->buffer_size_metals = max_cells;
 
   grids->buffer_metals = fftwf_alloc_real((size_t)max_cells);
+  if (run_globals.params.MetalFusedGrids)
+    grids->buffer_records_metals = fftwf_alloc_real((size_t)max_cells * N_METAL_RECORD);
 
   grids->mass_metals = fftwf_alloc_real((size_t)slab_n_real_metals);
   grids->mass_gas = fftwf_alloc_real((size_t)slab_n_real_metals);
@@ -499,6 +644,7 @@ void free_metal_grids()
   fftwf_free(grids->mass_IGM);
 
   fftwf_free(grids->buffer_metals);
+  fftwf_free(grids->buffer_records_metals);
 
   mlog(" ...done", MLOG_CLOSE);
 }
@@ -518,6 +664,13 @@ int map_galaxies_to_slabs_metals(int ngals)
 
   gal_to_slab_t* galaxy_to_slab_map_metals = run_globals.metal_grids.galaxy_to_slab_map_metals;
   ptrdiff_t* slab_ix_start_metals = run_globals.metal_grids.slab_ix_start_metals;
+  ptrdiff_t* slab_nix_metals = run_globals.metal_grids.slab_nix_metals;
+
+  // The slab holding each x index (see map_galaxies_to_slabs)
+  int* ix_to_slab = malloc(sizeof(int) * MetalGridDim);
+  for (int i_r = 0; i_r < run_globals.mpi_size; i_r++)
+    for (ptrdiff_t ix = slab_ix_start_metals[i_r]; ix < slab_ix_start_metals[i_r] + slab_nix_metals[i_r]; ix++)
+      ix_to_slab[ix] = i_r;
 
   galaxy_t* gal = run_globals.FirstGal;
   int gal_counter = 0;
@@ -529,17 +682,19 @@ int map_galaxies_to_slabs_metals(int ngals)
       assert((ix >= 0) && (ix < MetalGridDim));
 
       galaxy_to_slab_map_metals[gal_counter].index = gal_counter;
-      galaxy_to_slab_map_metals[gal_counter].slab_ind =
-        searchsorted(&ix, slab_ix_start_metals, run_globals.mpi_size, sizeof(ptrdiff_t), compare_ptrdiff, -1, -1);
+      galaxy_to_slab_map_metals[gal_counter].slab_ind = ix_to_slab[ix];
       galaxy_to_slab_map_metals[gal_counter++].galaxy = gal;
     }
 
     gal = gal->Next;
   }
 
-  // sort the slab indices IN PLACE (n.b. compare_slab_assign is a stable comparison)
-  if (galaxy_to_slab_map_metals != NULL)
-    qsort(galaxy_to_slab_map_metals, (size_t)gal_counter, sizeof(gal_to_slab_t), compare_slab_assign);
+  free(ix_to_slab);
+
+  // bucket the galaxies by slab, via a temporary buffer (in the same order as a qsort with compare_slab_assign)
+  int* slab_gal_offsets_metals = malloc(sizeof(int) * (run_globals.mpi_size + 1));
+  sort_slab_assign(galaxy_to_slab_map_metals, gal_counter, run_globals.mpi_size, slab_gal_offsets_metals);
+  run_globals.metal_grids.slab_gal_offsets_metals = slab_gal_offsets_metals;
 
   assert(gal_counter == ngals);
 
@@ -548,315 +703,141 @@ int map_galaxies_to_slabs_metals(int ngals)
   return gal_counter;
 }
 
-void assign_probability_to_galaxies(int ngals_in_metal_slabs, int snapshot, int flag_property)
+void assign_metal_properties_to_galaxies(int ngals_in_metal_slabs)
 {
-  // Same way in which we assing Mcrit due to Reio and LW feedback in reionization.c
+  // Give each galaxy the Probability_metals, mass_metals, mass_IGM, R_ave and R_max values of its cell.  Each rank
+  // asks the slab owners for the (unique) cells holding its galaxies, and the owners reply with a record of all
+  // five values for each of these cells, so that everything is fetched in a single exchange.
 
-  gal_to_slab_t* galaxy_to_slab_map_metals = run_globals.metal_grids.galaxy_to_slab_map_metals;
-  float* buffer_metals = run_globals.metal_grids.buffer_metals;
-  ptrdiff_t* slab_nix_metals = run_globals.metal_grids.slab_nix_metals;
-  ptrdiff_t* slab_ix_start_metals = run_globals.metal_grids.slab_ix_start_metals;
+  metal_grids_t* grids = &(run_globals.metal_grids);
+  gal_to_slab_t* galaxy_to_slab_map_metals = grids->galaxy_to_slab_map_metals;
+  int* slab_gal_offsets_metals = grids->slab_gal_offsets_metals;
+  ptrdiff_t* slab_nix_metals = grids->slab_nix_metals;
+  ptrdiff_t* slab_ix_start_metals = grids->slab_ix_start_metals;
   int MetalGridDim = run_globals.params.MetalGridDim;
   double box_size = run_globals.params.BoxSize;
-  float* Probability_metals = run_globals.metal_grids.Probability_metals;
-  float* mass_metals = run_globals.metal_grids.mass_metals;
-  float* mass_IGM = run_globals.metal_grids.mass_IGM;
-  float* Rave_metals = run_globals.metal_grids.R_ave;
-  float* Rmax_metals = run_globals.metal_grids.R_max;
+  int n_ranks = run_globals.mpi_size;
   int total_assigned = 0;
 
-  if (flag_property == 0)
-    mlog("Assigning probability for metals...", MLOG_OPEN);
+  mlog("Assigning metal properties to galaxies...", MLOG_OPEN);
 
-  if (flag_property == 1)
-    mlog("Assigning metals IGM for metals...", MLOG_OPEN);
+  int* send_counts = malloc(sizeof(int) * n_ranks);
+  int* send_displs = malloc(sizeof(int) * n_ranks);
+  int* recv_counts = malloc(sizeof(int) * n_ranks);
+  int* recv_displs = malloc(sizeof(int) * n_ranks);
 
-  if (flag_property == 2)
-    mlog("Assigning gas IGM for metals...", MLOG_OPEN);
+  // The cell of each galaxy (in its slab), and the sorted list of unique cells wanted from each slab
+  int* gal_cell = malloc(sizeof(int) * ngals_in_metal_slabs);
+  int* cells_wanted = malloc(sizeof(int) * ngals_in_metal_slabs);
+  int n_wanted = 0;
 
-  if (flag_property == 3)
-    mlog("Assigning Rave for metals...", MLOG_OPEN);
+  for (int i_r = 0; i_r < n_ranks; i_r++) {
+    int ix_start_metals = (int)slab_ix_start_metals[i_r];
+    int first = slab_gal_offsets_metals[i_r];
+    int n_gals = slab_gal_offsets_metals[i_r + 1] - first;
 
-  if (flag_property == 4)
-    mlog("Assigning Rmax for metals...", MLOG_OPEN);
+    for (int i_gal = first; i_gal < first + n_gals; i_gal++) {
+      // TODO: We should use the position of the FOF group here...
+      galaxy_t* gal = galaxy_to_slab_map_metals[i_gal].galaxy;
+      int ix = pos_to_ngp(gal->Pos[0], box_size, MetalGridDim) - ix_start_metals;
+      int iy = pos_to_ngp(gal->Pos[1], box_size, MetalGridDim);
+      int iz = pos_to_ngp(gal->Pos[2], box_size, MetalGridDim);
 
-  int slab_map_offsets[run_globals.mpi_size];
-  for (int ii = 0, i_gal = 0; ii < run_globals.mpi_size; ii++) {
-    if (galaxy_to_slab_map_metals != NULL) {
-      while ((i_gal < (ngals_in_metal_slabs - 1)) && (galaxy_to_slab_map_metals[i_gal].slab_ind < ii))
-        i_gal++;
+      assert(ix >= 0);
+      assert(ix < slab_nix_metals[i_r]);
 
-      if (galaxy_to_slab_map_metals[i_gal].slab_ind == ii)
-        slab_map_offsets[ii] = i_gal;
-      else
-        slab_map_offsets[ii] = -1;
-    } else
-      slab_map_offsets[ii] = -1;
-  }
-
-  for (int i_skip = 0; i_skip < run_globals.mpi_size; i_skip++) {
-    int recv_from_rank = (run_globals.mpi_rank + i_skip) % run_globals.mpi_size;
-    int send_to_rank = (run_globals.mpi_rank - i_skip + run_globals.mpi_size) % run_globals.mpi_size;
-
-    bool send_flag = false;
-    bool recv_flag = (slab_map_offsets[recv_from_rank] > -1);
-
-    if (flag_property == 0) {
-
-      if (i_skip > 0) {
-        MPI_Sendrecv(&recv_flag,
-                     sizeof(bool),
-                     MPI_BYTE,
-                     recv_from_rank,
-                     6393762,
-                     &send_flag,
-                     sizeof(bool),
-                     MPI_BYTE,
-                     send_to_rank,
-                     6393762,
-                     run_globals.mpi_comm,
-                     MPI_STATUS_IGNORE);
-
-        // need to ensure sends and receives do not clash!
-        if (send_to_rank > run_globals.mpi_rank) {
-          if (send_flag) {
-            int n_cells = (int)(slab_nix_metals[run_globals.mpi_rank] * MetalGridDim * MetalGridDim);
-            MPI_Send(Probability_metals, n_cells, MPI_FLOAT, send_to_rank, 793710, run_globals.mpi_comm);
-          }
-          if (recv_flag) {
-            int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-            MPI_Recv(
-              buffer_metals, n_cells, MPI_FLOAT, recv_from_rank, 793710, run_globals.mpi_comm, MPI_STATUS_IGNORE);
-          }
-        } else {
-          if (recv_flag) {
-            int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-            MPI_Recv(
-              buffer_metals, n_cells, MPI_FLOAT, recv_from_rank, 793710, run_globals.mpi_comm, MPI_STATUS_IGNORE);
-          }
-          if (send_flag) {
-            int n_cells = (int)(slab_nix_metals[run_globals.mpi_rank] * MetalGridDim * MetalGridDim);
-            MPI_Send(Probability_metals, n_cells, MPI_FLOAT, send_to_rank, 793710, run_globals.mpi_comm);
-          }
-        }
-      } else {
-        int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-        memcpy(buffer_metals, Probability_metals, sizeof(float) * n_cells);
-      }
+      gal_cell[i_gal] = grid_index(ix, iy, iz, MetalGridDim, INDEX_REAL);
+      cells_wanted[i_gal] = gal_cell[i_gal];
     }
 
-    if (flag_property == 1) {
-
-      if (i_skip > 0) {
-        MPI_Sendrecv(&recv_flag,
-                     sizeof(bool),
-                     MPI_BYTE,
-                     recv_from_rank,
-                     6393762,
-                     &send_flag,
-                     sizeof(bool),
-                     MPI_BYTE,
-                     send_to_rank,
-                     6393762,
-                     run_globals.mpi_comm,
-                     MPI_STATUS_IGNORE);
-
-        // need to ensure sends and receives do not clash!
-        if (send_to_rank > run_globals.mpi_rank) {
-          if (send_flag) {
-            int n_cells = (int)(slab_nix_metals[run_globals.mpi_rank] * MetalGridDim * MetalGridDim);
-            MPI_Send(mass_metals, n_cells, MPI_FLOAT, send_to_rank, 793710, run_globals.mpi_comm);
-          }
-          if (recv_flag) {
-            int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-            MPI_Recv(
-              buffer_metals, n_cells, MPI_FLOAT, recv_from_rank, 793710, run_globals.mpi_comm, MPI_STATUS_IGNORE);
-          }
-        } else {
-          if (recv_flag) {
-            int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-            MPI_Recv(
-              buffer_metals, n_cells, MPI_FLOAT, recv_from_rank, 793710, run_globals.mpi_comm, MPI_STATUS_IGNORE);
-          }
-          if (send_flag) {
-            int n_cells = (int)(slab_nix_metals[run_globals.mpi_rank] * MetalGridDim * MetalGridDim);
-            MPI_Send(mass_metals, n_cells, MPI_FLOAT, send_to_rank, 793710, run_globals.mpi_comm);
-          }
-        }
-      } else {
-        int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-        memcpy(buffer_metals, mass_metals, sizeof(float) * n_cells);
-      }
-    }
+    // n.b. as n_wanted <= first, the unique cells can be packed in place
+    qsort(&cells_wanted[first], (size_t)n_gals, sizeof(int), compare_ints);
+    send_displs[i_r] = n_wanted;
+    for (int ii = first; ii < first + n_gals; ii++)
+      if ((ii == first) || (cells_wanted[ii] != cells_wanted[ii - 1]))
+        cells_wanted[n_wanted++] = cells_wanted[ii];
+    send_counts[i_r] = n_wanted - send_displs[i_r];
+  }
 
-    if (flag_property == 2) {
-
-      if (i_skip > 0) {
-        MPI_Sendrecv(&recv_flag,
-                     sizeof(bool),
-                     MPI_BYTE,
-                     recv_from_rank,
-                     6393762,
-                     &send_flag,
-                     sizeof(bool),
-                     MPI_BYTE,
-                     send_to_rank,
-                     6393762,
-                     run_globals.mpi_comm,
-                     MPI_STATUS_IGNORE);
-
-        // need to ensure sends and receives do not clash!
-        if (send_to_rank > run_globals.mpi_rank) {
-          if (send_flag) {
-            int n_cells = (int)(slab_nix_metals[run_globals.mpi_rank] * MetalGridDim * MetalGridDim);
-            MPI_Send(mass_IGM, n_cells, MPI_FLOAT, send_to_rank, 793710, run_globals.mpi_comm);
-          }
-          if (recv_flag) {
-            int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-            MPI_Recv(
-              buffer_metals, n_cells, MPI_FLOAT, recv_from_rank, 793710, run_globals.mpi_comm, MPI_STATUS_IGNORE);
-          }
-        } else {
-          if (recv_flag) {
-            int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-            MPI_Recv(
-              buffer_metals, n_cells, MPI_FLOAT, recv_from_rank, 793710, run_globals.mpi_comm, MPI_STATUS_IGNORE);
-          }
-          if (send_flag) {
-            int n_cells = (int)(slab_nix_metals[run_globals.mpi_rank] * MetalGridDim * MetalGridDim);
-            MPI_Send(mass_IGM, n_cells, MPI_FLOAT, send_to_rank, 793710, run_globals.mpi_comm);
-          }
-        }
-      } else {
-        int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-        memcpy(buffer_metals, mass_IGM, sizeof(float) * n_cells);
-      }
-    }
+  MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, run_globals.mpi_comm);
 
-    if (flag_property == 3) {
-
-      if (i_skip > 0) {
-        MPI_Sendrecv(&recv_flag,
-                     sizeof(bool),
-                     MPI_BYTE,
-                     recv_from_rank,
-                     6393762,
-                     &send_flag,
-                     sizeof(bool),
-                     MPI_BYTE,
-                     send_to_rank,
-                     6393762,
-                     run_globals.mpi_comm,
-                     MPI_STATUS_IGNORE);
-
-        // need to ensure sends and receives do not clash!
-        if (send_to_rank > run_globals.mpi_rank) {
-          if (send_flag) {
-            int n_cells = (int)(slab_nix_metals[run_globals.mpi_rank] * MetalGridDim * MetalGridDim);
-            MPI_Send(Rave_metals, n_cells, MPI_FLOAT, send_to_rank, 793710, run_globals.mpi_comm);
-          }
-          if (recv_flag) {
-            int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-            MPI_Recv(
-              buffer_metals, n_cells, MPI_FLOAT, recv_from_rank, 793710, run_globals.mpi_comm, MPI_STATUS_IGNORE);
-          }
-        } else {
-          if (recv_flag) {
-            int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-            MPI_Recv(
-              buffer_metals, n_cells, MPI_FLOAT, recv_from_rank, 793710, run_globals.mpi_comm, MPI_STATUS_IGNORE);
-          }
-          if (send_flag) {
-            int n_cells = (int)(slab_nix_metals[run_globals.mpi_rank] * MetalGridDim * MetalGridDim);
-            MPI_Send(Rave_metals, n_cells, MPI_FLOAT, send_to_rank, 793710, run_globals.mpi_comm);
-          }
-        }
-      } else {
-        int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-        memcpy(buffer_metals, Rave_metals, sizeof(float) * n_cells);
-      }
-    }
+  int n_requested = 0;
+  for (int i_r = 0; i_r < n_ranks; i_r++) {
+    recv_displs[i_r] = n_requested;
+    n_requested += recv_counts[i_r];
+  }
 
-    if (flag_property == 4) {
-
-      if (i_skip > 0) {
-        MPI_Sendrecv(&recv_flag,
-                     sizeof(bool),
-                     MPI_BYTE,
-                     recv_from_rank,
-                     6393762,
-                     &send_flag,
-                     sizeof(bool),
-                     MPI_BYTE,
-                     send_to_rank,
-                     6393762,
-                     run_globals.mpi_comm,
-                     MPI_STATUS_IGNORE);
-
-        // need to ensure sends and receives do not clash!
-        if (send_to_rank > run_globals.mpi_rank) {
-          if (send_flag) {
-            int n_cells = (int)(slab_nix_metals[run_globals.mpi_rank] * MetalGridDim * MetalGridDim);
-            MPI_Send(Rmax_metals, n_cells, MPI_FLOAT, send_to_rank, 793710, run_globals.mpi_comm);
-          }
-          if (recv_flag) {
-            int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-            MPI_Recv(
-              buffer_metals, n_cells, MPI_FLOAT, recv_from_rank, 793710, run_globals.mpi_comm, MPI_STATUS_IGNORE);
-          }
-        } else {
-          if (recv_flag) {
-            int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-            MPI_Recv(
-              buffer_metals, n_cells, MPI_FLOAT, recv_from_rank, 793710, run_globals.mpi_comm, MPI_STATUS_IGNORE);
-          }
-          if (send_flag) {
-            int n_cells = (int)(slab_nix_metals[run_globals.mpi_rank] * MetalGridDim * MetalGridDim);
-            MPI_Send(Rmax_metals, n_cells, MPI_FLOAT, send_to_rank, 793710, run_globals.mpi_comm);
-          }
-        }
-      } else {
-        int n_cells = (int)(slab_nix_metals[recv_from_rank] * MetalGridDim * MetalGridDim);
-        memcpy(buffer_metals, Rmax_metals, sizeof(float) * n_cells);
-      }
-    }
+  int* cells_requested = malloc(sizeof(int) * n_requested);
+  MPI_Alltoallv(cells_wanted,
+                send_counts,
+                send_displs,
+                MPI_INT,
+                cells_requested,
+                recv_counts,
+                recv_displs,
+                MPI_INT,
+                run_globals.mpi_comm);
 
-    if (recv_flag) {
-      int i_gal = slab_map_offsets[recv_from_rank];
-      int ix_start_metals = (int)slab_ix_start_metals[recv_from_rank];
-      while ((i_gal < ngals_in_metal_slabs) && (galaxy_to_slab_map_metals[i_gal].slab_ind == recv_from_rank)) {
-        // TODO: We should use the position of the FOF group here...
-        galaxy_t* gal = galaxy_to_slab_map_metals[i_gal].galaxy;
-        int ix = pos_to_ngp(gal->Pos[0], box_size, MetalGridDim) - ix_start_metals;
-        int iy = pos_to_ngp(gal->Pos[1], box_size, MetalGridDim);
-        int iz = pos_to_ngp(gal->Pos[2], box_size, MetalGridDim);
+  // pack the records of the requested cells of this slab
+  float* replies = malloc(sizeof(float) * N_GAL_METAL_RECORD * n_requested);
+  for (int ii = 0; ii < n_requested; ii++) {
+    int cell = cells_requested[ii];
+    float* rec = replies + N_GAL_METAL_RECORD * ii;
 
-        assert(ix >= 0);
-        assert(ix < slab_nix_metals[recv_from_rank]);
+    assert((cell >= 0) && (cell < slab_nix_metals[run_globals.mpi_rank] * MetalGridDim * MetalGridDim));
 
-        if (flag_property == 0) //{
-          gal->Metal_Probability = (double)buffer_metals[grid_index(ix, iy, iz, MetalGridDim, INDEX_REAL)];
+    rec[gal_rec_prob] = grids->Probability_metals[cell];
+    rec[gal_rec_metals] = grids->mass_metals[cell];
+    rec[gal_rec_gas] = grids->mass_IGM[cell];
+    rec[gal_rec_Rave] = grids->R_ave[cell];
+    rec[gal_rec_Rmax] = grids->R_max[cell];
+  }
 
-        if (flag_property == 1)
-          gal->Metals_IGM = (double)buffer_metals[grid_index(ix, iy, iz, MetalGridDim, INDEX_REAL)];
+  MPI_Datatype record_type;
+  MPI_Type_contiguous(N_GAL_METAL_RECORD, MPI_FLOAT, &record_type);
+  MPI_Type_commit(&record_type);
+
+  float* records = malloc(sizeof(float) * N_GAL_METAL_RECORD * n_wanted);
+  MPI_Alltoallv(replies,
+                recv_counts,
+                recv_displs,
+                record_type,
+                records,
+                send_counts,
+                send_displs,
+                record_type,
+                run_globals.mpi_comm);
 
-        if (flag_property == 2) {
-          gal->Gas_IGM = (double)buffer_metals[grid_index(ix, iy, iz, MetalGridDim, INDEX_REAL)];
-          gal->Metallicity_IGM = calc_metallicity(gal->Gas_IGM, gal->Metals_IGM);
-        }
+  MPI_Type_free(&record_type);
 
-        if (flag_property == 3)
-          gal->AveBubble = (double)buffer_metals[grid_index(ix, iy, iz, MetalGridDim, INDEX_REAL)];
+  for (int i_r = 0; i_r < n_ranks; i_r++)
+    for (int i_gal = slab_gal_offsets_metals[i_r]; i_gal < slab_gal_offsets_metals[i_r + 1]; i_gal++) {
+      galaxy_t* gal = galaxy_to_slab_map_metals[i_gal].galaxy;
+      int* found = bsearch(
+        &gal_cell[i_gal], &cells_wanted[send_displs[i_r]], (size_t)send_counts[i_r], sizeof(int), compare_ints);
 
-        if (flag_property == 4)
-          gal->MaxBubble = (double)buffer_metals[grid_index(ix, iy, iz, MetalGridDim, INDEX_REAL)];
+      assert(found != NULL);
+      float* rec = records + N_GAL_METAL_RECORD * (found - cells_wanted);
 
-        // increment counters
-        i_gal++;
-        total_assigned++;
-      }
+      gal->Metal_Probability = (double)rec[gal_rec_prob];
+      gal->Metals_IGM = (double)rec[gal_rec_metals];
+      gal->Gas_IGM = (double)rec[gal_rec_gas];
+      gal->Metallicity_IGM = calc_metallicity(gal->Gas_IGM, gal->Metals_IGM);
+      gal->AveBubble = (double)rec[gal_rec_Rave];
+      gal->MaxBubble = (double)rec[gal_rec_Rmax];
+
+      total_assigned++;
     }
-  }
+
+  free(records);
+  free(replies);
+  free(cells_requested);
+  free(cells_wanted);
+  free(gal_cell);
+  free(recv_displs);
+  free(recv_counts);
+  free(send_displs);
+  free(send_counts);
 
   if (total_assigned != ngals_in_metal_slabs)
     ABORT(EXIT_FAILURE);
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <math.h>
+#include <string.h>
 
 #include "cn_exceptions.h"
 #include "debug.h"
@@ -101,6 +102,39 @@ int compare_slab_assign(const void* a, const void* b)
   return value != 0 ? value : ((gal_to_slab_t*)a)->index - ((gal_to_slab_t*)b)->index;
 }
 
+void sort_slab_assign(gal_to_slab_t* map, int n_gals, int n_slabs, int* slab_offsets)
+{
+  // Stable counting sort of a galaxy to slab mapping (built in index order) by slab.  This gives the same order as
+  // qsort with compare_slab_assign in linear time, but isn't in place: the entries are sorted into a temporary buffer
+  // and copied back to map.  The galaxies of slab i_r are then map[slab_offsets[i_r]] to
+  // map[slab_offsets[i_r + 1] - 1], so slab_offsets must hold n_slabs + 1 values.
+  for (int i_r = 0; i_r <= n_slabs; i_r++)
+    slab_offsets[i_r] = 0;
+
+  for (int i_gal = 0; i_gal < n_gals; i_gal++) {
+    assert((map[i_gal].slab_ind >= 0) && (map[i_gal].slab_ind < n_slabs));
+    slab_offsets[map[i_gal].slab_ind + 1]++;
+  }
+
+  for (int i_r = 0; i_r < n_slabs; i_r++)
+    slab_offsets[i_r + 1] += slab_offsets[i_r];
+
+  if (n_gals == 0)
+    return;
+
+  gal_to_slab_t* sorted = malloc(sizeof(gal_to_slab_t) * n_gals);
+  int* next = malloc(sizeof(int) * n_slabs);
+  memcpy(next, slab_offsets, sizeof(int) * n_slabs);
+
+  for (int i_gal = 0; i_gal < n_gals; i_gal++)
+    sorted[next[map[i_gal].slab_ind]++] = map[i_gal];
+
+  memcpy(map, sorted, sizeof(gal_to_slab_t) * n_gals);
+
+  free(next);
+  free(sorted);
+}
+
 static inline float apply_pbc_disp(float delta)
 {
   float box_size = (float)(run_globals.params.BoxSize);
@@ -237,6 +271,15 @@ int grid_index_smoothedSFR(int radii, int i, int j, int k, int filter_steps, int
   return ind;
 }
 
+int grid_index_smoothedSFR_blocked(int radii, int i, int j, int k, int filter_steps, int dim)
+{
+  // Tiles of SMOOTHED_SFR_BLOCK_CELLS consecutive cells, each holding every radius with the cells innermost
+  int cell = k + dim * (j + dim * i);
+
+  return (cell / SMOOTHED_SFR_BLOCK_CELLS) * SMOOTHED_SFR_BLOCK_CELLS * filter_steps +
+         radii * SMOOTHED_SFR_BLOCK_CELLS + cell % SMOOTHED_SFR_BLOCK_CELLS;
+}
+
 /// Numpy style isclose()
 int isclosef(float a,
              float b,
@@ -321,6 +364,18 @@ double trapz_table(double* y, double* x, int nPts, double a, double b)
   return sum;
 }
 
+uint64_t fnv1a_hash(const void* data, size_t len)
+{
+  // 64-bit FNV-1a hash (used to name cache files)
+  uint64_t hash = 14695981039346656037ULL;
+  const unsigned char* c = (const unsigned char*)data;
+  for (size_t ii = 0; ii < len; ii++) {
+    hash ^= (uint64_t)c[ii];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
 bool check_for_flag(int flag, int tree_flags)
 {
   if ((tree_flags & flag) == flag)
@@ -2,6 +2,7 @@
 #define MISC_TOOLS_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 typedef enum index_type
@@ -11,6 +12,11 @@ typedef enum index_type
   INDEX_COMPLEX_HERM,
 } index_type;
 
+//! Number of cells in each tile of the cell-blocked SMOOTHED_SFR histories (see grid_index_smoothedSFR_blocked)
+#define SMOOTHED_SFR_BLOCK_CELLS 16
+
+struct gal_to_slab_t;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -23,6 +29,7 @@ extern "C"
   int compare_ptrdiff(const void* a, const void* b);
   int compare_int_long(const void* a, const void* b);
   int compare_slab_assign(const void* a, const void* b);
+  void sort_slab_assign(struct gal_to_slab_t* map, int n_gals, int n_slabs, int* slab_offsets);
   float apply_pbc_pos(float x);
   int searchsorted(void* val,
                    void* arr,
@@ -37,12 +44,14 @@ extern "C"
   int grid_index(int i, int j, int k, int dim, index_type type);
 
   int grid_index_smoothedSFR(int radii, int i, int j, int k, int filter_steps, int dim);
+  int grid_index_smoothedSFR_blocked(int radii, int i, int j, int k, int filter_steps, int dim);
   int grid_index_LC(int i, int j, int k, int dim, int dim_LC);
 
   int isclosef(float a, float b, float rel_tol, float abs_tol);
   int find_original_index(int index, int* lookup, int n_mappings);
   double interp(double xp, double* x, double* y, int nPts);
   double trapz_table(double* y, double* x, int nPts, double a, double b);
+  uint64_t fnv1a_hash(const void* data, size_t len);
   bool check_for_flag(int flag, int tree_flags);
 
 #ifdef __cplusplus
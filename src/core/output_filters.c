@@ -0,0 +1,205 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "meraxes.h"
+#include "output_filters.h"
+
+static output_filter_t output_filters[N_OUTPUT_DATASET_CLASSES];
+
+static int parse_int_arg(const char* token, const char* arg, int min, int max, int* val)
+{
+  char* end = NULL;
+  long parsed = strtol(arg, &end, 10);
+
+  if ((end == arg) || (*end != '\0') || (parsed < min) || (parsed > max)) {
+    mlog_error("Invalid output filter `%s`: expected an integer in [%d, %d].", token, min, max);
+    return -1;
+  }
+
+  *val = (int)parsed;
+  return 0;
+}
+
+int parse_output_filter(const char* filter_str, const char* chunks_str, output_filter_t* filter)
+{
+  /*
+   * Parse a filter pipeline such as `shuffle, deflate:4` and a chunk shape
+   * such as `1, 0, 0` into `filter`.  Recognised filters are:
+   *
+   *   none             no filters (the default)
+   *   shuffle          byte shuffle
+   *   deflate[:level]  gzip compression (level 0-9, default 6)
+   *   scaleoffset:N    lossy scale-offset of floats, keeping N decimal digits
+   *                    (lossless minimum-bits packing of integers)
+   *   bitround:N       round floats to N mantissa bits before writing (1-23)
+   *
+   * A chunk extent of 0 (or a missing trailing extent) means the full extent
+   * of the dataset along that axis.  Returns 0 on success.
+   */
+
+  char sep[] = ", ";
+  char parse_string[STRLEN];
+  char* context = NULL;
+
+  filter->shuffle = false;
+  filter->deflate = 0;
+  filter->scaleoffset = -1;
+  filter->bitround = -1;
+  filter->chunk_rank = 0;
+  for (int ii = 0; ii < 3; ii++)
+    filter->chunks[ii] = 0;
+
+  snprintf(parse_string, STRLEN, "%s", filter_str);
+  for (char* p = strtok_r(parse_string, sep, &context); p != NULL; p = strtok_r(NULL, sep, &context)) {
+    char* arg = strchr(p, ':');
+    if (arg != NULL)
+      *(arg++) = '\0';
+
+    if (strcmp(p, "none") == 0)
+      continue;
+    else if (strcmp(p, "shuffle") == 0)
+      filter->shuffle = true;
+    else if (strcmp(p, "deflate") == 0) {
+      filter->deflate = 6;
+      if ((arg != NULL) && (parse_int_arg(p, arg, 0, 9, &(filter->deflate)) != 0))
+        return -1;
+    } else if ((strcmp(p, "scaleoffset") == 0) && (arg != NULL)) {
+      if (parse_int_arg(p, arg, 0, 16, &(filter->scaleoffset)) != 0)
+        return -1;
+    } else if ((strcmp(p, "bitround") == 0) && (arg != NULL)) {
+      if (parse_int_arg(p, arg, 1, 23, &(filter->bitround)) != 0)
+        return -1;
+    } else {
+      mlog_error("Unrecognised output filter `%s` in `%s`.", p, filter_str);
+      return -1;
+    }
+  }
+
+  snprintf(parse_string, STRLEN, "%s", chunks_str);
+  for (char* p = strtok_r(parse_string, sep, &context); p != NULL; p = strtok_r(NULL, sep, &context)) {
+    char* end = NULL;
+    long long extent = strtoll(p, &end, 10);
+
+    if ((filter->chunk_rank == 3) || (end == p) || (*end != '\0') || (extent < 0)) {
+      mlog_error("Invalid output chunk shape `%s`: expected up to 3 non-negative integers.", chunks_str);
+      return -1;
+    }
+    filter->chunks[filter->chunk_rank++] = (hsize_t)extent;
+  }
+
+  return 0;
+}
+
+void init_output_filters()
+{
+  const char* filter_strs[N_OUTPUT_DATASET_CLASSES] = { run_globals.params.GridsInputFilter,
+                                                        run_globals.params.GridsOutputFilter,
+                                                        run_globals.params.WalkIndicesFilter };
+  const char* chunks_strs[N_OUTPUT_DATASET_CLASSES] = { run_globals.params.GridsInputChunks,
+                                                        run_globals.params.GridsOutputChunks,
+                                                        run_globals.params.WalkIndicesChunks };
+
+  for (int ii = 0; ii < N_OUTPUT_DATASET_CLASSES; ii++) {
+    output_filter_t* filter = &(output_filters[ii]);
+
+    if (parse_output_filter(filter_strs[ii], chunks_strs[ii], filter) != 0)
+      ABORT(EXIT_FAILURE);
+
+    if ((filter->deflate > 0) && !H5Zfilter_avail(H5Z_FILTER_DEFLATE)) {
+      mlog_error("Output filter `%s` requested but the deflate filter is not available in this HDF5 build.",
+                 filter_strs[ii]);
+      ABORT(EXIT_FAILURE);
+    }
+  }
+}
+
+const output_filter_t* get_output_filter(output_dataset_class dataset_class)
+{
+  return &(output_filters[dataset_class]);
+}
+
+hid_t create_output_dcpl(const output_filter_t* filter, int rank, const hsize_t* dims, hid_t dtype_id)
+{
+  /*
+   * Create a dataset creation property list applying `filter` to a dataset of
+   * shape `dims`.  Chunk extents are clipped to the dataset shape.  Empty
+   * datasets can't be chunked and are left contiguous.
+   */
+
+  hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+  hsize_t chunks[3];
+
+  assert(rank <= 3);
+
+  for (int ii = 0; ii < rank; ii++) {
+    if (dims[ii] == 0)
+      return dcpl_id;
+    chunks[ii] = dims[ii];
+    if ((ii < filter->chunk_rank) && (filter->chunks[ii] > 0) && (filter->chunks[ii] < dims[ii]))
+      chunks[ii] = filter->chunks[ii];
+  }
+  H5Pset_chunk(dcpl_id, rank, chunks);
+
+  if (filter->scaleoffset >= 0) {
+    if (H5Tget_class(dtype_id) == H5T_FLOAT)
+      H5Pset_scaleoffset(dcpl_id, H5Z_SO_FLOAT_DSCALE, filter->scaleoffset);
+    else
+      H5Pset_scaleoffset(dcpl_id, H5Z_SO_INT, H5Z_SO_INT_MINBITS_DEFAULT);
+  }
+  if (filter->shuffle)
+    H5Pset_shuffle(dcpl_id);
+  if (filter->deflate > 0)
+    H5Pset_deflate(dcpl_id, (unsigned)filter->deflate);
+
+  return dcpl_id;
+}
+
+void apply_output_bitround(const output_filter_t* filter, float* data, size_t n)
+{
+  /*
+   * Round `data` in place to nearest, keeping `filter->bitround` mantissa
+   * bits.  The discarded bits are zeroed so that they compress well.
+   */
+
+  if ((filter->bitround < 0) || (filter->bitround >= 23))
+    return;
+
+  const int drop = 23 - filter->bitround;
+  const uint32_t half = (uint32_t)1 << (drop - 1);
+  const uint32_t mask = ~(((uint32_t)1 << drop) - 1);
+
+  for (size_t ii = 0; ii < n; ii++) {
+    uint32_t bits;
+    memcpy(&bits, &(data[ii]), sizeof(bits));
+
+    // leave inf and nan alone
+    if ((bits & 0x7f800000u) == 0x7f800000u)
+      continue;
+
+    bits = (bits + half) & mask;
+    memcpy(&(data[ii]), &bits, sizeof(bits));
+  }
+}
+
+void output_filter_str(const output_filter_t* filter, char* str, size_t len)
+{
+  int n = 0;
+
+  str[0] = '\0';
+  if (filter->bitround >= 0)
+    n += snprintf(str + n, len - n, "bitround:%d,", filter->bitround);
+  if ((filter->scaleoffset >= 0) && ((size_t)n < len))
+    n += snprintf(str + n, len - n, "scaleoffset:%d,", filter->scaleoffset);
+  if (filter->shuffle && ((size_t)n < len))
+    n += snprintf(str + n, len - n, "shuffle,");
+  if ((filter->deflate > 0) && ((size_t)n < len))
+    n += snprintf(str + n, len - n, "deflate:%d,", filter->deflate);
+
+  if (n == 0)
+    snprintf(str, len, "none");
+  else if ((size_t)n <= len)
+    str[n - 1] = '\0';
+}
@@ -0,0 +1,44 @@
+#ifndef OUTPUT_FILTERS_H
+#define OUTPUT_FILTERS_H
+
+#include <hdf5.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//! Classes of output dataset which can be given their own filters and chunk shapes
+typedef enum output_dataset_class
+{
+  OUTPUT_GRIDS_INPUT,   //!< tocf input grids (`save_reion_input_grids`, `save_metal_input_grids`)
+  OUTPUT_GRIDS_OUTPUT,  //!< tocf output grids (`save_reion_output_grids`)
+  OUTPUT_WALK_INDICES,  //!< galaxy walk indices (`save_walk_indices`)
+  N_OUTPUT_DATASET_CLASSES
+} output_dataset_class;
+
+//! Filter pipeline and chunk shape parsed from a `<Class>Filter` and `<Class>Chunks` parameter pair
+typedef struct output_filter_t
+{
+  bool shuffle;
+  int deflate;          //!< deflate level (0 => off)
+  int scaleoffset;      //!< decimal digits kept by the (lossy) scale-offset filter for floats (-1 => off)
+  int bitround;         //!< mantissa bits kept when rounding floats before writing (-1 => off)
+  int chunk_rank;       //!< number of entries in `chunks`
+  hsize_t chunks[3];    //!< chunk extent along each axis (0 => full extent)
+} output_filter_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  int parse_output_filter(const char* filter_str, const char* chunks_str, output_filter_t* filter);
+  void init_output_filters(void);
+  const output_filter_t* get_output_filter(output_dataset_class dataset_class);
+  hid_t create_output_dcpl(const output_filter_t* filter, int rank, const hsize_t* dims, hid_t dtype_id);
+  void apply_output_bitround(const output_filter_t* filter, float* data, size_t n);
+  void output_filter_str(const output_filter_t* filter, char* str, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
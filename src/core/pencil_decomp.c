@@ -0,0 +1,376 @@
+#include <complex.h>
+#include <fftw3-mpi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "meraxes.h"
+#include "pencil_decomp.h"
+#include "reionization.h"
+
+/*
+ * 2D pencil decomposition of the reionization grids.  The inverse transform
+ * of a (filtered) k-space pencil is done as three passes of serial 1D FFTs
+ * (x, y, then the c2r along z), with an all-to-all within each process
+ * column between the first two and within each process row between the
+ * last two.  Each all-to-all therefore only involves sqrt(n_ranks) ranks.
+ */
+
+static void split_blocks(int n, int n_blocks, int* start, int* count)
+{
+  for (int ii = 0; ii < n_blocks; ii++) {
+    count[ii] = n / n_blocks + (ii < n % n_blocks ? 1 : 0);
+    start[ii] = ii * (n / n_blocks) + (ii < n % n_blocks ? ii : n % n_blocks);
+  }
+}
+
+static int overlap(int a_start, int a_count, int b_start, int b_count, int* start)
+{
+  int lo = a_start > b_start ? a_start : b_start;
+  int hi = (a_start + a_count) < (b_start + b_count) ? (a_start + a_count) : (b_start + b_count);
+  *start = lo;
+  return hi > lo ? hi - lo : 0;
+}
+
+static void exchange(pencil_decomp_t* pd, MPI_Comm comm, int n_ranks)
+{
+  pd->send_displs[0] = 0;
+  pd->recv_displs[0] = 0;
+  for (int ii = 1; ii < n_ranks; ii++) {
+    pd->send_displs[ii] = pd->send_displs[ii - 1] + pd->send_counts[ii - 1];
+    pd->recv_displs[ii] = pd->recv_displs[ii - 1] + pd->recv_counts[ii - 1];
+  }
+
+  MPI_Alltoallv(pd->send_buffer,
+                pd->send_counts,
+                pd->send_displs,
+                MPI_FLOAT,
+                pd->recv_buffer,
+                pd->recv_counts,
+                pd->recv_displs,
+                MPI_FLOAT,
+                comm);
+}
+
+pencil_decomp_t* create_pencil_decomp(int dim, unsigned plan_flags)
+{
+  const int n_ranks = run_globals.mpi_size;
+  const int rank = run_globals.mpi_rank;
+  int dims[2] = { 0, 0 };
+
+  MPI_Dims_create(n_ranks, 2, dims);
+
+  pencil_decomp_t* pd = malloc(sizeof(pencil_decomp_t));
+  pd->dim = dim;
+  pd->n_kz = dim / 2 + 1;
+  pd->p_row = dims[0];
+  pd->p_col = dims[1];
+  pd->row = rank / pd->p_col;
+  pd->col = rank % pd->p_col;
+
+  if ((pd->p_row > dim) || (pd->p_col > pd->n_kz)) {
+    mlog_error("Cannot decompose a %d^3 grid over a %d x %d process grid (need p_row <= %d and p_col <= %d).",
+               dim,
+               pd->p_row,
+               pd->p_col,
+               dim,
+               pd->n_kz);
+    ABORT(EXIT_FAILURE);
+  }
+
+  MPI_Comm_split(run_globals.mpi_comm, pd->row, pd->col, &pd->comm_row);
+  MPI_Comm_split(run_globals.mpi_comm, pd->col, pd->row, &pd->comm_col);
+
+  pd->row_start = malloc(sizeof(int) * pd->p_row);
+  pd->row_count = malloc(sizeof(int) * pd->p_row);
+  pd->col_start = malloc(sizeof(int) * pd->p_col);
+  pd->col_count = malloc(sizeof(int) * pd->p_col);
+  pd->kz_start = malloc(sizeof(int) * pd->p_col);
+  pd->kz_count = malloc(sizeof(int) * pd->p_col);
+  split_blocks(dim, pd->p_row, pd->row_start, pd->row_count);
+  split_blocks(dim, pd->p_col, pd->col_start, pd->col_count);
+  split_blocks(pd->n_kz, pd->p_col, pd->kz_start, pd->kz_count);
+
+  pd->local_nx = pd->row_count[pd->row];
+  pd->local_ny = pd->col_count[pd->col];
+  pd->local_nkz = pd->kz_count[pd->col];
+  pd->n_complex = (ptrdiff_t)pd->local_nx * pd->local_nkz * dim;
+  pd->n_real = (ptrdiff_t)pd->local_nx * pd->local_ny * dim;
+
+  ptrdiff_t n_real_out = (ptrdiff_t)pd->local_nx * pd->local_ny * pd->n_kz;
+  pd->n_alloc = pd->n_complex > n_real_out ? pd->n_complex : n_real_out;
+
+  // The send and receive buffers also have to hold this rank's slab for the (re)distributions
+  ptrdiff_t n_buffer = pd->n_alloc;
+  if (run_globals.reion_grids.slab_n_complex[rank] > n_buffer)
+    n_buffer = run_globals.reion_grids.slab_n_complex[rank];
+
+  pd->work = fftwf_alloc_complex((size_t)pd->n_alloc);
+  pd->send_buffer = fftwf_alloc_real((size_t)n_buffer * 2);
+  pd->recv_buffer = fftwf_alloc_real((size_t)n_buffer * 2);
+  pd->send_counts = malloc(sizeof(int) * n_ranks);
+  pd->send_displs = malloc(sizeof(int) * n_ranks);
+  pd->recv_counts = malloc(sizeof(int) * n_ranks);
+  pd->recv_displs = malloc(sizeof(int) * n_ranks);
+
+  pd->plan_c2c = fftwf_plan_many_dft(
+    1, &dim, pd->local_nx * pd->local_nkz, pd->work, NULL, 1, dim, pd->work, NULL, 1, dim, FFTW_BACKWARD, plan_flags);
+  pd->plan_c2r = fftwf_plan_many_dft_c2r(1,
+                                         &dim,
+                                         pd->local_nx * pd->local_ny,
+                                         pd->work,
+                                         NULL,
+                                         1,
+                                         pd->n_kz,
+                                         (float*)pd->work,
+                                         NULL,
+                                         1,
+                                         2 * pd->n_kz,
+                                         plan_flags);
+
+  mlog("Pencil decomposition: %d x %d ranks, %d x %d x %d cells per rank",
+       MLOG_MESG,
+       pd->p_row,
+       pd->p_col,
+       pd->local_nx,
+       pd->local_ny,
+       dim);
+
+  return pd;
+}
+
+void destroy_pencil_decomp(pencil_decomp_t* pd)
+{
+  if (pd == NULL)
+    return;
+
+  fftwf_destroy_plan(pd->plan_c2r);
+  fftwf_destroy_plan(pd->plan_c2c);
+  free(pd->recv_displs);
+  free(pd->recv_counts);
+  free(pd->send_displs);
+  free(pd->send_counts);
+  fftwf_free(pd->recv_buffer);
+  fftwf_free(pd->send_buffer);
+  fftwf_free(pd->work);
+  free(pd->kz_count);
+  free(pd->kz_start);
+  free(pd->col_count);
+  free(pd->col_start);
+  free(pd->row_count);
+  free(pd->row_start);
+  MPI_Comm_free(&pd->comm_col);
+  MPI_Comm_free(&pd->comm_row);
+  free(pd);
+}
+
+void pencil_scatter_complex(pencil_decomp_t* pd, const fftwf_complex* slab, fftwf_complex* pencil)
+{
+  // Redistribute a slab decomposed k-space grid ([kx][ky][kz], as output by the r2c plans) into k-space pencils
+  const int dim = pd->dim;
+  const int n_kz = pd->n_kz;
+  const int n_ranks = run_globals.mpi_size;
+  const int slab_nix = (int)run_globals.reion_grids.slab_nix[run_globals.mpi_rank];
+  fftwf_complex* send = (fftwf_complex*)pd->send_buffer;
+  const fftwf_complex* recv = (fftwf_complex*)pd->recv_buffer;
+
+  size_t ii = 0;
+  for (int dest = 0; dest < n_ranks; dest++) {
+    const int row = dest / pd->p_col;
+    const int col = dest % pd->p_col;
+    for (int kx = 0; kx < slab_nix; kx++)
+      for (int ky = pd->row_start[row]; ky < pd->row_start[row] + pd->row_count[row]; ky++)
+        for (int kz = pd->kz_start[col]; kz < pd->kz_start[col] + pd->kz_count[col]; kz++)
+          send[ii++] = slab[((size_t)kx * dim + ky) * n_kz + kz];
+    pd->send_counts[dest] = 2 * slab_nix * pd->row_count[row] * pd->kz_count[col];
+  }
+  for (int src = 0; src < n_ranks; src++)
+    pd->recv_counts[src] = 2 * (int)run_globals.reion_grids.slab_nix[src] * pd->local_nx * pd->local_nkz;
+
+  exchange(pd, run_globals.mpi_comm, n_ranks);
+
+  ii = 0;
+  for (int src = 0; src < n_ranks; src++) {
+    const int kx_start = (int)run_globals.reion_grids.slab_ix_start[src];
+    for (int kx = kx_start; kx < kx_start + (int)run_globals.reion_grids.slab_nix[src]; kx++)
+      for (int ky = 0; ky < pd->local_nx; ky++)
+        for (int kz = 0; kz < pd->local_nkz; kz++)
+          pencil[((size_t)ky * pd->local_nkz + kz) * dim + kx] = recv[ii++];
+  }
+}
+
+void pencil_scatter_real(pencil_decomp_t* pd, const float* slab, float* pencil)
+{
+  // Redistribute a slab decomposed, unpadded real grid ([x][y][z]) into unpadded real-space pencils
+  const int dim = pd->dim;
+  const int n_ranks = run_globals.mpi_size;
+  const int slab_ix_start = (int)run_globals.reion_grids.slab_ix_start[run_globals.mpi_rank];
+  const int slab_nix = (int)run_globals.reion_grids.slab_nix[run_globals.mpi_rank];
+  const int pencil_ix_start = pd->row_start[pd->row];
+
+  size_t ii = 0;
+  for (int dest = 0; dest < n_ranks; dest++) {
+    const int row = dest / pd->p_col;
+    const int col = dest % pd->p_col;
+    int ix_start;
+    int nx = overlap(slab_ix_start, slab_nix, pd->row_start[row], pd->row_count[row], &ix_start);
+    for (int ix = ix_start; ix < ix_start + nx; ix++)
+      for (int iy = pd->col_start[col]; iy < pd->col_start[col] + pd->col_count[col]; iy++) {
+        memcpy(pd->send_buffer + ii, slab + ((size_t)(ix - slab_ix_start) * dim + iy) * dim, sizeof(float) * dim);
+        ii += dim;
+      }
+    pd->send_counts[dest] = nx * pd->col_count[col] * dim;
+  }
+  for (int src = 0; src < n_ranks; src++) {
+    int ix_start;
+    int nx = overlap((int)run_globals.reion_grids.slab_ix_start[src],
+                     (int)run_globals.reion_grids.slab_nix[src],
+                     pencil_ix_start,
+                     pd->local_nx,
+                     &ix_start);
+    pd->recv_counts[src] = nx * pd->local_ny * dim;
+  }
+
+  exchange(pd, run_globals.mpi_comm, n_ranks);
+
+  // Each source sends a contiguous run of x planes and all of our y columns, so its block lands contiguously
+  for (int src = 0; src < n_ranks; src++) {
+    if (pd->recv_counts[src] == 0)
+      continue;
+    int ix_start;
+    overlap((int)run_globals.reion_grids.slab_ix_start[src],
+            (int)run_globals.reion_grids.slab_nix[src],
+            pencil_ix_start,
+            pd->local_nx,
+            &ix_start);
+    memcpy(pencil + (size_t)(ix_start - pencil_ix_start) * pd->local_ny * dim,
+           pd->recv_buffer + pd->recv_displs[src],
+           sizeof(float) * pd->recv_counts[src]);
+  }
+}
+
+void pencil_gather_real(pencil_decomp_t* pd, const float* pencil, float* slab)
+{
+  // The inverse of pencil_scatter_real
+  const int dim = pd->dim;
+  const int n_ranks = run_globals.mpi_size;
+  const int slab_ix_start = (int)run_globals.reion_grids.slab_ix_start[run_globals.mpi_rank];
+  const int slab_nix = (int)run_globals.reion_grids.slab_nix[run_globals.mpi_rank];
+  const int pencil_ix_start = pd->row_start[pd->row];
+
+  size_t ii = 0;
+  for (int dest = 0; dest < n_ranks; dest++) {
+    int ix_start;
+    int nx = overlap((int)run_globals.reion_grids.slab_ix_start[dest],
+                     (int)run_globals.reion_grids.slab_nix[dest],
+                     pencil_ix_start,
+                     pd->local_nx,
+                     &ix_start);
+    size_t n = (size_t)nx * pd->local_ny * dim;
+    if (n > 0)
+      memcpy(
+        pd->send_buffer + ii, pencil + (size_t)(ix_start - pencil_ix_start) * pd->local_ny * dim, sizeof(float) * n);
+    ii += n;
+    pd->send_counts[dest] = (int)n;
+  }
+  for (int src = 0; src < n_ranks; src++) {
+    const int row = src / pd->p_col;
+    const int col = src % pd->p_col;
+    int ix_start;
+    int nx = overlap(slab_ix_start, slab_nix, pd->row_start[row], pd->row_count[row], &ix_start);
+    pd->recv_counts[src] = nx * pd->col_count[col] * dim;
+  }
+
+  exchange(pd, run_globals.mpi_comm, n_ranks);
+
+  ii = 0;
+  for (int src = 0; src < n_ranks; src++) {
+    const int row = src / pd->p_col;
+    const int col = src % pd->p_col;
+    int ix_start;
+    int nx = overlap(slab_ix_start, slab_nix, pd->row_start[row], pd->row_count[row], &ix_start);
+    for (int ix = ix_start; ix < ix_start + nx; ix++)
+      for (int iy = pd->col_start[col]; iy < pd->col_start[col] + pd->col_count[col]; iy++) {
+        memcpy(slab + ((size_t)(ix - slab_ix_start) * dim + iy) * dim, pd->recv_buffer + ii, sizeof(float) * dim);
+        ii += dim;
+      }
+  }
+}
+
+void pencil_filter_c2r(pencil_decomp_t* pd,
+                       const fftwf_complex* unfiltered,
+                       fftwf_complex* filtered,
+                       float R,
+                       int filter_type,
+                       bool apply_filter)
+{
+  // Equivalent to `filter` followed by the slab c2r plan, for a k-space pencil from `pencil_scatter_complex`.
+  // `filtered` must hold pd->n_alloc elements (allocated with fftwf_alloc_complex) and receives the padded
+  // real-space pencil.
+  const int dim = pd->dim;
+  const int n_kz = pd->n_kz;
+  const int nx = pd->local_nx;
+  const int ny = pd->local_ny;
+  const int nkz = pd->local_nkz;
+  fftwf_complex* work = pd->work;
+  fftwf_complex* send = (fftwf_complex*)pd->send_buffer;
+  const fftwf_complex* recv = (fftwf_complex*)pd->recv_buffer;
+
+  memcpy(work, unfiltered, sizeof(fftwf_complex) * pd->n_complex);
+  if (apply_filter)
+    filter_pencil(work, pd->row_start[pd->row], nx, pd->kz_start[pd->col], nkz, dim, R, filter_type);
+
+  // x pass: [ky][kz][kx] -> [ky][kz][x]
+  fftwf_execute_dft(pd->plan_c2c, work, work);
+
+  // transpose within the process column: [ky (our rows)][kz][x (all)] -> [x (our rows)][kz][ky (all)]
+  size_t ii = 0;
+  for (int dest = 0; dest < pd->p_row; dest++) {
+    for (int ky = 0; ky < nx; ky++)
+      for (int kz = 0; kz < nkz; kz++) {
+        memcpy(send + ii,
+               work + ((size_t)ky * nkz + kz) * dim + pd->row_start[dest],
+               sizeof(fftwf_complex) * pd->row_count[dest]);
+        ii += pd->row_count[dest];
+      }
+    pd->send_counts[dest] = 2 * nx * nkz * pd->row_count[dest];
+    pd->recv_counts[dest] = 2 * pd->row_count[dest] * nkz * nx;
+  }
+
+  exchange(pd, pd->comm_col, pd->p_row);
+
+  ii = 0;
+  for (int src = 0; src < pd->p_row; src++)
+    for (int ky = pd->row_start[src]; ky < pd->row_start[src] + pd->row_count[src]; ky++)
+      for (int kz = 0; kz < nkz; kz++)
+        for (int ix = 0; ix < nx; ix++)
+          work[((size_t)ix * nkz + kz) * dim + ky] = recv[ii++];
+
+  // y pass: [x][kz][ky] -> [x][kz][y]
+  fftwf_execute_dft(pd->plan_c2c, work, work);
+
+  // transpose within the process row: [x][kz (our cols)][y (all)] -> [x][y (our cols)][kz (all)]
+  ii = 0;
+  for (int dest = 0; dest < pd->p_col; dest++) {
+    for (int ix = 0; ix < nx; ix++)
+      for (int kz = 0; kz < nkz; kz++) {
+        memcpy(send + ii,
+               work + ((size_t)ix * nkz + kz) * dim + pd->col_start[dest],
+               sizeof(fftwf_complex) * pd->col_count[dest]);
+        ii += pd->col_count[dest];
+      }
+    pd->send_counts[dest] = 2 * nx * nkz * pd->col_count[dest];
+    pd->recv_counts[dest] = 2 * nx * pd->kz_count[dest] * ny;
+  }
+
+  exchange(pd, pd->comm_row, pd->p_col);
+
+  ii = 0;
+  for (int src = 0; src < pd->p_col; src++)
+    for (int ix = 0; ix < nx; ix++)
+      for (int kz = pd->kz_start[src]; kz < pd->kz_start[src] + pd->kz_count[src]; kz++)
+        for (int iy = 0; iy < ny; iy++)
+          filtered[((size_t)ix * ny + iy) * n_kz + kz] = recv[ii++];
+
+  // z pass: [x][y][kz] -> [x][y][z (padded to 2 * n_kz)]
+  fftwf_execute_dft_c2r(pd->plan_c2r, filtered, (float*)filtered);
+}
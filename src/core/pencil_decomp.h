@@ -0,0 +1,83 @@
+#ifndef PENCIL_DECOMP_H
+#define PENCIL_DECOMP_H
+
+#include <fftw3-mpi.h>
+#include <mpi.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A 2D (p_row x p_col) process grid over all ranks for the filtering and
+ * inverse FFTs of the reionization grids.  The slab decomposition used
+ * everywhere else gives work to at most ReionGridDim ranks; here each rank
+ * holds a pencil of roughly dim^3 / n_ranks cells however many ranks there
+ * are, as long as p_row <= dim and p_col <= dim/2+1.  Only the radius loop of
+ * find_HII_bubbles uses it: the galaxy to slab mapping, the forward FFTs and
+ * the other grids are still slab decomposed.
+ *
+ * Rank `row * p_col + col` holds (all layouts are row major, last index fastest):
+ *  - k-space input:   [ky in row block][kz in kz block][kx]            (see `pencil_scatter_complex`)
+ *  - after x pass:    [x in row block][kz in kz block][ky]
+ *  - real-space out:  [x in row block][y in col block][z, padded]      (as for the slab c2r transforms)
+ *  - real cells:      [x in row block][y in col block][z]              (see `pencil_scatter_real`)
+ */
+typedef struct pencil_decomp_t
+{
+  int dim;
+  int n_kz; //!< dim/2+1
+  int p_row;
+  int p_col;
+  int row;
+  int col;
+
+  MPI_Comm comm_row; //!< ranks with the same row (size p_col)
+  MPI_Comm comm_col; //!< ranks with the same col (size p_row)
+
+  int* row_start; //!< split of x (and ky) over the p_row rows
+  int* row_count;
+  int* col_start; //!< split of y over the p_col columns
+  int* col_count;
+  int* kz_start; //!< split of kz over the p_col columns
+  int* kz_count;
+
+  int local_nx; //!< x (and ky) planes held by this rank
+  int local_ny; //!< y columns held by this rank
+  int local_nkz;
+  ptrdiff_t n_complex; //!< elements of a k-space pencil
+  ptrdiff_t n_real;    //!< unpadded real cells of a real-space pencil
+  ptrdiff_t n_alloc;   //!< complex elements to allocate for each filtered (and work) pencil
+
+  fftwf_complex* work;
+  float* send_buffer;
+  float* recv_buffer;
+  int* send_counts;
+  int* send_displs;
+  int* recv_counts;
+  int* recv_displs;
+
+  fftwf_plan plan_c2c; //!< c2c along x and then along y (both passes have the same shape), in place on `work`
+  fftwf_plan plan_c2r; //!< c2r along z, in place
+} pencil_decomp_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  pencil_decomp_t* create_pencil_decomp(int dim, unsigned plan_flags);
+  void destroy_pencil_decomp(pencil_decomp_t* pd);
+  void pencil_scatter_complex(pencil_decomp_t* pd, const fftwf_complex* slab, fftwf_complex* pencil);
+  void pencil_scatter_real(pencil_decomp_t* pd, const float* slab, float* pencil);
+  void pencil_gather_real(pencil_decomp_t* pd, const float* pencil, float* slab);
+  void pencil_filter_c2r(pencil_decomp_t* pd,
+                         const fftwf_complex* unfiltered,
+                         fftwf_complex* filtered,
+                         float R,
+                         int filter_type,
+                         bool apply_filter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
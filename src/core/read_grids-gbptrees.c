@@ -95,21 +95,6 @@ int read_grid__gbptrees(const enum grid_prop property, const int snapshot, float
   if ((params->FlagInteractive || params->FlagMCMC) && !load_cached_slab(slab, snapshot, property))
     return 0;
 
-  if ((property == X_VELOCITY) || (property == Y_VELOCITY) || (property == Z_VELOCITY)) {
-
-    if (run_globals.params.TsVelocityComponent < 1 || run_globals.params.TsVelocityComponent > 3) {
-      mlog("Not a valid velocity direction: x=1, y=2, z=3", MLOG_MESG);
-      ABORT(EXIT_FAILURE);
-    }
-
-    if (run_globals.params.Flag_ConstructLightcone && run_globals.params.TsVelocityComponent != 3) {
-      mlog("Light-cone is generated along the z-direction, therefore the velocity component should be in the "
-           "z-direction (i.e 3).",
-           MLOG_MESG);
-      ABORT(EXIT_FAILURE);
-    }
-  }
-
   char fname[512];
   int n_cell[3];
   double box_size[3];
@@ -1,6 +1,10 @@
 #include <assert.h>
 #include <complex.h>
 #include <fftw3-mpi.h>
+#include <hdf5_hl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "meraxes.h"
 #include "misc_tools.h"
@@ -15,8 +19,39 @@
 
 void read_grid(const enum grid_prop property, const int snapshot, float* slab)
 {
+  run_params_t* params = &(run_globals.params);
+  bool use_disk_cache = (params->GridCacheDir[0] != '\0');
+
+  // Validate the requested velocity component before any cached grid is used
+  if ((property == X_VELOCITY) || (property == Y_VELOCITY) || (property == Z_VELOCITY)) {
+
+    if (params->TsVelocityComponent < 1 || params->TsVelocityComponent > 3) {
+      mlog("Not a valid velocity direction: 1 - x, 2 - y, 3 - z", MLOG_MESG);
+      ABORT(EXIT_FAILURE);
+    }
+
+    if (params->Flag_ConstructLightcone && params->TsVelocityComponent != 3) {
+      mlog("Light-cone is generated along the z-direction, therefore the velocity component should be in the "
+           "z-direction (i.e 3).",
+           MLOG_MESG);
+      ABORT(EXIT_FAILURE);
+    }
+  }
+
+  // Have we already smoothed and subsampled this grid in a previous run?
+  if (use_disk_cache) {
+    if ((params->FlagInteractive || params->FlagMCMC) && !load_cached_slab(slab, snapshot, property))
+      return;
+
+    if (!load_disk_cached_slab(slab, snapshot, property)) {
+      if (params->FlagInteractive || params->FlagMCMC)
+        cache_slab(slab, snapshot, property);
+      return;
+    }
+  }
+
   // Read in the dark matter density grid
-  switch (run_globals.params.TreesID) {
+  switch (params->TreesID) {
     case VELOCIRAPTOR_TREES:
       read_grid__velociraptor(property, snapshot, slab);
       break;
@@ -27,6 +62,9 @@ void read_grid(const enum grid_prop property, const int snapshot, float* slab)
       mlog_error("Unrecognised input trees identifier (TreesID).");
       break;
   }
+
+  if (use_disk_cache)
+    disk_cache_slab(slab, snapshot, property);
 }
 
 double calc_resample_factor(int n_cell[3])
@@ -354,3 +392,310 @@ void free_grids_cache()
     free(snapshot_deltax);
   }
 }
+
+// Bump this whenever the processing applied to the input grids changes, so
+// that stale disk cache entries are ignored.
+#define GRID_CACHE_VERSION 1
+
+static const char* grid_prop_name(const enum grid_prop property)
+{
+  switch (property) {
+    case DENSITY:
+      return "deltax";
+    case X_VELOCITY:
+      return "vx";
+    case Y_VELOCITY:
+      return "vy";
+    case Z_VELOCITY:
+      return "vz";
+    default:
+      return "unknown";
+  }
+}
+
+static void grid_part_fname(const enum grid_prop property, const int snapshot, const int i_part, char* fname)
+{
+  // N.B. This mirrors the naming of the multi-file VELOCIraptor grids in read_vr_multi.
+  sprintf(fname,
+          "%s/grids/snapshot_%03d.%s.%d",
+          run_globals.params.SimulationDir,
+          snapshot,
+          property == DENSITY ? "den" : "vel",
+          i_part);
+}
+
+static bool grid_source_fname(const enum grid_prop property, const int snapshot, char* fname)
+{
+  /*
+   * Find the file the grid is read from.  Returns true if the grid is split
+   * over multiple part files, in which case fname is the first of them.
+   */
+
+  // N.B. This mirrors the file naming conventions of the read_grid__* functions.
+  run_params_t* params = &(run_globals.params);
+  char dirname[STRLEN - 64];
+  struct stat filestatus;
+
+  sprintf(dirname, "%s/grids/resampled/N%d", params->SimulationDir, params->ReionGridDim);
+  bool resampled = (stat(dirname, &filestatus) == 0);
+  if (!resampled)
+    sprintf(dirname, "%s/grids", params->SimulationDir);
+
+  if (params->TreesID == GBPTREES_TREES) {
+    sprintf(fname, "%s/snapshot_%03d_dark_grid.dat", dirname, snapshot);
+    return false;
+  }
+
+  sprintf(fname, "%s/snap_%04d.hdf5", dirname, snapshot);
+  if (access(fname, F_OK) == -1) {
+    grid_part_fname(property, snapshot, 0, fname);
+    return true;
+  }
+
+  return false;
+}
+
+static uint64_t stamp_source_file(const char* fname, uint64_t stamp)
+{
+  // Fold the size and modification time of a source file into a running hash
+  struct stat filestatus;
+  long long file_stamp[3] = { (long long)stamp, -1, -1 };
+
+  if (stat(fname, &filestatus) == 0) {
+    file_stamp[1] = (long long)filestatus.st_size;
+    file_stamp[2] = (long long)filestatus.st_mtime;
+  }
+
+  return fnv1a_hash(file_stamp, sizeof(file_stamp));
+}
+
+static void grid_cache_key(const enum grid_prop property, const int snapshot, char* key, char* fname)
+{
+  /*
+   * Construct the key describing everything that goes into a processed grid
+   * (source files, smoothing and subsampling, and the normalisation applied to
+   * the density) and the cache file name, which includes a hash of the key.
+   * The key is built on rank 0 and broadcast so that all ranks agree even if
+   * the file system is slow to become consistent.
+   */
+
+  run_params_t* params = &(run_globals.params);
+
+  if (run_globals.mpi_rank == 0) {
+    char source[STRLEN];
+    int n_parts = 1;
+    uint64_t source_stamp = 0;
+
+    // The stamp covers the size and mtime of every part of a multi-file grid,
+    // so that rewriting any one of them invalidates the cache entry
+    if (grid_source_fname(property, snapshot, source)) {
+      char part[STRLEN];
+      struct stat filestatus;
+
+      for (n_parts = 0;; n_parts++) {
+        grid_part_fname(property, snapshot, n_parts, part);
+        if (stat(part, &filestatus) != 0)
+          break;
+        source_stamp = stamp_source_file(part, source_stamp);
+      }
+    } else
+      source_stamp = stamp_source_file(source, source_stamp);
+
+    snprintf(key,
+             GRID_CACHE_KEY_LEN,
+             "version=%d;trees=%d;source=%s;n_parts=%d;stamp=%016llx;snapshot=%d;property=%s;dim=%d;box_size=%.17g;"
+             "hubble_h=%.17g;npart=%lld;part_mass=%.17g;smoothing=real_tophat_half_cell",
+             GRID_CACHE_VERSION,
+             params->TreesID,
+             source,
+             n_parts,
+             (unsigned long long)source_stamp,
+             snapshot,
+             grid_prop_name(property),
+             params->ReionGridDim,
+             params->BoxSize,
+             params->Hubble_h,
+             params->NPart,
+             params->PartMass);
+
+    snprintf(fname,
+             STRLEN,
+             "%s/grid_%s_snap%03d_N%d_%016llx.hdf5",
+             params->GridCacheDir,
+             grid_prop_name(property),
+             snapshot,
+             params->ReionGridDim,
+             (unsigned long long)fnv1a_hash(key, strlen(key)));
+  }
+
+  MPI_Bcast(key, GRID_CACHE_KEY_LEN, MPI_CHAR, 0, run_globals.mpi_comm);
+  MPI_Bcast(fname, STRLEN, MPI_CHAR, 0, run_globals.mpi_comm);
+}
+
+int load_disk_cached_slab(float* slab, int snapshot, const enum grid_prop property)
+{
+  /*
+   * Read a smoothed and subsampled grid written by `disk_cache_slab` in a
+   * previous run.  Each rank reads its own x-planes, so the cache does not
+   * depend on the number of ranks it was written with.  Returns 0 on success.
+   */
+
+  char key[GRID_CACHE_KEY_LEN];
+  char fname[STRLEN];
+  int valid = 0;
+
+  grid_cache_key(property, snapshot, key, fname);
+
+  if (run_globals.mpi_rank == 0 && access(fname, F_OK) != -1) {
+    hid_t file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file_id >= 0) {
+      char stored_key[GRID_CACHE_KEY_LEN] = { '\0' };
+      hsize_t dims[1] = { 0 };
+      H5T_class_t type_class;
+      size_t type_size = 0;
+
+      // Guard against hash collisions and truncated keys before reading the attribute
+      if ((H5LTget_attribute_info(file_id, "/", "key", dims, &type_class, &type_size) >= 0) &&
+          (type_size < GRID_CACHE_KEY_LEN) && (H5LTget_attribute_string(file_id, "/", "key", stored_key) >= 0))
+        valid = (strcmp(stored_key, key) == 0);
+      H5Fclose(file_id);
+    }
+  }
+  MPI_Bcast(&valid, 1, MPI_INT, 0, run_globals.mpi_comm);
+
+  if (!valid)
+    return 1;
+
+  int ReionGridDim = run_globals.params.ReionGridDim;
+  ptrdiff_t slab_nix = run_globals.reion_grids.slab_nix[run_globals.mpi_rank];
+  ptrdiff_t slab_ix_start = run_globals.reion_grids.slab_ix_start[run_globals.mpi_rank];
+
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, run_globals.mpi_comm, MPI_INFO_NULL);
+  hid_t file_id = H5Fopen(fname, H5F_ACC_RDONLY, plist_id);
+  H5Pclose(plist_id);
+
+  hid_t dset_id = H5Dopen(file_id, "grid", H5P_DEFAULT);
+  hid_t fspace_id = H5Dget_space(dset_id);
+  H5Sselect_hyperslab(fspace_id,
+                      H5S_SELECT_SET,
+                      (hsize_t[3]){ (hsize_t)slab_ix_start, 0, 0 },
+                      NULL,
+                      (hsize_t[3]){ (hsize_t)slab_nix, (hsize_t)ReionGridDim, (hsize_t)ReionGridDim },
+                      NULL);
+  hid_t memspace_id = H5Screate_simple(1, (hsize_t[1]){ (hsize_t)(slab_nix * ReionGridDim * ReionGridDim) }, NULL);
+
+  plist_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
+
+  // The Fletcher32 checksum of each chunk is verified on read
+  herr_t status = H5Dread(dset_id, H5T_NATIVE_FLOAT, memspace_id, fspace_id, plist_id, slab);
+
+  H5Pclose(plist_id);
+  H5Sclose(memspace_id);
+  H5Sclose(fspace_id);
+  H5Dclose(dset_id);
+  H5Fclose(file_id);
+
+  int failed = (status < 0);
+  MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, run_globals.mpi_comm);
+  if (failed) {
+    mlog("Failed to read cached grid %s (checksum mismatch?) - ignoring cache.", MLOG_MESG, fname);
+    return 1;
+  }
+
+  // reorder the read slab for inplace fftw padding
+  for (int ii = (int)(slab_nix - 1); ii >= 0; ii--)
+    for (int jj = ReionGridDim - 1; jj >= 0; jj--)
+      for (int kk = ReionGridDim - 1; kk >= 0; kk--)
+        slab[grid_index(ii, jj, kk, ReionGridDim, INDEX_PADDED)] =
+          slab[grid_index(ii, jj, kk, ReionGridDim, INDEX_REAL)];
+
+  mlog("Loaded %s grid for snapshot %d from %s", MLOG_MESG, grid_prop_name(property), snapshot, fname);
+  return 0;
+}
+
+void disk_cache_slab(float* slab, int snapshot, const enum grid_prop property)
+{
+  /*
+   * Write a smoothed and subsampled grid to GridCacheDir for use by later
+   * runs.  The file is written under a temporary name and renamed once
+   * complete so that concurrent runs never see a partial file.
+   */
+
+  char key[GRID_CACHE_KEY_LEN];
+  char fname[STRLEN];
+  char tmp_fname[STRLEN + 32];
+  int ReionGridDim = run_globals.params.ReionGridDim;
+  ptrdiff_t slab_nix = run_globals.reion_grids.slab_nix[run_globals.mpi_rank];
+  ptrdiff_t slab_ix_start = run_globals.reion_grids.slab_ix_start[run_globals.mpi_rank];
+
+  grid_cache_key(property, snapshot, key, fname);
+
+  if (run_globals.mpi_rank == 0) {
+    struct stat filestatus;
+    if (stat(run_globals.params.GridCacheDir, &filestatus) != 0)
+      mkdir(run_globals.params.GridCacheDir, 02755);
+    snprintf(tmp_fname, STRLEN + 32, "%s.tmp%d", fname, (int)getpid());
+  }
+  MPI_Bcast(tmp_fname, STRLEN + 32, MPI_CHAR, 0, run_globals.mpi_comm);
+
+  float* grid = malloc(sizeof(float) * (size_t)(slab_nix * ReionGridDim * ReionGridDim));
+  for (int ii = 0; ii < slab_nix; ii++)
+    for (int jj = 0; jj < ReionGridDim; jj++)
+      for (int kk = 0; kk < ReionGridDim; kk++)
+        grid[grid_index(ii, jj, kk, ReionGridDim, INDEX_REAL)] =
+          slab[grid_index(ii, jj, kk, ReionGridDim, INDEX_PADDED)];
+
+  hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+  H5Pset_fapl_mpio(plist_id, run_globals.mpi_comm, MPI_INFO_NULL);
+  hid_t file_id = H5Fcreate(tmp_fname, H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
+  H5Pclose(plist_id);
+
+  if (file_id < 0) {
+    mlog("Failed to create grid cache file %s - not caching.", MLOG_MESG, tmp_fname);
+    free(grid);
+    return;
+  }
+
+  hsize_t dims[3] = { (hsize_t)ReionGridDim, (hsize_t)ReionGridDim, (hsize_t)ReionGridDim };
+  hid_t fspace_id = H5Screate_simple(3, dims, NULL);
+  H5Sselect_hyperslab(fspace_id,
+                      H5S_SELECT_SET,
+                      (hsize_t[3]){ (hsize_t)slab_ix_start, 0, 0 },
+                      NULL,
+                      (hsize_t[3]){ (hsize_t)slab_nix, (hsize_t)ReionGridDim, (hsize_t)ReionGridDim },
+                      NULL);
+  hid_t memspace_id = H5Screate_simple(1, (hsize_t[1]){ (hsize_t)(slab_nix * ReionGridDim * ReionGridDim) }, NULL);
+
+  hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+  H5Pset_chunk(dcpl_id, 3, (hsize_t[3]){ 1, (hsize_t)ReionGridDim, (hsize_t)ReionGridDim });
+  H5Pset_fletcher32(dcpl_id);
+
+  hid_t dset_id = H5Dcreate(file_id, "grid", H5T_NATIVE_FLOAT, fspace_id, H5P_DEFAULT, dcpl_id, H5P_DEFAULT);
+
+  plist_id = H5Pcreate(H5P_DATASET_XFER);
+  H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
+  herr_t status = H5Dwrite(dset_id, H5T_NATIVE_FLOAT, memspace_id, fspace_id, plist_id, grid);
+
+  H5Pclose(plist_id);
+  H5Dclose(dset_id);
+  H5Pclose(dcpl_id);
+  H5Sclose(memspace_id);
+  H5Sclose(fspace_id);
+
+  H5LTset_attribute_string(file_id, "/", "key", key);
+  H5Fclose(file_id);
+  free(grid);
+
+  int failed = (status < 0);
+  MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_LOR, run_globals.mpi_comm);
+
+  if (run_globals.mpi_rank == 0) {
+    if (failed || (rename(tmp_fname, fname) != 0)) {
+      mlog("Failed to write grid cache file %s - not caching.", MLOG_MESG, fname);
+      remove(tmp_fname);
+    } else
+      mlog("Cached %s grid for snapshot %d in %s", MLOG_MESG, grid_prop_name(property), snapshot, fname);
+  }
+}
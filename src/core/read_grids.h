@@ -3,6 +3,8 @@
 
 #include <fftw3-mpi.h>
 
+#define GRID_CACHE_KEY_LEN 1024
+
 // N.B. Don't change these values!
 enum grid_prop
 {
@@ -36,6 +38,8 @@ extern "C"
   void read_grid(const enum grid_prop property, const int snapshot, float* slab);
   int load_cached_slab(float* slab, int snapshot, const enum grid_prop property);
   int cache_slab(float* slab, int snapshot, const enum grid_prop property);
+  int load_disk_cached_slab(float* slab, int snapshot, const enum grid_prop property);
+  void disk_cache_slab(float* slab, int snapshot, const enum grid_prop property);
   int read_grid__gbptrees(const enum grid_prop property, const int snapshot, float* slab);
   int read_grid__velociraptor(const enum grid_prop property, const int snapshot, float* slab);
   void free_grids_cache(void);
@@ -7,6 +7,7 @@
 #include "misc_tools.h"
 #include "modifiers.h"
 #include "read_halos.h"
+#include "tree_file_cache.h"
 #include "virial_properties.h"
 
 static void halo_catalog_filename(char* simulation_dir,
@@ -247,6 +248,41 @@ static void inline convert_input_virial_props(double* Mvir,
   *Vvir = calculate_Vvir(*Mvir, *Rvir);
 }
 
+//! Memory type for reading the fields of the trees table into a struct of ints (as H5TBread_records would)
+static hid_t create_tree_entry_type(hid_t fd, size_t dst_size, const size_t* dst_offsets, int n_fields)
+{
+  hid_t dset_id = tree_dataset_open(fd, "trees");
+  hid_t file_type_id = H5Dget_type(dset_id);
+  hid_t mem_type_id = H5Tcreate(H5T_COMPOUND, dst_size);
+
+  for (int ii = 0; ii < n_fields; ii++) {
+    char* field_name = H5Tget_member_name(file_type_id, (unsigned)ii);
+    H5Tinsert(mem_type_id, field_name, dst_offsets[ii], H5T_NATIVE_INT);
+    H5free_memory(field_name);
+  }
+
+  H5Tclose(file_type_id);
+  tree_dataset_close(dset_id);
+
+  return mem_type_id;
+}
+
+//! Read a block of records from the trees table (through the cached dataset handle, rather than reopening it)
+static void read_tree_entries(hid_t fd, hid_t mem_type_id, hsize_t start, hsize_t n_records, void* buffer)
+{
+  hid_t dset_id = tree_dataset_open(fd, "trees");
+  hid_t fspace_id = H5Dget_space(dset_id);
+  H5Sselect_hyperslab(fspace_id, H5S_SELECT_SET, &start, NULL, &n_records, NULL);
+  hid_t memspace_id = H5Screate_simple(1, &n_records, NULL);
+
+  herr_t status = H5Dread(dset_id, mem_type_id, memspace_id, fspace_id, H5P_DEFAULT, buffer);
+  assert(status >= 0);
+
+  H5Sclose(memspace_id);
+  H5Sclose(fspace_id);
+  tree_dataset_close(dset_id);
+}
+
 //! Buffered read of hdf5 trees into halo structures
 void read_trees__gbptrees(int snapshot,
                           halo_t* halo,
@@ -286,6 +322,7 @@ void read_trees__gbptrees(int snapshot,
   char simulation_dir[STRLEN];
   char fname[STRLEN + 34];
   hid_t fd = 0;
+  hid_t tree_entry_type = -1;
   catalog_halo_t* catalog_buffer;
   catalog_halo_t* group_buffer;
 
@@ -309,7 +346,7 @@ void read_trees__gbptrees(int snapshot,
   if (run_globals.mpi_rank == 0) {
     // open the tree file
     sprintf(fname, "%s/trees/horizontal_trees_%03d.hdf5", run_globals.params.SimulationDir, snapshot);
-    if ((fd = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT)) < 0) {
+    if ((fd = tree_file_open(fname)) < 0) {
       mlog("Failed to open file %s", MLOG_MESG, fname);
       ABORT(EXIT_FAILURE);
     }
@@ -336,16 +373,9 @@ void read_trees__gbptrees(int snapshot,
                              HOFFSET(tree_entry_t, central_index),
                              HOFFSET(tree_entry_t, forest_id),
                              HOFFSET(tree_entry_t, group_index) };
-  size_t dst_sizes[10] = { sizeof(tree_buffer[0].id),
-                           sizeof(tree_buffer[0].flags),
-                           sizeof(tree_buffer[0].desc_id),
-                           sizeof(tree_buffer[0].tree_id),
-                           sizeof(tree_buffer[0].file_offset),
-                           sizeof(tree_buffer[0].desc_index),
-                           sizeof(tree_buffer[0].n_particle_peak),
-                           sizeof(tree_buffer[0].central_index),
-                           sizeof(tree_buffer[0].forest_id),
-                           sizeof(tree_buffer[0].group_index) };
+
+  if (run_globals.mpi_rank == 0)
+    tree_entry_type = create_tree_entry_type(fd, dst_size, dst_offsets, 10);
 
   // Calculate the maximum group buffer size we require to hold a single
   // buffer worth of subgroups.  This is necessary as subfind can produce
@@ -358,7 +388,7 @@ void read_trees__gbptrees(int snapshot,
       else
         n_to_read = n_halos - n_read;
 
-      H5TBread_records(fd, "trees", (hsize_t)n_read, (hsize_t)n_to_read, dst_size, dst_offsets, dst_sizes, tree_buffer);
+      read_tree_entries(fd, tree_entry_type, (hsize_t)n_read, (hsize_t)n_to_read, tree_buffer);
       n_read += n_to_read;
 
       int tmp_size = tree_buffer[n_to_read - 1].group_index - tree_buffer[0].group_index + 1;
@@ -381,7 +411,7 @@ void read_trees__gbptrees(int snapshot,
 
     // read in a tree_buffer of the trees
     if (run_globals.mpi_rank == 0)
-      H5TBread_records(fd, "trees", (hsize_t)n_read, (hsize_t)n_to_read, dst_size, dst_offsets, dst_sizes, tree_buffer);
+      read_tree_entries(fd, tree_entry_type, (hsize_t)n_read, (hsize_t)n_to_read, tree_buffer);
     MPI_Bcast(tree_buffer, n_to_read * sizeof(tree_entry_t), MPI_BYTE, 0, run_globals.mpi_comm);
 
     first_group_index = tree_buffer[0].group_index;
@@ -522,10 +552,13 @@ void read_trees__gbptrees(int snapshot,
 
   // close the catalogs and trees files
   if (run_globals.mpi_rank == 0) {
-    H5Fclose(fd);
+    H5Tclose(tree_entry_type);
+    tree_file_close(fd);
 
     if (fin_catalogs)
       fclose(fin_catalogs);
+    if (fin_groups)
+      fclose(fin_groups);
   }
 
   // free the buffers
@@ -546,7 +579,7 @@ trees_info_t read_trees_info__gbptrees(int snapshot)
     hid_t fd;
 
     sprintf(fname, "%s/trees/horizontal_trees_%03d.hdf5", run_globals.params.SimulationDir, snapshot);
-    if ((fd = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT)) < 0) {
+    if ((fd = tree_file_open(fname)) < 0) {
       mlog("Failed to open file %s", MLOG_MESG, fname);
       ABORT(EXIT_FAILURE);
     }
@@ -558,7 +591,8 @@ trees_info_t read_trees_info__gbptrees(int snapshot)
     H5LTget_attribute_int(fd, "trees", "n_fof_groups", &(trees_info.n_fof_groups));
     H5LTget_attribute_int(fd, "trees", "n_fof_groups_max", &(trees_info.n_fof_groups_max));
 
-    H5Fclose(fd);
+    // N.B. The file stays open (in the tree file cache) for read_trees__gbptrees
+    tree_file_close(fd);
   }
 
   // broadcast the tree file info
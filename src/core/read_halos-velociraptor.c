@@ -1,12 +1,14 @@
 #include <assert.h>
 #include <hdf5_hl.h>
 #include <math.h>
+#include <string.h>
 
 #include "debug.h"
 #include "meraxes.h"
 #include "misc_tools.h"
 #include "modifiers.h"
 #include "read_halos.h"
+#include "tree_file_cache.h"
 #include "tree_flags.h"
 #include "virial_properties.h"
 
@@ -15,11 +17,11 @@ trees_info_t read_trees_info__velociraptor(const int snapshot)
   trees_info_t trees_info;
 
   if (run_globals.mpi_rank == 0) {
-    // TODO: This could maybe only ever be done once and stored in run_globals.
+    // N.B. The file is kept open between snapshots by the tree file cache
     char fname[STRLEN + 34];
     sprintf(fname, "%s/trees/meraxes_augmented_stats.h5", run_globals.params.SimulationDir);
 
-    hid_t fd = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+    hid_t fd = tree_file_open(fname);
     if (fd < 0) {
       mlog("Failed to open file %s", MLOG_MESG, fname);
       ABORT(EXIT_FAILURE);
@@ -37,7 +39,7 @@ trees_info_t read_trees_info__velociraptor(const int snapshot)
     trees_info.n_fof_groups = buffer[snapshot];
     free(buffer);
 
-    H5Fclose(fd);
+    tree_file_close(fd);
   }
 
   // broadcast the snapshot info
@@ -85,6 +87,99 @@ inline static void convert_input_virial_props(double* Mvir,
     *Vvir = calculate_Vvir(*Mvir, *Rvir);
 }
 
+//! Tree entry struct (the properties of a halo as read from the input trees, in the input units)
+typedef struct tree_entry_t
+{
+  long ForestID;
+  long Head;
+  long Tail;
+  long hostHaloID;
+  double Mass_200crit;
+  double Mass_FOF;
+  double Mass_tot;
+  double R_200crit;
+  double Vmax;
+  double Xc;
+  double Yc;
+  double Zc;
+  double VXc;
+  double VYc;
+  double VZc;
+  double Lx;
+  double Ly;
+  double Lz;
+  unsigned long ID;
+  unsigned long npart;
+} tree_entry_t;
+
+//! An input property, its memory type and the field of tree_entry_t it ends up in (all of which are 8 bytes)
+typedef struct tree_entry_field_t
+{
+  const char* name;
+  size_t offset;
+  hid_t mem_type;
+} tree_entry_field_t;
+
+#define N_TREE_ENTRY_FIELDS 20
+#define TREE_ENTRY_FIELD_SIZE sizeof(long)
+#define TREE_ENTRY_FIELD(name, mem_type) { #name, HOFFSET(tree_entry_t, name), mem_type }
+
+//! Gather entry `ii` of a chunk of `n_entries` entries, read one property (column) at a time, into a tree entry
+static inline void gather_tree_entry(tree_entry_t* tree_entry,
+                                     const char* columns,
+                                     const tree_entry_field_t* fields,
+                                     const int n_entries,
+                                     const int ii)
+{
+  for (int i_field = 0; i_field < N_TREE_ENTRY_FIELDS; i_field++)
+    memcpy((char*)tree_entry + fields[i_field].offset,
+           columns + ((size_t)i_field * n_entries + ii) * TREE_ENTRY_FIELD_SIZE,
+           TREE_ENTRY_FIELD_SIZE);
+}
+
+//! Convert a tree entry from the input units to internal units
+static inline void convert_tree_entry_units(tree_entry_t* tree_entry,
+                                            const double mass_unit_to_internal,
+                                            const double scale_factor)
+{
+  double hubble_h = run_globals.params.Hubble_h;
+
+  tree_entry->Mass_200crit *= hubble_h * mass_unit_to_internal;
+  tree_entry->Mass_FOF *= hubble_h * mass_unit_to_internal;
+  tree_entry->Mass_tot *= hubble_h * mass_unit_to_internal;
+  tree_entry->R_200crit *= hubble_h;
+  tree_entry->Xc *= hubble_h / scale_factor;
+  tree_entry->Yc *= hubble_h / scale_factor;
+  tree_entry->Zc *= hubble_h / scale_factor;
+  tree_entry->VXc /= scale_factor;
+  tree_entry->VYc /= scale_factor;
+  tree_entry->VZc /= scale_factor;
+  tree_entry->Lx *= hubble_h * hubble_h * mass_unit_to_internal;
+  tree_entry->Ly *= hubble_h * hubble_h * mass_unit_to_internal;
+  tree_entry->Lz *= hubble_h * hubble_h * mass_unit_to_internal;
+
+  // TEMPORARY HACK
+  double box_size = run_globals.params.BoxSize;
+  if (tree_entry->Xc < 0.0)
+    tree_entry->Xc = 0.0;
+  if (tree_entry->Xc > box_size)
+    tree_entry->Xc = box_size;
+  if (tree_entry->Yc < 0.0)
+    tree_entry->Yc = 0.0;
+  if (tree_entry->Yc > box_size)
+    tree_entry->Yc = box_size;
+  if (tree_entry->Zc < 0.0)
+    tree_entry->Zc = 0.0;
+  if (tree_entry->Zc > box_size)
+    tree_entry->Zc = box_size;
+
+#ifdef DEBUG
+  assert((tree_entry->Xc <= box_size) && (tree_entry->Xc >= 0.0));
+  assert((tree_entry->Yc <= box_size) && (tree_entry->Yc >= 0.0));
+  assert((tree_entry->Zc <= box_size) && (tree_entry->Zc >= 0.0));
+#endif
+}
+
 void read_trees__velociraptor(int snapshot,
                               halo_t* halos,
                               int* n_halos,
@@ -95,39 +190,37 @@ void read_trees__velociraptor(int snapshot,
   // TODO: For the moment, I'll forgo chunking the read.  This will need to
   // be implemented in future though, as we ramp up the size of the trees
 
-  //! Tree entry struct
-  typedef struct tree_entry_t
-  {
-    long ForestID;
-    long Head;
-    long Tail;
-    long hostHaloID;
-    double Mass_200crit;
-    double Mass_FOF;
-    double Mass_tot;
-    double R_200crit;
-    double Vmax;
-    double Xc;
-    double Yc;
-    double Zc;
-    double VXc;
-    double VYc;
-    double VZc;
-    double Lx;
-    double Ly;
-    double Lz;
-    unsigned long ID;
-    unsigned long npart;
-  } tree_entry_t;
-
-  // simulations...
+  // The properties we need.  Each one is read straight into its own column of a chunk of entries, and only the
+  // entries of the forests we keep are gathered into tree entries and converted.  N.B. ForestID must come first.
+  const tree_entry_field_t fields[N_TREE_ENTRY_FIELDS] = {
+    TREE_ENTRY_FIELD(ForestID, H5T_NATIVE_LONG),
+    TREE_ENTRY_FIELD(Head, H5T_NATIVE_LONG),
+    TREE_ENTRY_FIELD(Tail, H5T_NATIVE_LONG),
+    TREE_ENTRY_FIELD(hostHaloID, H5T_NATIVE_LONG),
+    TREE_ENTRY_FIELD(Mass_200crit, H5T_NATIVE_DOUBLE),
+    TREE_ENTRY_FIELD(Mass_FOF, H5T_NATIVE_DOUBLE),
+    TREE_ENTRY_FIELD(Mass_tot, H5T_NATIVE_DOUBLE),
+    TREE_ENTRY_FIELD(R_200crit, H5T_NATIVE_DOUBLE),
+    TREE_ENTRY_FIELD(Vmax, H5T_NATIVE_DOUBLE),
+    TREE_ENTRY_FIELD(Xc, H5T_NATIVE_DOUBLE),
+    TREE_ENTRY_FIELD(Yc, H5T_NATIVE_DOUBLE),
+    TREE_ENTRY_FIELD(Zc, H5T_NATIVE_DOUBLE),
+    TREE_ENTRY_FIELD(VXc, H5T_NATIVE_DOUBLE),
+    TREE_ENTRY_FIELD(VYc, H5T_NATIVE_DOUBLE),
+    TREE_ENTRY_FIELD(VZc, H5T_NATIVE_DOUBLE),
+    TREE_ENTRY_FIELD(Lx, H5T_NATIVE_DOUBLE),
+    TREE_ENTRY_FIELD(Ly, H5T_NATIVE_DOUBLE),
+    TREE_ENTRY_FIELD(Lz, H5T_NATIVE_DOUBLE),
+    TREE_ENTRY_FIELD(ID, H5T_NATIVE_ULONG),
+    TREE_ENTRY_FIELD(npart, H5T_NATIVE_ULONG),
+  };
+  assert(sizeof(tree_entry_t) == N_TREE_ENTRY_FIELDS * TREE_ENTRY_FIELD_SIZE);
 
   mlog("Reading velociraptor trees for snapshot %d...", MLOG_OPEN, snapshot);
 
   int n_tree_entries = 0;
   hid_t fd = -1;
-  hid_t snap_group = -1;
-  void* property_buffer = NULL;
+  char snap_group_name[9];
   double mass_unit_to_internal = 1.0;
   double scale_factor = -999.;
 
@@ -135,26 +228,22 @@ void read_trees__velociraptor(int snapshot,
   *n_fof_groups = 0;
 
   int buffer_size = 10000; // NOTE: Arbitrary. Should be a multiple of the chunk size of arrays in file ideally?
-  tree_entry_t* tree_entries = malloc(sizeof(tree_entry_t) * buffer_size);
+  char* columns = malloc(sizeof(tree_entry_t) * buffer_size);
 
   if (run_globals.mpi_rank == 0) {
     char fname[STRLEN * 2 + 8];
     sprintf(fname, "%s/trees/%s", run_globals.params.SimulationDir, run_globals.params.CatalogFilePrefix);
 
-    fd = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+    fd = tree_file_open(fname);
     if (fd < 0) {
       mlog("Failed to open file %s", MLOG_MESG, fname);
       ABORT(EXIT_FAILURE);
     }
 
-    char snap_group_name[9];
     sprintf(snap_group_name, "Snap_%03d", snapshot);
-    snap_group = H5Gopen(fd, snap_group_name, H5P_DEFAULT);
 
     H5LTget_attribute_int(fd, snap_group_name, "NHalos", &n_tree_entries);
 
-    property_buffer = malloc(buffer_size * sizeof(long));
-
     // check the units
     H5LTget_attribute_double(fd, "Header/Units", "Mass_unit_to_solarmass", &mass_unit_to_internal);
     mass_unit_to_internal /= 1.0e10;
@@ -162,6 +251,8 @@ void read_trees__velociraptor(int snapshot,
   }
 
   MPI_Bcast(&n_tree_entries, 1, MPI_INT, 0, run_globals.mpi_comm);
+  MPI_Bcast(&mass_unit_to_internal, 1, MPI_DOUBLE, 0, run_globals.mpi_comm);
+  MPI_Bcast(&scale_factor, 1, MPI_DOUBLE, 0, run_globals.mpi_comm);
 
   int n_read = 0;
   int n_to_read = buffer_size > n_tree_entries ? n_tree_entries : buffer_size;
@@ -178,90 +269,34 @@ void read_trees__velociraptor(int snapshot,
       H5Sselect_hyperslab(fspace_id, H5S_SELECT_SET, (hsize_t[1]){ n_read }, NULL, (hsize_t[1]){ n_to_read }, NULL);
       hid_t memspace_id = H5Screate_simple(1, (hsize_t[1]){ n_to_read }, NULL);
 
-#define READ_TREE_ENTRY_PROP(name, type, h5type)                                                                       \
-  {                                                                                                                    \
-    hid_t dset_id = H5Dopen(snap_group, #name, H5P_DEFAULT);                                                           \
-    herr_t status = H5Dread(dset_id, h5type, memspace_id, fspace_id, H5P_DEFAULT, property_buffer);                    \
-    assert(status >= 0);                                                                                               \
-    H5Dclose(dset_id);                                                                                                 \
-    for (int ii = 0; ii < n_to_read; ii++) {                                                                           \
-      tree_entries[ii].name = ((type*)property_buffer)[ii];                                                            \
-    }                                                                                                                  \
-  }
-
       // TODO(trees): Read tail.  If head<->tail then first progenitor line, else it's a merger.  We should populate the
       // new halo and then do a standard merger prescription.
 
-      READ_TREE_ENTRY_PROP(ForestID, long, H5T_NATIVE_LONG);
-      READ_TREE_ENTRY_PROP(Head, long, H5T_NATIVE_LONG);
-      READ_TREE_ENTRY_PROP(Tail, long, H5T_NATIVE_LONG);
-      READ_TREE_ENTRY_PROP(hostHaloID, long, H5T_NATIVE_LONG);
-      READ_TREE_ENTRY_PROP(Mass_200crit, double, H5T_NATIVE_DOUBLE);
-      READ_TREE_ENTRY_PROP(Mass_FOF, double, H5T_NATIVE_DOUBLE);
-      READ_TREE_ENTRY_PROP(Mass_tot, double, H5T_NATIVE_DOUBLE);
-      READ_TREE_ENTRY_PROP(R_200crit, double, H5T_NATIVE_DOUBLE);
-      READ_TREE_ENTRY_PROP(Vmax, double, H5T_NATIVE_DOUBLE);
-      READ_TREE_ENTRY_PROP(Xc, double, H5T_NATIVE_DOUBLE);
-      READ_TREE_ENTRY_PROP(Yc, double, H5T_NATIVE_DOUBLE);
-      READ_TREE_ENTRY_PROP(Zc, double, H5T_NATIVE_DOUBLE);
-      READ_TREE_ENTRY_PROP(VXc, double, H5T_NATIVE_DOUBLE);
-      READ_TREE_ENTRY_PROP(VYc, double, H5T_NATIVE_DOUBLE);
-      READ_TREE_ENTRY_PROP(VZc, double, H5T_NATIVE_DOUBLE);
-      READ_TREE_ENTRY_PROP(Lx, double, H5T_NATIVE_DOUBLE);
-      READ_TREE_ENTRY_PROP(Ly, double, H5T_NATIVE_DOUBLE);
-      READ_TREE_ENTRY_PROP(Lz, double, H5T_NATIVE_DOUBLE);
-      READ_TREE_ENTRY_PROP(ID, unsigned long, H5T_NATIVE_ULONG);
-      READ_TREE_ENTRY_PROP(npart, unsigned long, H5T_NATIVE_ULONG);
+      // N.B. Reading straight into the fields of an array of tree entries (with a strided memory selection) is
+      // several times slower than this with HDF5 1.10
+      for (int i_field = 0; i_field < N_TREE_ENTRY_FIELDS; i_field++) {
+        char dset_path[32];
+        sprintf(dset_path, "%s/%s", snap_group_name, fields[i_field].name);
+        void* column = columns + (size_t)i_field * n_to_read * TREE_ENTRY_FIELD_SIZE;
+
+        hid_t dset_id = tree_dataset_open(fd, dset_path);
+        herr_t status = H5Dread(dset_id, fields[i_field].mem_type, memspace_id, fspace_id, H5P_DEFAULT, column);
+        assert(status >= 0);
+        tree_dataset_close(dset_id);
+      }
 
       H5Sclose(memspace_id);
       H5Sclose(fspace_id);
-
-      double hubble_h = run_globals.params.Hubble_h;
-      for (int ii = 0; ii < n_to_read; ii++) {
-        tree_entries[ii].Mass_200crit *= hubble_h * mass_unit_to_internal;
-        tree_entries[ii].Mass_FOF *= hubble_h * mass_unit_to_internal;
-        tree_entries[ii].Mass_tot *= hubble_h * mass_unit_to_internal;
-        tree_entries[ii].R_200crit *= hubble_h;
-        tree_entries[ii].Xc *= hubble_h / scale_factor;
-        tree_entries[ii].Yc *= hubble_h / scale_factor;
-        tree_entries[ii].Zc *= hubble_h / scale_factor;
-        tree_entries[ii].VXc /= scale_factor;
-        tree_entries[ii].VYc /= scale_factor;
-        tree_entries[ii].VZc /= scale_factor;
-        tree_entries[ii].Lx *= hubble_h * hubble_h * mass_unit_to_internal;
-        tree_entries[ii].Ly *= hubble_h * hubble_h * mass_unit_to_internal;
-        tree_entries[ii].Lz *= hubble_h * hubble_h * mass_unit_to_internal;
-
-        // TEMPORARY HACK
-        double box_size = run_globals.params.BoxSize;
-        if (tree_entries[ii].Xc < 0.0)
-          tree_entries[ii].Xc = 0.0;
-        if (tree_entries[ii].Xc > box_size)
-          tree_entries[ii].Xc = box_size;
-        if (tree_entries[ii].Yc < 0.0)
-          tree_entries[ii].Yc = 0.0;
-        if (tree_entries[ii].Yc > box_size)
-          tree_entries[ii].Yc = box_size;
-        if (tree_entries[ii].Zc < 0.0)
-          tree_entries[ii].Zc = 0.0;
-        if (tree_entries[ii].Zc > box_size)
-          tree_entries[ii].Zc = box_size;
-
-#ifdef DEBUG
-        assert((tree_entries[ii].Xc <= box_size) && (tree_entries[ii].Xc >= 0.0));
-        assert((tree_entries[ii].Yc <= box_size) && (tree_entries[ii].Yc >= 0.0));
-        assert((tree_entries[ii].Zc <= box_size) && (tree_entries[ii].Zc >= 0.0));
-#endif
-      }
     }
 
     size_t _nbytes = sizeof(tree_entry_t) * n_to_read;
-    MPI_Bcast(tree_entries, (int)_nbytes, MPI_BYTE, 0, run_globals.mpi_comm);
+    MPI_Bcast(columns, (int)_nbytes, MPI_BYTE, 0, run_globals.mpi_comm);
 
+    const long* forest_ids = (const long*)columns;
     for (int ii = 0; ii < n_to_read; ++ii) {
       bool keep_this_halo = true;
 
-      if ((run_globals.RequestedForestId != NULL) && (bsearch(&(tree_entries[ii].ForestID),
+      if ((run_globals.RequestedForestId != NULL) && (bsearch(&(forest_ids[ii]),
                                                               run_globals.RequestedForestId,
                                                               (size_t)run_globals.NRequestedForests,
                                                               sizeof(long),
@@ -269,7 +304,9 @@ void read_trees__velociraptor(int snapshot,
         keep_this_halo = false;
 
       if (keep_this_halo) {
-        tree_entry_t tree_entry = tree_entries[ii];
+        tree_entry_t tree_entry;
+        gather_tree_entry(&tree_entry, columns, fields, n_to_read, ii);
+        convert_tree_entry_units(&tree_entry, mass_unit_to_internal, scale_factor);
         halo_t* halo = &(halos[*n_halos]);
 
         halo->ID = tree_entry.ID;
@@ -387,12 +424,10 @@ void read_trees__velociraptor(int snapshot,
     n_read += n_to_read;
   }
 
-  free(tree_entries);
+  free(columns);
 
   if (run_globals.mpi_rank == 0) {
-    free(property_buffer);
-    H5Gclose(snap_group);
-    H5Fclose(fd);
+    tree_file_close(fd);
   }
 
   mlog("...done", MLOG_CLOSE);
@@ -6,6 +6,7 @@
 #include "misc_tools.h"
 #include "modifiers.h"
 #include "read_halos.h"
+#include "tree_file_cache.h"
 
 inline static void update_pointers_from_offsets(int n_fof_groups_kept,
                                                 fof_group_t* fof_group,
@@ -595,4 +596,6 @@ void free_halo_storage()
   free(snapshot_fof_group);
   free(snapshot_index_lookup);
   free(snapshot_trees_info);
+
+  close_tree_file_cache();
 }
\ No newline at end of file
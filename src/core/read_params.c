@@ -254,11 +254,35 @@ void read_parameter_file(char* fname, int mode)
       required_tag[n_param] = 1;
       params_type[n_param++] = PARAM_TYPE_STRING;
 
+      strncpy(params_tag[n_param], "TreesMaxOpenFiles", tag_length);
+      params_addr[n_param] = &(run_params->TreesMaxOpenFiles);
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_INT;
+      run_params->TreesMaxOpenFiles = 4;
+
+      strncpy(params_tag[n_param], "TreesChunkCacheMB", tag_length);
+      params_addr[n_param] = &(run_params->TreesChunkCacheMB);
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_INT;
+      run_params->TreesChunkCacheMB = 16;
+
+      strncpy(params_tag[n_param], "TreesMetadataCacheMB", tag_length);
+      params_addr[n_param] = &(run_params->TreesMetadataCacheMB);
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_INT;
+      run_params->TreesMetadataCacheMB = 8;
+
       strncpy(params_tag[n_param], "NSteps", tag_length);
       params_addr[n_param] = &(run_params->NSteps);
       required_tag[n_param] = 1;
       params_type[n_param++] = PARAM_TYPE_INT;
 
+      strncpy(params_tag[n_param], "SkipQuiescentFOFGroups", tag_length);
+      params_addr[n_param] = &(run_params->SkipQuiescentFOFGroups);
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_INT;
+      run_params->SkipQuiescentFOFGroups = 1;
+
       strncpy(params_tag[n_param], "BoxSize", tag_length);
       params_addr[n_param] = &(run_params->BoxSize);
       required_tag[n_param] = 1;
@@ -406,6 +430,72 @@ void read_parameter_file(char* fname, int mode)
       params_type[n_param++] = PARAM_TYPE_INT;
       run_params->FlagIgnoreProgIndex = 0;
 
+      strncpy(params_tag[n_param], "GalaxyOutputLayout", tag_length);
+      params_addr[n_param] = &(run_params->GalaxyOutputLayout);
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_INT;
+      run_params->GalaxyOutputLayout = GALAXY_OUTPUT_TABLE;
+
+      strncpy(params_tag[n_param], "GalaxyOutputProps", tag_length);
+      params_addr[n_param] = &(run_params->GalaxyOutputProps);
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_STRING;
+      *(run_params->GalaxyOutputProps) = '\0';
+
+      strncpy(params_tag[n_param], "GalaxyOutputDeflate", tag_length);
+      params_addr[n_param] = &(run_params->GalaxyOutputDeflate);
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_INT;
+      run_params->GalaxyOutputDeflate = 0;
+
+      strncpy(params_tag[n_param], "GridsInputFilter", tag_length);
+      params_addr[n_param] = run_params->GridsInputFilter;
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_STRING;
+      sprintf(run_params->GridsInputFilter, "none");
+
+      strncpy(params_tag[n_param], "GridsInputChunks", tag_length);
+      params_addr[n_param] = run_params->GridsInputChunks;
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_STRING;
+      sprintf(run_params->GridsInputChunks, "1, 0, 0");
+
+      strncpy(params_tag[n_param], "GridsOutputFilter", tag_length);
+      params_addr[n_param] = run_params->GridsOutputFilter;
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_STRING;
+      sprintf(run_params->GridsOutputFilter, "none");
+
+      strncpy(params_tag[n_param], "GridsOutputChunks", tag_length);
+      params_addr[n_param] = run_params->GridsOutputChunks;
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_STRING;
+      sprintf(run_params->GridsOutputChunks, "1, 0, 0");
+
+      strncpy(params_tag[n_param], "WalkIndicesFilter", tag_length);
+      params_addr[n_param] = run_params->WalkIndicesFilter;
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_STRING;
+      sprintf(run_params->WalkIndicesFilter, "deflate:6");
+
+      strncpy(params_tag[n_param], "WalkIndicesChunks", tag_length);
+      params_addr[n_param] = run_params->WalkIndicesChunks;
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_STRING;
+      sprintf(run_params->WalkIndicesChunks, "1000");
+
+      strncpy(params_tag[n_param], "GridCacheDir", tag_length);
+      params_addr[n_param] = run_params->GridCacheDir;
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_STRING;
+      *(run_params->GridCacheDir) = '\0';
+
+      strncpy(params_tag[n_param], "StellarFeedbackCacheDir", tag_length);
+      params_addr[n_param] = run_params->StellarFeedbackCacheDir;
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_STRING;
+      *(run_params->StellarFeedbackCacheDir) = '\0';
+
       // Physics params
 
       strncpy(params_tag[n_param], "EscapeFracDependency", tag_length);
@@ -869,6 +959,18 @@ void read_parameter_file(char* fname, int mode)
       required_tag[n_param] = 1;
       params_type[n_param++] = PARAM_TYPE_INT;
 
+      strncpy(params_tag[n_param], "TsNumThreads", tag_length);
+      params_addr[n_param] = &(run_params->TsNumThreads);
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_INT;
+      run_params->TsNumThreads = 1;
+
+      strncpy(params_tag[n_param], "TsCompactSFRHistory", tag_length);
+      params_addr[n_param] = &(run_params->TsCompactSFRHistory);
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_INT;
+      run_params->TsCompactSFRHistory = 0;
+
       strncpy(params_tag[n_param], "Flag_ComputePS", tag_length);
       params_addr[n_param] = &(run_params->Flag_ComputePS);
       required_tag[n_param] = 1;
@@ -923,6 +1025,12 @@ void read_parameter_file(char* fname, int mode)
 #endif
       params_type[n_param++] = PARAM_TYPE_INT;
 
+      strncpy(params_tag[n_param], "MetalFusedGrids", tag_length);
+      params_addr[n_param] = &(run_params->MetalFusedGrids);
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_INT;
+      run_params->MetalFusedGrids = 0;
+
       strncpy(params_tag[n_param], "ReionRBubbleMin", tag_length);
       params_addr[n_param] = &(run_params->physics).ReionRBubbleMin;
       required_tag[n_param] = 1;
@@ -943,6 +1051,30 @@ void read_parameter_file(char* fname, int mode)
       required_tag[n_param] = 1;
       params_type[n_param++] = PARAM_TYPE_DOUBLE;
 
+      strncpy(params_tag[n_param], "ReionAdaptiveRTol", tag_length);
+      params_addr[n_param] = &(run_params->ReionAdaptiveRTol);
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_DOUBLE;
+      run_params->ReionAdaptiveRTol = 0.0;
+
+      strncpy(params_tag[n_param], "ReionActiveCellLists", tag_length);
+      params_addr[n_param] = &(run_params->ReionActiveCellLists);
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_INT;
+      run_params->ReionActiveCellLists = 1;
+
+      strncpy(params_tag[n_param], "ReionBatchedFFTs", tag_length);
+      params_addr[n_param] = &(run_params->ReionBatchedFFTs);
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_INT;
+      run_params->ReionBatchedFFTs = 0;
+
+      strncpy(params_tag[n_param], "ReionPencilDecomposition", tag_length);
+      params_addr[n_param] = &(run_params->ReionPencilDecomposition);
+      required_tag[n_param] = 0;
+      params_type[n_param++] = PARAM_TYPE_INT;
+      run_params->ReionPencilDecomposition = 0;
+
       strncpy(params_tag[n_param], "ReionGammaHaloBias", tag_length);
       params_addr[n_param] = &(run_params->physics).ReionGammaHaloBias;
       required_tag[n_param] = 1;
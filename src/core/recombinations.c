@@ -27,6 +27,8 @@ static double RR_table[RR_Z_NPTS][RR_lnGamma_NPTS], lnGamma_values[RR_lnGamma_NP
 static gsl_interp_accel* RR_acc[RR_Z_NPTS];
 static gsl_spline* RR_spline[RR_Z_NPTS];
 
+double RR_tab[RR_Z_NPTS * RR_TAB_lnGamma_NPTS];
+
 double splined_recombination_rate(double z_eff, double gamma12_bg)
 {
   int z_ct = (int)(z_eff / RR_DEL_Z + 0.5); // round to nearest int
@@ -80,6 +82,12 @@ void init_MHR()
     RR_spline[z_ct] = gsl_spline_alloc(gsl_interp_cspline, RR_lnGamma_NPTS);
     gsl_spline_init(RR_spline[z_ct], lnGamma_values, RR_table[z_ct], RR_lnGamma_NPTS);
 
+    // and the finer, flat table used by tabulated_recombination_rate
+    for (gamma_ct = 0; gamma_ct < RR_TAB_lnGamma_NPTS; gamma_ct++) {
+      double lnGamma = fmin(RR_lnGamma_min + gamma_ct * RR_TAB_DEL_lnGamma, lnGamma_values[RR_lnGamma_NPTS - 1]);
+      RR_tab[z_ct * RR_TAB_lnGamma_NPTS + gamma_ct] = gsl_spline_eval(RR_spline[z_ct], lnGamma, RR_acc[z_ct]);
+    }
+
   } // go to next redshift
 }
 
@@ -11,6 +11,7 @@
 
 #include <gsl/gsl_integration.h>
 #include <gsl/gsl_spline.h>
+#include <math.h>
 
 #include "meraxes.h"
 
@@ -32,11 +33,19 @@
 
 #define RR_DEL_lnGamma (float)(0.1)
 
+// the bilinear (z, ln gamma) table samples the gamma splines this many times more finely than RR_DEL_lnGamma
+#define RR_TAB_lnGamma_SUBSAMPLE (int)(4)
+#define RR_TAB_lnGamma_NPTS (int)((RR_lnGamma_NPTS - 1) * RR_TAB_lnGamma_SUBSAMPLE + 1)
+#define RR_TAB_DEL_lnGamma ((double)RR_DEL_lnGamma / (double)RR_TAB_lnGamma_SUBSAMPLE)
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+  // flat [RR_Z_NPTS][RR_TAB_lnGamma_NPTS] table of recombination rates built by init_MHR
+  extern double RR_tab[RR_Z_NPTS * RR_TAB_lnGamma_NPTS];
+
   double alpha_A(double T);
   double alpha_B(double T); // case B hydrogen recombination coefficient (Spitzer 1978) T in K
   double neutral_fraction(double density,
@@ -67,4 +76,33 @@ extern "C"
 }
 #endif
 
+// Bilinear interpolation of the recombination rate table in (z, ln gamma12), assuming T=1e4 and case B.
+// Unlike splined_recombination_rate this is branch-light and never logs, so that it can be inlined into (and
+// vectorised with) the cell loops.  Out of range redshifts and gamma12 values are silently clamped to the edges of
+// the table, and the rate is zero below RR_lnGamma_min.
+static inline double tabulated_recombination_rate(double z_eff, double gamma12_bg)
+{
+  double lnGamma = log(gamma12_bg);
+  if (!(lnGamma >= RR_lnGamma_min))
+    return 0.0;
+
+  double x = z_eff / (double)RR_DEL_Z;
+  x = x > 0.0 ? x : 0.0;
+  x = x < (double)(RR_Z_NPTS - 1) ? x : (double)(RR_Z_NPTS - 1);
+  int i_z = (int)x;
+  i_z = i_z < RR_Z_NPTS - 2 ? i_z : RR_Z_NPTS - 2;
+  double t_z = x - (double)i_z;
+
+  double y = (lnGamma - RR_lnGamma_min) / RR_TAB_DEL_lnGamma;
+  y = y < (double)(RR_TAB_lnGamma_NPTS - 1) ? y : (double)(RR_TAB_lnGamma_NPTS - 1);
+  int i_g = (int)y;
+  i_g = i_g < RR_TAB_lnGamma_NPTS - 2 ? i_g : RR_TAB_lnGamma_NPTS - 2;
+  double t_g = y - (double)i_g;
+
+  const double* lo = &RR_tab[i_z * RR_TAB_lnGamma_NPTS + i_g];
+  const double* hi = lo + RR_TAB_lnGamma_NPTS;
+
+  return (1.0 - t_z) * ((1.0 - t_g) * lo[0] + t_g * lo[1]) + t_z * ((1.0 - t_g) * hi[0] + t_g * hi[1]);
+}
+
 #endif
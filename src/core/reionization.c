@@ -5,14 +5,17 @@
 #include <hdf5_hl.h>
 #include <math.h>
 #include <string.h>
-#include <sys/stat.h>
 
 #include "ComputeTs.h"
+#include "fftw_wisdom.h"
 #include "find_HII_bubbles.h"
 #include "meraxes.h"
 #include "misc_tools.h"
+#include "output_filters.h"
+#include "pencil_decomp.h"
 #include "read_grids.h"
 #include "reionization.h"
+#include "utils.h"
 #include "virial_properties.h"
 
 void update_galaxy_fesc_vals(galaxy_t* gal, double new_stars, int snapshot)
@@ -341,6 +344,9 @@ void init_reion_grids()
   if (run_globals.params.Flag_IncludeSpinTemp) {
     slab_n_real_smoothedSFR =
       slab_nix[run_globals.mpi_rank] * run_globals.params.TsNumFilterSteps * ReionGridDim * ReionGridDim;
+    if (run_globals.params.TsCompactSFRHistory)
+      slab_n_real_smoothedSFR = (slab_n_real + SMOOTHED_SFR_BLOCK_CELLS - 1) / SMOOTHED_SFR_BLOCK_CELLS *
+                                SMOOTHED_SFR_BLOCK_CELLS * run_globals.params.TsNumFilterSteps;
   }
   ptrdiff_t slab_n_real_LC;
   if (run_globals.params.Flag_ConstructLightcone) {
@@ -411,11 +417,20 @@ void init_reion_grids()
 
   if (run_globals.params.Flag_IncludeSpinTemp) {
 
-    for (int ii = 0; ii < slab_n_real_smoothedSFR; ii++) {
-      grids->SMOOTHED_SFR_GAL[ii] = 0.0;
+    if (run_globals.params.TsCompactSFRHistory) {
+      for (int ii = 0; ii < slab_n_real_smoothedSFR; ii++) {
+        grids->SMOOTHED_SFR_GAL_blocked[ii] = 0.0;
 #if USE_MINI_HALOS
-      grids->SMOOTHED_SFR_III[ii] = 0.0;
+        grids->SMOOTHED_SFR_III_blocked[ii] = 0.0;
 #endif
+      }
+    } else {
+      for (int ii = 0; ii < slab_n_real_smoothedSFR; ii++) {
+        grids->SMOOTHED_SFR_GAL[ii] = 0.0;
+#if USE_MINI_HALOS
+        grids->SMOOTHED_SFR_III[ii] = 0.0;
+#endif
+      }
     }
   }
 
@@ -519,38 +534,7 @@ void malloc_reionization_grids()
   fftwf_mpi_init();
 
   // Load wisdom if requested
-  run_globals.reion_grids.flag_wisdom = strlen(run_globals.params.FFTW3WisdomDir) > 0;
-  bool save_wisdom = false;
-  char wisdom_fname[STRLEN + 32];
-  const int ReionGridDim = run_globals.params.ReionGridDim;
-  unsigned plan_flags = FFTW_ESTIMATE;
-
-  if (run_globals.reion_grids.flag_wisdom) {
-    plan_flags = FFTW_PATIENT;
-    sprintf(wisdom_fname,
-            "%s/fftw3f-meraxes-N_%d-ranks_%d.wisdom",
-            run_globals.params.FFTW3WisdomDir,
-            ReionGridDim,
-            run_globals.mpi_size);
-    if (run_globals.mpi_rank == 0) {
-      if (fftwf_import_wisdom_from_filename(wisdom_fname)) {
-        mlog("Successfully loaded FFTW3 wisdom from %s", MLOG_MESG, wisdom_fname);
-      } else {
-        mlog("FFTW3 wisdom directory provided, but no suitable wisdom exists. New wisdom will be created (this make "
-             "take a while).",
-             MLOG_MESG | MLOG_FLUSH);
-        save_wisdom = true;
-        // Check to see if the wisdom directory exists and if not, create it
-        struct stat filestatus;
-        if (stat(run_globals.params.FFTW3WisdomDir, &filestatus) != 0)
-          mkdir(run_globals.params.FFTW3WisdomDir, 02755);
-      }
-    }
-    MPI_Bcast(&save_wisdom, 1, MPI_C_BOOL, 0, run_globals.mpi_comm);
-    if (!save_wisdom) {
-      fftwf_mpi_broadcast_wisdom(run_globals.mpi_comm);
-    }
-  }
+  unsigned plan_flags = init_fftw_wisdom();
 
   // run_globals.NStoreSnapshots is set in `initialize_halo_storage`
   run_globals.SnapshotDeltax = (float**)calloc((size_t)run_globals.NStoreSnapshots, sizeof(float*));
@@ -598,12 +582,14 @@ void malloc_reionization_grids()
   grids->x_e_filtered = NULL;
 
   grids->SMOOTHED_SFR_GAL = NULL;
+  grids->SMOOTHED_SFR_GAL_blocked = NULL;
 
 #if USE_MINI_HALOS
   grids->Tk_boxII = NULL;
   grids->TS_boxII = NULL;
 
   grids->SMOOTHED_SFR_III = NULL;
+  grids->SMOOTHED_SFR_III_blocked = NULL;
 #endif
 
   // Grids required for inhomogeneous recombinations
@@ -640,6 +626,10 @@ void malloc_reionization_grids()
   grids->PSII_error = NULL;
 #endif
 
+  grids->HII_filter_batch = NULL;
+  grids->Ts_filter_batch = NULL;
+  grids->pencil = NULL;
+
   if (run_globals.params.Flag_PatchyReion) {
     assign_slabs();
 
@@ -652,6 +642,9 @@ void malloc_reionization_grids()
     if (run_globals.params.Flag_IncludeSpinTemp) {
       slab_n_real_smoothedSFR =
         slab_nix[run_globals.mpi_rank] * run_globals.params.TsNumFilterSteps * ReionGridDim * ReionGridDim;
+      if (run_globals.params.TsCompactSFRHistory)
+        slab_n_real_smoothedSFR = (slab_n_real + SMOOTHED_SFR_BLOCK_CELLS - 1) / SMOOTHED_SFR_BLOCK_CELLS *
+                                  SMOOTHED_SFR_BLOCK_CELLS * run_globals.params.TsNumFilterSteps;
     }
 
     ptrdiff_t slab_n_real_LC;
@@ -838,12 +831,18 @@ void malloc_reionization_grids()
       grids->Tk_box = fftwf_alloc_real((size_t)slab_n_real);
       grids->TS_box = fftwf_alloc_real((size_t)slab_n_real);
 
-      grids->SMOOTHED_SFR_GAL = calloc((size_t)slab_n_real_smoothedSFR, sizeof(double));
+      if (run_globals.params.TsCompactSFRHistory)
+        grids->SMOOTHED_SFR_GAL_blocked = calloc((size_t)slab_n_real_smoothedSFR, sizeof(float));
+      else
+        grids->SMOOTHED_SFR_GAL = calloc((size_t)slab_n_real_smoothedSFR, sizeof(double));
 #if USE_MINI_HALOS
       grids->Tk_boxII = fftwf_alloc_real((size_t)slab_n_real);
       grids->TS_boxII = fftwf_alloc_real((size_t)slab_n_real);
 
-      grids->SMOOTHED_SFR_III = calloc((size_t)slab_n_real_smoothedSFR, sizeof(double));
+      if (run_globals.params.TsCompactSFRHistory)
+        grids->SMOOTHED_SFR_III_blocked = calloc((size_t)slab_n_real_smoothedSFR, sizeof(float));
+      else
+        grids->SMOOTHED_SFR_III = calloc((size_t)slab_n_real_smoothedSFR, sizeof(double));
 #endif
     }
 
@@ -926,17 +925,56 @@ void malloc_reionization_grids()
 #endif
     }
 
-    init_reion_grids();
+    // The pencil decomposition takes over the filtering and inverse transforms of find_HII_bubbles (but not
+    // ComputeTs), so there is no need for the HII batch when it is in use.
+    if (run_globals.params.ReionPencilDecomposition)
+      grids->pencil = create_pencil_decomp(ReionGridDim, plan_flags);
+
+    if (run_globals.params.ReionBatchedFFTs) {
+      fftwf_complex* unfiltered[FILTER_BATCH_MAX_FIELDS];
+      fftwf_complex* filtered[FILTER_BATCH_MAX_FIELDS];
+      int n_fields = 0;
+
+      // The order here is irrelevant to the results
+      unfiltered[n_fields] = grids->deltax_unfiltered;
+      filtered[n_fields++] = grids->deltax_filtered;
+      unfiltered[n_fields] = grids->stars_unfiltered;
+      filtered[n_fields++] = grids->stars_filtered;
+      unfiltered[n_fields] = grids->weighted_sfr_unfiltered;
+      filtered[n_fields++] = grids->weighted_sfr_filtered;
+#if USE_MINI_HALOS
+      unfiltered[n_fields] = grids->starsIII_unfiltered;
+      filtered[n_fields++] = grids->starsIII_filtered;
+      unfiltered[n_fields] = grids->weighted_sfrIII_unfiltered;
+      filtered[n_fields++] = grids->weighted_sfrIII_filtered;
+#endif
+      if (run_globals.params.Flag_IncludeRecombinations) {
+        unfiltered[n_fields] = grids->N_rec_unfiltered;
+        filtered[n_fields++] = grids->N_rec_filtered;
+      }
+      if (run_globals.params.Flag_IncludeSpinTemp) {
+        unfiltered[n_fields] = grids->x_e_unfiltered;
+        filtered[n_fields++] = grids->x_e_filtered;
+      }
+      if (grids->pencil == NULL)
+        grids->HII_filter_batch = create_filter_batch(n_fields, unfiltered, filtered, plan_flags);
 
-    if (run_globals.reion_grids.flag_wisdom && save_wisdom) {
-      fftwf_mpi_gather_wisdom(run_globals.mpi_comm);
-      if (run_globals.mpi_rank == 0) {
-        if (fftwf_export_wisdom_to_filename(wisdom_fname)) {
-          mlog("Successfully saved FFTW3 wisdom to %s", MLOG_MESG, wisdom_fname);
-        }
+#if USE_MINI_HALOS
+      // Without mini-halos _ComputeTs only filters a single field
+      if (run_globals.params.Flag_IncludeSpinTemp) {
+        unfiltered[0] = grids->sfr_unfiltered;
+        filtered[0] = grids->sfr_filtered;
+        unfiltered[1] = grids->sfrIII_unfiltered;
+        filtered[1] = grids->sfrIII_filtered;
+        grids->Ts_filter_batch = create_filter_batch(2, unfiltered, filtered, plan_flags);
       }
+#endif
     }
 
+    init_reion_grids();
+
+    finalize_fftw_wisdom();
+
   } // if (run_globals.params.Flag_PatchyReion)
 
   mlog("...done", MLOG_CLOSE);
@@ -948,6 +986,10 @@ void free_reionization_grids()
 
   reion_grids_t* grids = &(run_globals.reion_grids);
 
+  destroy_filter_batch(grids->Ts_filter_batch);
+  destroy_filter_batch(grids->HII_filter_batch);
+  destroy_pencil_decomp(grids->pencil);
+
   free(run_globals.reion_grids.slab_n_complex);
   free(run_globals.reion_grids.slab_ix_start);
   free(run_globals.reion_grids.slab_nix);
@@ -1013,9 +1055,13 @@ void free_reionization_grids()
   }
 
   if (run_globals.params.Flag_IncludeSpinTemp) {
+    free_Ts_tables();
+
     free(grids->SMOOTHED_SFR_GAL);
+    free(grids->SMOOTHED_SFR_GAL_blocked);
 #if USE_MINI_HALOS
     free(grids->SMOOTHED_SFR_III);
+    free(grids->SMOOTHED_SFR_III_blocked);
 #endif
 
     fftwf_free(grids->Tk_box);
@@ -1110,6 +1156,13 @@ int map_galaxies_to_slabs(int ngals)
 
   gal_to_slab_t* galaxy_to_slab_map = run_globals.reion_grids.galaxy_to_slab_map;
   ptrdiff_t* slab_ix_start = run_globals.reion_grids.slab_ix_start;
+  ptrdiff_t* slab_nix = run_globals.reion_grids.slab_nix;
+
+  // The slab holding each x index (empty slabs are only ever at the end, so this is what searchsorted would give)
+  int* ix_to_slab = malloc(sizeof(int) * ReionGridDim);
+  for (int i_r = 0; i_r < run_globals.mpi_size; i_r++)
+    for (ptrdiff_t ix = slab_ix_start[i_r]; ix < slab_ix_start[i_r] + slab_nix[i_r]; ix++)
+      ix_to_slab[ix] = i_r;
 
   galaxy_t* gal = run_globals.FirstGal;
   int gal_counter = 0;
@@ -1131,17 +1184,19 @@ int map_galaxies_to_slabs(int ngals)
       assert((ix >= 0) && (ix < ReionGridDim));
 
       galaxy_to_slab_map[gal_counter].index = gal_counter;
-      galaxy_to_slab_map[gal_counter].slab_ind =
-        searchsorted(&ix, slab_ix_start, run_globals.mpi_size, sizeof(ptrdiff_t), compare_ptrdiff, -1, -1);
+      galaxy_to_slab_map[gal_counter].slab_ind = ix_to_slab[ix];
       galaxy_to_slab_map[gal_counter++].galaxy = gal;
     }
 
     gal = gal->Next;
   }
 
-  // sort the slab indices IN PLACE (n.b. compare_slab_assign is a stable comparison)
-  if (galaxy_to_slab_map != NULL)
-    qsort(galaxy_to_slab_map, (size_t)gal_counter, sizeof(gal_to_slab_t), compare_slab_assign);
+  free(ix_to_slab);
+
+  // bucket the galaxies by slab, via a temporary buffer (in the same order as a qsort with compare_slab_assign)
+  int* slab_gal_offsets = malloc(sizeof(int) * (run_globals.mpi_size + 1));
+  sort_slab_assign(galaxy_to_slab_map, gal_counter, run_globals.mpi_size, slab_gal_offsets);
+  run_globals.reion_grids.slab_gal_offsets = slab_gal_offsets;
 
   assert(gal_counter == ngals);
 
@@ -1181,29 +1236,15 @@ void assign_Mvir_crit_to_galaxies(int ngals_in_slabs, int flag_feed)
 #endif
   }
 
-  // Work out the index of the galaxy_to_slab_map where each slab begins.
-  // TODO: This needs checked...
-  int slab_map_offsets[run_globals.mpi_size];
-  for (int ii = 0, i_gal = 0; ii < run_globals.mpi_size; ii++) {
-    if (galaxy_to_slab_map != NULL) {
-      while ((i_gal < (ngals_in_slabs - 1)) && (galaxy_to_slab_map[i_gal].slab_ind < ii))
-        i_gal++;
-
-      if (galaxy_to_slab_map[i_gal].slab_ind == ii)
-        slab_map_offsets[ii] = i_gal;
-      else
-        slab_map_offsets[ii] = -1;
-    } else
-      // if this core has no galaxies then the offsets are -1 everywhere
-      slab_map_offsets[ii] = -1;
-  }
+  // The galaxies of slab i_r are galaxy_to_slab_map[slab_gal_offsets[i_r]] to [slab_gal_offsets[i_r + 1] - 1]
+  int* slab_gal_offsets = run_globals.reion_grids.slab_gal_offsets;
 
   // DEBUG
   // for (int ii = 0; ii < run_globals.mpi_size; ii++) {
   //     if (run_globals.mpi_rank == ii) {
-  //         mlog("slab_map_offsets[%d] = [ ", MLOG_MESG|MLOG_ALLRANKS, ii);
-  //         for (int jj = 0; jj < run_globals.mpi_size; ++jj)
-  //             printf("%d ", slab_map_offsets[jj]);
+  //         mlog("slab_gal_offsets[%d] = [ ", MLOG_MESG|MLOG_ALLRANKS, ii);
+  //         for (int jj = 0; jj <= run_globals.mpi_size; ++jj)
+  //             printf("%d ", slab_gal_offsets[jj]);
   //         printf("]\n");
   //     }
   //     MPI_Barrier(run_globals.mpi_comm);
@@ -1215,7 +1256,7 @@ void assign_Mvir_crit_to_galaxies(int ngals_in_slabs, int flag_feed)
     int send_to_rank = (run_globals.mpi_rank - i_skip + run_globals.mpi_size) % run_globals.mpi_size;
 
     bool send_flag = false;
-    bool recv_flag = (slab_map_offsets[recv_from_rank] > -1);
+    bool recv_flag = (slab_gal_offsets[recv_from_rank + 1] > slab_gal_offsets[recv_from_rank]);
 
     if (flag_feed == 1) {
 
@@ -1305,9 +1346,9 @@ void assign_Mvir_crit_to_galaxies(int ngals_in_slabs, int flag_feed)
     // if this core has received a slab of Mvir_crit then assign values to the
     // galaxies which belong to this slab
     if (recv_flag) {
-      int i_gal = slab_map_offsets[recv_from_rank];
+      int i_gal = slab_gal_offsets[recv_from_rank];
       int ix_start = (int)slab_ix_start[recv_from_rank];
-      while ((i_gal < ngals_in_slabs) && (galaxy_to_slab_map[i_gal].slab_ind == recv_from_rank)) {
+      while (i_gal < slab_gal_offsets[recv_from_rank + 1]) {
         // TODO: We should use the position of the FOF group here...
         galaxy_t* gal = galaxy_to_slab_map[i_gal].galaxy;
         int ix = pos_to_ngp(gal->Pos[0], box_size, ReionGridDim) - ix_start;
@@ -1354,6 +1395,7 @@ void construct_baryon_grids(int snapshot, int local_ngals)
 #endif
 
   gal_to_slab_t* galaxy_to_slab_map = run_globals.reion_grids.galaxy_to_slab_map;
+  int* slab_gal_offsets = run_globals.reion_grids.slab_gal_offsets;
   ptrdiff_t* slab_ix_start = run_globals.reion_grids.slab_ix_start;
   int local_n_complex = (int)(run_globals.reion_grids.slab_n_complex[run_globals.mpi_rank]);
 
@@ -1408,8 +1450,6 @@ void construct_baryon_grids(int snapshot, int local_ngals)
     if ((!run_globals.params.Flag_IncludeSpinTemp) && (prop == prop_sfr))
       continue;
 
-    int i_gal = 0;
-    int skipped_gals = 0;
     long N_BlackHoleMassLimitReion = 0;
 
     for (int i_r = 0; i_r < run_globals.mpi_size; i_r++) {
@@ -1417,93 +1457,86 @@ void construct_baryon_grids(int snapshot, int local_ngals)
       for (int ii = 0; ii < buffer_size; ii++)
         buffer[ii] = (float)0.;
 
-      // if this core holds no galaxies then we don't need to fill the buffer
-      if (local_ngals != 0)
-        // fill the local buffer for this slab
-        while (((i_gal - skipped_gals) < local_ngals) && (galaxy_to_slab_map[i_gal].slab_ind == i_r)) {
-          galaxy_t* gal = galaxy_to_slab_map[i_gal].galaxy;
-
-          // Dead galaxies should not be included here and are not in the
-          // local_ngals count.  They will, however, have been assigned to a
-          // slab so we will need to ignore them here...
-          if (gal->Type > 2) {
-            i_gal++;
-            skipped_gals++;
-            continue;
-          }
+      // fill the local buffer for this slab
+      for (int i_gal = slab_gal_offsets[i_r]; i_gal < slab_gal_offsets[i_r + 1]; i_gal++) {
+        galaxy_t* gal = galaxy_to_slab_map[i_gal].galaxy;
 
-          assert(galaxy_to_slab_map[i_gal].index >= 0);
-          assert((galaxy_to_slab_map[i_gal].slab_ind >= 0) &&
-                 (galaxy_to_slab_map[i_gal].slab_ind < run_globals.mpi_size));
+        // Dead galaxies should not be included here and are not in the
+        // local_ngals count.  They will, however, have been assigned to a
+        // slab so we will need to ignore them here...
+        if (gal->Type > 2)
+          continue;
 
-          int ix = (int)(pos_to_ngp(gal->Pos[0], box_size, ReionGridDim) - slab_ix_start[i_r]);
-          int iy = pos_to_ngp(gal->Pos[1], box_size, ReionGridDim);
-          int iz = pos_to_ngp(gal->Pos[2], box_size, ReionGridDim);
+        assert(galaxy_to_slab_map[i_gal].index >= 0);
+        assert((galaxy_to_slab_map[i_gal].slab_ind >= 0) &&
+               (galaxy_to_slab_map[i_gal].slab_ind < run_globals.mpi_size));
 
-          assert((ix < slab_nix[i_r]) && (ix >= 0));
-          assert((iy < ReionGridDim) && (iy >= 0));
-          assert((iz < ReionGridDim) && (iz >= 0));
+        int ix = (int)(pos_to_ngp(gal->Pos[0], box_size, ReionGridDim) - slab_ix_start[i_r]);
+        int iy = pos_to_ngp(gal->Pos[1], box_size, ReionGridDim);
+        int iz = pos_to_ngp(gal->Pos[2], box_size, ReionGridDim);
 
-          int ind = grid_index(ix, iy, iz, ReionGridDim, INDEX_REAL);
+        assert((ix < slab_nix[i_r]) && (ix >= 0));
+        assert((iy < ReionGridDim) && (iy >= 0));
+        assert((iz < ReionGridDim) && (iz >= 0));
 
-          assert((ind >= 0) && (ind < slab_nix[i_r] * ReionGridDim * ReionGridDim));
+        int ind = grid_index(ix, iy, iz, ReionGridDim, INDEX_REAL);
 
-          // They are the same just now, but may be different in the future once the model is improved.
-          switch (prop) {
-            case prop_stellar:
+        assert((ind >= 0) && (ind < slab_nix[i_r] * ReionGridDim * ReionGridDim));
 
-              buffer[ind] += gal->FescWeightedGSM; // Only Pop II
-              // a trick to include quasar radiation using current 21cmFAST code
-              if (run_globals.params.physics.Flag_BHFeedback) {
-                if (gal->BlackHoleMass >= run_globals.params.physics.BlackHoleMassLimitReion)
-                  buffer[ind] += gal->EffectiveBHM;
-                else
-                  N_BlackHoleMassLimitReion += 1;
-              }
-              break;
+        // They are the same just now, but may be different in the future once the model is improved.
+        switch (prop) {
+          case prop_stellar:
+
+            buffer[ind] += gal->FescWeightedGSM; // Only Pop II
+            // a trick to include quasar radiation using current 21cmFAST code
+            if (run_globals.params.physics.Flag_BHFeedback) {
+              if (gal->BlackHoleMass >= run_globals.params.physics.BlackHoleMassLimitReion)
+                buffer[ind] += gal->EffectiveBHM;
+              else
+                N_BlackHoleMassLimitReion += 1;
+            }
+            break;
 
 #if USE_MINI_HALOS
-            case prop_stellarIII:
+          case prop_stellarIII:
 
-              buffer[ind] += gal->FescIIIWeightedGSM;
+            buffer[ind] += gal->FescIIIWeightedGSM;
 
-              break;
+            break;
 
-            case prop_weighted_sfrIII:
+          case prop_weighted_sfrIII:
 
-              buffer[ind] += gal->FescIIIWeightedGSM;
+            buffer[ind] += gal->FescIIIWeightedGSM;
 
-              break;
+            break;
 
-            case prop_sfrIII:
+          case prop_sfrIII:
 
-              buffer[ind] += gal->GrossStellarMassIII;
-              // this sfr grid is used for X-ray and Lyman, PopIII.
-              break;
+            buffer[ind] += gal->GrossStellarMassIII;
+            // this sfr grid is used for X-ray and Lyman, PopIII.
+            break;
 #endif
-            case prop_weighted_sfr:
-              buffer[ind] += (gal->FescWeightedGSM);
-              // for ionizing_source_formation_rate_grid, need further convertion due to different UV spectral index of
-              // quasar and stellar component
-              if (run_globals.params.physics.Flag_BHFeedback)
-                if (gal->BlackHoleMass >= run_globals.params.physics.BlackHoleMassLimitReion)
-                  buffer[ind] += gal->EffectiveBHM * run_globals.params.physics.ReionAlphaUVBH /
-                                 run_globals.params.physics.ReionAlphaUV;
-              break;
-
-            case prop_sfr:
-              buffer[ind] += gal->GrossStellarMass;
-              // this sfr grid is used for X-ray and Lyman, PopII.
-              break;
+          case prop_weighted_sfr:
+            buffer[ind] += (gal->FescWeightedGSM);
+            // for ionizing_source_formation_rate_grid, need further convertion due to different UV spectral index of
+            // quasar and stellar component
+            if (run_globals.params.physics.Flag_BHFeedback)
+              if (gal->BlackHoleMass >= run_globals.params.physics.BlackHoleMassLimitReion)
+                buffer[ind] += gal->EffectiveBHM * run_globals.params.physics.ReionAlphaUVBH /
+                               run_globals.params.physics.ReionAlphaUV;
+            break;
 
-            default:
-              mlog_error("Unrecognised property in slab creation.");
-              ABORT(EXIT_FAILURE);
-              break;
-          }
+          case prop_sfr:
+            buffer[ind] += gal->GrossStellarMass;
+            // this sfr grid is used for X-ray and Lyman, PopII.
+            break;
 
-          i_gal++;
+          default:
+            mlog_error("Unrecognised property in slab creation.");
+            ABORT(EXIT_FAILURE);
+            break;
         }
+      }
 
       // reduce on to the correct rank
       if (run_globals.mpi_rank == i_r)
@@ -1594,13 +1627,49 @@ void construct_baryon_grids(int snapshot, int local_ngals)
   mlog("done", MLOG_CLOSE | MLOG_TIMERSTOP);
 }
 
+// Raw and on-disk sizes of the grids written since the last call to log_grid_write_stats()
+static struct
+{
+  double raw_bytes;
+  double stored_bytes;
+} grid_write_stats = { 0.0, 0.0 };
+
+static void log_grid_write_stats(const output_filter_t* filter, timer_info timer)
+{
+  char filter_str[STRLEN];
+  output_filter_str(filter, filter_str, STRLEN);
+
+  double ratio = grid_write_stats.stored_bytes > 0 ? grid_write_stats.raw_bytes / grid_write_stats.stored_bytes : 1.0;
+  mlog("Wrote %.1f MB of grids with filters `%s` (compression ratio = %.2f) in %.2f s",
+       MLOG_MESG,
+       grid_write_stats.raw_bytes / (1024. * 1024.),
+       filter_str,
+       ratio,
+       timer_delta(timer));
+
+  grid_write_stats.raw_bytes = 0.0;
+  grid_write_stats.stored_bytes = 0.0;
+}
+
 static void write_grid_float(const char* name,
                              float* data,
                              hid_t file_id,
                              hid_t fspace_id,
                              hid_t memspace_id,
-                             hid_t dcpl_id)
+                             hid_t dcpl_id,
+                             const output_filter_t* filter)
 {
+  float* rounded = NULL;
+
+  // bit rounding is applied to a copy, as `data` is often a live grid
+  if (filter->bitround >= 0) {
+    size_t n_points = (size_t)H5Sget_select_npoints(memspace_id);
+    rounded = malloc(sizeof(float) * n_points);
+    memcpy(rounded, data, sizeof(float) * n_points);
+    apply_output_bitround(filter, rounded, n_points);
+    data = rounded;
+  }
+
   // create the dataset
   hid_t dset_id = H5Dcreate(file_id, name, H5T_NATIVE_FLOAT, fspace_id, H5P_DEFAULT, dcpl_id, H5P_DEFAULT);
 
@@ -1612,9 +1681,14 @@ static void write_grid_float(const char* name,
   // write the dataset
   H5Dwrite(dset_id, H5T_NATIVE_FLOAT, memspace_id, fspace_id, plist_id, data);
 
+  grid_write_stats.raw_bytes += (double)H5Sget_simple_extent_npoints(fspace_id) * sizeof(float);
+  grid_write_stats.stored_bytes += (double)H5Dget_storage_size(dset_id);
+
   // cleanup
   H5Pclose(plist_id);
   H5Dclose(dset_id);
+  if (rounded != NULL)
+    free(rounded);
 }
 
 void gen_grids_fname(const int snapshot, char* name, const bool relative)
@@ -1635,6 +1709,9 @@ void save_reion_input_grids(int snapshot)
 
   mlog("Saving tocf input grids...", MLOG_OPEN);
 
+  timer_info timer;
+  timer_start(&timer);
+
   char name[STRLEN];
   gen_grids_fname(snapshot, name, false);
 
@@ -1657,9 +1734,9 @@ void save_reion_input_grids(int snapshot)
   hsize_t count[3] = { (hsize_t)local_nix, (hsize_t)ReionGridDim, (hsize_t)ReionGridDim };
   H5Sselect_hyperslab(fspace_id, H5S_SELECT_SET, start, NULL, count, NULL);
 
-  // set the dataset creation property list to use chunking along x-axis
-  hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
-  H5Pset_chunk(dcpl_id, 3, (hsize_t[3]){ 1, (hsize_t)ReionGridDim, (hsize_t)ReionGridDim });
+  // set the dataset creation property list (chunking along the x-axis by default)
+  const output_filter_t* filter = get_output_filter(OUTPUT_GRIDS_INPUT);
+  hid_t dcpl_id = create_output_dcpl(filter, 3, dims, H5T_NATIVE_FLOAT);
 
   // fftw padded grids
   float* grid = (float*)calloc((size_t)local_nix * (size_t)ReionGridDim * (size_t)ReionGridDim, sizeof(float));
@@ -1669,14 +1746,14 @@ void save_reion_input_grids(int snapshot)
       for (int kk = 0; kk < ReionGridDim; kk++)
         grid[grid_index(ii, jj, kk, ReionGridDim, INDEX_REAL)] =
           (grids->deltax)[grid_index(ii, jj, kk, ReionGridDim, INDEX_PADDED)];
-  write_grid_float("deltax", grid, file_id, fspace_id, memspace_id, dcpl_id);
+  write_grid_float("deltax", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
 
   for (int ii = 0; ii < local_nix; ii++)
     for (int jj = 0; jj < ReionGridDim; jj++)
       for (int kk = 0; kk < ReionGridDim; kk++)
         grid[grid_index(ii, jj, kk, ReionGridDim, INDEX_REAL)] =
           (grids->stars)[grid_index(ii, jj, kk, ReionGridDim, INDEX_PADDED)];
-  write_grid_float("stars", grid, file_id, fspace_id, memspace_id, dcpl_id);
+  write_grid_float("stars", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
 
   if (run_globals.params.Flag_IncludeSpinTemp) {
     for (int ii = 0; ii < local_nix; ii++)
@@ -1685,7 +1762,7 @@ void save_reion_input_grids(int snapshot)
           grid[grid_index(ii, jj, kk, ReionGridDim, INDEX_REAL)] =
             (float)((grids->sfr)[grid_index(ii, jj, kk, ReionGridDim, INDEX_PADDED)] * UnitMass_in_g / UnitTime_in_s *
                     SEC_PER_YEAR / SOLAR_MASS);
-    write_grid_float("sfr", grid, file_id, fspace_id, memspace_id, dcpl_id);
+    write_grid_float("sfr", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
   }
 
   for (int ii = 0; ii < local_nix; ii++)
@@ -1694,7 +1771,7 @@ void save_reion_input_grids(int snapshot)
         grid[grid_index(ii, jj, kk, ReionGridDim, INDEX_REAL)] =
           (float)((grids->weighted_sfr)[grid_index(ii, jj, kk, ReionGridDim, INDEX_PADDED)] * UnitMass_in_g /
                   UnitTime_in_s * SEC_PER_YEAR / SOLAR_MASS);
-  write_grid_float("weighted_sfr", grid, file_id, fspace_id, memspace_id, dcpl_id);
+  write_grid_float("weighted_sfr", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
 
 #if USE_MINI_HALOS
   for (int ii = 0; ii < local_nix; ii++)
@@ -1702,7 +1779,7 @@ void save_reion_input_grids(int snapshot)
       for (int kk = 0; kk < ReionGridDim; kk++)
         grid[grid_index(ii, jj, kk, ReionGridDim, INDEX_REAL)] =
           (grids->starsIII)[grid_index(ii, jj, kk, ReionGridDim, INDEX_PADDED)];
-  write_grid_float("starsIII", grid, file_id, fspace_id, memspace_id, dcpl_id);
+  write_grid_float("starsIII", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
 
   if (run_globals.params.Flag_IncludeSpinTemp) {
     for (int ii = 0; ii < local_nix; ii++)
@@ -1711,7 +1788,7 @@ void save_reion_input_grids(int snapshot)
           grid[grid_index(ii, jj, kk, ReionGridDim, INDEX_REAL)] =
             (float)((grids->sfrIII)[grid_index(ii, jj, kk, ReionGridDim, INDEX_PADDED)] * UnitMass_in_g /
                     UnitTime_in_s * SEC_PER_YEAR / SOLAR_MASS);
-    write_grid_float("sfrIII", grid, file_id, fspace_id, memspace_id, dcpl_id);
+    write_grid_float("sfrIII", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
   }
 
   for (int ii = 0; ii < local_nix; ii++)
@@ -1720,7 +1797,7 @@ void save_reion_input_grids(int snapshot)
         grid[grid_index(ii, jj, kk, ReionGridDim, INDEX_REAL)] =
           (float)((grids->weighted_sfrIII)[grid_index(ii, jj, kk, ReionGridDim, INDEX_PADDED)] * UnitMass_in_g /
                   UnitTime_in_s * SEC_PER_YEAR / SOLAR_MASS);
-  write_grid_float("weighted_sfrIII", grid, file_id, fspace_id, memspace_id, dcpl_id);
+  write_grid_float("weighted_sfrIII", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
 #endif
 
   // tidy up
@@ -1730,6 +1807,9 @@ void save_reion_input_grids(int snapshot)
   H5Sclose(fspace_id);
   H5Fclose(file_id);
 
+  timer_stop(&timer);
+  log_grid_write_stats(filter, timer);
+
   mlog("...done", MLOG_CLOSE);
 }
 
@@ -1750,6 +1830,9 @@ void save_reion_output_grids(int snapshot)
 
   mlog("Saving tocf output grids...", MLOG_OPEN);
 
+  timer_info timer;
+  timer_start(&timer);
+
   char name[STRLEN];
   gen_grids_fname(snapshot, name, false);
 
@@ -1772,24 +1855,24 @@ void save_reion_output_grids(int snapshot)
   hsize_t count[3] = { (hsize_t)local_nix, (hsize_t)ReionGridDim, (hsize_t)ReionGridDim };
   H5Sselect_hyperslab(fspace_id, H5S_SELECT_SET, start, NULL, count, NULL);
 
-  // set the dataset creation property list to use chunking along x-axis
-  hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
-  H5Pset_chunk(dcpl_id, 3, (hsize_t[3]){ 1, (hsize_t)ReionGridDim, (hsize_t)ReionGridDim });
+  // set the dataset creation property list (chunking along the x-axis by default)
+  const output_filter_t* filter = get_output_filter(OUTPUT_GRIDS_OUTPUT);
+  hid_t dcpl_id = create_output_dcpl(filter, 3, dims, H5T_NATIVE_FLOAT);
 
   // create and write the datasets
-  write_grid_float("xH", grids->xH, file_id, fspace_id, memspace_id, dcpl_id);
-  write_grid_float("z_at_ionization", grids->z_at_ionization, file_id, fspace_id, memspace_id, dcpl_id);
-  write_grid_float("r_bubble", grids->r_bubble, file_id, fspace_id, memspace_id, dcpl_id);
+  write_grid_float("xH", grids->xH, file_id, fspace_id, memspace_id, dcpl_id, filter);
+  write_grid_float("z_at_ionization", grids->z_at_ionization, file_id, fspace_id, memspace_id, dcpl_id, filter);
+  write_grid_float("r_bubble", grids->r_bubble, file_id, fspace_id, memspace_id, dcpl_id, filter);
 
   if (run_globals.params.ReionUVBFlag) {
-    write_grid_float("J_21", grids->J_21, file_id, fspace_id, memspace_id, dcpl_id);
+    write_grid_float("J_21", grids->J_21, file_id, fspace_id, memspace_id, dcpl_id, filter);
     H5LTset_attribute_double(file_id, "J_21", "volume_weighted_global_J_21", &(grids->volume_weighted_global_J_21), 1);
-    write_grid_float("J_21_at_ionization", grids->J_21_at_ionization, file_id, fspace_id, memspace_id, dcpl_id);
-    write_grid_float("Mvir_crit", grids->Mvir_crit, file_id, fspace_id, memspace_id, dcpl_id);
+    write_grid_float("J_21_at_ionization", grids->J_21_at_ionization, file_id, fspace_id, memspace_id, dcpl_id, filter);
+    write_grid_float("Mvir_crit", grids->Mvir_crit, file_id, fspace_id, memspace_id, dcpl_id, filter);
 
 #if USE_MINI_HALOS
     if (run_globals.params.Flag_IncludeLymanWerner)
-      write_grid_float("Mvir_crit_MC", grids->Mvir_crit_MC, file_id, fspace_id, memspace_id, dcpl_id);
+      write_grid_float("Mvir_crit_MC", grids->Mvir_crit_MC, file_id, fspace_id, memspace_id, dcpl_id, filter);
 #endif
   }
 
@@ -1798,17 +1881,17 @@ void save_reion_output_grids(int snapshot)
 
 #if USE_MINI_HALOS
   if (run_globals.params.Flag_IncludeLymanWerner) {
-    write_grid_float("JLW_box", grids->JLW_box, file_id, fspace_id, memspace_id, dcpl_id);
-    write_grid_float("JLW_boxII", grids->JLW_boxII, file_id, fspace_id, memspace_id, dcpl_id);
+    write_grid_float("JLW_box", grids->JLW_box, file_id, fspace_id, memspace_id, dcpl_id, filter);
+    write_grid_float("JLW_boxII", grids->JLW_boxII, file_id, fspace_id, memspace_id, dcpl_id, filter);
   }
 #endif
 
   if (run_globals.params.Flag_IncludeSpinTemp) {
-    write_grid_float("TS_box", grids->TS_box, file_id, fspace_id, memspace_id, dcpl_id);
-    write_grid_float("Tk_box", grids->Tk_box, file_id, fspace_id, memspace_id, dcpl_id);
+    write_grid_float("TS_box", grids->TS_box, file_id, fspace_id, memspace_id, dcpl_id, filter);
+    write_grid_float("Tk_box", grids->Tk_box, file_id, fspace_id, memspace_id, dcpl_id, filter);
 #if USE_MINI_HALOS
-    write_grid_float("TS_boxII", grids->TS_boxII, file_id, fspace_id, memspace_id, dcpl_id);
-    write_grid_float("Tk_boxII", grids->Tk_boxII, file_id, fspace_id, memspace_id, dcpl_id);
+    write_grid_float("TS_boxII", grids->TS_boxII, file_id, fspace_id, memspace_id, dcpl_id, filter);
+    write_grid_float("Tk_boxII", grids->Tk_boxII, file_id, fspace_id, memspace_id, dcpl_id, filter);
 #endif
 
     for (int ii = 0; ii < local_nix; ii++)
@@ -1817,13 +1900,13 @@ void save_reion_output_grids(int snapshot)
           grid[grid_index(ii, jj, kk, ReionGridDim, INDEX_REAL)] =
             (grids->x_e_box_prev)[grid_index(ii, jj, kk, ReionGridDim, INDEX_PADDED)];
 
-    write_grid_float("x_e_box", grid, file_id, fspace_id, memspace_id, dcpl_id);
+    write_grid_float("x_e_box", grid, file_id, fspace_id, memspace_id, dcpl_id, filter);
   }
 
   if (run_globals.params.Flag_Compute21cmBrightTemp) {
-    write_grid_float("delta_T", grids->delta_T, file_id, fspace_id, memspace_id, dcpl_id);
+    write_grid_float("delta_T", grids->delta_T, file_id, fspace_id, memspace_id, dcpl_id, filter);
 #if USE_MINI_HALOS
-    write_grid_float("delta_TII", grids->delta_TII, file_id, fspace_id, memspace_id, dcpl_id);
+    write_grid_float("delta_TII", grids->delta_TII, file_id, fspace_id, memspace_id, dcpl_id, filter);
 #endif
   }
 
@@ -1844,11 +1927,10 @@ void save_reion_output_grids(int snapshot)
     H5Sselect_hyperslab(fspace_id_LC, H5S_SELECT_SET, start_LC, NULL, count_LC, NULL);
 
     // set the dataset creation property list to use chunking along x-axis
-    hid_t dcpl_id_LC = H5Pcreate(H5P_DATASET_CREATE);
-    H5Pset_chunk(dcpl_id_LC, 3, (hsize_t[3]){ 1, (hsize_t)ReionGridDim, (hsize_t)run_globals.params.LightconeLength });
+    hid_t dcpl_id_LC = create_output_dcpl(filter, 3, dims_LC, H5T_NATIVE_FLOAT);
 
     mlog("Outputting light-cone", MLOG_MESG);
-    write_grid_float("LightconeBox", grids->LightconeBox, file_id, fspace_id_LC, memspace_id_LC, dcpl_id_LC);
+    write_grid_float("LightconeBox", grids->LightconeBox, file_id, fspace_id_LC, memspace_id_LC, dcpl_id_LC, filter);
 
     // create the filespace
     hsize_t dims_LCz[1] = { (hsize_t)run_globals.params.LightconeLength };
@@ -1996,6 +2078,9 @@ void save_reion_output_grids(int snapshot)
   H5Sclose(fspace_id);
   H5Fclose(file_id);
 
+  timer_stop(&timer);
+  log_grid_write_stats(filter, timer);
+
   mlog("...done", MLOG_CLOSE); // Saving tocf grids
 }
 
@@ -2057,12 +2142,52 @@ bool check_if_reionization_ongoing(int snapshot)
     return false;
 }
 
+static void check_filter_type(int filter_type)
+{
+  if ((filter_type < 0) || (filter_type > 2)) {
+    mlog_error("ReionFilterType.c: Warning, ReionFilterType type %d is undefined!", filter_type);
+    ABORT(EXIT_FAILURE);
+  }
+}
+
+static inline float filter_weight(float kR, int filter_type)
+{
+  switch (filter_type) {
+    case 0: // Real space top-hat
+      if (kR > 1e-4)
+        return (float)(3.0 * (sinf(kR) / powf(kR, 3) - cosf(kR) / powf(kR, 2)));
+      return 1.0f;
+
+    case 1:              // k-space top hat
+      kR *= 0.413566994; // Equates integrated volume to the real space top-hat (9pi/2)^(-1/3)
+      return (kR > 1) ? 0.0f : 1.0f;
+
+    default:       // Gaussian
+      kR *= 0.643; // Equates integrated volume to the real space top-hat
+      return powf((float)M_E, (float)(-kR * kR / 2.0));
+  }
+}
+
 void filter(fftwf_complex* box, int local_ix_start, int slab_nx, int grid_dim, float R, int filter_type)
 {
+  filter_interleaved(box, 1, local_ix_start, slab_nx, grid_dim, R, filter_type);
+}
+
+void filter_interleaved(fftwf_complex* box,
+                        int n_fields,
+                        int local_ix_start,
+                        int slab_nx,
+                        int grid_dim,
+                        float R,
+                        int filter_type)
+{
+  // Filter `n_fields` k-space grids stored interleaved (field fastest) in `box`
   int middle = grid_dim / 2;
   float box_size = (float)run_globals.params.BoxSize;
   float delta_k = (float)(2.0 * M_PI / box_size);
 
+  check_filter_type(filter_type);
+
   // Loop through k-box
   for (int n_x = 0; n_x < slab_nx; n_x++) {
     float k_x;
@@ -2086,37 +2211,136 @@ void filter(fftwf_complex* box, int local_ix_start, int slab_nx, int grid_dim, f
 
         float k_mag = sqrtf(k_x * k_x + k_y * k_y + k_z * k_z);
 
-        float kR = k_mag * R; // Real space top-hat
+        float weight = filter_weight(k_mag * R, filter_type);
 
-        switch (filter_type) {
-          case 0: // Real space top-hat
-            if (kR > 1e-4)
-              box[grid_index(n_x, n_y, n_z, grid_dim, INDEX_COMPLEX_HERM)] *=
-                (fftwf_complex)(3.0 * (sinf(kR) / powf(kR, 3) - cosf(kR) / powf(kR, 2)));
-            break;
+        fftwf_complex* cell = box + (size_t)grid_index(n_x, n_y, n_z, grid_dim, INDEX_COMPLEX_HERM) * n_fields;
+        for (int ii = 0; ii < n_fields; ii++)
+          cell[ii] *= weight;
+      }
+    }
+  } // End looping through k box
+}
 
-          case 1:              // k-space top hat
-            kR *= 0.413566994; // Equates integrated volume to the real space top-hat (9pi/2)^(-1/3)
-            if (kR > 1)
-              box[grid_index(n_x, n_y, n_z, grid_dim, INDEX_COMPLEX_HERM)] = (fftwf_complex)0.0;
-            break;
+void filter_pencil(fftwf_complex* box,
+                   int ky_start,
+                   int n_ky,
+                   int kz_start,
+                   int n_kz,
+                   int grid_dim,
+                   float R,
+                   int filter_type)
+{
+  // As `filter`, but for a k-space pencil stored as [ky][kz][kx] (see pencil_decomp.h)
+  int middle = grid_dim / 2;
+  float box_size = (float)run_globals.params.BoxSize;
+  float delta_k = (float)(2.0 * M_PI / box_size);
 
-          case 2:        // Gaussian
-            kR *= 0.643; // Equates integrated volume to the real space top-hat
-            box[grid_index(n_x, n_y, n_z, grid_dim, INDEX_COMPLEX_HERM)] *=
-              (fftwf_complex)(powf((float)M_E, (float)(-kR * kR / 2.0)));
-            break;
+  check_filter_type(filter_type);
 
-          default:
-            if ((n_x == 0) && (n_y == 0) && (n_z == 0)) {
-              mlog_error("ReionFilterType.c: Warning, ReionFilterType type %d is undefined!", filter_type);
-              ABORT(EXIT_FAILURE);
-            }
-            break;
-        }
+  for (int n_y = 0; n_y < n_ky; n_y++) {
+    int n_y_global = n_y + ky_start;
+    float k_y = (n_y_global > middle) ? (n_y_global - grid_dim) * delta_k : n_y_global * delta_k;
+
+    for (int n_z = 0; n_z < n_kz; n_z++) {
+      float k_z = (n_z + kz_start) * delta_k;
+      fftwf_complex* row = box + ((size_t)n_y * n_kz + n_z) * grid_dim;
+
+      for (int n_x = 0; n_x < grid_dim; n_x++) {
+        float k_x = (n_x > middle) ? (n_x - grid_dim) * delta_k : n_x * delta_k;
+        float k_mag = sqrtf(k_x * k_x + k_y * k_y + k_z * k_z);
+        row[n_x] *= filter_weight(k_mag * R, filter_type);
       }
     }
-  } // End looping through k box
+  }
+}
+
+filter_batch_t* create_filter_batch(int n_fields,
+                                    fftwf_complex** unfiltered,
+                                    fftwf_complex** filtered,
+                                    unsigned plan_flags)
+{
+  /*
+   * Set up a batched inverse transform of `n_fields` k-space grids which are
+   * all filtered at the same radius.  The fields are interleaved into a
+   * single work array so that FFTW carries out one MPI transpose for all of
+   * them, rather than one per field.
+   */
+
+  const int ReionGridDim = run_globals.params.ReionGridDim;
+  const ptrdiff_t n_real[3] = { ReionGridDim, ReionGridDim, ReionGridDim };
+  const ptrdiff_t n_complex[3] = { ReionGridDim, ReionGridDim, ReionGridDim / 2 + 1 };
+  ptrdiff_t local_nix, local_ix_start;
+
+  assert(n_fields <= FILTER_BATCH_MAX_FIELDS);
+
+  ptrdiff_t n_alloc = fftwf_mpi_local_size_many(
+    3, n_complex, n_fields, FFTW_MPI_DEFAULT_BLOCK, run_globals.mpi_comm, &local_nix, &local_ix_start);
+
+  if ((local_nix != run_globals.reion_grids.slab_nix[run_globals.mpi_rank]) ||
+      (local_ix_start != run_globals.reion_grids.slab_ix_start[run_globals.mpi_rank])) {
+    mlog_error("Batched FFT slab decomposition does not match the reionization grids.");
+    ABORT(EXIT_FAILURE);
+  }
+
+  filter_batch_t* batch = malloc(sizeof(filter_batch_t));
+  batch->n_fields = n_fields;
+  for (int ii = 0; ii < n_fields; ii++) {
+    batch->unfiltered[ii] = unfiltered[ii];
+    batch->filtered[ii] = filtered[ii];
+  }
+  batch->buffer = fftwf_alloc_complex((size_t)n_alloc);
+  batch->reverse_plan = fftwf_mpi_plan_many_dft_c2r(3,
+                                                    n_real,
+                                                    n_fields,
+                                                    FFTW_MPI_DEFAULT_BLOCK,
+                                                    FFTW_MPI_DEFAULT_BLOCK,
+                                                    batch->buffer,
+                                                    (float*)batch->buffer,
+                                                    run_globals.mpi_comm,
+                                                    plan_flags);
+
+  return batch;
+}
+
+void execute_filter_batch(filter_batch_t* batch, float R, int filter_type, bool apply_filter)
+{
+  // Equivalent to copying each unfiltered grid into its filtered grid, calling `filter` on it (if `apply_filter`)
+  // and running its c2r plan.
+  const int ReionGridDim = run_globals.params.ReionGridDim;
+  const int local_nix = (int)(run_globals.reion_grids.slab_nix[run_globals.mpi_rank]);
+  const int local_ix_start = (int)(run_globals.reion_grids.slab_ix_start[run_globals.mpi_rank]);
+  const size_t n_cells = (size_t)local_nix * ReionGridDim * (ReionGridDim / 2 + 1);
+  const int n_fields = batch->n_fields;
+  fftwf_complex* buffer = batch->buffer;
+
+  for (int jj = 0; jj < n_fields; jj++) {
+    const fftwf_complex* unfiltered = batch->unfiltered[jj];
+    for (size_t ii = 0; ii < n_cells; ii++)
+      buffer[ii * n_fields + jj] = unfiltered[ii];
+  }
+
+  if (apply_filter)
+    filter_interleaved(buffer, n_fields, local_ix_start, local_nix, ReionGridDim, R, filter_type);
+
+  fftwf_execute(batch->reverse_plan);
+
+  // The real-space output has the same padded layout as the single field transforms, with the fields interleaved
+  const float* out = (float*)buffer;
+  for (int jj = 0; jj < n_fields; jj++) {
+    float* filtered = (float*)(batch->filtered[jj]);
+    for (size_t ii = 0; ii < 2 * n_cells; ii++)
+      filtered[ii] = out[ii * n_fields + jj];
+  }
+}
+
+void destroy_filter_batch(filter_batch_t* batch)
+{
+  if (batch == NULL)
+    return;
+
+  fftwf_destroy_plan(batch->reverse_plan);
+  fftwf_free(batch->buffer);
+  free(batch);
 }
 
 void velocity_gradient(fftwf_complex* box, int local_ix_start, int slab_nx, int grid_dim)
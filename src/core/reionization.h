@@ -47,6 +47,18 @@ typedef struct gal_to_slab_t
   int slab_ind;
 } gal_to_slab_t;
 
+#define FILTER_BATCH_MAX_FIELDS 8
+
+//! Fields which are filtered at the same radius and inverse transformed together with a single interleaved plan
+typedef struct filter_batch_t
+{
+  int n_fields;
+  fftwf_complex* unfiltered[FILTER_BATCH_MAX_FIELDS]; //!< k-space inputs (left untouched)
+  fftwf_complex* filtered[FILTER_BATCH_MAX_FIELDS];   //!< receive the real-space results in the usual padded layout
+  fftwf_complex* buffer;                              //!< interleaved (field fastest) work array
+  fftwf_plan reverse_plan;
+} filter_batch_t;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -69,6 +81,27 @@ extern "C"
   void save_reion_output_grids(int snapshot);
   bool check_if_reionization_ongoing(int snapshot);
   void filter(fftwf_complex* box, int local_ix_start, int slab_nx, int grid_dim, float R, int filter_type);
+  void filter_interleaved(fftwf_complex* box,
+                          int n_fields,
+                          int local_ix_start,
+                          int slab_nx,
+                          int grid_dim,
+                          float R,
+                          int filter_type);
+  void filter_pencil(fftwf_complex* box,
+                     int ky_start,
+                     int n_ky,
+                     int kz_start,
+                     int n_kz,
+                     int grid_dim,
+                     float R,
+                     int filter_type);
+  filter_batch_t* create_filter_batch(int n_fields,
+                                      fftwf_complex** unfiltered,
+                                      fftwf_complex** filtered,
+                                      unsigned plan_flags);
+  void execute_filter_batch(filter_batch_t* batch, float R, int filter_type, bool apply_filter);
+  void destroy_filter_batch(filter_batch_t* batch);
   void velocity_gradient(fftwf_complex* box, int local_ix_start, int slab_nx, int grid_dim);
 
 #ifdef __cplusplus
@@ -1,12 +1,15 @@
 #include <assert.h>
 #include <hdf5_hl.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "magnitudes.h"
 #include "meraxes.h"
+#include "output_filters.h"
 #include "parse_paramfile.h"
 #include "reionization.h"
 #include "save.h"
+#include "utils.h"
 #if USE_MINI_HALOS
 #include "metal_evo.h"
 #endif
@@ -26,7 +29,7 @@ static float current_mwmsa(galaxy_t* gal, int i_snap)
   return (float)((mwmsa_num / mwmsa_denom) - LTTime[snapshot]);
 }
 
-void prepare_galaxy_for_output(galaxy_t gal, galaxy_output_t* galout, int i_snap)
+static void prepare_galaxy_for_output(galaxy_t gal, galaxy_output_t* galout, int i_snap)
 {
   run_units_t* units = &(run_globals.units);
 
@@ -114,12 +117,63 @@ void prepare_galaxy_for_output(galaxy_t gal, galaxy_output_t* galout, int i_snap
 #endif
   }
 
-#ifdef CALC_MAGS
-  get_output_magnitudes(galout->Mags, galout->DustyMags, &gal, run_globals.ListOutputSnaps[i_snap]);
-#if USE_MINI_HALOS
-  get_output_magnitudesIII(galout->MagsIII, &gal, run_globals.ListOutputSnaps[i_snap]);
-#endif
-#endif
+  // The magnitudes are filled in for the whole output buffer by get_output_magnitudes_batch
+}
+
+static void select_output_columns(hdf5_output_t* h5props)
+{
+  /*
+   * Set the deflate level of each galaxy property written in the columnar
+   * layout.  GalaxyOutputProps is a comma (or space) separated list of
+   * property names, each optionally followed by `:<deflate level>` to
+   * override GalaxyOutputDeflate for that column.  An empty list selects all
+   * properties.
+   */
+
+  run_params_t* params = &(run_globals.params);
+  int n_props = h5props->n_props;
+  const char sep[] = ", \t";
+  char props_string[STRLEN];
+  char* context = NULL;
+
+  h5props->field_deflate = malloc(sizeof(int) * n_props);
+
+  if (strlen(params->GalaxyOutputProps) == 0) {
+    for (int ii = 0; ii < n_props; ii++)
+      h5props->field_deflate[ii] = params->GalaxyOutputDeflate;
+    return;
+  }
+
+  for (int ii = 0; ii < n_props; ii++)
+    h5props->field_deflate[ii] = -1;
+
+  strncpy(props_string, params->GalaxyOutputProps, STRLEN - 1);
+  props_string[STRLEN - 1] = '\0';
+
+  for (char* p = strtok_r(props_string, sep, &context); p != NULL; p = strtok_r(NULL, sep, &context)) {
+    int level = params->GalaxyOutputDeflate;
+    char* colon = strchr(p, ':');
+    if (colon != NULL) {
+      *colon = '\0';
+      level = atoi(colon + 1);
+    }
+
+    if ((level < 0) || (level > 9)) {
+      mlog_error("Invalid deflate level (%d) requested for galaxy property %s.", level, p);
+      ABORT(EXIT_FAILURE);
+    }
+
+    int i_prop = 0;
+    while ((i_prop < n_props) && (strcmp(p, h5props->field_names[i_prop]) != 0))
+      i_prop++;
+
+    if (i_prop == n_props) {
+      mlog_error("Unrecognised galaxy property (%s) in GalaxyOutputProps.", p);
+      ABORT(EXIT_FAILURE);
+    }
+
+    h5props->field_deflate[i_prop] = level;
+  }
 }
 
 void calc_hdf5_props()
@@ -654,6 +708,8 @@ void calc_hdf5_props()
       mlog_error("Incorrect number of galaxy properties in HDF5 file. Should be %d, but is %d", h5props->n_props, i);
       ABORT(EXIT_FAILURE);
     }
+
+    select_output_columns(h5props);
   }
 }
 
@@ -893,7 +949,12 @@ void create_master_file()
       H5Lcreate_external(relative_source_file, source_ds, group_id, "Galaxies", H5P_DEFAULT, H5P_DEFAULT);
 
       source_file_id = H5Fopen(source_file, H5F_ACC_RDONLY, H5P_DEFAULT);
-      H5TBget_table_info(source_file_id, source_ds, NULL, &core_n_gals);
+      if (run_globals.params.GalaxyOutputLayout == GALAXY_OUTPUT_COLUMNS) {
+        int n_gals = 0;
+        H5LTget_attribute_int(source_file_id, source_ds, "NGalaxies", &n_gals);
+        core_n_gals = (hsize_t)n_gals;
+      } else
+        H5TBget_table_info(source_file_id, source_ds, NULL, &core_n_gals);
       snap_n_gals += (int)core_n_gals;
 
       // if they exists, then also create a link to walk indices
@@ -976,15 +1037,11 @@ static void inline save_walk_indices(hid_t file_id,
 {
   hid_t dset_id;
   char target[50];
-  int chunk_size = 1000;
+  const output_filter_t* filter = get_output_filter(OUTPUT_WALK_INDICES);
 
   if (old_count > 0) {
     hsize_t dim[1] = { (hsize_t)old_count };
-    hsize_t chunks[1] = { chunk_size > old_count ? (hsize_t)old_count : (hsize_t)chunk_size };
-
-    hid_t plist_id = H5Pcreate(H5P_DATASET_CREATE);
-    H5Pset_chunk(plist_id, 1, chunks);
-    H5Pset_deflate(plist_id, 6);
+    hid_t plist_id = create_output_dcpl(filter, 1, dim, H5T_NATIVE_INT);
 
     hid_t dspace_id = H5Screate_simple(1, dim, NULL);
 
@@ -1015,13 +1072,7 @@ static void inline save_walk_indices(hid_t file_id,
 
   if (n_write > 0) {
     hsize_t dim[1] = { (hsize_t)n_write };
-    hsize_t chunks[1] = { chunk_size > n_write ? n_write : chunk_size };
-
-    hid_t plist_id = H5Pcreate(H5P_DATASET_CREATE);
-    H5Pset_chunk(plist_id, 1, chunks);
-    H5Pset_deflate(plist_id, 6);
-
-    H5Pset_chunk(plist_id, 1, chunks);
+    hid_t plist_id = create_output_dcpl(filter, 1, dim, H5T_NATIVE_INT);
     hid_t dspace_id = H5Screate_simple(1, dim, NULL);
 
     sprintf(target, "Snap%03d/FirstProgenitorIndices", (run_globals.ListOutputSnaps)[i_out]);
@@ -1054,24 +1105,227 @@ static inline bool pass_write_check(galaxy_t* gal, bool flag_merger)
     return false;
 }
 
-void write_snapshot(int n_write, int i_out, int* last_n_write)
+static void create_galaxy_columns(hid_t group_id, hdf5_output_t* h5props, int n_write, hsize_t chunk_size)
 {
   /*
-   * Write a batch of galaxies to the output HDF5 table.
+   * Create one dataset per selected galaxy property.  Scalar properties are
+   * written as 1D datasets and fixed width arrays (e.g. Pos, NewStars, Mags)
+   * as 2D datasets of shape [n_write, width].
+   */
+
+  hid_t cols_id = H5Gcreate(group_id, "Galaxies", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+
+  for (int ii = 0; ii < h5props->n_props; ii++) {
+    if (h5props->field_deflate[ii] < 0)
+      continue;
+
+    int rank = 1;
+    hsize_t dims[2] = { (hsize_t)n_write, 1 };
+    hsize_t chunks[2] = { chunk_size < (hsize_t)n_write ? chunk_size : (hsize_t)n_write, 1 };
+    hid_t type_id = h5props->field_types[ii];
+    bool is_array = (H5Tget_class(type_id) == H5T_ARRAY);
+
+    if (is_array) {
+      H5Tget_array_dims(type_id, &dims[1]);
+      chunks[1] = dims[1];
+      type_id = H5Tget_super(type_id);
+      rank = 2;
+    }
+
+    hid_t plist_id = H5Pcreate(H5P_DATASET_CREATE);
+    if (n_write > 0) {
+      H5Pset_chunk(plist_id, rank, chunks);
+      if (h5props->field_deflate[ii] > 0) {
+        H5Pset_shuffle(plist_id);
+        H5Pset_deflate(plist_id, (unsigned)h5props->field_deflate[ii]);
+      }
+    }
+
+    hid_t dspace_id = H5Screate_simple(rank, dims, NULL);
+    hid_t dset_id =
+      H5Dcreate(cols_id, h5props->field_names[ii], type_id, dspace_id, H5P_DEFAULT, plist_id, H5P_DEFAULT);
+
+    H5Dclose(dset_id);
+    H5Sclose(dspace_id);
+    H5Pclose(plist_id);
+    if (is_array)
+      H5Tclose(type_id);
+  }
+
+  H5LTset_attribute_int(group_id, "Galaxies", "NGalaxies", &n_write, 1);
+
+  H5Gclose(cols_id);
+}
+
+static void write_galaxy_columns(hid_t group_id,
+                                 hdf5_output_t* h5props,
+                                 galaxy_output_t* output_buffer,
+                                 int gal_count,
+                                 int buffer_count,
+                                 char* column_buffer)
+{
+  hid_t cols_id = H5Gopen(group_id, "Galaxies", H5P_DEFAULT);
+
+  for (int ii = 0; ii < h5props->n_props; ii++) {
+    if (h5props->field_deflate[ii] < 0)
+      continue;
+
+    // gather this property into a contiguous block
+    size_t offset = h5props->dst_offsets[ii];
+    size_t size = h5props->dst_field_sizes[ii];
+    for (int jj = 0; jj < buffer_count; jj++)
+      memcpy(column_buffer + jj * size, (char*)&(output_buffer[jj]) + offset, size);
+
+    hid_t dset_id = H5Dopen(cols_id, h5props->field_names[ii], H5P_DEFAULT);
+    hid_t fspace_id = H5Dget_space(dset_id);
+    hsize_t dims[2] = { 0, 1 };
+    int rank = H5Sget_simple_extent_dims(fspace_id, dims, NULL);
+
+    hsize_t start[2] = { (hsize_t)gal_count, 0 };
+    hsize_t count[2] = { (hsize_t)buffer_count, dims[1] };
+    H5Sselect_hyperslab(fspace_id, H5S_SELECT_SET, start, NULL, count, NULL);
+    hid_t mspace_id = H5Screate_simple(rank, count, NULL);
+
+    hid_t type_id = H5Dget_type(dset_id);
+    H5Dwrite(dset_id, type_id, mspace_id, fspace_id, H5P_DEFAULT, column_buffer);
+
+    H5Tclose(type_id);
+    H5Sclose(mspace_id);
+    H5Sclose(fspace_id);
+    H5Dclose(dset_id);
+  }
+
+  H5Gclose(cols_id);
+}
+
+static void write_galaxy_buffer(hid_t group_id,
+                                hdf5_output_t* h5props,
+                                galaxy_output_t* output_buffer,
+                                int gal_count,
+                                int buffer_count,
+                                char* column_buffer)
+{
+  if (run_globals.params.GalaxyOutputLayout == GALAXY_OUTPUT_COLUMNS)
+    write_galaxy_columns(group_id, h5props, output_buffer, gal_count, buffer_count, column_buffer);
+  else
+    H5TBwrite_records(group_id,
+                      "Galaxies",
+                      (hsize_t)gal_count,
+                      (hsize_t)buffer_count,
+                      h5props->dst_size,
+                      h5props->dst_offsets,
+                      h5props->dst_field_sizes,
+                      output_buffer);
+}
+
+//! The galaxies (and walk indices) of one output snapshot, ready to be written
+typedef struct snapshot_output_t
+{
+  galaxy_output_t* galaxies;
+  int* descendant_index;
+  int* first_progenitor_index;
+  int* next_progenitor_index;
+  int i_out;
+  int prev_i_out; //!< output index of the preceding snapshot (-1 => no walk indices to write)
+  int n_write;
+  int last_n_write;
+} snapshot_output_t;
+
+static void free_snapshot_output(snapshot_output_t* snap_out)
+{
+  free(snap_out->next_progenitor_index);
+  free(snap_out->first_progenitor_index);
+  free(snap_out->descendant_index);
+  free(snap_out->galaxies);
+  free(snap_out);
+}
+
+static int write_snapshot_output(snapshot_output_t* snap_out)
+{
+  /*
+   * Write the galaxies (and walk indices) of one snapshot to the output file.
    */
 
-  hid_t file_id;
-  hid_t group_id;
   hsize_t chunk_size = 5000;
-  galaxy_output_t* output_buffer = NULL;
   int* fill_data = NULL;
+  char* column_buffer = NULL;
   char target_group[20];
-  galaxy_t* gal = NULL;
   hdf5_output_t h5props = run_globals.hdf5props;
+  int n_write = snap_out->n_write;
+
+  hid_t file_id = H5Fopen(run_globals.FNameOut, H5F_ACC_RDWR, H5P_DEFAULT);
+  if (file_id < 0)
+    return -1;
+
+  // Create the relevant group.
+  sprintf(target_group, "Snap%03d", (run_globals.ListOutputSnaps)[snap_out->i_out]);
+  hid_t group_id = H5Gcreate(file_id, target_group, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+
+  // reset the chunk size if required
+  if ((int)chunk_size < n_write)
+    chunk_size = (hsize_t)n_write;
+
+  // Make the table (or the group of per-property datasets)
+  if (run_globals.params.GalaxyOutputLayout == GALAXY_OUTPUT_COLUMNS)
+    create_galaxy_columns(group_id, &h5props, n_write, chunk_size);
+  else
+    H5TBmake_table("Galaxies",
+                   group_id,
+                   "Galaxies",
+                   (hsize_t)h5props.n_props,
+                   (hsize_t)n_write,
+                   h5props.dst_size,
+                   h5props.field_names,
+                   h5props.dst_offsets,
+                   h5props.field_types,
+                   chunk_size,
+                   fill_data,
+                   1,
+                   NULL);
+
+  if (snap_out->prev_i_out > -1)
+    save_walk_indices(file_id,
+                      snap_out->i_out,
+                      snap_out->prev_i_out,
+                      snap_out->descendant_index,
+                      snap_out->first_progenitor_index,
+                      snap_out->next_progenitor_index,
+                      snap_out->last_n_write,
+                      n_write);
+
+  // Write the galaxies.  The chunk size is never smaller than n_write, so the
+  // whole snapshot goes out in a single write.
+  if (n_write > 0) {
+    if (run_globals.params.GalaxyOutputLayout == GALAXY_OUTPUT_COLUMNS) {
+      size_t max_field_size = 0;
+      for (int ii = 0; ii < h5props.n_props; ii++)
+        if (h5props.dst_field_sizes[ii] > max_field_size)
+          max_field_size = h5props.dst_field_sizes[ii];
+      column_buffer = malloc(max_field_size * (size_t)n_write);
+    }
+
+    write_galaxy_buffer(group_id, &h5props, snap_out->galaxies, 0, n_write, column_buffer);
+
+    if (column_buffer != NULL)
+      free(column_buffer);
+  }
+
+  H5Gclose(group_id);
+  H5Fclose(file_id);
+
+  return 0;
+}
+
+void write_snapshot(int n_write, int i_out, int* last_n_write)
+{
+  /*
+   * Copy a batch of galaxies into an output buffer and write it to the output
+   * HDF5 table.
+   */
+
+  galaxy_t* gal = NULL;
   int gal_count = 0;
   int old_count = 0;
-  int* first_progenitor_index = NULL;
-  int* next_progenitor_index = NULL;
   int calc_descendants_i_out = -1;
   int prev_snapshot = -1;
   int write_count = 0;
@@ -1093,31 +1347,10 @@ void write_snapshot(int n_write, int i_out, int* last_n_write)
     n_write = write_count;
   }
 
-  // Create the file.
-  file_id = H5Fopen(run_globals.FNameOut, H5F_ACC_RDWR, H5P_DEFAULT);
-
-  // Create the relevant group.
-  sprintf(target_group, "Snap%03d", (run_globals.ListOutputSnaps)[i_out]);
-  group_id = H5Gcreate(file_id, target_group, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-
-  // reset the chunk size if required
-  if ((int)chunk_size < n_write)
-    chunk_size = (hsize_t)n_write;
-
-  // Make the table
-  H5TBmake_table("Galaxies",
-                 group_id,
-                 "Galaxies",
-                 (hsize_t)h5props.n_props,
-                 (hsize_t)n_write,
-                 h5props.dst_size,
-                 h5props.field_names,
-                 h5props.dst_offsets,
-                 h5props.field_types,
-                 chunk_size,
-                 fill_data,
-                 1,
-                 NULL);
+  snapshot_output_t* snap_out = calloc(1, sizeof(snapshot_output_t));
+  snap_out->i_out = i_out;
+  snap_out->n_write = n_write;
+  snap_out->last_n_write = *last_n_write;
 
   // If the immediately preceding snapshot was also written, then save the
   // descendent indices
@@ -1129,6 +1362,7 @@ void write_snapshot(int n_write, int i_out, int* last_n_write)
         break;
       }
   }
+  snap_out->prev_i_out = calc_descendants_i_out;
 
   // Assign the write order indices to each galaxy and store the old indices if required
   gal_count = 0;
@@ -1136,8 +1370,8 @@ void write_snapshot(int n_write, int i_out, int* last_n_write)
   if (calc_descendants_i_out > -1) {
     // malloc the arrays
     int* descendant_index = malloc(sizeof(int) * (*last_n_write));
-    next_progenitor_index = malloc(sizeof(int) * (*last_n_write));
-    first_progenitor_index = malloc(sizeof(int) * n_write);
+    int* next_progenitor_index = malloc(sizeof(int) * (*last_n_write));
+    int* first_progenitor_index = malloc(sizeof(int) * n_write);
 
     // initialise all entries to -1
     for (int ii = 0; ii < *last_n_write; ii++) {
@@ -1189,19 +1423,10 @@ void write_snapshot(int n_write, int i_out, int* last_n_write)
       gal = gal->Next;
     }
 
-    save_walk_indices(file_id,
-                      i_out,
-                      calc_descendants_i_out,
-                      descendant_index,
-                      first_progenitor_index,
-                      next_progenitor_index,
-                      *last_n_write,
-                      n_write);
-
-    // Free the allocated arrays
-    free(first_progenitor_index);
-    free(next_progenitor_index);
-    free(descendant_index);
+    // The snapshot output takes ownership of the index arrays
+    snap_out->descendant_index = descendant_index;
+    snap_out->first_progenitor_index = first_progenitor_index;
+    snap_out->next_progenitor_index = next_progenitor_index;
 
   } else {
 
@@ -1219,66 +1444,46 @@ void write_snapshot(int n_write, int i_out, int* last_n_write)
     ABORT(EXIT_FAILURE);
   }
 
-  // Write the galaxies.
-  // In order to speed things up, we will chunk our write.
-  // This can cause significant memory overhead if `chunk_size` is large.
+  // Copy the galaxies into the output buffer.  This is the only part of the
+  // write which needs the live galaxy list.
   gal_count = 0;
   gal = run_globals.FirstGal;
-  output_buffer = calloc((int)chunk_size, sizeof(galaxy_output_t));
-  int buffer_count = 0;
+  snap_out->galaxies = calloc((size_t)(n_write > 0 ? n_write : 1), sizeof(galaxy_output_t));
+#ifdef CALC_MAGS
+  galaxy_t** output_gals = malloc(sizeof(galaxy_t*) * (size_t)(n_write > 0 ? n_write : 1));
+#endif
   while (gal != NULL) {
     // Don't output galaxies which merged at this timestep
     if (pass_write_check(gal, false)) {
-      prepare_galaxy_for_output(*gal, &(output_buffer[buffer_count]), i_out);
-      buffer_count++;
-    }
-    if (buffer_count == (int)chunk_size) {
-      H5TBwrite_records(group_id,
-                        "Galaxies",
-                        (hsize_t)gal_count,
-                        (hsize_t)buffer_count,
-                        h5props.dst_size,
-                        h5props.dst_offsets,
-                        h5props.dst_field_sizes,
-                        output_buffer);
-      gal_count += buffer_count;
-      buffer_count = 0;
+#ifdef CALC_MAGS
+      output_gals[gal_count] = gal;
+#endif
+      prepare_galaxy_for_output(*gal, &(snap_out->galaxies[gal_count++]), i_out);
     }
     gal = gal->Next;
   }
 
-  // Write any remaining galaxies in the buffer
-  if (buffer_count > 0) {
-    H5TBwrite_records(group_id,
-                      "Galaxies",
-                      (hsize_t)gal_count,
-                      (hsize_t)buffer_count,
-                      h5props.dst_size,
-                      h5props.dst_offsets,
-                      h5props.dst_field_sizes,
-                      output_buffer);
-    gal_count += buffer_count;
-  }
-
   if (n_write != gal_count) {
     mlog("We don't have the expected number of galaxies in save...", MLOG_MESG);
     mlog("gal_count=%d, n_write=%d", MLOG_MESG, gal_count, n_write);
     ABORT(EXIT_FAILURE);
   }
 
-  // Free the output buffer
-  free(output_buffer);
+#ifdef CALC_MAGS
+  get_output_magnitudes_batch(snap_out->galaxies, output_gals, n_write, run_globals.ListOutputSnaps[i_out]);
+  free(output_gals);
+#endif
+
+  if (write_snapshot_output(snap_out) != 0) {
+    mlog_error("Failed to open output file %s.", run_globals.FNameOut);
+    ABORT(EXIT_FAILURE);
+  }
+  free_snapshot_output(snap_out);
 
   if (run_globals.params.Flag_PatchyReion && check_if_reionization_ongoing(run_globals.ListOutputSnaps[i_out]) &&
       (run_globals.params.Flag_OutputGrids))
     save_reion_output_grids(run_globals.ListOutputSnaps[i_out]);
 
-  // Close the group.
-  H5Gclose(group_id);
-
-  // Close the file.
-  H5Fclose(file_id);
-
   // Update the value of last_n_write
   *last_n_write = n_write;
 
@@ -1,5 +1,8 @@
 #include <hdf5.h>
 #include <hdf5_hl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "meraxes.h"
 #include "misc_tools.h"
@@ -10,9 +13,17 @@
 
 static double age[NAGE];
 static double yield_tables[NELEMENT][NMETAL * NAGE];
-static double yield_tables_working[N_HISTORY_SNAPS][NMETAL][NELEMENT];
 static double energy_tables[NMETAL * NAGE];
-static double energy_tables_working[N_HISTORY_SNAPS][NMETAL];
+
+// The working tables only depend on LTTime and the tables above, so they are
+// computed for every snapshot once (see init_stellar_feedback_working_tables)
+// and shared by all subsequent calls to dracarys.  The recycling fraction,
+// metal yield and energy of each (burst, metallicity) are interleaved in one
+// record, so that a burst needs a single lookup.  feedback_tables_working is
+// a view of the current snapshot's tables.
+typedef sn_feedback_t feedback_working_t[N_HISTORY_SNAPS][NMETAL];
+static feedback_working_t* feedback_tables_all = NULL;
+static sn_feedback_t (*feedback_tables_working)[NMETAL] = NULL;
 
 static void check_n_history_snaps(void)
 {
@@ -68,6 +79,176 @@ static void check_n_history_snaps(void)
   }
 }
 
+static void compute_working_tables(int snapshot, feedback_working_t working)
+{
+  int n_bursts = (snapshot >= N_HISTORY_SNAPS) ? N_HISTORY_SNAPS : snapshot;
+  double* LTTime = run_globals.LTTime;
+  double time_unit = run_globals.units.UnitTime_in_Megayears / run_globals.params.Hubble_h;
+  double t_begin, t_end;
+  double* pData;
+
+  for (int i_burst = 0; i_burst < n_bursts; ++i_burst) {
+    // Assume that SN happens at the middle time of the given snapshot.
+    // As an approximation adopt the value at the middle time of each
+    // snapshot for yields and energy injection.
+    if (i_burst > 0)
+      t_begin = ((LTTime[snapshot - i_burst - 1] + LTTime[snapshot - i_burst]) / 2. - LTTime[snapshot - 1]) * time_unit;
+    else
+      t_begin = age[0];
+    t_end = ((LTTime[snapshot - i_burst - 1] + LTTime[snapshot - i_burst]) / 2. - LTTime[snapshot]) * time_unit;
+    if (t_end < age[NAGE - 1]) {
+      for (int i_metal = 0; i_metal < NMETAL; ++i_metal) {
+        sn_feedback_t* record = &working[i_burst][i_metal];
+        pData = yield_tables[RECYCLING_FRACTION] + i_metal * NAGE;
+        record->recycling_fraction = trapz_table(pData, age, NAGE, t_begin, t_end);
+        pData = yield_tables[TOTAL_METAL] + i_metal * NAGE;
+        record->metal_yield = trapz_table(pData, age, NAGE, t_begin, t_end);
+        pData = energy_tables + i_metal * NAGE;
+        record->energy = interp(t_end, age, pData, NAGE) - interp(t_begin, age, pData, NAGE);
+      }
+    } else {
+      // When the stellar age is older than the time last grid,
+      // yields and energy injection are negligible.
+      for (int i_metal = 0; i_metal < NMETAL; ++i_metal)
+        working[i_burst][i_metal] = (sn_feedback_t){ 0., 0., 0. };
+    }
+  }
+}
+
+static void feedback_cache_key(char* key, char* fname)
+{
+  // Everything that goes into the working tables: the source tables, units and look back times of the snapshots
+  run_params_t* params = &(run_globals.params);
+  char source[STRLEN + 32];
+  struct stat filestatus;
+  long long source_size = -1;
+  long long source_mtime = -1;
+
+  snprintf(source, sizeof(source), "%s/stellar_feedback_tables.hdf5", params->StellarFeedbackDir);
+  if (stat(source, &filestatus) == 0) {
+    source_size = (long long)filestatus.st_size;
+    source_mtime = (long long)filestatus.st_mtime;
+  }
+
+  snprintf(key,
+           FEEDBACK_CACHE_KEY_LEN,
+           "version=%d;source=%s;size=%lld;mtime=%lld;n_history_snaps=%d;nmetal=%d;nage=%d;nelement=%d;n_snaps=%d;"
+           "time_unit=%.17g;energy_unit=%.17g;lttime=%016llx",
+           FEEDBACK_CACHE_VERSION,
+           source,
+           source_size,
+           source_mtime,
+           N_HISTORY_SNAPS,
+           NMETAL,
+           NAGE,
+           NELEMENT,
+           params->SnaplistLength,
+           run_globals.units.UnitTime_in_Megayears / params->Hubble_h,
+           run_globals.units.UnitEnergy_in_cgs,
+           (unsigned long long)fnv1a_hash(run_globals.LTTime, sizeof(double) * (size_t)params->SnaplistLength));
+
+  snprintf(fname,
+           STRLEN,
+           "%s/stellar_feedback_working_%016llx.hdf5",
+           params->StellarFeedbackCacheDir,
+           (unsigned long long)fnv1a_hash(key, strlen(key)));
+}
+
+static bool load_working_tables(const char* key, const char* fname)
+{
+  // Read the working tables saved by a previous run with the same snapshot list (returns false if there are none)
+  if (access(fname, F_OK) == -1)
+    return false;
+
+  hid_t fd = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+  if (fd < 0)
+    return false;
+
+  char stored_key[FEEDBACK_CACHE_KEY_LEN] = { '\0' };
+  hsize_t dims[1] = { 0 };
+  H5T_class_t type_class;
+  size_t type_size = 0;
+  bool valid = false;
+
+  // Guard against hash collisions and truncated keys before reading the attribute
+  if ((H5LTget_attribute_info(fd, "/", "key", dims, &type_class, &type_size) >= 0) &&
+      (type_size < FEEDBACK_CACHE_KEY_LEN) && (H5LTget_attribute_string(fd, "/", "key", stored_key) >= 0) &&
+      (strcmp(stored_key, key) == 0))
+    valid = (H5LTread_dataset_double(fd, "records", (double*)feedback_tables_all) >= 0);
+
+  H5Fclose(fd);
+  return valid;
+}
+
+static void save_working_tables(const char* key, const char* fname)
+{
+  // The file is written under a temporary name and renamed once complete so
+  // that concurrent runs never see a partial file.
+  char tmp_fname[STRLEN + 32];
+  struct stat filestatus;
+  hsize_t n_snaps = (hsize_t)run_globals.params.SnaplistLength;
+
+  if (stat(run_globals.params.StellarFeedbackCacheDir, &filestatus) != 0)
+    mkdir(run_globals.params.StellarFeedbackCacheDir, 02755);
+  snprintf(tmp_fname, sizeof(tmp_fname), "%s.tmp%d", fname, (int)getpid());
+
+  hid_t fd = H5Fcreate(tmp_fname, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  if (fd < 0) {
+    mlog("Failed to create stellar feedback cache file %s - not caching.", MLOG_MESG, tmp_fname);
+    return;
+  }
+
+  // Each record is stored as (recycling_fraction, metal_yield, energy)
+  herr_t status = H5LTmake_dataset_double(
+    fd, "records", 4, (hsize_t[4]){ n_snaps, N_HISTORY_SNAPS, NMETAL, 3 }, (double*)feedback_tables_all);
+  if (status >= 0)
+    status = H5LTset_attribute_string(fd, "/", "key", key);
+  H5Fclose(fd);
+
+  if ((status < 0) || (rename(tmp_fname, fname) != 0)) {
+    mlog("Failed to write stellar feedback cache file %s - not caching.", MLOG_MESG, fname);
+    remove(tmp_fname);
+  } else
+    mlog("Cached stellar feedback working tables in %s", MLOG_MESG, fname);
+}
+
+static void init_stellar_feedback_working_tables(void)
+{
+  /*
+   * Compute the working tables of every snapshot (or read them from
+   * StellarFeedbackCacheDir, if they have been saved by a previous run with
+   * the same snapshot list).  Must be called on all ranks after the tables
+   * have been read.
+   */
+
+  int n_snaps = run_globals.params.SnaplistLength;
+  bool use_disk_cache = (run_globals.params.StellarFeedbackCacheDir[0] != '\0');
+
+  feedback_tables_all = calloc((size_t)n_snaps, sizeof(feedback_working_t));
+
+  if (run_globals.mpi_rank == 0) {
+    char key[FEEDBACK_CACHE_KEY_LEN];
+    char fname[STRLEN];
+    bool loaded = false;
+
+    if (use_disk_cache) {
+      feedback_cache_key(key, fname);
+      loaded = load_working_tables(key, fname);
+      if (loaded)
+        mlog("Loaded stellar feedback working tables from %s", MLOG_MESG, fname);
+    }
+
+    if (!loaded) {
+      for (int snapshot = 0; snapshot < n_snaps; ++snapshot)
+        compute_working_tables(snapshot, feedback_tables_all[snapshot]);
+      if (use_disk_cache)
+        save_working_tables(key, fname);
+    }
+  }
+
+  MPI_Bcast(feedback_tables_all, (int)(n_snaps * sizeof(feedback_working_t)), MPI_BYTE, 0, run_globals.mpi_comm);
+}
+
 void read_stellar_feedback_tables(void)
 {
   if (run_globals.mpi_rank == 0) {
@@ -98,76 +279,82 @@ void read_stellar_feedback_tables(void)
   MPI_Bcast(age, sizeof(age), MPI_BYTE, 0, run_globals.mpi_comm);
   MPI_Bcast(yield_tables, sizeof(yield_tables), MPI_BYTE, 0, run_globals.mpi_comm);
   MPI_Bcast(energy_tables, sizeof(energy_tables), MPI_BYTE, 0, run_globals.mpi_comm);
+
+  init_stellar_feedback_working_tables();
 }
 
 void compute_stellar_feedback_tables(int snapshot)
 {
-  int n_bursts = (snapshot >= N_HISTORY_SNAPS) ? N_HISTORY_SNAPS : snapshot;
-  double* LTTime = run_globals.LTTime;
-  double time_unit = run_globals.units.UnitTime_in_Megayears / run_globals.params.Hubble_h;
-  double t_begin, t_end;
-  double* pData;
+  // Point the working tables at those of this snapshot
+  feedback_tables_working = feedback_tables_all[snapshot];
+}
 
-  for (int i_burst = 0; i_burst < n_bursts; ++i_burst) {
-    // Assume that SN happens at the middle time of the given snapshot.
-    // As an approximation adopt the value at the middle time of each
-    // snapshot for yields and energy injection.
-    if (i_burst > 0)
-      t_begin = ((LTTime[snapshot - i_burst - 1] + LTTime[snapshot - i_burst]) / 2. - LTTime[snapshot - 1]) * time_unit;
-    else
-      t_begin = age[0];
-    t_end = ((LTTime[snapshot - i_burst - 1] + LTTime[snapshot - i_burst]) / 2. - LTTime[snapshot]) * time_unit;
-    if (t_end < age[NAGE - 1]) {
-      for (int i_element = 0; i_element < NELEMENT; ++i_element) {
-        pData = yield_tables[i_element];
-        for (int i_metal = 0; i_metal < NMETAL; ++i_metal) {
-          yield_tables_working[i_burst][i_metal][i_element] = trapz_table(pData, age, NAGE, t_begin, t_end);
-          pData += NAGE;
-        }
-      }
-      pData = energy_tables;
-      for (int i_metal = 0; i_metal < NMETAL; ++i_metal) {
-        energy_tables_working[i_burst][i_metal] = interp(t_end, age, pData, NAGE) - interp(t_begin, age, pData, NAGE);
-        pData += NAGE;
-      }
-    } else {
-      // When the stellar age is older than the time last grid,
-      // yields and energy injection are negligible.
-      for (int i_element = 0; i_element < NELEMENT; ++i_element)
-        for (int i_metal = 0; i_metal < NMETAL; ++i_metal)
-          yield_tables_working[i_burst][i_metal][i_element] = 0.;
-      for (int i_metal = 0; i_metal < NMETAL; ++i_metal)
-        energy_tables_working[i_burst][i_metal] = 0.;
-    }
-  }
+void free_stellar_feedback_tables(void)
+{
+  free(feedback_tables_all);
+  feedback_tables_all = NULL;
 }
 
 static inline int get_integer_metallicity(double metals)
 {
+  // Convert the metallicity to an integer (the clamps compile to conditional moves rather than branches)
   int Z = (int)(metals * 1000 - .5);
-  if (Z < MIN_Z)
-    Z = MIN_Z;
-  else if (Z > MAX_Z)
-    Z = MAX_Z;
-  return Z;
+  Z = Z < MIN_Z ? MIN_Z : Z;
+  return Z > MAX_Z ? MAX_Z : Z;
+}
+
+const sn_feedback_t* get_sn_feedback(int i_burst, double metals)
+{
+  return &feedback_tables_working[i_burst][get_integer_metallicity(metals)];
 }
 
 double get_recycling_fraction(int i_burst, double metals)
 {
   // The recycling fraction equals to the yield of all elements including H & He
-  return yield_tables_working[i_burst][get_integer_metallicity(metals)][RECYCLING_FRACTION];
+  return get_sn_feedback(i_burst, metals)->recycling_fraction;
 }
 
 double get_metal_yield(int i_burst, double metals)
 {
   // The metal yield includes all elements execpt H & He
-  return yield_tables_working[i_burst][get_integer_metallicity(metals)][TOTAL_METAL];
+  return get_sn_feedback(i_burst, metals)->metal_yield;
 }
 
 double get_SN_energy(int i_burst, double metals)
 {
-  // Convert the metallicity to an integer
-  return energy_tables_working[i_burst][get_integer_metallicity(metals)];
+  return get_sn_feedback(i_burst, metals)->energy;
+}
+
+void get_burst_history_feedback(const double* m_stars,
+                                const double* metals,
+                                int first_burst,
+                                int n_bursts,
+                                double* m_recycled,
+                                double* new_metals,
+                                double* sn_energy)
+{
+  /*
+   * Add the recycled mass, new metals and SNII energy released during this
+   * snapshot by bursts first_burst to n_bursts - 1 of a star formation
+   * history, where m_stars[i_burst] and metals[i_burst] are the stellar mass
+   * and metallicity of each burst.  Bursts which should be skipped can be
+   * given zero mass, which keeps the loop free of branches.
+   */
+
+  double recycled = *m_recycled;
+  double yield = *new_metals;
+  double energy = *sn_energy;
+
+  for (int i_burst = first_burst; i_burst < n_bursts; ++i_burst) {
+    const sn_feedback_t* record = get_sn_feedback(i_burst, metals[i_burst]);
+    recycled += m_stars[i_burst] * record->recycling_fraction;
+    yield += m_stars[i_burst] * record->metal_yield;
+    energy += record->energy * m_stars[i_burst];
+  }
+
+  *m_recycled = recycled;
+  *new_metals = yield;
+  *sn_energy = energy;
 }
 
 double get_total_SN_energy(void)
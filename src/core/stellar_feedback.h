@@ -10,10 +10,22 @@
 #define RECYCLING_FRACTION 0
 #define TOTAL_METAL 1
 
+// Cache of the working tables for every snapshot (see StellarFeedbackCacheDir)
+#define FEEDBACK_CACHE_VERSION 2
+#define FEEDBACK_CACHE_KEY_LEN 1024
+
 // Pop III stuff (Atm ENOVA_CC and ENOVA_PISN are the same but you could change)
 #define ENOVA_CC 1e51
 #define ENOVA_PISN 1e51
 
+//! Feedback released in a snapshot by a burst, per unit stellar mass
+typedef struct sn_feedback_t
+{
+  double recycling_fraction; //!< yield of all elements including H & He
+  double metal_yield;        //!< yield of all elements except H & He
+  double energy;             //!< SNII energy
+} sn_feedback_t;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -21,9 +33,18 @@ extern "C"
 
   void read_stellar_feedback_tables(void);
   void compute_stellar_feedback_tables(int snapshot);
+  void free_stellar_feedback_tables(void);
   double get_recycling_fraction(int i_burst, double metals);
   double get_metal_yield(int i_burst, double metals);
   double get_SN_energy(int i_burst, double metals);
+  const sn_feedback_t* get_sn_feedback(int i_burst, double metals);
+  void get_burst_history_feedback(const double* m_stars,
+                                  const double* metals,
+                                  int first_burst,
+                                  int n_bursts,
+                                  double* m_recycled,
+                                  double* new_metals,
+                                  double* sn_energy);
 #if USE_MINI_HALOS
   double get_SN_energy_PopIII(int i_burst, int snapshot, int SN_type);
 #endif
@@ -0,0 +1,240 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "meraxes.h"
+#include "tree_file_cache.h"
+
+/*
+ * Cache of open HDF5 handles for the input trees.
+ *
+ * The tree readers are run (on rank 0) for every snapshot, and used to open
+ * and close the same files, and the datasets within them, for every snapshot
+ * and chunk read, which is a lot of metadata traffic for parallel file
+ * systems.  Files opened with tree_file_open, and datasets opened with
+ * tree_dataset_open, are instead kept open until they are evicted (least
+ * recently used first) to keep at most TreesMaxOpenFiles files, and
+ * TREE_CACHE_MAX_DATASETS datasets in each, open.  Files are opened with the
+ * raw data chunk cache and metadata cache sizes given by TreesChunkCacheMB
+ * and TreesMetadataCacheMB (0 => HDF5 defaults).  TreesMaxOpenFiles = 0
+ * turns off the caching.
+ *
+ * Handles must still be released with tree_file_close and
+ * tree_dataset_close, and are only valid until the next call to
+ * tree_file_open.
+ */
+
+typedef struct tree_dataset_entry_t
+{
+  char path[TREE_CACHE_PATH_LEN];
+  hid_t id;
+  unsigned long last_used;
+} tree_dataset_entry_t;
+
+typedef struct tree_file_entry_t
+{
+  char fname[STRLEN * 2 + 8];
+  hid_t id;
+  unsigned long last_used;
+  int n_datasets;
+  tree_dataset_entry_t datasets[TREE_CACHE_MAX_DATASETS];
+} tree_file_entry_t;
+
+static tree_file_entry_t* cached_files = NULL;
+static int n_cached_files = 0;
+static unsigned long cache_clock = 0;
+static tree_file_cache_stats_t cache_stats = { 0 };
+
+static hid_t open_tree_file(const char* fname)
+{
+  run_params_t* params = &(run_globals.params);
+  hid_t fapl_id = H5Pcreate(H5P_FILE_ACCESS);
+
+  if (params->TreesChunkCacheMB > 0) {
+    int mdc_nelmts;
+    size_t rdcc_nslots, rdcc_nbytes;
+    double rdcc_w0;
+    H5Pget_cache(fapl_id, &mdc_nelmts, &rdcc_nslots, &rdcc_nbytes, &rdcc_w0);
+
+    // The trees are read through in order, so chunks which have been fully read can be evicted first (w0 = 1).  The
+    // number of slots should be a prime ~100 times the number of chunks which fit in the cache.
+    rdcc_nbytes = (size_t)params->TreesChunkCacheMB << 20;
+    H5Pset_cache(fapl_id, mdc_nelmts, 10007, rdcc_nbytes, 1.0);
+  }
+
+  if (params->TreesMetadataCacheMB > 0) {
+    H5AC_cache_config_t mdc_config = { .version = H5AC__CURR_CACHE_CONFIG_VERSION };
+    H5Pget_mdc_config(fapl_id, &mdc_config);
+    mdc_config.set_initial_size = true;
+    mdc_config.initial_size = (size_t)params->TreesMetadataCacheMB << 20;
+    if (mdc_config.max_size < mdc_config.initial_size)
+      mdc_config.max_size = mdc_config.initial_size;
+    if (mdc_config.min_size > mdc_config.initial_size)
+      mdc_config.min_size = mdc_config.initial_size;
+    H5Pset_mdc_config(fapl_id, &mdc_config);
+  }
+
+  hid_t fd = H5Fopen(fname, H5F_ACC_RDONLY, fapl_id);
+  H5Pclose(fapl_id);
+  cache_stats.n_file_opens++;
+
+  return fd;
+}
+
+static void evict_tree_dataset(tree_dataset_entry_t* dataset)
+{
+  H5Dclose(dataset->id);
+  cache_stats.n_dataset_closes++;
+  dataset->id = -1;
+}
+
+static void evict_tree_file(tree_file_entry_t* file)
+{
+  for (int ii = 0; ii < file->n_datasets; ii++)
+    evict_tree_dataset(&file->datasets[ii]);
+  file->n_datasets = 0;
+
+  H5Fclose(file->id);
+  cache_stats.n_file_closes++;
+  file->id = -1;
+}
+
+static tree_file_entry_t* find_cached_file(hid_t fd)
+{
+  for (int ii = 0; ii < n_cached_files; ii++)
+    if (cached_files[ii].id == fd)
+      return &cached_files[ii];
+
+  return NULL;
+}
+
+static bool dataset_is_cached(hid_t dset_id)
+{
+  for (int ii = 0; ii < n_cached_files; ii++)
+    for (int jj = 0; jj < cached_files[ii].n_datasets; jj++)
+      if (cached_files[ii].datasets[jj].id == dset_id)
+        return true;
+
+  return false;
+}
+
+hid_t tree_file_open(const char* fname)
+{
+  int max_open_files = run_globals.params.TreesMaxOpenFiles;
+
+  cache_stats.n_file_requests++;
+
+  if ((max_open_files <= 0) || (strlen(fname) >= sizeof(cached_files[0].fname)))
+    return open_tree_file(fname);
+
+  if (cached_files == NULL) {
+    cached_files = malloc(sizeof(tree_file_entry_t) * (size_t)max_open_files);
+    n_cached_files = 0;
+  }
+
+  for (int ii = 0; ii < n_cached_files; ii++)
+    if (strcmp(cached_files[ii].fname, fname) == 0) {
+      cached_files[ii].last_used = ++cache_clock;
+      return cached_files[ii].id;
+    }
+
+  hid_t fd = open_tree_file(fname);
+  if (fd < 0)
+    return fd;
+
+  tree_file_entry_t* file = NULL;
+  if (n_cached_files < max_open_files)
+    file = &cached_files[n_cached_files++];
+  else {
+    file = &cached_files[0];
+    for (int ii = 1; ii < n_cached_files; ii++)
+      if (cached_files[ii].last_used < file->last_used)
+        file = &cached_files[ii];
+    evict_tree_file(file);
+  }
+
+  strcpy(file->fname, fname);
+  file->id = fd;
+  file->last_used = ++cache_clock;
+  file->n_datasets = 0;
+
+  return fd;
+}
+
+void tree_file_close(hid_t fd)
+{
+  if (find_cached_file(fd) == NULL) {
+    H5Fclose(fd);
+    cache_stats.n_file_closes++;
+  }
+}
+
+hid_t tree_dataset_open(hid_t fd, const char* path)
+{
+  tree_file_entry_t* file = find_cached_file(fd);
+
+  cache_stats.n_dataset_requests++;
+
+  if ((file == NULL) || (strlen(path) >= TREE_CACHE_PATH_LEN)) {
+    cache_stats.n_dataset_opens++;
+    return H5Dopen(fd, path, H5P_DEFAULT);
+  }
+
+  for (int ii = 0; ii < file->n_datasets; ii++)
+    if (strcmp(file->datasets[ii].path, path) == 0) {
+      file->datasets[ii].last_used = ++cache_clock;
+      return file->datasets[ii].id;
+    }
+
+  hid_t dset_id = H5Dopen(fd, path, H5P_DEFAULT);
+  cache_stats.n_dataset_opens++;
+  if (dset_id < 0)
+    return dset_id;
+
+  tree_dataset_entry_t* dataset = NULL;
+  if (file->n_datasets < TREE_CACHE_MAX_DATASETS)
+    dataset = &file->datasets[file->n_datasets++];
+  else {
+    dataset = &file->datasets[0];
+    for (int ii = 1; ii < file->n_datasets; ii++)
+      if (file->datasets[ii].last_used < dataset->last_used)
+        dataset = &file->datasets[ii];
+    evict_tree_dataset(dataset);
+  }
+
+  strcpy(dataset->path, path);
+  dataset->id = dset_id;
+  dataset->last_used = ++cache_clock;
+
+  return dset_id;
+}
+
+void tree_dataset_close(hid_t dset_id)
+{
+  if (!dataset_is_cached(dset_id)) {
+    H5Dclose(dset_id);
+    cache_stats.n_dataset_closes++;
+  }
+}
+
+void close_tree_file_cache()
+{
+  for (int ii = 0; ii < n_cached_files; ii++)
+    evict_tree_file(&cached_files[ii]);
+  free(cached_files);
+  cached_files = NULL;
+  n_cached_files = 0;
+
+  if (cache_stats.n_file_requests > 0)
+    mlog("Tree file cache: opened %ld of %ld requested files and %ld of %ld requested datasets",
+         MLOG_MESG,
+         cache_stats.n_file_opens,
+         cache_stats.n_file_requests,
+         cache_stats.n_dataset_opens,
+         cache_stats.n_dataset_requests);
+}
+
+tree_file_cache_stats_t get_tree_file_cache_stats()
+{
+  return cache_stats;
+}
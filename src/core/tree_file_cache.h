@@ -0,0 +1,37 @@
+#ifndef TREE_FILE_CACHE_H
+#define TREE_FILE_CACHE_H
+
+#include <hdf5.h>
+
+// Maximum number of datasets kept open in each cached file
+#define TREE_CACHE_MAX_DATASETS 32
+#define TREE_CACHE_PATH_LEN 128
+
+//! Counts of the handles requested from, and opened and closed by, the tree file cache
+typedef struct tree_file_cache_stats_t
+{
+  long n_file_requests;
+  long n_file_opens;
+  long n_file_closes;
+  long n_dataset_requests;
+  long n_dataset_opens;
+  long n_dataset_closes;
+} tree_file_cache_stats_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  hid_t tree_file_open(const char* fname);
+  void tree_file_close(hid_t fd);
+  hid_t tree_dataset_open(hid_t fd, const char* path);
+  void tree_dataset_close(hid_t dset_id);
+  void close_tree_file_cache(void);
+  tree_file_cache_stats_t get_tree_file_cache_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
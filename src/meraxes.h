@@ -44,6 +44,17 @@
 #define ABS_TOL (float)1e-8
 // ======================================================
 
+#ifdef CALC_MAGS
+// The galaxy flux accumulators dominate the size of galaxy_t.  In single
+// precision every burst's contribution is still summed in double before being
+// rounded, so the relative error grows by at most 2^-24 per burst.
+#ifdef MAGS_FLOAT_FLUXES
+typedef float flux_t;
+#else
+typedef double flux_t;
+#endif
+#endif
+
 // Define things used for aborting exceptions
 #ifdef __cplusplus
 extern "C"
@@ -206,6 +217,12 @@ enum tree_ids
   GBPTREES_TREES
 };
 
+enum galaxy_output_layouts
+{
+  GALAXY_OUTPUT_TABLE,  //!< single H5TB compound table per snapshot
+  GALAXY_OUTPUT_COLUMNS //!< one chunked dataset per galaxy property
+};
+
 //! Run params
 //! Everything in this structure is supplied by the user...
 typedef struct run_params_t
@@ -236,6 +253,15 @@ typedef struct run_params_t
   char MassRatioModifier[STRLEN];
   char BaryonFracModifier[STRLEN];
   char FFTW3WisdomDir[STRLEN];
+  char GalaxyOutputProps[STRLEN];
+  char GridsInputFilter[STRLEN];
+  char GridsInputChunks[STRLEN];
+  char GridsOutputFilter[STRLEN];
+  char GridsOutputChunks[STRLEN];
+  char WalkIndicesFilter[STRLEN];
+  char WalkIndicesChunks[STRLEN];
+  char GridCacheDir[STRLEN];
+  char StellarFeedbackCacheDir[STRLEN];
 
   physics_params_t physics;
 
@@ -257,6 +283,10 @@ typedef struct run_params_t
   double* MvirCrit_MC;
 
   double ReionDeltaRFactor;
+  double ReionAdaptiveRTol;
+  int ReionActiveCellLists;
+  int ReionBatchedFFTs;
+  int ReionPencilDecomposition;
   double ReionPowerSpecDeltaK;
   int ReionGridDim;
   int ReionFilterType;
@@ -264,11 +294,13 @@ typedef struct run_params_t
   int ReionRtoMFilterType;
   int ReionUVBFlag;
   int MetalGridDim;
+  int MetalFusedGrids;
 
   enum tree_ids TreesID;
   int FirstFile;
   int LastFile;
   int NSteps;
+  int SkipQuiescentFOFGroups;
   int SnaplistLength;
   int RandomSeed;
   int FlagSubhaloVirialProps;
@@ -287,6 +319,8 @@ typedef struct run_params_t
 
   int TsVelocityComponent;
   int TsNumFilterSteps;
+  int TsNumThreads;
+  int TsCompactSFRHistory;
 
   double ReionSfrTimescale;
 
@@ -298,6 +332,11 @@ typedef struct run_params_t
   int Flag_OutputGrids;
   int Flag_OutputGridsPostReion;
   int FlagIgnoreProgIndex;
+  int GalaxyOutputLayout;
+  int GalaxyOutputDeflate;
+  int TreesMaxOpenFiles;
+  int TreesChunkCacheMB;
+  int TreesMetadataCacheMB;
 } run_params_t;
 
 typedef struct run_units_t
@@ -325,6 +364,7 @@ typedef struct hdf5_output_t
   const char** field_units;
   const char** field_h_conv;
   hid_t* field_types;
+  int* field_deflate; // deflate level of each column (-1 => column not written)
   size_t dst_size;
   hid_t array3f_tid; // sizeof(hid_t) = 4
   hid_t array_nmag_f_tid;
@@ -342,8 +382,10 @@ typedef struct metal_grids_t // New stuff for MetalEvo, probably you will need t
   ptrdiff_t* slab_ix_start_metals;
 
   float* buffer_metals;
+  float* buffer_records_metals; //!< interleaved properties of each cell (MetalFusedGrids)
 
   struct gal_to_slab_t* galaxy_to_slab_map_metals;
+  int* slab_gal_offsets_metals; //!< [mpi_size + 1] start of each slab's galaxies in galaxy_to_slab_map_metals
 
   double volume_ave_ZIGM;        // Is it necessary? Maybe this one could be used as a log message
   double volume_ave_mass_metals; // Is it necessary?
@@ -440,9 +482,12 @@ typedef struct reion_grids_t
   float* TS_boxII;
 #endif
 
+  // Filtered SFR history; either in double with the radii innermost, or (TsCompactSFRHistory) in float blocked cells
   double* SMOOTHED_SFR_GAL;
+  float* SMOOTHED_SFR_GAL_blocked;
 #if USE_MINI_HALOS
   double* SMOOTHED_SFR_III;
+  float* SMOOTHED_SFR_III_blocked;
 #endif
 
   // Grids necessary for LW background and future disentangling between MC/AC Pop3/Pop2 stuff
@@ -490,10 +535,12 @@ typedef struct reion_grids_t
 #endif
 
   struct gal_to_slab_t* galaxy_to_slab_map;
+  int* slab_gal_offsets; //!< [mpi_size + 1] start of each slab's galaxies in galaxy_to_slab_map
 
   double volume_weighted_global_xH;
   double volume_weighted_global_J_21;
   double mass_weighted_global_xH;
+  int n_filter_steps; //!< number of radii filtered by the last (CPU) find_HII_bubbles call
 
   double volume_ave_J_alpha;
   double volume_ave_xalpha;
@@ -517,6 +564,13 @@ typedef struct reion_grids_t
   int finished;
   int buffer_size;
   bool flag_wisdom;
+
+  // Batched inverse transforms of the fields filtered at each R (ReionBatchedFFTs)
+  struct filter_batch_t* HII_filter_batch;
+  struct filter_batch_t* Ts_filter_batch;
+
+  // 2D process grid used by find_HII_bubbles for the radius loop (ReionPencilDecomposition)
+  struct pencil_decomp_t* pencil;
 } reion_grids_t;
 
 typedef struct galaxy_t
@@ -529,11 +583,11 @@ typedef struct galaxy_t
   double NewMetals[N_HISTORY_SNAPS];
 
 #ifdef CALC_MAGS
-  double inBCFlux[MAGS_N];
-  double outBCFlux[MAGS_N];
+  flux_t inBCFlux[MAGS_N];
+  flux_t outBCFlux[MAGS_N];
 #if USE_MINI_HALOS
-  double inBCFluxIII[MAGS_N];
-  double outBCFluxIII[MAGS_N];
+  flux_t inBCFluxIII[MAGS_N];
+  flux_t outBCFluxIII[MAGS_N];
 #endif
 #endif
 
@@ -612,6 +666,7 @@ typedef struct galaxy_t
   double Prefactor[N_HISTORY_SNAPS]; // here you store the prefactors of the metal bubbles
   double Times[N_HISTORY_SNAPS];     // Time at which the SN explode!
   double Radii[N_HISTORY_SNAPS];
+  int BubbleHead; //!< position of the newest bubble in the Prefactor and Times ring buffers
 #endif
 
   // baryonic hostories
@@ -725,6 +780,9 @@ typedef struct mag_params_t
   double* outBC;
   double* centreWaves;
   double* logWaves;
+  // Per-band ISM and birth cloud optical depths of the dust model, per unit of a galaxy's dust factor
+  double dustTauISM[MAGS_N_BANDS];
+  double dustTauBC[MAGS_N_BANDS];
 #ifdef USE_MINI_HALOS
   size_t totalSizeIII;
   double* workingIII;
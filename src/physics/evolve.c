@@ -15,6 +15,115 @@
 #include "supernova_feedback.h"
 #include <math.h>
 
+static inline bool reservoirs_are_valid(galaxy_t* gal)
+{
+  // update_reservoirs_from_sn_feedback clamps any negative reservoirs to zero
+  return (gal->HotGas >= 0) && (gal->MetalsHotGas >= 0) && (gal->ColdGas >= 0) && (gal->MetalsColdGas >= 0) &&
+         (gal->EjectedGas >= 0) && (gal->MetalsEjectedGas >= 0) && (gal->StellarMass >= 0) &&
+#if USE_MINI_HALOS
+         (gal->StellarMass_II >= 0) && (gal->StellarMass_III >= 0) && (gal->Remnant_Mass >= 0) &&
+#endif
+         (gal->MetalsStellarMass >= 0);
+}
+
+bool fof_group_is_quiescent(fof_group_t* fof_group, double infalling_gas, int snapshot)
+{
+  /*
+   * Returns true if the substeps of evolve_galaxies would leave this FOF
+   * group unchanged, other than counting down the merger clocks of its
+   * satellites and stripping any metals left in the hot halo of its central.
+   * Such groups are evolved by evolve_quiescent_fof_group instead.
+   *
+   * This is conservative: a group is evolved as normal if it has any hot or
+   * ejected gas, cold gas (above the floor of insitu_star_formation),
+   * accreting black holes, bursts within the delayed feedback window or a
+   * merger due this snapshot.  Must be called after gas_infall.
+   */
+
+  int NSteps = run_globals.params.NSteps;
+  int n_bursts = (snapshot >= N_HISTORY_SNAPS) ? N_HISTORY_SNAPS : snapshot;
+  bool Flag_IRA = (bool)(run_globals.params.physics.Flag_IRA);
+
+#if USE_MINI_HALOS
+  // The metal bubbles grow every substep
+  if (run_globals.params.Flag_IncludeMetalEvo)
+    return false;
+#endif
+
+  if (!(infalling_gas <= 0))
+    return false;
+
+  for (halo_t* halo = fof_group->FirstHalo; halo != NULL; halo = halo->NextHaloInFOFGroup)
+    for (galaxy_t* gal = halo->Galaxy; gal != NULL; gal = gal->NextGalInHalo) {
+      if (gal->Type == 3)
+        continue;
+
+      if (!reservoirs_are_valid(gal) || (gal->ColdGas > 1e-10) || (gal->BlackHoleAccretingColdMass > 0))
+        return false;
+
+      // Cooling, infall and reincorporation
+      if ((gal->Type == 0) && ((gal->HotGas != 0) || (gal->EjectedGas != 0)))
+        return false;
+
+      if (!Flag_IRA)
+        for (int i_burst = 1; i_burst < n_bursts; i_burst++)
+#if USE_MINI_HALOS
+          if (gal->NewStars_II[i_burst] + gal->NewStars_III[i_burst] > 1e-10)
+#else
+          if (gal->NewStars[i_burst] > 1e-10)
+#endif
+            return false;
+
+      if (gal->Type == 2) {
+        if (gal->MergerTarget->Type == 3)
+          return false;
+
+        double merg_time = gal->MergTime;
+        for (int i_step = 0; i_step < NSteps; i_step++) {
+          merg_time -= gal->dt;
+          if (merg_time < 0)
+            return false;
+        }
+      }
+    }
+
+  return true;
+}
+
+static int evolve_quiescent_fof_group(fof_group_t* fof_group, double infalling_gas)
+{
+  // The net effect of the substeps of evolve_galaxies on a quiescent FOF group
+  // (see fof_group_is_quiescent).  Returns the number of galaxies in the group.
+  int NSteps = run_globals.params.NSteps;
+  int n_gals = 0;
+
+  for (halo_t* halo = fof_group->FirstHalo; halo != NULL; halo = halo->NextHaloInFOFGroup)
+    for (galaxy_t* gal = halo->Galaxy; gal != NULL; gal = gal->NextGalInHalo) {
+      if (gal->Type == 0) {
+        // With no hot or ejected gas, stripping empties the hot halo in the
+        // first substep and does nothing after that
+        add_infall_to_hot(gal, infalling_gas / ((double)NSteps));
+        gal->Mcool = 0.0;
+      }
+
+      if (gal->Type < 3) {
+#if USE_MINI_HALOS
+        if ((calc_metallicity(gal->ColdGas, gal->MetalsColdGas) / 0.01) > run_globals.params.physics.ZCrit)
+          gal->Galaxy_Population = 2;
+        else
+          gal->Galaxy_Population = 3;
+#endif
+        if (gal->Type == 2)
+          for (int i_step = 0; i_step < NSteps; i_step++)
+            gal->MergTime -= gal->dt;
+      }
+
+      n_gals++;
+    }
+
+  return n_gals;
+}
+
 //! Evolve existing galaxies forward in time
 #if USE_MINI_HALOS
 int evolve_galaxies(fof_group_t* fof_group,
@@ -32,10 +141,13 @@ int evolve_galaxies(fof_group_t* fof_group, int snapshot, int NGal, int NFof)
   halo_t* halo = NULL;
   int gal_counter = 0;
   int dead_gals = 0;
+  int n_quiescent = 0;
+  int n_occupied = 0;
   double infalling_gas = 0;
   double cooling_mass = 0;
   int NSteps = run_globals.params.NSteps;
   bool Flag_IRA = (bool)(run_globals.params.physics.Flag_IRA);
+  bool skip_quiescent = (bool)(run_globals.params.SkipQuiescentFOFGroups);
 #if USE_MINI_HALOS
   double DiskMetallicity; // Need this to compute the internal enrichment in a more accurate way
   bool Flag_Metals = (bool)(run_globals.params.Flag_IncludeMetalEvo);
@@ -51,6 +163,13 @@ int evolve_galaxies(fof_group_t* fof_group, int snapshot, int NGal, int NFof)
       continue;
 
     infalling_gas = gas_infall(&(fof_group[i_fof]), snapshot);
+    n_occupied++;
+
+    if (skip_quiescent && fof_group_is_quiescent(&(fof_group[i_fof]), infalling_gas, snapshot)) {
+      gal_counter += evolve_quiescent_fof_group(&(fof_group[i_fof]), infalling_gas);
+      n_quiescent++;
+      continue;
+    }
 
     for (int i_step = 0; i_step < NSteps; i_step++) {
       halo = fof_group[i_fof].FirstHalo;
@@ -160,6 +279,9 @@ int evolve_galaxies(fof_group_t* fof_group, int snapshot, int NGal, int NFof)
     ABORT(EXIT_FAILURE);
   }
 
+  if (skip_quiescent)
+    mlog("%d of %d occupied FOF groups were quiescent", MLOG_MESG, n_quiescent, n_occupied);
+
   mlog("...done", MLOG_CLOSE | MLOG_TIMERSTOP);
 
   return gal_counter - dead_gals;
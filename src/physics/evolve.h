@@ -2,6 +2,7 @@
 #define EVOLVE_H
 
 #include "meraxes.h"
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -19,6 +20,7 @@ extern "C"
 #else
 int evolve_galaxies(fof_group_t* fof_group, int snapshot, int NGal, int NFof);
 #endif
+  bool fof_group_is_quiescent(fof_group_t* fof_group, double infalling_gas, int snapshot);
   void passively_evolve_ghost(struct galaxy_t* gal, int snapshot);
 
 #ifdef __cplusplus
@@ -269,7 +269,15 @@ void delayed_supernova_feedback(galaxy_t* gal, int snapshot)
 
   // Loop through each of the last `N_HISTORY_SNAPS` recorded stellar mass
   // bursts and calculate the amount of energy and mass that they will release
-  // in the current time step.
+  // in the current time step.  The Pop. II feedback of all of the bursts is
+  // then looked up in one pass, with the bursts that formed no stars given zero
+  // mass.
+  double m_stars_hist[N_HISTORY_SNAPS] = { 0.0 };
+  double metallicity_hist[N_HISTORY_SNAPS] = { 0.0 };
+#if USE_MINI_HALOS
+  double new_metals_III = 0.0;
+#endif
+
   for (int i_burst = 1; i_burst < n_bursts; i_burst++) {
 #if USE_MINI_HALOS
     m_stars_II = gal->NewStars_II[i_burst];
@@ -281,30 +289,25 @@ void delayed_supernova_feedback(galaxy_t* gal, int snapshot)
 
     // Only need to do this if any stars formed in this history bin
     if (m_stars > 1e-10) {
-      double metallicity = calc_metallicity(m_stars, gal->NewMetals[i_burst]);
-      // Calculate recycled mass and metals by yield tables
-
-      m_recycled_II += m_stars_II * get_recycling_fraction(i_burst, metallicity);
+      m_stars_hist[i_burst] = m_stars_II;
+      metallicity_hist[i_burst] = calc_metallicity(m_stars, gal->NewMetals[i_burst]);
 #if USE_MINI_HALOS
-      m_recycled_III +=
-        m_stars_III * CCSN_PopIII_Yield(i_burst, snapshot, 0) * MassSNII; // Only CCSN have delayed feedback
-#endif
-
-      new_metals += m_stars_II * get_metal_yield(i_burst, metallicity);
-#if USE_MINI_HALOS
-      new_metals += m_stars_III * CCSN_PopIII_Yield(i_burst, snapshot, 1) * MassSNII;
+      // Only CCSN have delayed feedback
+      m_recycled_III += m_stars_III * CCSN_PopIII_Yield(i_burst, snapshot, 0) * MassSNII;
+      new_metals_III += m_stars_III * CCSN_PopIII_Yield(i_burst, snapshot, 1) * MassSNII;
       m_remnant += m_stars_III * CCSN_PopIII_Yield(i_burst, snapshot, 2) * MassSNII; // Remnants from Pop. III
-#endif
-      // Calculate SNII energy
-
-      sn_energy_II += get_SN_energy(i_burst, metallicity) * m_stars_II;
-#if USE_MINI_HALOS
       sn_energy_III +=
         get_SN_energy_PopIII(i_burst, snapshot, 0) * m_stars_III; // This is DeltaM reheat (eq.16 Mutch+16) * ENOVA
 #endif
     }
   }
 
+  // Calculate recycled mass and metals by yield tables, and SNII energy
+  get_burst_history_feedback(m_stars_hist, metallicity_hist, 1, n_bursts, &m_recycled_II, &new_metals, &sn_energy_II);
+#if USE_MINI_HALOS
+  new_metals += new_metals_III;
+#endif
+
   m_reheat_II = calc_sn_reheat_eff(gal, snapshot, 2) * sn_energy_II / get_total_SN_energy();
   sn_energy_II *= calc_sn_ejection_eff(gal, snapshot, 2);
 #if USE_MINI_HALOS
@@ -481,6 +484,8 @@ void contemporaneous_supernova_feedback(galaxy_t* gal,
 void calc_metal_bubble(galaxy_t* gal, int snapshot) // result in internal units (Mpc/h) This new function assumes that a
                                                     // bubble will overtake a previous one in no more than 17 snapshots!
 {
+  // Prefactor and Times are ring buffers, with the bubble from `i_burst` snapshots ago at
+  // (BubbleHead + i_burst) % N_HISTORY_SNAPS.  Radii is indexed by i_burst directly.
   int n_bursts = (snapshot >= N_HISTORY_SNAPS) ? N_HISTORY_SNAPS : snapshot;
 
   double UnitMass_in_g = run_globals.units.UnitMass_in_g;
@@ -501,65 +506,80 @@ void calc_metal_bubble(galaxy_t* gal, int snapshot) // result in internal units
                 (4.0 * M_PI / 3.0 * pow(gal->Rvir * UnitLength_in_cm, 3.)); // cm^-3
   IGM_density = gal->Gas_IGM * UnitMass_in_g / PROTONMASS *
                 pow(pixel_length_metals / (1.0 + run_globals.ZZ[snapshot]) * UnitLength_in_cm, -3.);
+
+  // These are the same for every bubble of this galaxy
+  double gas_density_factor = pow(gas_density, -0.2);
+  double IGM_density_factor = pow(IGM_density, -0.2);
+  double time_now = run_globals.LTTime[snapshot] * time_unit;
+
   // First evolve the existing RmetalBubble (you do this also for the ghost galaxies).
 
   if (gal->RmetalBubble > 0.) {
     if ((gal->RmetalBubble <= gal->Rvir) && (gas_density >= IGM_density))
-      gal->RmetalBubble = gal->PrefactorBubble * pow(gas_density, -0.2) *
-                          pow((gal->TimeBubble - run_globals.LTTime[snapshot] * time_unit), 0.4);
+      gal->RmetalBubble = gal->PrefactorBubble * gas_density_factor * pow((gal->TimeBubble - time_now), 0.4);
     else
-      gal->RmetalBubble = gal->PrefactorBubble * pow(IGM_density, -0.2) *
-                          pow((gal->TimeBubble - run_globals.LTTime[snapshot] * time_unit), 0.4);
+      gal->RmetalBubble = gal->PrefactorBubble * IGM_density_factor * pow((gal->TimeBubble - time_now), 0.4);
   }
 
   if (gal->Type == 0) {
+    // Compute the SN energy that drives the metal bubble.
+    double sn_ejection_eff_II = -1.0;
+    double sn_ejection_eff_III = -1.0;
+
     for (int i_burst = 0; i_burst < n_bursts; i_burst++) {
       double m_stars_II = gal->NewStars_II[i_burst];
       double m_stars_III = gal->NewStars_III[i_burst];
       double m_stars = m_stars_II + m_stars_III;
 
-      // Compute the SN energy that drives the metal bubble.
       if (m_stars_II > 1e-10) {
         double metallicity = calc_metallicity(m_stars, gal->NewMetals[i_burst]);
-        sn_energy += m_stars_II * get_SN_energy(0, metallicity) * energy_unit * calc_sn_ejection_eff(gal, snapshot, 2);
+        if (sn_ejection_eff_II < 0)
+          sn_ejection_eff_II = calc_sn_ejection_eff(gal, snapshot, 2);
+        sn_energy += m_stars_II * get_SN_energy(0, metallicity) * energy_unit * sn_ejection_eff_II;
       } else if (m_stars_III > 1e-10) {
+        if (sn_ejection_eff_III < 0)
+          sn_ejection_eff_III = calc_sn_ejection_eff(gal, snapshot, 3);
         if (i_burst == 0) // You have both CC and PISN
           sn_energy += (get_SN_energy_PopIII(i_burst, snapshot, 0) + get_SN_energy_PopIII(i_burst, snapshot, 1)) *
-                       m_stars_III * calc_sn_ejection_eff(gal, snapshot, 3);
+                       m_stars_III * sn_ejection_eff_III;
         else
-          sn_energy +=
-            get_SN_energy_PopIII(i_burst, snapshot, 0) * m_stars_III * calc_sn_ejection_eff(gal, snapshot, 3);
+          sn_energy += get_SN_energy_PopIII(i_burst, snapshot, 0) * m_stars_III * sn_ejection_eff_III;
       }
-      if (i_burst != 0) {
-        gal->Prefactor[n_bursts - i_burst] = gal->Prefactor[n_bursts - i_burst - 1];
-        gal->Times[n_bursts - i_burst] = gal->Times[n_bursts - i_burst - 1];
-        if (gal->Prefactor[n_bursts - i_burst] > 0.0) {
-          if ((gal->Radii[n_bursts - i_burst] >= gal->Rvir) || (IGM_density >= gas_density))
-            gal->Radii[n_bursts - i_burst] =
-              gal->Prefactor[n_bursts - i_burst] * pow(IGM_density, -0.2) *
-              pow((gal->Times[n_bursts - i_burst] - run_globals.LTTime[snapshot] * time_unit), 0.4);
-          else
-            gal->Radii[n_bursts - i_burst] =
-              gal->Prefactor[n_bursts - i_burst] * pow(gas_density, -0.2) *
-              pow((gal->Times[n_bursts - i_burst] - run_globals.LTTime[snapshot] * time_unit), 0.4);
-        } else
-          gal->Radii[n_bursts - i_burst] = 0.0;
-        if (gal->Radii[n_bursts - i_burst] > gal->RmetalBubble) {
-          // Look if one of the new bubbles is bigger than RmetalBubble
-          // and in this case this will be the new metal bubble associated to the galaxy.
-          gal->RmetalBubble = gal->Radii[n_bursts - i_burst];
-          gal->PrefactorBubble = gal->Prefactor[n_bursts - i_burst];
-          gal->TimeBubble = gal->Times[n_bursts - i_burst];
-        }
+    }
+
+    // Age the stored bubbles by a snapshot (the oldest one is dropped) and evolve them, from oldest to newest
+    if (n_bursts > 1)
+      gal->BubbleHead = (gal->BubbleHead + N_HISTORY_SNAPS - 1) % N_HISTORY_SNAPS;
+
+    for (int i_burst = n_bursts - 1; i_burst > 0; i_burst--) {
+      int i_ring = (gal->BubbleHead + i_burst) % N_HISTORY_SNAPS;
+      double prefactor = gal->Prefactor[i_ring];
+
+      if (prefactor > 0.0) {
+        if ((gal->Radii[i_burst] >= gal->Rvir) || (IGM_density >= gas_density))
+          gal->Radii[i_burst] = prefactor * IGM_density_factor * pow((gal->Times[i_ring] - time_now), 0.4);
+        else
+          gal->Radii[i_burst] = prefactor * gas_density_factor * pow((gal->Times[i_ring] - time_now), 0.4);
+      } else
+        gal->Radii[i_burst] = 0.0;
+
+      if (gal->Radii[i_burst] > gal->RmetalBubble) {
+        // Look if one of the new bubbles is bigger than RmetalBubble
+        // and in this case this will be the new metal bubble associated to the galaxy.
+        gal->RmetalBubble = gal->Radii[i_burst];
+        gal->PrefactorBubble = prefactor;
+        gal->TimeBubble = gal->Times[i_ring];
       }
     }
   }
+
+  int i_newest = gal->BubbleHead;
   if (!gal->ghost_flag) {
-    gal->Prefactor[0] = pow(sn_energy / PROTONMASS, 0.2) / UnitLength_in_cm; // Mpc s^-0.4
-    gal->Times[0] = run_globals.LTTime[snapshot] * time_unit;                // s
+    gal->Prefactor[i_newest] = pow(sn_energy / PROTONMASS, 0.2) / UnitLength_in_cm; // Mpc s^-0.4
+    gal->Times[i_newest] = time_now;                                                 // s
   } else {
-    gal->Prefactor[0] = 0.0;
-    gal->Times[0] = 0.0;
+    gal->Prefactor[i_newest] = 0.0;
+    gal->Times[i_newest] = 0.0;
   }
   gal->Radii[0] = 0.0;
 }
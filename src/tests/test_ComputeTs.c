@@ -0,0 +1,369 @@
+#define _MAIN
+#include "../core/ComputeTs.h"
+#include "../core/XRayHeatingFunctions.h"
+#include "../core/misc_tools.h"
+#include "../core/reionization.h"
+#include <criterion/criterion.h>
+#include <math.h>
+#include <meraxes.h>
+#include <mpi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GRID_DIM 8
+#define N_FILTER_STEPS 6
+
+static const int n_padded = GRID_DIM * GRID_DIM * 2 * (GRID_DIM / 2 + 1);
+static const int n_real = GRID_DIM * GRID_DIM * GRID_DIM;
+
+#define SFR_BLOCKED_UNITS 1e-80
+
+static double smoothed_sfr[GRID_DIM * GRID_DIM * GRID_DIM * N_FILTER_STEPS];
+static float smoothed_sfr_blocked[GRID_DIM * GRID_DIM * GRID_DIM * N_FILTER_STEPS];
+static double freq_int_heat_tbl[x_int_NXHII * N_FILTER_STEPS];
+static double freq_int_ion_tbl[x_int_NXHII * N_FILTER_STEPS];
+static double freq_int_lya_tbl[x_int_NXHII * N_FILTER_STEPS];
+
+void setup(void)
+{
+  int argc = 0;
+  char** argv = NULL;
+
+  MPI_Init(&argc, &argv);
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  run_globals.mpi_rank = 0;
+  run_globals.mpi_size = 1;
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  run_params_t* params = &(run_globals.params);
+  sprintf(params->TablesForXHeatingDir, "%s", TEST_TABLES_DIR);
+  params->TsNumFilterSteps = N_FILTER_STEPS;
+  params->Hubble_h = 0.678;
+  params->OmegaM = 0.308;
+  params->OmegaLambda = 0.692;
+  params->OmegaR = 0.0;
+  params->OmegaK = 0.0;
+  params->wLambda = -1.0;
+  params->BaryonFrac = 0.157;
+  params->physics.Y_He = 0.24;
+  params->physics.SpecIndexXrayGal = 1.0;
+  params->Flag_IncludeLymanWerner = 0;
+
+  cr_assert_eq(init_heat(), 0);
+
+  // Per-snapshot globals normally set up by _ComputeTs
+  const double zp = 15.0;
+  dt_dzp = dtdz((float)zp);
+  growth_factor_zp = dicke(zp);
+  dgrowth_factor_dzp = ddicke_dz(zp);
+  const_zp_prefactor_GAL = 1.0;
+  for (int R_ct = 0; R_ct < N_FILTER_STEPS; R_ct++) {
+    zpp_edge[R_ct] = zp + 0.5 * (R_ct + 1);
+    double zpp = zpp_edge[R_ct] - 0.25;
+
+    sum_lyn[R_ct] = 0.0;
+    for (int n_ct = NSPEC_MAX; n_ct >= 2; n_ct--) {
+      if (zpp > zmax((float)zp, n_ct))
+        continue;
+      sum_lyn[R_ct] += frecycle(n_ct) * spectral_emissivity(nu_n(n_ct) * (1 + zpp) / (1.0 + zp), 0, 2);
+    }
+  }
+  dt_dzpp = dtdz((float)(zpp_edge[N_FILTER_STEPS - 1] - 0.25));
+
+  // Synthetic, but roughly realistic, input fields
+  srand(42);
+  for (int ii = 0; ii < GRID_DIM * GRID_DIM * GRID_DIM * N_FILTER_STEPS; ii++)
+    smoothed_sfr[ii] = 1e-85 * (double)rand() / (double)RAND_MAX;
+  for (int ix = 0; ix < GRID_DIM; ix++)
+    for (int iy = 0; iy < GRID_DIM; iy++)
+      for (int iz = 0; iz < GRID_DIM; iz++)
+        for (int R_ct = 0; R_ct < N_FILTER_STEPS; R_ct++) {
+          int i_sfr = grid_index_smoothedSFR(R_ct, ix, iy, iz, N_FILTER_STEPS, GRID_DIM);
+          int i_blocked = grid_index_smoothedSFR_blocked(R_ct, ix, iy, iz, N_FILTER_STEPS, GRID_DIM);
+          smoothed_sfr_blocked[i_blocked] = (float)(smoothed_sfr[i_sfr] / SFR_BLOCKED_UNITS);
+        }
+  for (int ii = 0; ii < x_int_NXHII * N_FILTER_STEPS; ii++) {
+    double frac = 1.0 + (double)rand() / (double)RAND_MAX;
+    freq_int_heat_tbl[ii] = 1e39 * frac;
+    freq_int_ion_tbl[ii] = 1e51 * frac;
+    freq_int_lya_tbl[ii] = 1e52 * frac;
+  }
+
+  reion_grids_t* grids = &(run_globals.reion_grids);
+  grids->x_e_box_prev = calloc((size_t)n_padded, sizeof(float));
+  grids->deltax = calloc((size_t)n_padded, sizeof(float));
+  grids->Tk_box = calloc((size_t)n_real, sizeof(float));
+  grids->TS_box = calloc((size_t)n_real, sizeof(float));
+#if USE_MINI_HALOS
+  grids->Tk_boxII = calloc((size_t)n_real, sizeof(float));
+  grids->TS_boxII = calloc((size_t)n_real, sizeof(float));
+#endif
+  for (int ix = 0; ix < GRID_DIM; ix++)
+    for (int iy = 0; iy < GRID_DIM; iy++)
+      for (int iz = 0; iz < GRID_DIM; iz++) {
+        int i_padded = grid_index(ix, iy, iz, GRID_DIM, INDEX_PADDED);
+        int i_real = grid_index(ix, iy, iz, GRID_DIM, INDEX_REAL);
+        grids->deltax[i_padded] = (float)(2.0 * (double)rand() / (double)RAND_MAX - 0.9);
+        grids->x_e_box_prev[i_padded] = (float)(2e-4 * (1.0 + (double)rand() / (double)RAND_MAX));
+        grids->Tk_box[i_real] = (float)(10.0 + 20.0 * (double)rand() / (double)RAND_MAX);
+#if USE_MINI_HALOS
+        grids->Tk_boxII[i_real] = grids->Tk_box[i_real];
+#endif
+      }
+}
+
+void teardown(void)
+{
+  reion_grids_t* grids = &(run_globals.reion_grids);
+#if USE_MINI_HALOS
+  free(grids->TS_boxII);
+  free(grids->Tk_boxII);
+#endif
+  free(grids->TS_box);
+  free(grids->Tk_box);
+  free(grids->deltax);
+  free(grids->x_e_box_prev);
+  destruct_heat();
+  MPI_Finalize();
+}
+
+TestSuite(ComputeTs, .init = setup, .fini = teardown);
+
+static void run_cells(int n_threads, bool blocked, float* x_e, float* Tk, float* Ts, Ts_cell_sums_t* sums)
+{
+  reion_grids_t* grids = &(run_globals.reion_grids);
+  Ts_cell_inputs_t inputs = { .zp = 15.0,
+                              .dzp = -0.2,
+                              .local_nix = GRID_DIM,
+                              .grid_dim = GRID_DIM,
+                              .n_filter_steps = N_FILTER_STEPS,
+                              .no_light = 0,
+                              .SMOOTHED_SFR_GAL = blocked ? NULL : smoothed_sfr,
+                              .SMOOTHED_SFR_GAL_blocked = blocked ? smoothed_sfr_blocked : NULL,
+                              .SMOOTHED_SFR_blocked_units = SFR_BLOCKED_UNITS,
+                              .freq_int_heat_tbl_GAL = freq_int_heat_tbl,
+                              .freq_int_ion_tbl_GAL = freq_int_ion_tbl,
+                              .freq_int_lya_tbl_GAL = freq_int_lya_tbl,
+#if USE_MINI_HALOS
+                              .SMOOTHED_SFR_III = blocked ? NULL : smoothed_sfr,
+                              .SMOOTHED_SFR_III_blocked = blocked ? smoothed_sfr_blocked : NULL,
+                              .freq_int_heat_tbl_III = freq_int_heat_tbl,
+                              .freq_int_ion_tbl_III = freq_int_ion_tbl,
+                              .freq_int_lya_tbl_III = freq_int_lya_tbl,
+#endif
+  };
+
+  // always start from the same initial state
+  float* x_e_init = malloc(sizeof(float) * n_padded);
+  float* Tk_init = malloc(sizeof(float) * n_real);
+  memcpy(x_e_init, grids->x_e_box_prev, sizeof(float) * n_padded);
+  memcpy(Tk_init, grids->Tk_box, sizeof(float) * n_real);
+#if USE_MINI_HALOS
+  float* TkII_init = malloc(sizeof(float) * n_real);
+  memcpy(TkII_init, grids->Tk_boxII, sizeof(float) * n_real);
+#endif
+
+  evolve_Ts_cells(&inputs, n_threads, sums);
+
+  memcpy(x_e, grids->x_e_box_prev, sizeof(float) * n_padded);
+  memcpy(Tk, grids->Tk_box, sizeof(float) * n_real);
+  memcpy(Ts, grids->TS_box, sizeof(float) * n_real);
+
+  memcpy(grids->x_e_box_prev, x_e_init, sizeof(float) * n_padded);
+  memcpy(grids->Tk_box, Tk_init, sizeof(float) * n_real);
+#if USE_MINI_HALOS
+  memcpy(grids->Tk_boxII, TkII_init, sizeof(float) * n_real);
+  free(TkII_init);
+#endif
+  free(Tk_init);
+  free(x_e_init);
+}
+
+Test(ComputeTs, threaded_cells_match_serial)
+{
+  float *x_e[2], *Tk[2], *Ts[2];
+  Ts_cell_sums_t sums[2];
+  const int n_threads[2] = { 1, 4 };
+
+  for (int ii = 0; ii < 2; ii++) {
+    x_e[ii] = malloc(sizeof(float) * n_padded);
+    Tk[ii] = malloc(sizeof(float) * n_real);
+    Ts[ii] = malloc(sizeof(float) * n_real);
+    run_cells(n_threads[ii], false, x_e[ii], Tk[ii], Ts[ii], &(sums[ii]));
+  }
+
+  // the serial run should actually have done something...
+  cr_expect_neq(memcmp(Tk[0], run_globals.reion_grids.Tk_box, sizeof(float) * n_real), 0);
+  cr_expect(isfinite(Ts[0][0]));
+
+  // ...and the threaded run should reproduce it exactly
+  cr_expect_eq(memcmp(x_e[0], x_e[1], sizeof(float) * n_padded), 0);
+  cr_expect_eq(memcmp(Tk[0], Tk[1], sizeof(float) * n_real), 0);
+  cr_expect_eq(memcmp(Ts[0], Ts[1], sizeof(float) * n_real), 0);
+  cr_expect_eq(memcmp(&(sums[0]), &(sums[1]), sizeof(Ts_cell_sums_t)), 0);
+
+  for (int ii = 0; ii < 2; ii++) {
+    free(Ts[ii]);
+    free(Tk[ii]);
+    free(x_e[ii]);
+  }
+}
+
+Test(ComputeTs, blocked_float_sfr_history)
+{
+  float *x_e[2], *Tk[2], *Ts[2];
+  Ts_cell_sums_t sums[2];
+
+  // every (cell, radius) pair must map to a unique slot of the blocked array
+  bool* seen = calloc(GRID_DIM * GRID_DIM * GRID_DIM * N_FILTER_STEPS, sizeof(bool));
+  for (int ix = 0; ix < GRID_DIM; ix++)
+    for (int iy = 0; iy < GRID_DIM; iy++)
+      for (int iz = 0; iz < GRID_DIM; iz++)
+        for (int R_ct = 0; R_ct < N_FILTER_STEPS; R_ct++) {
+          int i_blocked = grid_index_smoothedSFR_blocked(R_ct, ix, iy, iz, N_FILTER_STEPS, GRID_DIM);
+          cr_expect(!seen[i_blocked]);
+          seen[i_blocked] = true;
+        }
+  free(seen);
+
+  for (int ii = 0; ii < 2; ii++) {
+    x_e[ii] = malloc(sizeof(float) * n_padded);
+    Tk[ii] = malloc(sizeof(float) * n_real);
+    Ts[ii] = malloc(sizeof(float) * n_real);
+    run_cells(1, ii == 1, x_e[ii], Tk[ii], Ts[ii], &(sums[ii]));
+  }
+
+  // storing the history in float should only perturb the results at the level of float rounding
+  const float rel_tol = 1e-5f;
+  for (int ix = 0; ix < GRID_DIM; ix++)
+    for (int iy = 0; iy < GRID_DIM; iy++)
+      for (int iz = 0; iz < GRID_DIM; iz++) {
+        int i_padded = grid_index(ix, iy, iz, GRID_DIM, INDEX_PADDED);
+        int i_real = grid_index(ix, iy, iz, GRID_DIM, INDEX_REAL);
+        cr_expect(isclosef(x_e[1][i_padded], x_e[0][i_padded], rel_tol, 0.0f));
+        cr_expect(isclosef(Tk[1][i_real], Tk[0][i_real], rel_tol, 0.0f));
+        cr_expect(isclosef(Ts[1][i_real], Ts[0][i_real], rel_tol, 0.0f));
+      }
+  cr_expect(isclosef((float)sums[1].Xheat, (float)sums[0].Xheat, rel_tol, 0.0f));
+  cr_expect(isclosef((float)sums[1].J_alpha, (float)sums[0].J_alpha, rel_tol, 0.0f));
+
+  for (int ii = 0; ii < 2; ii++) {
+    free(Ts[ii]);
+    free(Tk[ii]);
+    free(x_e[ii]);
+  }
+}
+
+static bool isclose_rel(double a, double b, double rel_tol)
+{
+  return fabs(a - b) <= rel_tol * fabs(b);
+}
+
+Test(ComputeTs, Ts_tables_match_direct)
+{
+  run_params_t* params = &(run_globals.params);
+  physics_params_t* physics = &(params->physics);
+  double ZZ[4] = { 20.0, 15.0, 12.0, 9.0 };
+  const double spec_index[2] = { 1.0, 0.8 };
+
+  params->SnaplistLength = 4;
+  params->BoxSize = 67.8;
+  params->ReionGridDim = GRID_DIM;
+  physics->NuXrayGalThreshold = 500.0;
+  physics->NuXraySoftCut = 2000.0;
+  physics->LXrayGal = 1e40;
+  run_globals.ZZ = ZZ;
+
+  for (int i_spec = 0; i_spec < 2; i_spec++) {
+    physics->SpecIndexXrayGal = spec_index[i_spec];
+    init_Ts_tables();
+    const Ts_tables_t* tables = get_Ts_tables();
+
+    cr_assert_eq(tables->n_snaps, 4);
+    cr_assert_eq(tables->n_filter_steps, N_FILTER_STEPS);
+
+    double lum_conv;
+    if (i_spec == 0)
+      lum_conv = 1. / ((physics->NuXrayGalThreshold * NU_over_EV) *
+                       log(physics->NuXraySoftCut / physics->NuXrayGalThreshold));
+    else
+      lum_conv = pow(physics->NuXrayGalThreshold * NU_over_EV, -spec_index[i_spec]) * (1 - spec_index[i_spec]) /
+                 (pow(physics->NuXraySoftCut * NU_over_EV, 1. - spec_index[i_spec]) -
+                  pow(physics->NuXrayGalThreshold * NU_over_EV, 1. - spec_index[i_spec]));
+    lum_conv *= SEC_PER_YEAR / PLANCK;
+
+    for (int snapshot = 0; snapshot < 4; snapshot++) {
+      const double zp = ZZ[snapshot];
+      const double* sum_lyn_tbl = &(tables->sum_lyn[snapshot * N_FILTER_STEPS]);
+
+      double prefactor = physics->LXrayGal * lum_conv / (physics->NuXrayGalThreshold * NU_over_EV) * SPEED_OF_LIGHT *
+                         pow(1 + zp, spec_index[i_spec] + 3);
+      cr_expect(isclose_rel(xray_emissivity_prefactor(zp, physics->LXrayGal, spec_index[i_spec]), prefactor, 1e-12));
+
+      // the prefactor must follow the X-ray luminosity (e.g. between MCMC steps) without re-initialising the tables
+      physics->LXrayGal = 3e40;
+      cr_expect(isclose_rel(
+        xray_emissivity_prefactor(zp, physics->LXrayGal, spec_index[i_spec]), prefactor * 3.0, 1e-12));
+      physics->LXrayGal = 1e40;
+
+      // direct evaluation of the shell redshifts and Lyman series sums
+      double R = L_FACTOR * params->BoxSize / params->Hubble_h / (float)GRID_DIM;
+      double R_factor = pow(R_XLy_MAX / R, 1 / (float)N_FILTER_STEPS);
+      double prev_zpp = zp;
+      double prev_R = 0;
+      int n_kink = 0;
+
+      for (int R_ct = 0; R_ct < N_FILTER_STEPS; R_ct++) {
+        int i_table = snapshot * N_FILTER_STEPS + R_ct;
+        double zpp_edge = prev_zpp - (R - prev_R) * MPC / drdz((float)prev_zpp);
+        double zpp = (zpp_edge + prev_zpp) * 0.5;
+
+        cr_expect(isclose_rel(tables->zpp_edge[i_table], zpp_edge, 1e-12));
+        cr_expect(isclose_rel(tables->zpp[i_table], zpp, 1e-12));
+        cr_expect(isclose_rel(tables->dt_dzpp[i_table], dtdz((float)zpp), 1e-12));
+
+        double sum_lyn = 0.0;
+        for (int n_ct = NSPEC_MAX; n_ct >= 2; n_ct--) {
+          if (zpp > zmax((float)zp, n_ct))
+            continue;
+          sum_lyn += frecycle(n_ct) * spectral_emissivity(nu_n(n_ct) * (1 + zpp) / (1.0 + zp), 0, 2);
+        }
+
+        if (sum_lyn > 0.0)
+          cr_expect(isclose_rel(sum_lyn_tbl[R_ct], sum_lyn, 1e-12));
+        else if (sum_lyn_tbl[R_ct] > 0.0) {
+          // the partial contribution added to the first shell beyond the Lyman series horizon
+          n_kink++;
+          cr_expect(R_ct > 2);
+          cr_expect(sum_lyn_tbl[R_ct] <= sum_lyn_tbl[R_ct - 1]);
+        }
+
+        prev_zpp = zpp_edge;
+        prev_R = R;
+        R *= R_factor;
+      }
+      cr_expect(n_kink <= 1);
+    }
+  }
+
+  free_Ts_tables();
+  cr_expect_eq(get_Ts_tables()->sum_lyn, NULL);
+
+  physics->SpecIndexXrayGal = 1.0;
+  run_globals.ZZ = NULL;
+}
+
+Test(ComputeTs, kappa_10_accelerators)
+{
+  // spline lookups must not depend on the accelerator (or its history)
+  kappa_accel_t acc;
+  init_kappa_accel(&acc);
+
+  for (double TK = 0.5; TK < 2e5; TK *= 1.37) {
+    cr_expect_eq(kappa_10(TK, acc.HI), kappa_10(TK, NULL));
+    cr_expect_eq(kappa_10_elec(TK, acc.elec), kappa_10_elec(TK, NULL));
+    cr_expect_eq(kappa_10_pH(TK, acc.pH), kappa_10_pH(TK, NULL));
+  }
+
+  free_kappa_accel(&acc);
+}
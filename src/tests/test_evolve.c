@@ -0,0 +1,210 @@
+#define _MAIN
+#include <criterion/criterion.h>
+#include <meraxes.h>
+
+// The Pop. III feedback tables aren't set up here
+#if !USE_MINI_HALOS
+#include "../core/stellar_feedback.h"
+#include "../physics/evolve.h"
+#include "../physics/infall.h"
+#include <mpi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_SNAPS 60
+#define SNAPSHOT 50
+#define N_FOF 40
+#define N_GALS (3 * N_FOF)
+
+// Every fourth FOF group is of each kind
+enum
+{
+  QUIESCENT,
+  QUIESCENT_HOT_METALS,
+  RECENT_BURST,
+  COLD_GAS,
+  N_KINDS
+};
+
+static fof_group_t fof_groups[N_FOF];
+static halo_t halos[2 * N_FOF];
+static galaxy_t gals[N_GALS];
+static galaxy_t initial_gals[N_GALS];
+
+void setup(void)
+{
+  int argc = 0;
+  char** argv = NULL;
+
+  MPI_Init(&argc, &argv);
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  run_globals.mpi_rank = 0;
+  run_globals.mpi_size = 1;
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  run_params_t* params = &(run_globals.params);
+  physics_params_t* physics = &(params->physics);
+  run_units_t* units = &(run_globals.units);
+
+  units->UnitTime_in_s = 3.08568e19;
+  units->UnitTime_in_Megayears = 977.8;
+  units->UnitEnergy_in_cgs = 1.989e53;
+  params->Hubble_h = 0.678;
+  params->BaryonFrac = 0.17;
+  params->NSteps = 1;
+
+  physics->Flag_IRA = 0;
+  physics->SnModel = 1;
+  physics->SnReheatEff = 10.;
+  physics->SnReheatNorm = 70.;
+  physics->SnReheatScaling = 2.;
+  physics->SnReheatLimit = 10.;
+  physics->SnEjectionEff = 0.5;
+  physics->SnEjectionNorm = 70.;
+  physics->SnEjectionScaling = 2.;
+  physics->SfDiskVelOpt = 1;
+  physics->SfPrescription = 1;
+  // No in-situ star formation
+  physics->SfCriticalSDNorm = 1e10;
+
+  // Snapshots 20 Myr apart
+  params->SnaplistLength = N_SNAPS;
+  run_globals.ZZ = malloc(sizeof(double) * N_SNAPS);
+  run_globals.LTTime = malloc(sizeof(double) * N_SNAPS);
+  for (int ii = 0; ii < N_SNAPS; ii++) {
+    run_globals.ZZ[ii] = 15.0 - 0.2 * ii;
+    run_globals.LTTime[ii] = 20.0 * (N_SNAPS - 1 - ii) / units->UnitTime_in_Megayears * params->Hubble_h;
+  }
+  run_globals.ListOutputSnaps = malloc(sizeof(int));
+  run_globals.ListOutputSnaps[0] = N_SNAPS - 1;
+  run_globals.NOutputSnaps = 1;
+
+  strcpy(params->StellarFeedbackDir, STELLAR_FEEDBACK_DIR);
+  read_stellar_feedback_tables();
+
+  // Each FOF group has a central and an orphan in its first halo and a satellite in its second.  All of them are
+  // gas poor with old stellar populations (so that there is no infall), and the orphans aren't due to merge.
+  double dt = (run_globals.LTTime[SNAPSHOT - 1] - run_globals.LTTime[SNAPSHOT]);
+  memset(gals, 0, sizeof(gals));
+  for (int i_fof = 0; i_fof < N_FOF; i_fof++) {
+    fof_group_t* fof_group = &fof_groups[i_fof];
+    halo_t* halo = &halos[2 * i_fof];
+    galaxy_t* gal = &gals[3 * i_fof];
+
+    fof_group->FirstHalo = halo;
+    fof_group->FirstOccupiedHalo = halo;
+    fof_group->Mvir = 1e-2 * (1.0 + i_fof);
+    fof_group->Rvir = 0.02;
+    fof_group->Vvir = 50.0;
+    fof_group->FOFMvirModifier = 1.0;
+
+    halo[0].FOFGroup = fof_group;
+    halo[0].NextHaloInFOFGroup = &halo[1];
+    halo[0].Galaxy = &gal[0];
+    halo[1].FOFGroup = fof_group;
+    halo[1].NextHaloInFOFGroup = NULL;
+    halo[1].Galaxy = &gal[2];
+
+    for (int ii = 0; ii < 3; ii++) {
+      gal[ii].Type = (ii == 1) ? 2 : ii / 2;
+      gal[ii].Halo = (ii < 2) ? &halo[0] : &halo[1];
+      gal[ii].dt = dt;
+      gal[ii].Vmax = 40.0 + i_fof;
+      gal[ii].Vvir = 35.0 + i_fof;
+      gal[ii].DiskScaleLength = 1e-3;
+      gal[ii].StellarMass = fof_group->Mvir;
+      gal[ii].MetalsStellarMass = 0.01 * gal[ii].StellarMass;
+      gal[ii].ColdGas = (ii == 1) ? 5e-11 : 0.0;
+    }
+    gal[0].NextGalInHalo = &gal[1];
+    gal[1].NextGalInHalo = NULL;
+    gal[1].MergerTarget = &gal[0];
+    gal[1].MergTime = 100.0 * dt;
+    gal[2].NextGalInHalo = NULL;
+
+    switch (i_fof % N_KINDS) {
+      case QUIESCENT_HOT_METALS:
+        gal[0].MetalsHotGas = 1e-6;
+        break;
+      case RECENT_BURST:
+        gal[2].NewStars[2] = 1e-3;
+        gal[2].NewMetals[2] = 1e-5;
+        break;
+      case COLD_GAS:
+        gal[0].ColdGas = 1e-3;
+        gal[0].MetalsColdGas = 1e-5;
+        break;
+      default:
+        break;
+    }
+  }
+
+  memcpy(initial_gals, gals, sizeof(gals));
+}
+
+void teardown(void)
+{
+  free_stellar_feedback_tables();
+  free(run_globals.ListOutputSnaps);
+  free(run_globals.LTTime);
+  free(run_globals.ZZ);
+  MPI_Finalize();
+}
+
+TestSuite(evolve, .init = setup, .fini = teardown);
+
+static bool classify(int i_fof)
+{
+  return fof_group_is_quiescent(&fof_groups[i_fof], gas_infall(&fof_groups[i_fof], SNAPSHOT), SNAPSHOT);
+}
+
+Test(evolve, classifies_groups)
+{
+  for (int i_fof = 0; i_fof < N_FOF; i_fof++) {
+    int kind = i_fof % N_KINDS;
+    cr_expect_eq(classify(i_fof), (kind == QUIESCENT) || (kind == QUIESCENT_HOT_METALS), "FOF group %d", i_fof);
+  }
+
+  // Groups with a merger due, or with hot or ejected gas, are evolved as normal
+  galaxy_t* gal = &gals[3 * QUIESCENT];
+  memcpy(gals, initial_gals, sizeof(gals));
+  gal[1].MergTime = 0.5 * gal[1].dt;
+  cr_expect_not(classify(QUIESCENT));
+
+  memcpy(gals, initial_gals, sizeof(gals));
+  gal[1].MergerTarget = &gal[2];
+  gal[2].Type = 3;
+  cr_expect_not(classify(QUIESCENT));
+
+  memcpy(gals, initial_gals, sizeof(gals));
+  gal[2].HotGas = 1e-4;
+  cr_expect_not(classify(QUIESCENT));
+
+  memcpy(gals, initial_gals, sizeof(gals));
+  gal[0].EjectedGas = 1e-4;
+  cr_expect_not(classify(QUIESCENT));
+}
+
+Test(evolve, skipped_groups_are_bit_identical)
+{
+  galaxy_t* evolved_gals = malloc(sizeof(gals));
+
+  memcpy(gals, initial_gals, sizeof(gals));
+  run_globals.params.SkipQuiescentFOFGroups = 0;
+  cr_assert_eq(evolve_galaxies(fof_groups, SNAPSHOT, N_GALS, N_FOF), N_GALS);
+  memcpy(evolved_gals, gals, sizeof(gals));
+
+  memcpy(gals, initial_gals, sizeof(gals));
+  run_globals.params.SkipQuiescentFOFGroups = 1;
+  cr_assert_eq(evolve_galaxies(fof_groups, SNAPSHOT, N_GALS, N_FOF), N_GALS);
+
+  for (int i_gal = 0; i_gal < N_GALS; i_gal++)
+    cr_assert(memcmp(&gals[i_gal], &evolved_gals[i_gal], sizeof(galaxy_t)) == 0, "galaxy %d differs", i_gal);
+
+  // The test groups should exercise the stripping and the delayed feedback
+  cr_assert_eq(gals[3 * QUIESCENT_HOT_METALS].MetalsHotGas, 0.0);
+  cr_assert(gals[3 * RECENT_BURST + 2].ColdGas > 0.0);
+
+  free(evolved_gals);
+}
+#endif
@@ -0,0 +1,295 @@
+#define _MAIN
+#include "../core/find_HII_bubbles.h"
+#include "../core/misc_tools.h"
+#include "../core/pencil_decomp.h"
+#include "../core/reionization.h"
+#include <criterion/criterion.h>
+#include <math.h>
+#include <meraxes.h>
+#include <mpi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GRID_DIM 32
+#define BOX_SIZE 64.0
+#define SNAPSHOT 1
+
+static float fixed_xH[GRID_DIM * GRID_DIM * GRID_DIM];
+static float fixed_z_at_ionization[GRID_DIM * GRID_DIM * GRID_DIM];
+static float fixed_r_bubble[GRID_DIM * GRID_DIM * GRID_DIM];
+static filter_batch_t* filter_batch = NULL;
+
+static void alloc_grids(int dim)
+{
+  run_globals.params.ReionGridDim = dim;
+  malloc_reionization_grids();
+
+  // Each test picks whether to use the batched transforms
+  filter_batch = run_globals.reion_grids.HII_filter_batch;
+  cr_assert_not_null(filter_batch);
+#if USE_MINI_HALOS
+  cr_assert_eq(filter_batch->n_fields, 5);
+#else
+  cr_assert_eq(filter_batch->n_fields, 3);
+#endif
+}
+
+static void free_grids(void)
+{
+  run_globals.reion_grids.HII_filter_batch = filter_batch;
+  free_reionization_grids();
+  free(run_globals.SnapshotVel);
+  free(run_globals.SnapshotDeltax);
+}
+
+void setup(void)
+{
+  int argc = 0;
+  char** argv = NULL;
+
+  // The tests also run on several ranks (see CMakeLists.txt), in which case each rank holds a slab of the grids
+  MPI_Init(&argc, &argv);
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  MPI_Comm_rank(MPI_COMM_WORLD, &run_globals.mpi_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &run_globals.mpi_size);
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  run_params_t* params = &(run_globals.params);
+  params->Flag_PatchyReion = 1;
+  params->BoxSize = BOX_SIZE;
+  params->Hubble_h = 0.678;
+  params->OmegaM = 0.308;
+  params->OmegaLambda = 0.692;
+  params->ReionDeltaRFactor = 1.1;
+  params->ReionFilterType = 0;
+  params->ReionRtoMFilterType = 0;
+  params->ReionBatchedFFTs = 1;
+  params->physics.ReionRBubbleMax = 20.0;
+  params->physics.ReionRBubbleMin = 0.0;
+  params->physics.ReionEfficiency = 1.0;
+  params->physics.ReionNionPhotPerBary = 4000.0;
+  params->physics.ReionGammaHaloBias = 2.0;
+  params->physics.ReionAlphaUV = 5.0;
+
+  run_globals.RhoCrit = 27.755;
+  run_globals.units.UnitLength_in_cm = 3.08568e24;
+  run_globals.units.UnitMass_in_g = 1.989e43;
+  run_globals.units.UnitTime_in_s = 3.08568e19;
+
+  run_globals.ZZ = malloc(sizeof(double) * (SNAPSHOT + 1));
+  run_globals.ZZ[SNAPSHOT - 1] = 8.5;
+  run_globals.ZZ[SNAPSHOT] = 8.0;
+  run_globals.NStoreSnapshots = 1;
+
+  alloc_grids(GRID_DIM);
+}
+
+void teardown(void)
+{
+  free_grids();
+  free(run_globals.ZZ);
+  MPI_Finalize();
+}
+
+TestSuite(find_HII_bubbles, .init = setup, .fini = teardown);
+
+static double input_deltax(int ix, int iy, int iz, int dim)
+{
+  // A few long-wavelength modes, exponentiated to give a density-like field
+  const double k = 2.0 * M_PI / (double)dim;
+  double val = cos(k * ix + 0.3) + cos(2 * k * iy + 1.1) + cos(k * (iz + ix) + 2.0) + 0.5 * cos(3 * k * iz);
+  return exp(0.3 * val) - 1.0;
+}
+
+static int local_n_real(void)
+{
+  const int dim = run_globals.params.ReionGridDim;
+  return (int)run_globals.reion_grids.slab_nix[run_globals.mpi_rank] * dim * dim;
+}
+
+static double global_fraction(int n_local)
+{
+  const double dim = (double)run_globals.params.ReionGridDim;
+  MPI_Allreduce(MPI_IN_PLACE, &n_local, 1, MPI_INT, MPI_SUM, run_globals.mpi_comm);
+  return (double)n_local / (dim * dim * dim);
+}
+
+static void run_find_HII_bubbles(double tol, bool active_cells, bool batched)
+{
+  // The input grids are overwritten by the forward FFTs, so they are rebuilt for each call
+  reion_grids_t* grids = &(run_globals.reion_grids);
+  const int dim = run_globals.params.ReionGridDim;
+  const int slab_ix_start = (int)grids->slab_ix_start[run_globals.mpi_rank];
+  const int slab_nix = (int)grids->slab_nix[run_globals.mpi_rank];
+  const double cell_mass = run_globals.params.OmegaM * run_globals.RhoCrit * pow(BOX_SIZE / (double)dim, 3);
+
+  init_reion_grids();
+
+  for (int ix = 0; ix < slab_nix; ix++)
+    for (int iy = 0; iy < dim; iy++)
+      for (int iz = 0; iz < dim; iz++) {
+        int i_padded = grid_index(ix, iy, iz, dim, INDEX_PADDED);
+        double density = 1.0 + input_deltax(ix + slab_ix_start, iy, iz, dim);
+
+        grids->deltax[i_padded] = (float)(density - 1.0);
+        grids->stars[i_padded] = (float)(0.7 * cell_mass * density * density);
+        grids->weighted_sfr[i_padded] = (float)(1e-3 * cell_mass * density * density);
+#if USE_MINI_HALOS
+        grids->starsIII[i_padded] = 0.0f;
+        grids->weighted_sfrIII[i_padded] = 0.0f;
+#endif
+      }
+
+  run_globals.params.ReionAdaptiveRTol = tol;
+  run_globals.params.ReionActiveCellLists = active_cells;
+  grids->HII_filter_batch = batched ? filter_batch : NULL;
+  _find_HII_bubbles(SNAPSHOT);
+}
+
+Test(find_HII_bubbles, adaptive_R_matches_fixed)
+{
+  reion_grids_t* grids = &(run_globals.reion_grids);
+  const int n_real = local_n_real();
+
+  run_find_HII_bubbles(0.0, false, false);
+  double fixed_global_xH = grids->volume_weighted_global_xH;
+  int fixed_n_filter_steps = grids->n_filter_steps;
+  memcpy(fixed_xH, grids->xH, sizeof(float) * n_real);
+  memcpy(fixed_z_at_ionization, grids->z_at_ionization, sizeof(float) * n_real);
+
+  cr_assert(fixed_global_xH > 0.05 && fixed_global_xH < 0.95,
+            "test field should be partially ionised (global xH = %g)",
+            fixed_global_xH);
+
+  run_find_HII_bubbles(1e-3, false, false);
+  double adaptive_global_xH = grids->volume_weighted_global_xH;
+
+  // The test is only meaningful if some radii were actually skipped
+  cr_assert_lt(grids->n_filter_steps,
+               fixed_n_filter_steps,
+               "adaptive run took %d filter steps, fixed run took %d",
+               grids->n_filter_steps,
+               fixed_n_filter_steps);
+
+  // The adaptive radii are a subset of the fixed ones (including the final cell-sized step), so it can only miss
+  // ionisations, never add them.
+  int n_differ = 0;
+  for (int ii = 0; ii < n_real; ii++) {
+    cr_assert_geq(grids->xH[ii],
+                  fixed_xH[ii] - 1e-6f,
+                  "cell %d: adaptive xH=%g < fixed xH=%g",
+                  ii,
+                  grids->xH[ii],
+                  fixed_xH[ii]);
+    if (grids->z_at_ionization[ii] != fixed_z_at_ionization[ii])
+      n_differ++;
+  }
+
+  cr_expect_lt(fabs(adaptive_global_xH - fixed_global_xH),
+               0.01,
+               "global xH: fixed=%g adaptive=%g",
+               fixed_global_xH,
+               adaptive_global_xH);
+  cr_expect_lt(global_fraction(n_differ), 0.01, "%d cells have a different z_at_ionization", n_differ);
+}
+
+Test(find_HII_bubbles, active_cell_lists_match_dense)
+{
+  reion_grids_t* grids = &(run_globals.reion_grids);
+  const int n_real = local_n_real();
+
+  run_find_HII_bubbles(0.0, false, false);
+  double dense_global_xH = grids->volume_weighted_global_xH;
+  memcpy(fixed_xH, grids->xH, sizeof(float) * n_real);
+  memcpy(fixed_z_at_ionization, grids->z_at_ionization, sizeof(float) * n_real);
+  memcpy(fixed_r_bubble, grids->r_bubble, sizeof(float) * n_real);
+
+  run_find_HII_bubbles(0.0, true, false);
+
+  // Only the order in which cells are visited changes, so the results should be identical
+  cr_assert_eq(grids->volume_weighted_global_xH, dense_global_xH);
+  for (int ii = 0; ii < n_real; ii++) {
+    cr_assert_eq(grids->xH[ii], fixed_xH[ii], "cell %d", ii);
+    cr_assert_eq(grids->z_at_ionization[ii], fixed_z_at_ionization[ii], "cell %d", ii);
+    cr_assert_eq(grids->r_bubble[ii], fixed_r_bubble[ii], "cell %d", ii);
+  }
+}
+
+Test(find_HII_bubbles, batched_ffts_match_per_field)
+{
+  reion_grids_t* grids = &(run_globals.reion_grids);
+  const int n_real = local_n_real();
+
+  run_find_HII_bubbles(0.0, false, false);
+  double single_global_xH = grids->volume_weighted_global_xH;
+  memcpy(fixed_z_at_ionization, grids->z_at_ionization, sizeof(float) * n_real);
+
+  run_find_HII_bubbles(0.0, false, true);
+
+  // FFTW may use a different algorithm for the batched plan, so only round-off level differences are expected
+  int n_differ = 0;
+  for (int ii = 0; ii < n_real; ii++)
+    if (grids->z_at_ionization[ii] != fixed_z_at_ionization[ii])
+      n_differ++;
+
+  cr_expect_lt(fabs(grids->volume_weighted_global_xH - single_global_xH),
+               1e-4,
+               "global xH: per field=%g batched=%g",
+               single_global_xH,
+               grids->volume_weighted_global_xH);
+  cr_expect_lt(global_fraction(n_differ), 1e-3, "%d cells have a different z_at_ionization", n_differ);
+}
+
+static void check_pencil_decomposition_matches_slabs(void)
+{
+  reion_grids_t* grids = &(run_globals.reion_grids);
+  const int n_real = local_n_real();
+
+  run_find_HII_bubbles(0.0, true, false);
+  double slab_global_xH = grids->volume_weighted_global_xH;
+  memcpy(fixed_xH, grids->xH, sizeof(float) * n_real);
+  memcpy(fixed_z_at_ionization, grids->z_at_ionization, sizeof(float) * n_real);
+  memcpy(fixed_r_bubble, grids->r_bubble, sizeof(float) * n_real);
+
+  grids->pencil = create_pencil_decomp(run_globals.params.ReionGridDim, FFTW_ESTIMATE);
+  run_find_HII_bubbles(0.0, true, false);
+  destroy_pencil_decomp(grids->pencil);
+  grids->pencil = NULL;
+
+  // The 1D transforms are different FFTW plans to the 3D ones, so again only round-off level differences are expected
+  int n_differ = 0;
+  for (int ii = 0; ii < n_real; ii++)
+    if ((fabsf(grids->xH[ii] - fixed_xH[ii]) > 1e-5f) || (grids->z_at_ionization[ii] != fixed_z_at_ionization[ii]) ||
+        (grids->r_bubble[ii] != fixed_r_bubble[ii]))
+      n_differ++;
+
+  cr_expect_lt(fabs(grids->volume_weighted_global_xH - slab_global_xH),
+               1e-4,
+               "global xH: slabs=%g pencils=%g",
+               slab_global_xH,
+               grids->volume_weighted_global_xH);
+  cr_expect_lt(global_fraction(n_differ), 1e-3, "%d cells differ on rank %d", n_differ, run_globals.mpi_rank);
+}
+
+Test(find_HII_bubbles, pencil_decomposition_matches_slabs)
+{
+  // A 2x2 process grid when run on 4 ranks
+  check_pencil_decomposition_matches_slabs();
+}
+
+Test(find_HII_bubbles, pencil_decomposition_more_ranks_than_cells)
+{
+  // With one x plane fewer than there are ranks, at least one rank holds no slab but still gets a pencil
+  const int dim = run_globals.mpi_size - 1;
+  int dims[2] = { 0, 0 };
+
+  MPI_Dims_create(run_globals.mpi_size, 2, dims);
+  if ((dim < 1) || (dims[0] > dim) || (dims[1] > dim / 2 + 1))
+    cr_skip_test("a %d^3 grid can't be decomposed over %d ranks", dim, run_globals.mpi_size);
+
+  free_grids();
+  alloc_grids(dim);
+  cr_assert_eq(run_globals.reion_grids.slab_nix[run_globals.mpi_size - 1], 0);
+
+  check_pencil_decomposition_matches_slabs();
+}
@@ -0,0 +1,219 @@
+#define _MAIN
+#include <criterion/criterion.h>
+#include <meraxes.h>
+
+#ifdef CALC_MAGS
+#include "../core/magnitudes.h"
+#include "../core/misc_tools.h"
+#include "../core/save.h"
+#include <math.h>
+#include <mpi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_SNAPS 120
+#define N_Z 6
+#define I_AGE_BC 3
+
+// Largest difference from magnitudes accumulated in double precision (MAGS_FLOAT_FLUXES builds)
+#define MAG_TOL 1e-4
+
+static mag_params_t* mag_params = &run_globals.mag_params;
+static double centre_waves[MAGS_N_BANDS];
+
+static double rand_log(double log_min, double log_max)
+{
+  return pow(10., log_min + (log_max - log_min) * (double)rand() / RAND_MAX);
+}
+
+void setup(void)
+{
+  int argc = 0;
+  char** argv = NULL;
+
+  MPI_Init(&argc, &argv);
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  run_globals.mpi_rank = 0;
+  run_globals.mpi_size = 1;
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  // SFRs in Msun/yr, so that there is no unit correction to the magnitudes
+  run_globals.units.UnitMass_in_g = SOLAR_MASS;
+  run_globals.units.UnitTime_in_s = SEC_PER_YEAR;
+  run_globals.units.UnitTime_in_Megayears = 1e-6;
+  run_globals.params.Hubble_h = 1.0;
+
+  run_globals.ZZ = malloc(sizeof(double) * N_SNAPS);
+  for (int ii = 0; ii < N_SNAPS; ii++)
+    run_globals.ZZ[ii] = 30.0 - 25.0 * (double)ii / (double)(N_SNAPS - 1);
+
+  // Synthetic SED tables spanning several decades, laid out as by init_templates_mini
+  size_t n_working = 0;
+  for (int iS = 0; iS < MAGS_N_SNAPS; ++iS) {
+    mag_params->targetSnap[iS] = N_SNAPS - 1 - 10 * (MAGS_N_SNAPS - 1 - iS);
+    mag_params->iAgeBC[iS] = I_AGE_BC;
+    n_working += (size_t)mag_params->targetSnap[iS] * N_Z * MAGS_N_BANDS;
+  }
+  mag_params->minZ = 0;
+  mag_params->maxZ = N_Z - 1;
+  mag_params->nMaxZ = N_Z;
+  mag_params->tBC = 1e7;
+
+  srand(2019);
+  size_t n_bc = MAGS_N_SNAPS * N_Z * MAGS_N_BANDS;
+  mag_params->working = malloc(sizeof(double) * (n_working + 2 * n_bc));
+  for (size_t ii = 0; ii < n_working + 2 * n_bc; ii++)
+    mag_params->working[ii] = rand_log(-2., 2.);
+  mag_params->inBC = mag_params->working + n_working;
+  mag_params->outBC = mag_params->inBC + n_bc;
+
+#if USE_MINI_HALOS
+  mag_params->workingIII = calloc(n_working, sizeof(double));
+#endif
+
+  for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band)
+    centre_waves[i_band] = 1300. + 18000. * (double)i_band / MAGS_N_BANDS;
+  mag_params->centreWaves = centre_waves;
+  init_dust_attenuation(mag_params);
+}
+
+void teardown(void)
+{
+  free(mag_params->working);
+#if USE_MINI_HALOS
+  free(mag_params->workingIII);
+#endif
+  free(run_globals.ZZ);
+  MPI_Finalize();
+}
+
+TestSuite(magnitudes, .init = setup, .fini = teardown);
+
+static void add_reference_luminosities(double* in_flux, double* out_flux, int snapshot, double metals, double sfr)
+{
+  // add_luminosities, accumulating in double precision
+  int Z = (int)(metals * 1000 - .5);
+  Z = Z < mag_params->minZ + 1 ? mag_params->minZ + 1 : (Z > mag_params->maxZ ? mag_params->maxZ : Z);
+
+  double* pWorking = mag_params->working;
+  double* pInBC = mag_params->inBC;
+  double* pOutBC = mag_params->outBC;
+
+  for (int iS = 0; iS < MAGS_N_SNAPS; ++iS) {
+    int nAgeStep = mag_params->targetSnap[iS];
+    int iA = nAgeStep - snapshot;
+    for (int iF = 0; (iA >= 0) && (iF < MAGS_N_BANDS); ++iF) {
+      int i_flux = iS * MAGS_N_BANDS + iF;
+      if (iA > I_AGE_BC)
+        out_flux[i_flux] += sfr * pWorking[(Z * nAgeStep + iA) * MAGS_N_BANDS + iF];
+      else if (iA == I_AGE_BC) {
+        in_flux[i_flux] += sfr * pInBC[Z * MAGS_N_BANDS + iF];
+        out_flux[i_flux] += sfr * pOutBC[Z * MAGS_N_BANDS + iF];
+      } else
+        in_flux[i_flux] += sfr * pWorking[(Z * nAgeStep + iA) * MAGS_N_BANDS + iF];
+    }
+    pWorking += nAgeStep * N_Z * MAGS_N_BANDS;
+    pInBC += N_Z * MAGS_N_BANDS;
+    pOutBC += N_Z * MAGS_N_BANDS;
+  }
+}
+
+static void make_galaxy(galaxy_t* gal, double* in_flux, double* out_flux)
+{
+  // A galaxy with a burst at every snapshot, with SFRs spanning several decades
+  init_luminosities(gal);
+  for (int ii = 0; ii < MAGS_N; ++ii) {
+    in_flux[ii] = TOL;
+    out_flux[ii] = TOL;
+  }
+
+  for (int snapshot = 0; snapshot < N_SNAPS; ++snapshot) {
+    double metals = 0.006 * (double)rand() / RAND_MAX;
+    double sfr = rand_log(-3., 2.);
+    add_luminosities(mag_params, gal, snapshot, metals, sfr, 0.0);
+    add_reference_luminosities(in_flux, out_flux, snapshot, metals, sfr);
+  }
+
+  gal->ColdGas = rand_log(-3., 0.);
+  gal->MetalsColdGas = gal->ColdGas * 0.02 * (double)rand() / RAND_MAX;
+  gal->DiskScaleLength = 1e-3 * rand_log(-1., 0.5);
+}
+
+Test(magnitudes, within_tolerance_of_double_accumulation)
+{
+  galaxy_t* gal = calloc(1, sizeof(galaxy_t));
+  double in_flux[MAGS_N], out_flux[MAGS_N];
+  float mags[MAGS_N_BANDS], dusty_mags[MAGS_N_BANDS];
+  double max_diff = 0.0;
+  double max_dusty_diff = 0.0;
+
+#if USE_MINI_HALOS
+  gal->Galaxy_Population = 2;
+#endif
+
+  for (int i_gal = 0; i_gal < 50; ++i_gal) {
+    make_galaxy(gal, in_flux, out_flux);
+
+    for (int iS = 0; iS < MAGS_N_SNAPS; ++iS) {
+      int snapshot = mag_params->targetSnap[iS];
+      get_output_magnitudes(mags, dusty_mags, gal, snapshot);
+
+      // The reference dust attenuation is sector's
+      double factor = pow(calc_metallicity(gal->ColdGas, gal->MetalsColdGas) / 0.02, 1.2) * gal->ColdGas *
+                      pow(gal->DiskScaleLength * 1e3, -2.0) * exp(-0.35 * run_globals.ZZ[snapshot]);
+      dust_params_t dust_params = { .tauUV_ISM = 13.5 * factor,
+                                    .nISM = -1.6,
+                                    .tauUV_BC = 381.3 * factor,
+                                    .nBC = -1.6,
+                                    .tBC = mag_params->tBC };
+      double* in = in_flux + iS * MAGS_N_BANDS;
+      double* out = out_flux + iS * MAGS_N_BANDS;
+      double dusty_in[MAGS_N_BANDS], dusty_out[MAGS_N_BANDS];
+      memcpy(dusty_in, in, sizeof(dusty_in));
+      memcpy(dusty_out, out, sizeof(dusty_out));
+      dust_absorption_approx(dusty_in, dusty_out, centre_waves, MAGS_N_BANDS, &dust_params);
+
+      for (int i_band = 0; i_band < MAGS_N_BANDS; ++i_band) {
+        double diff = fabs(mags[i_band] - (-2.5 * log10(in[i_band] + out[i_band]) + 8.9));
+        double dusty_diff = fabs(dusty_mags[i_band] - (-2.5 * log10(dusty_in[i_band] + dusty_out[i_band]) + 8.9));
+        max_diff = diff > max_diff ? diff : max_diff;
+        max_dusty_diff = dusty_diff > max_dusty_diff ? dusty_diff : max_dusty_diff;
+      }
+    }
+  }
+
+  cr_expect(max_diff < MAG_TOL, "max magnitude difference = %g", max_diff);
+  cr_expect(max_dusty_diff < MAG_TOL, "max dusty magnitude difference = %g", max_dusty_diff);
+  free(gal);
+}
+
+Test(magnitudes, batch_matches_single)
+{
+  const int n_gals = 8;
+  galaxy_t* gals = calloc(n_gals, sizeof(galaxy_t));
+  galaxy_t* gal_ptrs[8];
+  galaxy_output_t galout[8];
+  double in_flux[MAGS_N], out_flux[MAGS_N];
+  float mags[MAGS_N_BANDS], dusty_mags[MAGS_N_BANDS];
+
+  for (int i_gal = 0; i_gal < n_gals; ++i_gal) {
+#if USE_MINI_HALOS
+    gals[i_gal].Galaxy_Population = 2;
+#endif
+    make_galaxy(&gals[i_gal], in_flux, out_flux);
+    gal_ptrs[i_gal] = &gals[i_gal];
+  }
+
+  // Include a snapshot which isn't a target snapshot
+  for (int snapshot = N_SNAPS - 2; snapshot < N_SNAPS; ++snapshot) {
+    get_output_magnitudes_batch(galout, gal_ptrs, n_gals, snapshot);
+    for (int i_gal = 0; i_gal < n_gals; ++i_gal) {
+      get_output_magnitudes(mags, dusty_mags, &gals[i_gal], snapshot);
+      cr_assert(memcmp(mags, galout[i_gal].Mags, sizeof(mags)) == 0);
+      cr_assert(memcmp(dusty_mags, galout[i_gal].DustyMags, sizeof(dusty_mags)) == 0);
+    }
+  }
+
+  free(gals);
+}
+#endif
@@ -0,0 +1,292 @@
+#define _MAIN
+#include <criterion/criterion.h>
+#include <meraxes.h>
+
+#if USE_MINI_HALOS
+#include "../core/PopIII.h"
+#include "../core/misc_tools.h"
+#include "../core/stellar_feedback.h"
+#include "../physics/supernova_feedback.h"
+#include <math.h>
+#include <mpi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_SNAPS (4 * N_HISTORY_SNAPS + 2)
+#define N_GALS 48
+
+static galaxy_t gals[N_GALS];
+static galaxy_t ref_gals[N_GALS];
+
+void setup(void)
+{
+  int argc = 0;
+  char** argv = NULL;
+
+  MPI_Init(&argc, &argv);
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  run_globals.mpi_rank = 0;
+  run_globals.mpi_size = 1;
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  run_params_t* params = &(run_globals.params);
+  physics_params_t* physics = &(params->physics);
+  run_units_t* units = &(run_globals.units);
+
+  units->UnitMass_in_g = 1.989e43;
+  units->UnitLength_in_cm = 3.08568e24;
+  units->UnitTime_in_s = 3.08568e19;
+  units->UnitTime_in_Megayears = 977.8;
+  units->UnitEnergy_in_cgs = 1.989e53;
+  params->Hubble_h = 0.678;
+  params->BoxSize = 67.8;
+  params->MetalGridDim = 64;
+
+  physics->SnModel = 1;
+  physics->SnEjectionEff = 0.5;
+  physics->SnEjectionNorm = 70.;
+  physics->SnEjectionScaling = 2.;
+  physics->SnEjectionRedshiftDep = 0.5;
+  physics->SnEjectionEff_III = 0.8;
+  physics->SnEjectionNorm_III = 50.;
+  physics->SnEjectionScaling_III = 1.;
+  physics->SnEjectionRedshiftDep_III = 0.;
+  physics->PopIII_IMF = 1;
+  physics->PopIIIAgePrescription = 2;
+
+  // Snapshots 20 Myr apart
+  params->SnaplistLength = N_SNAPS;
+  run_globals.ZZ = malloc(sizeof(double) * N_SNAPS);
+  run_globals.LTTime = malloc(sizeof(double) * N_SNAPS);
+  for (int ii = 0; ii < N_SNAPS; ii++) {
+    run_globals.ZZ[ii] = 20.0 - 0.2 * ii;
+    run_globals.LTTime[ii] = 20.0 * (N_SNAPS - 1 - ii) / units->UnitTime_in_Megayears * params->Hubble_h;
+  }
+  run_globals.ListOutputSnaps = malloc(sizeof(int));
+  run_globals.ListOutputSnaps[0] = N_SNAPS - 1;
+  run_globals.NOutputSnaps = 1;
+
+  strcpy(params->StellarFeedbackDir, STELLAR_FEEDBACK_DIR);
+  read_stellar_feedback_tables();
+  initialize_PopIII();
+}
+
+void teardown(void)
+{
+  free_stellar_feedback_tables();
+  free(run_globals.Time_Values);
+  free(run_globals.Mass_Values);
+  free(run_globals.ListOutputSnaps);
+  free(run_globals.LTTime);
+  free(run_globals.ZZ);
+  MPI_Finalize();
+}
+
+TestSuite(metal_bubble, .init = setup, .fini = teardown);
+
+static double sn_ejection_eff(galaxy_t* gal, int snapshot, int flag_population)
+{
+  // calc_sn_ejection_eff (SnModel = 1)
+  physics_params_t* params = &run_globals.params.physics;
+  double zplus1 = 1. + run_globals.ZZ[snapshot];
+  double eff;
+
+  if (flag_population == 2)
+    eff = params->SnEjectionEff * pow(zplus1 / 4., params->SnEjectionRedshiftDep) *
+          (.5 + pow(gal->Vmax / params->SnEjectionNorm, -params->SnEjectionScaling));
+  else
+    eff = params->SnEjectionEff_III * pow(zplus1 / 4., params->SnEjectionRedshiftDep_III) *
+          (.5 + pow(gal->Vmax / params->SnEjectionNorm_III, -params->SnEjectionScaling_III));
+
+  return (eff < 1.) ? eff : 1.;
+}
+
+static void calc_metal_bubble_shifted(galaxy_t* gal, int snapshot)
+{
+  // The original calc_metal_bubble, which shifts the stored bubbles down by one element every snapshot
+  int n_bursts = (snapshot >= N_HISTORY_SNAPS) ? N_HISTORY_SNAPS : snapshot;
+
+  double UnitMass_in_g = run_globals.units.UnitMass_in_g;
+  double UnitLength_in_cm = run_globals.units.UnitLength_in_cm;
+  double energy_unit = run_globals.units.UnitEnergy_in_cgs;
+  double time_unit = run_globals.units.UnitTime_in_s;
+
+  double sn_energy = 0.0;
+
+  double gas_density;
+  double IGM_density;
+
+  int MetalGridDim = run_globals.params.MetalGridDim;
+  double box_size = run_globals.params.BoxSize;
+  double pixel_length_metals = box_size / (double)MetalGridDim;
+
+  gas_density = (gal->ColdGas + gal->HotGas) * UnitMass_in_g / PROTONMASS /
+                (4.0 * M_PI / 3.0 * pow(gal->Rvir * UnitLength_in_cm, 3.));
+  IGM_density = gal->Gas_IGM * UnitMass_in_g / PROTONMASS *
+                pow(pixel_length_metals / (1.0 + run_globals.ZZ[snapshot]) * UnitLength_in_cm, -3.);
+
+  if (gal->RmetalBubble > 0.) {
+    if ((gal->RmetalBubble <= gal->Rvir) && (gas_density >= IGM_density))
+      gal->RmetalBubble = gal->PrefactorBubble * pow(gas_density, -0.2) *
+                          pow((gal->TimeBubble - run_globals.LTTime[snapshot] * time_unit), 0.4);
+    else
+      gal->RmetalBubble = gal->PrefactorBubble * pow(IGM_density, -0.2) *
+                          pow((gal->TimeBubble - run_globals.LTTime[snapshot] * time_unit), 0.4);
+  }
+
+  if (gal->Type == 0) {
+    for (int i_burst = 0; i_burst < n_bursts; i_burst++) {
+      double m_stars_II = gal->NewStars_II[i_burst];
+      double m_stars_III = gal->NewStars_III[i_burst];
+      double m_stars = m_stars_II + m_stars_III;
+
+      if (m_stars_II > 1e-10) {
+        double metallicity = calc_metallicity(m_stars, gal->NewMetals[i_burst]);
+        sn_energy += m_stars_II * get_SN_energy(0, metallicity) * energy_unit * sn_ejection_eff(gal, snapshot, 2);
+      } else if (m_stars_III > 1e-10) {
+        if (i_burst == 0)
+          sn_energy += (get_SN_energy_PopIII(i_burst, snapshot, 0) + get_SN_energy_PopIII(i_burst, snapshot, 1)) *
+                       m_stars_III * sn_ejection_eff(gal, snapshot, 3);
+        else
+          sn_energy += get_SN_energy_PopIII(i_burst, snapshot, 0) * m_stars_III * sn_ejection_eff(gal, snapshot, 3);
+      }
+      if (i_burst != 0) {
+        gal->Prefactor[n_bursts - i_burst] = gal->Prefactor[n_bursts - i_burst - 1];
+        gal->Times[n_bursts - i_burst] = gal->Times[n_bursts - i_burst - 1];
+        if (gal->Prefactor[n_bursts - i_burst] > 0.0) {
+          if ((gal->Radii[n_bursts - i_burst] >= gal->Rvir) || (IGM_density >= gas_density))
+            gal->Radii[n_bursts - i_burst] =
+              gal->Prefactor[n_bursts - i_burst] * pow(IGM_density, -0.2) *
+              pow((gal->Times[n_bursts - i_burst] - run_globals.LTTime[snapshot] * time_unit), 0.4);
+          else
+            gal->Radii[n_bursts - i_burst] =
+              gal->Prefactor[n_bursts - i_burst] * pow(gas_density, -0.2) *
+              pow((gal->Times[n_bursts - i_burst] - run_globals.LTTime[snapshot] * time_unit), 0.4);
+        } else
+          gal->Radii[n_bursts - i_burst] = 0.0;
+        if (gal->Radii[n_bursts - i_burst] > gal->RmetalBubble) {
+          gal->RmetalBubble = gal->Radii[n_bursts - i_burst];
+          gal->PrefactorBubble = gal->Prefactor[n_bursts - i_burst];
+          gal->TimeBubble = gal->Times[n_bursts - i_burst];
+        }
+      }
+    }
+  }
+  if (!gal->ghost_flag) {
+    gal->Prefactor[0] = pow(sn_energy / PROTONMASS, 0.2) / UnitLength_in_cm;
+    gal->Times[0] = run_globals.LTTime[snapshot] * time_unit;
+  } else {
+    gal->Prefactor[0] = 0.0;
+    gal->Times[0] = 0.0;
+  }
+  gal->Radii[0] = 0.0;
+}
+
+static double uniform(unsigned long* state)
+{
+  *state = *state * 6364136223846793005UL + 1442695040888963407UL;
+  return (double)(*state >> 11) / 9007199254740992.0;
+}
+
+static void set_galaxy_state(galaxy_t* gal, int i_gal, int snapshot, unsigned long* state)
+{
+  // Galaxies change type (and become or stop being ghosts) every few snapshots, and have a mix of empty, Pop. II
+  // and Pop. III bursts.  Every fourth galaxy is gas free.
+  gal->Type = (i_gal + snapshot / 5) % 3;
+  gal->ghost_flag = ((i_gal + snapshot / 3) % 4) == 0;
+  gal->Vmax = 30.0 + 5.0 * (i_gal % 10) + snapshot;
+  gal->Rvir = 1e-2 * pow(10.0, 2.0 * uniform(state));
+  gal->ColdGas = (i_gal % 4 == 3) ? 0.0 : 1e-4 * pow(10.0, 2.0 * uniform(state));
+  gal->HotGas = (i_gal % 4 == 3) ? 0.0 : 1e-3 * uniform(state);
+  gal->Gas_IGM = 1e-2 * pow(10.0, 2.0 * uniform(state));
+
+  for (int i_burst = 0; i_burst < N_HISTORY_SNAPS; i_burst++) {
+    double draw = uniform(state);
+    double m_stars = 1e-5 * pow(10.0, 2.0 * uniform(state));
+
+    gal->NewStars_II[i_burst] = (draw < 0.5) ? m_stars : 0.0;
+    gal->NewStars_III[i_burst] = ((draw >= 0.5) && (draw < 0.8)) ? m_stars : 0.0;
+    gal->NewMetals[i_burst] = 0.02 * uniform(state) * m_stars;
+  }
+}
+
+Test(metal_bubble, ring_buffer_matches_shifted_history)
+{
+  unsigned long state = 42;
+  int n_in_rvir = 0;
+  int n_outside_rvir = 0;
+
+  memset(gals, 0, sizeof(gals));
+  memset(ref_gals, 0, sizeof(ref_gals));
+
+  // Run past N_HISTORY_SNAPS so that the ring buffers wrap around several times.  The last snapshot is skipped as
+  // the Pop. III SN energy looks at the following one.
+  for (int snapshot = 0; snapshot < N_SNAPS - 1; snapshot++) {
+    int n_bursts = (snapshot >= N_HISTORY_SNAPS) ? N_HISTORY_SNAPS : snapshot;
+
+    compute_stellar_feedback_tables(snapshot);
+    for (int i_gal = 0; i_gal < N_GALS; i_gal++) {
+      galaxy_t* gal = &gals[i_gal];
+      galaxy_t* ref_gal = &ref_gals[i_gal];
+
+      set_galaxy_state(gal, i_gal, snapshot, &state);
+      memcpy(ref_gal->NewStars_II, gal->NewStars_II, sizeof(gal->NewStars_II));
+      memcpy(ref_gal->NewStars_III, gal->NewStars_III, sizeof(gal->NewStars_III));
+      memcpy(ref_gal->NewMetals, gal->NewMetals, sizeof(gal->NewMetals));
+      ref_gal->Type = gal->Type;
+      ref_gal->ghost_flag = gal->ghost_flag;
+      ref_gal->Vmax = gal->Vmax;
+      ref_gal->Rvir = gal->Rvir;
+      ref_gal->ColdGas = gal->ColdGas;
+      ref_gal->HotGas = gal->HotGas;
+      ref_gal->Gas_IGM = gal->Gas_IGM;
+
+      calc_metal_bubble(gal, snapshot);
+      calc_metal_bubble_shifted(ref_gal, snapshot);
+
+      cr_assert(memcmp(&gal->RmetalBubble, &ref_gal->RmetalBubble, sizeof(double)) == 0,
+                "RmetalBubble of galaxy %d differs at snapshot %d",
+                i_gal,
+                snapshot);
+      cr_assert(memcmp(&gal->PrefactorBubble, &ref_gal->PrefactorBubble, sizeof(double)) == 0,
+                "PrefactorBubble of galaxy %d differs at snapshot %d",
+                i_gal,
+                snapshot);
+      cr_assert(memcmp(&gal->TimeBubble, &ref_gal->TimeBubble, sizeof(double)) == 0,
+                "TimeBubble of galaxy %d differs at snapshot %d",
+                i_gal,
+                snapshot);
+
+      // Radii is indexed by burst in both versions
+      cr_assert(memcmp(gal->Radii, ref_gal->Radii, sizeof(gal->Radii)) == 0,
+                "Radii of galaxy %d differ at snapshot %d",
+                i_gal,
+                snapshot);
+
+      // Only the first n_bursts bubbles (or the newest one) of the shifted history have been set
+      for (int i_burst = 0; i_burst < ((n_bursts > 1) ? n_bursts : 1); i_burst++) {
+        int i_ring = (gal->BubbleHead + i_burst) % N_HISTORY_SNAPS;
+        cr_assert(memcmp(&gal->Prefactor[i_ring], &ref_gal->Prefactor[i_burst], sizeof(double)) == 0,
+                  "Prefactor %d of galaxy %d differs at snapshot %d",
+                  i_burst,
+                  i_gal,
+                  snapshot);
+        cr_assert(memcmp(&gal->Times[i_ring], &ref_gal->Times[i_burst], sizeof(double)) == 0,
+                  "Times %d of galaxy %d differs at snapshot %d",
+                  i_burst,
+                  i_gal,
+                  snapshot);
+      }
+
+      if (gal->RmetalBubble > gal->Rvir)
+        n_outside_rvir++;
+      else if (gal->RmetalBubble > 0.0)
+        n_in_rvir++;
+    }
+  }
+
+  // The bubbles should have grown both within and beyond the virial radius
+  cr_expect(n_in_rvir > 0);
+  cr_expect(n_outside_rvir > 0);
+}
+#endif
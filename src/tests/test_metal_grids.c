@@ -0,0 +1,126 @@
+#define _MAIN
+#include <criterion/criterion.h>
+#include <meraxes.h>
+
+#if USE_MINI_HALOS
+#include "../core/metal_evo.h"
+#include "../core/misc_tools.h"
+#include <fftw3-mpi.h>
+#include <math.h>
+#include <mpi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GRID_DIM 16
+#define BOX_SIZE 32.0
+#define SNAPSHOT 1
+#define N_GALS 2000
+
+static const int n_real = GRID_DIM * GRID_DIM * GRID_DIM;
+
+static galaxy_t gals[N_GALS];
+static int n_alive = 0;
+
+void setup(void)
+{
+  int argc = 0;
+  char** argv = NULL;
+
+  MPI_Init(&argc, &argv);
+  fftwf_mpi_init();
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  run_globals.mpi_rank = 0;
+  run_globals.mpi_size = 1;
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  run_params_t* params = &(run_globals.params);
+  params->Flag_IncludeMetalEvo = 1;
+  params->MetalGridDim = GRID_DIM;
+  params->BoxSize = BOX_SIZE;
+
+  // The per-property path doesn't need the record buffer, so allocate it up front to allow switching
+  params->MetalFusedGrids = 1;
+
+  run_globals.ZZ = malloc(sizeof(double) * (SNAPSHOT + 1));
+  run_globals.ZZ[SNAPSHOT - 1] = 10.5;
+  run_globals.ZZ[SNAPSHOT] = 10.0;
+
+  malloc_metal_grids();
+
+  // Clustered galaxies (so that many share a cell), with a mix of bubble sizes and some dead galaxies
+  srand(8542);
+  n_alive = 0;
+  for (int ii = 0; ii < N_GALS; ii++) {
+    galaxy_t* gal = &gals[ii];
+    memset(gal, 0, sizeof(galaxy_t));
+
+    int i_clump = rand() % 40;
+    for (int jj = 0; jj < 3; jj++) {
+      double centre = fmod(i_clump * (7.3 + 2.1 * jj), BOX_SIZE);
+      double offset = 2.0 * ((double)rand() / RAND_MAX - 0.5);
+      gal->Pos[jj] = (float)fmod(centre + offset + BOX_SIZE, BOX_SIZE);
+    }
+
+    gal->Type = (ii % 17 == 0) ? 3 : ii % 3;
+    gal->Rvir = 0.01 + 0.02 * (double)rand() / RAND_MAX;
+    gal->RmetalBubble = (ii % 5 == 0) ? 0.0 : 0.15 * (double)rand() / RAND_MAX;
+    gal->HotGas = 1e-2 * (double)rand() / RAND_MAX;
+    gal->ColdGas = 1e-2 * (double)rand() / RAND_MAX;
+    gal->EjectedGas = 1e-2 * (double)rand() / RAND_MAX;
+    gal->MetalsEjectedGas = 1e-4 * (double)rand() / RAND_MAX;
+    gal->Next = (ii < N_GALS - 1) ? &gals[ii + 1] : NULL;
+
+    if (gal->Type < 3)
+      n_alive++;
+  }
+  run_globals.FirstGal = &gals[0];
+}
+
+void teardown(void)
+{
+  free_metal_grids();
+  free(run_globals.ZZ);
+  fftwf_mpi_cleanup();
+  MPI_Finalize();
+}
+
+TestSuite(metal_grids, .init = setup, .fini = teardown);
+
+Test(metal_grids, fused_matches_per_property)
+{
+  metal_grids_t* grids = &(run_globals.metal_grids);
+  float* per_property[6];
+  float* fused[6] = {
+    grids->Probability_metals, grids->N_bubbles, grids->R_ave, grids->R_max, grids->mass_metals, grids->mass_gas
+  };
+  const char* names[6] = { "Probability_metals", "N_bubbles", "R_ave", "R_max", "mass_metals", "mass_gas" };
+
+  cr_assert_eq(map_galaxies_to_slabs_metals(n_alive), n_alive);
+
+  run_globals.params.MetalFusedGrids = 0;
+  construct_metal_grids(SNAPSHOT, n_alive);
+  for (int ii = 0; ii < 6; ii++) {
+    per_property[ii] = malloc(sizeof(float) * n_real);
+    memcpy(per_property[ii], fused[ii], sizeof(float) * n_real);
+  }
+
+  // The test galaxies should exercise every property
+  int n_polluted = 0;
+  for (int ii = 0; ii < n_real; ii++)
+    if (per_property[0][ii] > 0 && per_property[2][ii] > 0 && per_property[4][ii] > 0)
+      n_polluted++;
+  cr_assert(n_polluted > 10, "only %d cells are polluted", n_polluted);
+
+  run_globals.params.MetalFusedGrids = 1;
+  construct_metal_grids(SNAPSHOT, n_alive);
+
+  // The same deposits are made in the same order, so the grids should be bit identical
+  for (int ii = 0; ii < 6; ii++) {
+    cr_assert(memcmp(per_property[ii], fused[ii], sizeof(float) * n_real) == 0, "%s differs", names[ii]);
+    free(per_property[ii]);
+  }
+
+  free(grids->galaxy_to_slab_map_metals);
+  free(grids->slab_gal_offsets_metals);
+}
+#endif
@@ -0,0 +1,84 @@
+#define _MAIN
+#include "../core/misc_tools.h"
+#include "../core/reionization.h"
+#include <criterion/criterion.h>
+#include <meraxes.h>
+#include <mpi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_GALS 5000
+#define N_SLABS 7
+
+void setup(void)
+{
+  int argc = 0;
+  char** argv = NULL;
+
+  MPI_Init(&argc, &argv);
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  run_globals.mpi_rank = 0;
+  run_globals.mpi_size = 1;
+}
+
+void teardown(void)
+{
+  MPI_Finalize();
+}
+
+TestSuite(misc_tools, .init = setup, .fini = teardown);
+
+static void check_sort_slab_assign(int n_gals, int n_slabs, int empty_slab)
+{
+  static galaxy_t gals[N_GALS];
+  gal_to_slab_t* map = malloc(sizeof(gal_to_slab_t) * (n_gals + 1));
+  gal_to_slab_t* expected = malloc(sizeof(gal_to_slab_t) * (n_gals + 1));
+  int slab_offsets[N_SLABS + 1];
+
+  // The maps are built in galaxy index order, with the slabs shuffled
+  srand(1234 + n_gals);
+  for (int i_gal = 0; i_gal < n_gals; i_gal++) {
+    int slab = rand() % n_slabs;
+    if (slab == empty_slab)
+      slab = (slab + 1) % n_slabs;
+
+    map[i_gal].index = i_gal;
+    map[i_gal].galaxy = &gals[i_gal];
+    map[i_gal].slab_ind = slab;
+  }
+  memcpy(expected, map, sizeof(gal_to_slab_t) * n_gals);
+
+  qsort(expected, (size_t)n_gals, sizeof(gal_to_slab_t), compare_slab_assign);
+  sort_slab_assign(map, n_gals, n_slabs, slab_offsets);
+
+  // (compared field by field, as the struct padding isn't copied by the counting sort)
+  for (int i_gal = 0; i_gal < n_gals; i_gal++) {
+    cr_assert_eq(map[i_gal].index, expected[i_gal].index, "galaxy %d", i_gal);
+    cr_assert_eq(map[i_gal].galaxy, expected[i_gal].galaxy, "galaxy %d", i_gal);
+    cr_assert_eq(map[i_gal].slab_ind, expected[i_gal].slab_ind, "galaxy %d", i_gal);
+  }
+
+  // The galaxies of slab i_r are map[slab_offsets[i_r]] to map[slab_offsets[i_r + 1] - 1]
+  cr_expect_eq(slab_offsets[0], 0);
+  cr_expect_eq(slab_offsets[n_slabs], n_gals);
+  for (int i_r = 0; i_r < n_slabs; i_r++) {
+    cr_expect(slab_offsets[i_r] <= slab_offsets[i_r + 1], "slab %d", i_r);
+    for (int i_gal = slab_offsets[i_r]; i_gal < slab_offsets[i_r + 1]; i_gal++)
+      cr_assert_eq(expected[i_gal].slab_ind, i_r, "galaxy %d of slab %d", i_gal, i_r);
+  }
+  if (empty_slab >= 0)
+    cr_expect_eq(slab_offsets[empty_slab], slab_offsets[empty_slab + 1]);
+
+  free(expected);
+  free(map);
+}
+
+Test(misc_tools, sort_slab_assign_matches_qsort)
+{
+  check_sort_slab_assign(N_GALS, N_SLABS, -1);
+  check_sort_slab_assign(N_GALS, N_SLABS, 0);
+  check_sort_slab_assign(N_GALS, N_SLABS, N_SLABS - 1);
+  check_sort_slab_assign(N_GALS, 1, -1);
+  check_sort_slab_assign(3, N_SLABS, 2);
+  check_sort_slab_assign(0, N_SLABS, -1);
+}
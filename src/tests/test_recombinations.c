@@ -0,0 +1,87 @@
+#define _MAIN
+#include "../core/recombinations.h"
+#include <criterion/criterion.h>
+#include <math.h>
+#include <meraxes.h>
+#include <mpi.h>
+
+void setup(void)
+{
+  int argc = 0;
+  char** argv = NULL;
+
+  MPI_Init(&argc, &argv);
+  run_globals.mpi_comm = MPI_COMM_WORLD;
+  run_globals.mpi_rank = 0;
+  run_globals.mpi_size = 1;
+  init_mlog(MPI_COMM_WORLD, stdout, stdout, stderr);
+
+  run_globals.params.physics.Y_He = 0.24;
+  init_MHR();
+}
+
+void teardown(void)
+{
+  free_MHR();
+  MPI_Finalize();
+}
+
+TestSuite(recombinations, .init = setup, .fini = teardown);
+
+static double rel_err(double val, double ref)
+{
+  return fabs(val - ref) / fabs(ref);
+}
+
+Test(recombinations, spline_nodes)
+{
+  // At the redshift nodes the bilinear table should reproduce the gamma splines it was sampled from
+  const double lnGamma_max = RR_lnGamma_min + RR_DEL_lnGamma * (RR_lnGamma_NPTS - 1);
+  double max_err = 0.0;
+
+  for (int z_ct = 0; z_ct < RR_Z_NPTS; z_ct += 7) {
+    double z = z_ct * RR_DEL_Z;
+    for (double lnGamma = RR_lnGamma_min; lnGamma < lnGamma_max; lnGamma += 0.0137) {
+      double gamma12 = exp(lnGamma);
+      double err = rel_err(tabulated_recombination_rate(z, gamma12), splined_recombination_rate(z, gamma12));
+      max_err = err > max_err ? err : max_err;
+    }
+  }
+
+  cr_expect_lt(max_err, 1e-3, "max relative error of %g", max_err);
+}
+
+Test(recombinations, off_nodes)
+{
+  // Between the redshift nodes compare against the direct integral (which itself has a 1% tolerance)
+  const double z_vals[] = { 5.13, 6.71, 8.05, 10.37, 14.92, 19.66 };
+  const double gamma12_vals[] = { 1e-4, 3e-3, 0.05, 0.7, 2.5 };
+  double max_err = 0.0;
+
+  for (int ii = 0; ii < (int)(sizeof(z_vals) / sizeof(double)); ii++)
+    for (int jj = 0; jj < (int)(sizeof(gamma12_vals) / sizeof(double)); jj++) {
+      double ref = recombination_rate(z_vals[ii], gamma12_vals[jj], 1, 1);
+      double err = rel_err(tabulated_recombination_rate(z_vals[ii], gamma12_vals[jj]), ref);
+      max_err = err > max_err ? err : max_err;
+    }
+
+  cr_expect_lt(max_err, 2e-2, "max relative error of %g", max_err);
+}
+
+Test(recombinations, bounds)
+{
+  const double lnGamma_max = RR_lnGamma_min + RR_DEL_lnGamma * (RR_lnGamma_NPTS - 1);
+  const double z_max = (RR_Z_NPTS - 1) * RR_DEL_Z;
+
+  // no recombinations below the bottom of the table (including no ionising background at all)
+  cr_expect_eq(tabulated_recombination_rate(7.0, 0.0), 0.0);
+  cr_expect_eq(tabulated_recombination_rate(7.0, exp(RR_lnGamma_min - 0.5)), 0.0);
+
+  // everything else is clamped to the edges of the table
+  cr_expect_lt(rel_err(tabulated_recombination_rate(-0.5, 0.1), tabulated_recombination_rate(0.0, 0.1)), 1e-6);
+  cr_expect_lt(rel_err(tabulated_recombination_rate(z_max + 10.0, 0.1), tabulated_recombination_rate(z_max, 0.1)),
+               1e-6);
+  cr_expect_lt(rel_err(tabulated_recombination_rate(7.0, exp(lnGamma_max + 2.0)),
+                       tabulated_recombination_rate(7.0, exp(lnGamma_max))),
+               1e-6);
+}